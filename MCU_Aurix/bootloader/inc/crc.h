@@ -11,7 +11,7 @@
  *  - ReflectIn     = True
  *  - XorOut        = 0xffffffff
  *  - ReflectOut    = True
- *  - Algorithm     = bit-by-bit-fast
+ *  - Algorithm     = bit-by-bit-fast, table-driven (slicing-by-4/8), see CRC_ALGO
  *
  * This file defines the functions crc_init(), crc_update() and crc_finalize().
  *
@@ -49,12 +49,23 @@ extern "C" {
 
 
 /**
- * The definition of the used algorithm.
+ * The definition of the available algorithms.
  *
- * This is not used anywhere in the generated code, but it may be used by the
- * application code to call algorithm-specific code, if desired.
+ * All of them calculate the same CRC. The table-driven variants process 4 or 8
+ * bytes per step with the constant tables of crc.c (placed in flash), the
+ * bit-by-bit-fast variant needs no table but 8 shifts per byte.
  */
 #define CRC_ALGO_BIT_BY_BIT_FAST 1
+#define CRC_ALGO_SLICING_BY_4    2
+#define CRC_ALGO_SLICING_BY_8    3
+
+
+/**
+ * The algorithm used by crc_update() and crc_finalize(), selected at compile time.
+ */
+#ifndef CRC_ALGO
+#define CRC_ALGO                 CRC_ALGO_SLICING_BY_8
+#endif
 
 
 /**
@@ -97,6 +108,42 @@ static inline crc_t crc_init(void)
 crc_t crc_update(crc_t crc, const void *data, size_t data_len);
 
 
+/**
+ * Update the crc value with new data, single algorithms independent of CRC_ALGO.
+ *
+ * The bit-by-bit-fast variant keeps the crc value unreflected, the table-driven
+ * variants keep it reflected. Therefore the crc values of different variants
+ * must not be mixed before they are finalized with the matching function.
+ */
+crc_t crc_update_bit_by_bit_fast(crc_t crc, const void *data, size_t data_len);
+crc_t crc_update_slicing_by_4(crc_t crc, const void *data, size_t data_len);
+crc_t crc_update_slicing_by_8(crc_t crc, const void *data, size_t data_len);
+
+
+/**
+ * Calculate the final crc value of the bit-by-bit-fast variant.
+ *
+ * \param[in] crc  The current crc value.
+ * \return     The final crc value.
+ */
+static inline crc_t crc_finalize_bit_by_bit_fast(crc_t crc)
+{
+    return crc_reflect(crc, 32) ^ 0xffffffff;
+}
+
+
+/**
+ * Calculate the final crc value of the table-driven variants.
+ *
+ * \param[in] crc  The current crc value.
+ * \return     The final crc value.
+ */
+static inline crc_t crc_finalize_table_driven(crc_t crc)
+{
+    return crc ^ 0xffffffff;
+}
+
+
 /**
  * Calculate the final crc value.
  *
@@ -105,7 +152,11 @@ crc_t crc_update(crc_t crc, const void *data, size_t data_len);
  */
 static inline crc_t crc_finalize(crc_t crc)
 {
-    return crc_reflect(crc, 32) ^ 0xffffffff;
+#if CRC_ALGO == CRC_ALGO_BIT_BY_BIT_FAST
+    return crc_finalize_bit_by_bit_fast(crc);
+#else
+    return crc_finalize_table_driven(crc);
+#endif
 }
 
 
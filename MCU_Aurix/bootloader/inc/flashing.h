@@ -5,7 +5,7 @@
 //============================================================================
 // Name        : flashing.h
 // Author      : Dorothea Ehrl, Michael Bauer
-// Version     : 0.1
+// Version     : 0.6
 // Copyright   : MIT
 // Description : Manages flash data
 //============================================================================
@@ -16,18 +16,62 @@
 #define FLASHING_FLASHING_ENDIANNESS            (0)     // 0 = Big-endian, 1=Little-endian; // TODO: Other format necessary? Big vs. Little Endian
 #define FLASHING_GOOD_KEY_STORED_ENDIANNESS     (1)     // 0 = Big-endian, 1=Little-endian; // TODO: Other format necessary? Big vs. Little Endian
 
+#define FLASHING_PIPELINED_TRANSFER_DATA        (1)     // 1 = TransferData is confirmed before programming, the next block is received while the flash is busy; 0 = Program before the response
+#define FLASHING_BUFFERS                        (2)     // Number of TransferData blocks buffered for programming
+#define FLASHING_TRANSFER_DATA_HEADER           (5)     // SID + address in front of the data of a TransferData request
+#define FLASHING_SECTOR_CHECKSUMS               (256)   // Max sectors per Request Upload with FBL_CHECKSUM_MODE_SECTOR_MAP (4 MB)
+#define FLASHING_ERASE_AHEAD                    (1)     // 1 = The sectors of a download are erased after Request Download while no TransferData is pending; 0 = Erased by the first TransferData writing into them
+#define FLASHING_ERASE_AHEAD_SECTORS            (1)     // Logical PFLASH sectors erased ahead per cyclic call, the CAN RX is blocked meanwhile
+
 #include "Ifx_Types.h"
 #include <stdint.h>
+#include <stdbool.h>
+
+enum FLASHING_STATE {FLASHING_DOWNLOAD, FLASHING_UPLOAD, FLASHING_TRANSFER_DATA, FLASHING_IDLE};
+
+typedef struct {
+    uint32_t address;
+    size_t len;                 // Number of uint32_t values in flashBuffer
+    uint8_t pending;            // Data is not programmed yet
+} Flashing_Buffer;
+
+typedef struct {
+    uint32_t buffer;
+    uint32_t startAddr;
+    uint32_t endAddr;
+    uint32_t eraseAddr;         // Next address to be erased ahead of the TransferData (FLASHING_ERASE_AHEAD), endAddr + 1 once done
+    enum FLASHING_STATE state;
+    uint8_t dataFormat;         // FBL_DATA_FORMAT_UNCOMPRESSED or _LZ4, selected by Request Download
+    uint32_t checksum;
+    uint8_t checksumMode;       // FBL_CHECKSUM_MODE_ASCII, _RAW or _SECTOR_MAP, selected by the tester via FBL_DID_CHECKSUM_MODE
+    uint32_t numSectorChecksums;// Valid entries of flashSectorChecksums after a Request Upload with FBL_CHECKSUM_MODE_SECTOR_MAP
+    Flashing_Buffer buffers[FLASHING_BUFFERS];
+    uint8_t fillIdx;            // Next buffer for TransferData
+    uint8_t programIdx;         // Oldest buffer waiting for programming
+    uint8_t programError;       // Programming of a buffer failed after its TransferData was confirmed
+    uint32_t programmedStart;   // Start address of the last download, kept after TransferExit (FBL_DID_PROGRAMMED_OFFSET)
+    uint32_t programmedEnd;     // End of the data of the last download that is programmed without a gap, programmedStart if none
+    uint8_t pipelined;          // TransferData is confirmed before programming, FLASHING_PIPELINED_TRANSFER_DATA after flashingInit
+} Flashing_Internal;
 
 void flashingInit(void);
+void flashingProcess(void);
+uint8_t flashingBusy(void);
 
-uint8_t flashingRequestDownload(uint32_t address, uint32_t data_len);
+uint8_t flashingRequestDownload(uint32_t address, uint32_t data_len, uint8_t data_format);
 uint8_t flashingRequestUpload(uint32_t address, uint32_t data_len);
 uint8_t flashingTransferData(uint32_t address, uint8_t* data, uint32_t data_len);
 uint8_t flashingTransferExit(uint32_t address);
 
 uint32_t flashingGetFlashBufferSize(void);
 uint32_t flashingGetChecksum();
+uint8_t flashingGetChecksumMode(void);
+uint8_t flashingSetChecksumMode(uint8_t mode);
+void flashingSetPipelined(uint8_t pipelined);
+uint32_t flashingGetSectorChecksums(const uint32_t **checksums);
+uint32_t flashingGetEraseProgress(uint32_t *total);
+uint32_t flashingGetProgrammedOffset(uint32_t *start);
+bool flashingAddrInRange(uint32_t address, uint32_t data_len);
 uint32_t flashingGetGoodKey(void);
 uint32_t flashingGetGoodKeyStored(void);
 
@@ -5,14 +5,22 @@
 //============================================================================
 // Name        : isotp.h
 // Author      : Leon Wilms, Michael Bauer
-// Version     : 0.2
+// Version     : 0.3
 // Copyright   : MIT
 // Description : ISO-TP stack
 //============================================================================
 #ifndef BOOTLOADER_INC_ISOTP_H_
 #define BOOTLOADER_INC_ISOTP_H_
 
-#define ISOTP_RX_ACK_CONSECUTIVE_FRAMES    (1)
+#define ISOTP_RX_MODE_ACK                  (0)     // Legacy: Flow Control with BS=0/STmin=0 and 1 byte ACK for every Consecutive Frame
+#define ISOTP_RX_MODE_FLOW_CONTROL         (1)     // ISO 15765-2: Flow Control with BS/STmin, sender streams whole blocks
+#define ISOTP_RX_MODE                      (ISOTP_RX_MODE_FLOW_CONTROL)
+
+#define ISOTP_RX_FC_BLOCK_SIZE             (32)    // Consecutive Frames per block, 0 = all Consecutive Frames without further Flow Control
+#define ISOTP_RX_FC_ST_MIN                 (0)     // Separation Time minimum in ms requested from the sender
+#define ISOTP_RX_FC_BLOCK_SIZE_BUSY        (CAN_RX_FIFO0_SIZE) // Max Consecutive Frames per block while the flash is programmed, the RX FIFO holds the block while the interrupts are locked
+
+#define ISOTP_RX_ACK_CONSECUTIVE_FRAMES    (ISOTP_RX_MODE == ISOTP_RX_MODE_ACK)
 
 #include "can_driver.h"
 #include "uds_comm_spec.h"
@@ -47,6 +55,8 @@ typedef struct isoTp_RX
     uint32_t data_in_len;
     uint8_t ready_to_read; // bool that will be set to =! 0 if message can be read.
     uint8_t last_consecutive_ctr;
+    uint8_t block_ctr;          // Consecutive Frames received in the current block (Flow Control mode)
+    uint8_t block_size;         // BS granted by the last Flow Control, 0 = no further Flow Control
 
 }isoTP_RX;
 
@@ -70,6 +80,7 @@ void close_isoTP(isoTP* iso);
 // TX
 //============================================================================
 void isotp_send(isoTP* iso, uint8_t* data, uint32_t data_in_len);
+uint8_t isotp_get_max_len_per_frame(void);
 
 
 //============================================================================
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : lz4.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Decompression of LZ4 blocks (Transfer Data with FBL_DATA_FORMAT_LZ4)
+//============================================================================
+
+#ifndef BOOTLOADER_INC_LZ4_H_
+#define BOOTLOADER_INC_LZ4_H_
+
+#define LZ4_MIN_MATCH               (4)     // Match length encoded as 0 in the token
+
+#include <stdint.h>
+
+int32_t lz4DecompressBlock(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_capacity);
+
+#endif /* BOOTLOADER_INC_LZ4_H_ */
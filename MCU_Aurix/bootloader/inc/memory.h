@@ -6,7 +6,7 @@
 //============================================================================
 // Name        : memory.h
 // Author      : Dorothea Ehrl, Sebastian Rodriguez, Michael Bauer
-// Version     : 0.3
+// Version     : 0.7
 // Copyright   : MIT
 // Description : Manages writing and returning data in memory
 //============================================================================
@@ -17,11 +17,20 @@
 #include <stdint.h>
 
 #include "Ifx_Types.h"
+#include "perf_counters.h"
 
 #define DID_DATA_FLASH_ADDR                                         0xAF000000
 #define FBL_STRUCTURE_VERSION                                       (4)
 #define FBL_STRUCTURE_DATA_FLASH_STRUCTURE_VERSION                  {0x00, 0x00, 0x00, 0x02} // INFO: Change if Structure or Default Data changed, forces loading of Default config
 
+// DID Log: A write of a DID appends one record to the active sector, only a full sector is compacted into the other one
+#define MEMORY_DID_LOG                                              (1)     // 1 = Append-only DID log in the data flash, 0 = Whole data block is erased and programmed per write
+#define DID_LOG_SECTORS                                             (2)     // Sectors used alternately by the log, starting at DID_DATA_FLASH_ADDR
+#define DID_LOG_SECTOR_SIZE                                         (0x1000)// Size of a DFLASH sector in bytes
+#define DID_LOG_MAGIC                                               0x4C444944  // "DIDL", header of a valid log sector
+#define DID_LOG_RECORD_MARKER                                       (0xA5)  // Marks a programmed record, erased flash reads 0
+#define DID_LOG_ALIGNMENT                                           (8)     // Records start at a DFLASH page
+
 // Size in uint8_t bytes
 // Info: Changing of size may effect other modules -> Flashing
 #define FBL_DID_APP_ID_BYTES_SIZE                                   (32)
@@ -31,6 +40,10 @@
 #define FBL_DID_BL_KEY_GOOD_VALUE_BYTES_SIZE                        (4)
 #define FBL_DID_CAN_BASE_MASK_BYTES_SIZE                            (2)
 #define FBL_DID_CAN_ID_BYTES_SIZE                                   (2)
+#define FBL_DID_CHECKSUM_MODE_BYTES_SIZE                            (1)
+#define FBL_DID_ERASE_PROGRESS_BYTES_SIZE                           (8)
+#define FBL_DID_PROGRAMMED_OFFSET_BYTES_SIZE                        (8)
+#define FBL_DID_PERF_COUNTERS_BYTES_SIZE                            (PERF_COUNTERS_BYTES_SIZE)
 #define FBL_DID_BL_WRITE_START_ADD_CORE0_BYTES_SIZE                 (4)
 #define FBL_DID_BL_WRITE_END_ADD_CORE0_BYTES_SIZE                   (4)
 #define FBL_DID_BL_WRITE_START_ADD_CORE1_BYTES_SIZE                 (4)
@@ -62,13 +75,69 @@
 #define FBL_DID_BL_WRITE_START_ADD_CAL_DATA_DEFAULT                 {0xA0, 0x4F, 0xC0, 0x00}
 #define FBL_DID_BL_WRITE_END_ADD_CAL_DATA_DEFAULT                   {0xA0, 0x4F, 0xFF, 0xFF}
 
+// Memory Layout
+#define MEMORY_LAYOUT_REGIONS                                       (5)     // Number of write address ranges (Core 0..2, ASW Key, Cal Data)
+
 //KEY
 #define KEY_ADDRESS                                                 0xA04F8000
 #define KEY_GOOD_VALUE                                              0x9386C3A5
+//============================================================================
+// Persistent Data
+//============================================================================
+
+// Current value of the DIDs stored in the data flash
+typedef struct {
+        uint8_t did_structure_version[FBL_STRUCTURE_VERSION];
+        uint8_t did_app_id[FBL_DID_APP_ID_BYTES_SIZE];
+        uint8_t did_system_name[FBL_DID_SYSTEM_NAME_BYTES_SIZE];
+        uint8_t did_programming_date[FBL_DID_PROGRAMMING_DATE_BYTES_SIZE];
+        uint8_t did_bl_key_address[FBL_DID_BL_KEY_ADDRESS_BYTES_SIZE];
+        uint8_t did_bl_key_good_value[FBL_DID_BL_KEY_GOOD_VALUE_BYTES_SIZE];
+        uint8_t did_can_base_mask[FBL_DID_CAN_BASE_MASK_BYTES_SIZE];
+        uint8_t did_can_id[FBL_DID_CAN_ID_BYTES_SIZE];
+        uint8_t did_bl_write_start_add_core0[FBL_DID_BL_WRITE_START_ADD_CORE0_BYTES_SIZE];
+        uint8_t did_bl_write_end_add_core0[FBL_DID_BL_WRITE_END_ADD_CORE0_BYTES_SIZE];
+        uint8_t did_bl_write_start_add_core1[FBL_DID_BL_WRITE_START_ADD_CORE1_BYTES_SIZE];
+        uint8_t did_bl_write_end_add_core1[FBL_DID_BL_WRITE_END_ADD_CORE1_BYTES_SIZE];
+        uint8_t did_bl_write_start_add_core2[FBL_DID_BL_WRITE_START_ADD_CORE2_BYTES_SIZE];
+        uint8_t did_bl_write_end_add_core2[FBL_DID_BL_WRITE_END_ADD_CORE2_BYTES_SIZE];
+        uint8_t did_bl_write_start_add_asw_key[FBL_DID_BL_WRITE_START_ADD_ASW_KEY_BYTES_SIZE];
+        uint8_t did_bl_write_end_add_asw_key[FBL_DID_BL_WRITE_END_ADD_ASW_KEY_BYTES_SIZE];
+        uint8_t did_bl_write_start_add_cal_data[FBL_DID_BL_WRITE_START_ADD_CAL_DATA_BYTES_SIZE];
+        uint8_t did_bl_write_end_add_cal_data[FBL_DID_BL_WRITE_END_ADD_CAL_DATA_BYTES_SIZE];
+} Memory_Data;
+
+// Active sector of the DID log (MEMORY_DID_LOG), found by init_memory
+typedef struct {
+        uint32_t sector;                                    // Address of the active log sector, 0 if there is none
+        uint32_t sequence;                                  // Sequence number of the active log sector
+        uint32_t offset;                                    // Offset of the next free record in the active log sector
+} Memory_Log;
+
+//============================================================================
+// Memory Layout
+//============================================================================
+
+// Index of the regions in Memory_Layout
+enum MEMORY_REGION {MEMORY_REGION_CORE0, MEMORY_REGION_CORE1, MEMORY_REGION_CORE2, MEMORY_REGION_ASW_KEY, MEMORY_REGION_CAL_DATA};
+
+typedef struct {
+        uint32_t start_addr;
+        uint32_t end_addr;
+} Memory_Region;
+
+// Decoded layout DIDs, rebuilt by init_memory and writeData whenever one of them changes
+typedef struct {
+        Memory_Region regions[MEMORY_LAYOUT_REGIONS];
+        uint32_t key_address;
+        uint32_t key_good_value;
+} Memory_Layout;
+
 //============================================================================
 // Init
 //============================================================================
 void init_memory(void);
+const Memory_Layout* getMemoryLayout(void);
 
 //============================================================================
 // Identification
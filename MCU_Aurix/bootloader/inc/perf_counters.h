@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : perf_counters.h
+// Author      : Michael Bauer
+// Version     : 0.2
+// Copyright   : MIT
+// Description : Performance counters of the bootloader, readable via FBL_DID_PERF_COUNTERS
+//============================================================================
+
+#ifndef BOOTLOADER_INC_PERF_COUNTERS_H_
+#define BOOTLOADER_INC_PERF_COUNTERS_H_
+
+#define PERF_COUNTERS                           (1)     // 1 = Timings and events are counted (FBL_DID_PERF_COUNTERS), 0 = Nothing is counted, the DID reads 0
+
+#include <stdint.h>
+
+#include "Ifx_Types.h"
+#include "Bsp.h"
+
+// Timed sections, the order is the order within FBL_DID_PERF_COUNTERS - only append new sections
+typedef enum {
+    PERF_ERASE,                 // Erase of PFLASH/DFLASH sectors (flash driver)
+    PERF_PROGRAM,               // Programming of PFLASH/DFLASH pages (flash driver)
+    PERF_CRC,                   // Checksum of a flash range for Request Upload (flash driver)
+    PERF_ISOTP_RX,              // Processing of one received CAN frame by ISO TP, called from the CAN RX interrupt
+    PERF_UDS_REQUEST,           // Handling of one UDS request including the response
+    PERF_SECTIONS
+} Perf_Section;
+
+typedef struct {
+    uint32_t count;             // Number of measurements
+    uint64_t ticks;             // Sum of the measured STM ticks
+    uint32_t max_ticks;         // Longest measurement in STM ticks
+} Perf_Counter;
+
+typedef struct {
+    Perf_Counter sections[PERF_SECTIONS];
+    uint32_t negative_responses;        // Negative responses sent, including the ones below
+    uint32_t busy_repeat_responses;     // Negative responses with FBL_RC_BUSY_REPEAT_REQUEST (ISO TP buffer still occupied)
+    uint32_t rx_fifo_overrun_events;    // Overruns of the RX FIFO 0 seen by the RX interrupt, each one lost at least one CAN frame (e.g. while the interrupts are locked for PFLASH)
+} Perf_Counters;
+
+#define PERF_COUNTERS_BYTES_SIZE        (4 + 1 + PERF_SECTIONS * 16 + 3 * 4)    // Serialized size, see FBL_DID_PERF_COUNTERS
+
+//============================================================================
+// Counting
+//============================================================================
+
+Ifx_TickTime perfStart(void);
+void perfStop(Perf_Section section, Ifx_TickTime start);
+void perfCountNegativeResponse(uint8_t neg_code);
+void perfCountRxFifoOverrun(void);
+
+//============================================================================
+// Readout
+//============================================================================
+
+void perfReset(void);
+void perfSerialize(uint8_t *data);
+
+#endif /* BOOTLOADER_INC_PERF_COUNTERS_H_ */
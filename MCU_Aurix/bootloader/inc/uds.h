@@ -54,7 +54,7 @@ void uds_read_memory_by_address(uint32_t address, uint16_t noBytesToRead);
 void uds_write_data_by_identifier(uint16_t did, uint8_t* data, uint8_t data_len);
 
 // Upload | Download
-void uds_request_download(uint32_t address, uint32_t data_len);
+void uds_request_download(uint32_t address, uint32_t data_len, uint8_t data_format);
 void uds_request_upload(uint32_t address, uint32_t data_len);
 void uds_transfer_data(uint32_t address, uint8_t* data, uint32_t data_len);
 void uds_request_transfer_exit(uint32_t address);
@@ -106,6 +106,9 @@ void cyclicProcessing (void){
         rx_reset_isotp_multi_buffer();
         time = now(); //Assumes no tester present was received
     }
+
+    // Program the confirmed TransferData while the next message is received by the CAN interrupt
+    flashingProcess();
     
     //After 5 seconds without communication AND Default Session AND the right goodKey in the Key Address -> Jump
     if (elapsed(time) > (5 * IfxStm_getFrequency(BSP_DEFAULT_TIMER)) &&
@@ -6,7 +6,7 @@
 //============================================================================
 // Name        : flashing.c
 // Author      : Dorothea Ehrl, Michael Bauer, Wiktor Pilarczyk
-// Version     : 0.1
+// Version     : 0.6
 // Copyright   : MIT
 // Description : Manages flash data
 //============================================================================
@@ -15,21 +15,14 @@
 
 #include "flashing.h"
 #include "uds_comm_spec.h"
+#include "lz4.h"
 #include "memory.h"
 #include "flash_driver.h"
 #include "flash_driver_TC375_LK.h"
 
-enum FLASHING_STATE {DOWNLOAD, UPLOAD, TRANSFER_DATA, IDLE};
-uint32_t flashBuffer[MAX_ISOTP_MESSAGE_LEN/4];
+uint32_t flashBuffer[FLASHING_BUFFERS][MAX_ISOTP_MESSAGE_LEN/4];
 uint32_t flashTransferDataCtr;
-
-typedef struct {
-    uint32_t buffer;
-    uint32_t startAddr;
-    uint32_t endAddr;
-    enum FLASHING_STATE state;
-    uint32_t checksum;
-} Flashing_Internal;
+uint32_t flashSectorChecksums[FLASHING_SECTOR_CHECKSUMS];
 
 Flashing_Internal flashing_int_data;
 
@@ -37,26 +30,9 @@ Flashing_Internal flashing_int_data;
 // Internal helper function
 //============================================================================
 
-uint32_t flashingGetDIDData(uint16_t DID){
-    uint32_t data = 0;
-
-    uint8_t len, nrc;
-    uint8_t *read = readData(DID, &len, &nrc);
-    if(!nrc){
-        if(len == 4){ // uint32_t
-            data |= (read[0] << 24);
-            data |= (read[1] << 16);
-            data |= (read[2] << 8);
-            data |= read[3];
-        }
-    }
-    free(read);
-    return data;
-}
-
-static inline bool addrInCoreRangeCheck(uint32_t addr, uint32_t data_len, uint16_t start_addr_ID, uint16_t end_addr_ID) {
-    uint32_t core_start_add = flashingGetDIDData(start_addr_ID);
-    uint32_t core_end_add = flashingGetDIDData(end_addr_ID);
+static inline bool addrInCoreRangeCheck(uint32_t addr, uint32_t data_len, const Memory_Region *region) {
+    uint32_t core_start_add = region->start_addr;
+    uint32_t core_end_add = region->end_addr;
     if((core_start_add > 0 && core_end_add > 0) && (addr >= core_start_add && addr < core_end_add)){
         // address belongs to core
         if(addr + (data_len-1) <= core_end_add)
@@ -65,7 +41,7 @@ static inline bool addrInCoreRangeCheck(uint32_t addr, uint32_t data_len, uint16
     return false;
 }
 
-static inline size_t insertDataForFlashing(uint8_t* data, uint32_t data_len){
+static inline size_t insertDataForFlashing(uint32_t* buffer, uint8_t* data, uint32_t data_len){
 
     uint32_t data_ctr = 0;
     size_t flash_ctr = 0;
@@ -73,7 +49,7 @@ static inline size_t insertDataForFlashing(uint8_t* data, uint32_t data_len){
     uint32 temp = 0;
     uint32 shifted = 0;
 
-    for(int idx = 0; idx < sizeof(flashBuffer) && data_ctr < data_len ; idx++){
+    for(int idx = 0; idx < sizeof(flashBuffer[0])/sizeof(uint32_t) && data_ctr < data_len ; idx++){
         temp = 0;
         shifted = 0;
 
@@ -91,12 +67,126 @@ static inline size_t insertDataForFlashing(uint8_t* data, uint32_t data_len){
                 break;
         }
 
-        flashBuffer[idx] = temp;
+        buffer[idx] = temp;
         flash_ctr++;
     }
     return flash_ctr;
 }
 
+/**
+ * @brief                       Decompresses a LZ4 block of TransferData directly into the flash buffer, without an
+ *                              additional copy of the data. The result is the same as of insertDataForFlashing.
+ *
+ * @param buffer                Flash buffer, at least flashing_int_data.buffer bytes
+ * @param data                  Compressed TransferData payload
+ * @param data_len              Number of compressed bytes
+ * @return                      Number of decompressed bytes, 0 or less if the block is corrupted or too big
+ */
+static inline int32_t decompressDataForFlashing(uint32_t* buffer, uint8_t* data, uint32_t data_len){
+    uint8_t *bytes = (uint8_t *)buffer;
+    int32_t len = lz4DecompressBlock(data, data_len, bytes, flashing_int_data.buffer);
+    if(len <= 0)
+        return len;
+
+    // Last word is filled up with 0
+    for(int32_t i = len; i % sizeof(uint32_t); i++)
+        bytes[i] = 0;
+
+    // Bytes are in memory order of the little-endian TriCore, which is FLASHING_FLASHING_ENDIANNESS 0
+    if(FLASHING_FLASHING_ENDIANNESS){
+        for(int32_t idx = 0; idx < (len + 3) / 4; idx++){
+            uint32 value = buffer[idx];
+            buffer[idx] = ((value>>24) & 0x000000ff) | ((value<<8) & 0x00ff0000) |
+                          ((value>>8)  & 0x0000ff00) | ((value<<24) & 0xff000000);
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief                       Programs the oldest pending flash buffer
+ *
+ * @return                      Returns 0 if nothing was pending or programming was successful, else 1
+ */
+static uint8_t programPendingBuffer(void){
+    Flashing_Buffer *buf = &flashing_int_data.buffers[flashing_int_data.programIdx];
+    if(!buf->pending)
+        return 0;
+
+    bool flashed = flashWrite(buf->address, flashBuffer[flashing_int_data.programIdx], buf->len);
+
+    buf->pending = 0;
+    flashing_int_data.programIdx = (flashing_int_data.programIdx + 1) % FLASHING_BUFFERS;
+
+    if(!flashed){
+        flashing_int_data.programError = 1;
+        flashing_int_data.programmedStart = 0;
+        flashing_int_data.programmedEnd = 0;
+        return 1;
+    }
+
+    // The programmed data of the download grows with every buffer continuing it, other data ends the tracking
+    if(buf->address == flashing_int_data.programmedEnd && flashing_int_data.programmedEnd != 0){
+        uint32_t end = buf->address + buf->len * sizeof(uint32_t);
+        flashing_int_data.programmedEnd = end > flashing_int_data.endAddr + 1 ? flashing_int_data.endAddr + 1 : end;
+    }
+    else{
+        flashing_int_data.programmedStart = 0;
+        flashing_int_data.programmedEnd = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief                       Programs all pending flash buffers
+ *
+ * @return                      Returns 0 if all data since the last Request Download was programmed, else FBL_RC_GENERAL_PROGRAMMING_FAILURE
+ */
+static uint8_t flushPendingBuffers(void){
+    for(int i = 0; i < FLASHING_BUFFERS; i++)
+        programPendingBuffer();
+
+    return flashing_int_data.programError ? FBL_RC_GENERAL_PROGRAMMING_FAILURE : 0;
+}
+
+/**
+ * @brief                       Erases the next sectors of the download (FLASHING_ERASE_AHEAD_SECTORS) that are not erased yet,
+ *                              flashWrite skips them afterwards. Ranges outside of the PFLASH are erased by flashWrite as before.
+ */
+static void eraseAhead(void){
+    if(flashing_int_data.state != FLASHING_TRANSFER_DATA || flashing_int_data.eraseAddr > flashing_int_data.endAddr)
+        return;
+
+    uint32_t stepEnd = flashing_int_data.eraseAddr - (flashing_int_data.eraseAddr % PFLASH_SECTOR_LENGTH)
+                       + FLASHING_ERASE_AHEAD_SECTORS * PFLASH_SECTOR_LENGTH - 1;
+    if(stepEnd > flashing_int_data.endAddr)
+        stepEnd = flashing_int_data.endAddr;
+
+    flashEraseProgram(flashing_int_data.eraseAddr, stepEnd - flashing_int_data.eraseAddr + 1);
+    flashing_int_data.eraseAddr = stepEnd + 1;
+}
+
+/**
+ * @brief                       Calculates the max data bytes of a TransferData (maxNumberOfBlockLength of Request Download).
+ *                              The (decompressed) data needs to fit one flash buffer, the uncompressed request the ISO TP buffer.
+ *
+ * @return                      Max data bytes per TransferData, a multiple of the PFLASH page length
+ */
+static uint32_t maxBlockLength(void){
+    uint32_t len = sizeof(flashBuffer[0]);
+    if(len > MAX_ISOTP_MESSAGE_LEN - FLASHING_TRANSFER_DATA_HEADER)
+        len = MAX_ISOTP_MESSAGE_LEN - FLASHING_TRANSFER_DATA_HEADER;
+    return len - (len % PFLASH_PAGE_LENGTH); // Full pages
+}
+
+static void resetBuffers(void){
+    for(int i = 0; i < FLASHING_BUFFERS; i++)
+        flashing_int_data.buffers[i].pending = 0;
+    flashing_int_data.fillIdx = 0;
+    flashing_int_data.programIdx = 0;
+    flashing_int_data.programError = 0;
+}
+
 //============================================================================
 // Public
 //============================================================================
@@ -104,35 +194,84 @@ void flashingInit(void){
     flashing_int_data.buffer = 0;
     flashing_int_data.startAddr = 0;
     flashing_int_data.endAddr = 0;
-    flashing_int_data.state = IDLE;
+    flashing_int_data.eraseAddr = 0;
+    flashing_int_data.state = FLASHING_IDLE;
+    flashing_int_data.dataFormat = FBL_DATA_FORMAT_UNCOMPRESSED;
+    flashing_int_data.checksumMode = FBL_CHECKSUM_MODE_ASCII;
+    flashing_int_data.numSectorChecksums = 0;
+    flashing_int_data.programmedStart = 0;
+    flashing_int_data.programmedEnd = 0;
+    flashing_int_data.pipelined = FLASHING_PIPELINED_TRANSFER_DATA;
+    resetBuffers();
 }
 
-uint8_t flashingRequestDownload(uint32_t address, uint32_t data_len){
+/**
+ * @brief                       Programs the oldest buffer of TransferData that is pending. Called cyclically,
+ *                              the next TransferData is received by the CAN interrupt in the meantime.
+ *                              Without pending data the next sectors of the download are erased ahead.
+ */
+void flashingProcess(void){
+    if(flashing_int_data.buffers[flashing_int_data.programIdx].pending)
+        programPendingBuffer();
+    else if(FLASHING_ERASE_AHEAD)
+        eraseAhead();
+}
+
+/**
+ * @brief                       Checks if flashingProcess still has to program or erase, the interrupts are locked meanwhile
+ *
+ * @return                      Returns 1 if a buffer is pending or sectors are left to be erased ahead, else 0
+ */
+uint8_t flashingBusy(void){
+    if(flashing_int_data.buffers[flashing_int_data.programIdx].pending)
+        return 1;
+    return FLASHING_ERASE_AHEAD && flashing_int_data.state == FLASHING_TRANSFER_DATA
+           && flashing_int_data.eraseAddr <= flashing_int_data.endAddr;
+}
+
+uint8_t flashingRequestDownload(uint32_t address, uint32_t data_len, uint8_t data_format){
+
+    // Data of a previous download has to be in the flash before it is reset
+    flushPendingBuffers();
+    resetBuffers();
 
     // Not used since request download should always be able to reset
-    //if (flashing_int_data.state != IDLE)
+    //if (flashing_int_data.state != FLASHING_IDLE)
     //    return FBL_RC_UPLOAD_DOWNLOAD_NOT_ACCEPTED;
 
     // Check on Flash Memory to accept download
-    if(!addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_CORE0, FBL_DID_BL_WRITE_END_ADD_CORE0) &&
-       !addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_CORE1, FBL_DID_BL_WRITE_END_ADD_CORE1) &&
-       !addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_CORE2, FBL_DID_BL_WRITE_END_ADD_CORE2) &&
-       !addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_ASW_KEY, FBL_DID_BL_WRITE_END_ADD_ASW_KEY) &&
-       !addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_CAL_DATA, FBL_DID_BL_WRITE_END_ADD_CAL_DATA))
+    if(!flashingAddrInRange(address, data_len))
+    {
+        flashing_int_data.state = FLASHING_IDLE;
+        return FBL_RC_REQUEST_OUT_OF_RANGE;
+    }
+
+    // Compression of the TransferData payloads, no encryption supported
+    if(data_format != FBL_DATA_FORMAT_UNCOMPRESSED && data_format != FBL_DATA_FORMAT_LZ4)
     {
-        flashing_int_data.state = IDLE;
+        flashing_int_data.state = FLASHING_IDLE;
         return FBL_RC_REQUEST_OUT_OF_RANGE;
     }
+    flashing_int_data.dataFormat = data_format;
+
+    // A download starting at the end of the programmed data of the last one continues it (e.g. the tester was interrupted).
+    // The rest of the partly programmed sector is still erased, erasing the sector again would delete its programmed part.
+    if(address == flashing_int_data.programmedEnd && flashing_int_data.programmedEnd != flashing_int_data.programmedStart
+       && address % PFLASH_SECTOR_LENGTH != 0)
+        flashSetSectorErased(address);
+    flashing_int_data.programmedStart = address;
+    flashing_int_data.programmedEnd = address;
 
     // Store base address for flashing
     flashing_int_data.startAddr = address;
     flashing_int_data.endAddr = flashing_int_data.startAddr + data_len - 1; // Idx 0 also counts
+    flashing_int_data.eraseAddr = FLASHING_ERASE_AHEAD ? flashing_int_data.startAddr : flashing_int_data.endAddr + 1;
 
     // Identify the max package size
-    flashing_int_data.buffer = MAX_ISOTP_MESSAGE_LEN - PFLASH_PAGE_LENGTH; // Excluding: SID + address (5 bytes), keep some buffer, try to keep pages
+    flashing_int_data.buffer = maxBlockLength();
 
     // Setup Flashing Mode
-    flashing_int_data.state = TRANSFER_DATA;
+    flashing_int_data.state = FLASHING_TRANSFER_DATA;
 
     // Reset the TransferData counter
     flashTransferDataCtr = 0;
@@ -142,40 +281,73 @@ uint8_t flashingRequestDownload(uint32_t address, uint32_t data_len){
 
 uint8_t flashingRequestUpload(uint32_t address, uint32_t data_len){
     
-    if(!addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_CORE0, FBL_DID_BL_WRITE_END_ADD_CORE0) &&
-       !addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_CORE1, FBL_DID_BL_WRITE_END_ADD_CORE1) &&
-       !addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_CORE2, FBL_DID_BL_WRITE_END_ADD_CORE2) &&
-       !addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_ASW_KEY, FBL_DID_BL_WRITE_END_ADD_ASW_KEY) &&
-       !addrInCoreRangeCheck(address, data_len, FBL_DID_BL_WRITE_START_ADD_CAL_DATA, FBL_DID_BL_WRITE_END_ADD_CAL_DATA))
+    if(!flashingAddrInRange(address, data_len))
     {
         return FBL_RC_REQUEST_OUT_OF_RANGE;
     }
-    
-    flashing_int_data.checksum = flashCalculateChecksum(address, data_len);
+
+    // Checksum has to cover the pending data as well
+    flushPendingBuffers();
+
+    flashing_int_data.numSectorChecksums = 0;
+    if(flashing_int_data.checksumMode == FBL_CHECKSUM_MODE_SECTOR_MAP){
+        // One checksum for every sector touched by the range, the tester compares them with the sectors of its image
+        uint32_t firstSector = address - (address % FBL_CHECKSUM_SECTOR_LENGTH);
+        uint32_t numSectors = (address + (data_len-1) - firstSector) / FBL_CHECKSUM_SECTOR_LENGTH + 1;
+        if(numSectors > FLASHING_SECTOR_CHECKSUMS)
+            return FBL_RC_REQUEST_OUT_OF_RANGE;
+
+        for(uint32_t i = 0; i < numSectors; i++)
+            flashSectorChecksums[i] = flashCalculateChecksumRaw(firstSector + i * FBL_CHECKSUM_SECTOR_LENGTH, FBL_CHECKSUM_SECTOR_LENGTH);
+        flashing_int_data.numSectorChecksums = numSectors;
+        flashing_int_data.checksum = flashSectorChecksums[0];
+    }
+    else if(flashing_int_data.checksumMode == FBL_CHECKSUM_MODE_RAW)
+        flashing_int_data.checksum = flashCalculateChecksumRaw(address, data_len);
+    else
+        flashing_int_data.checksum = flashCalculateChecksum(address, data_len);
     
     return 0;
 }
 
 uint8_t flashingTransferData(uint32_t address, uint8_t* data, uint32_t data_len){
-    if (flashing_int_data.state != TRANSFER_DATA || flashing_int_data.startAddr == 0 || flashing_int_data.endAddr == 0)
+    if (flashing_int_data.state != FLASHING_TRANSFER_DATA || flashing_int_data.startAddr == 0 || flashing_int_data.endAddr == 0)
         return FBL_RC_REQUEST_SEQUENCE_ERROR;
 
-    if(address < flashing_int_data.startAddr || address+(data_len-1) > flashing_int_data.endAddr){ // Idx 0 also counts
+    // Compressed data is checked after the decompression
+    bool compressed = flashing_int_data.dataFormat == FBL_DATA_FORMAT_LZ4;
+    if(!compressed && (address < flashing_int_data.startAddr || address+(data_len-1) > flashing_int_data.endAddr)){ // Idx 0 also counts
         return FBL_RC_REQUEST_OUT_OF_RANGE;
     }
 
-    // Debugging
-    if(flashTransferDataCtr == 4){
-         __nop();
-    }
+    // Programming of a previous TransferData failed after its positive response
+    if(flashing_int_data.programError)
+        return FBL_RC_GENERAL_PROGRAMMING_FAILURE;
 
-    // Store flash data to temp flash buffer
-    size_t flashLen = insertDataForFlashing(data, data_len);
-    bool flashed = flashWrite(address, flashBuffer, flashLen);
+    // Both buffers are in use -> Program the oldest one to get a free buffer
+    Flashing_Buffer *buf = &flashing_int_data.buffers[flashing_int_data.fillIdx];
+    if(buf->pending && programPendingBuffer())
+        return FBL_RC_GENERAL_PROGRAMMING_FAILURE;
 
-    if(!flashed){
-        return FBL_RC_FAILURE_PREVENTS_EXEC_OF_REQUESTED_ACTION;
+    // Store flash data to temp flash buffer
+    if(compressed){
+        int32_t len = decompressDataForFlashing(flashBuffer[flashing_int_data.fillIdx], data, data_len);
+        if(len <= 0)
+            return FBL_RC_TRANSFER_DATA_SUSPENDED;
+        if(address < flashing_int_data.startAddr || address+(len-1) > flashing_int_data.endAddr) // Idx 0 also counts
+            return FBL_RC_REQUEST_OUT_OF_RANGE;
+
+        buf->len = (len + sizeof(uint32_t) - 1) / sizeof(uint32_t);
     }
+    else
+        buf->len = insertDataForFlashing(flashBuffer[flashing_int_data.fillIdx], data, data_len);
+    buf->address = address;
+    buf->pending = 1;
+    flashing_int_data.fillIdx = (flashing_int_data.fillIdx + 1) % FLASHING_BUFFERS;
+
+    // Without pipelining the data is programmed before the response
+    if(!flashing_int_data.pipelined && programPendingBuffer())
+        return FBL_RC_FAILURE_PREVENTS_EXEC_OF_REQUESTED_ACTION;
 
     flashTransferDataCtr++;
     return 0;
@@ -185,13 +357,18 @@ uint8_t flashingTransferExit(uint32_t address){
     if(address != 0 && flashing_int_data.startAddr != address)
         return FBL_RC_REQUEST_OUT_OF_RANGE;
 
+    // All data needs to be programmed before the transfer is confirmed
+    uint8_t nrc = flushPendingBuffers();
+    resetBuffers();
+
     flashing_int_data.startAddr = 0;
     flashing_int_data.endAddr = 0;
     flashing_int_data.buffer = 0;
+    flashing_int_data.dataFormat = FBL_DATA_FORMAT_UNCOMPRESSED;
     flashTransferDataCtr = 0;
 
-    flashing_int_data.state = IDLE;
-    return 0;
+    flashing_int_data.state = FLASHING_IDLE;
+    return nrc;
 }
 
 uint32_t flashingGetFlashBufferSize(void){
@@ -202,12 +379,97 @@ uint32_t flashingGetChecksum(void) {
     return flashing_int_data.checksum;
 }
 
+uint8_t flashingGetChecksumMode(void) {
+    return flashing_int_data.checksumMode;
+}
+
+/**
+ * @brief                       Selects the checksum calculation of Request Upload. Testers that don't know the
+ *                              FBL_DID_CHECKSUM_MODE keep getting the ASCII-Hex based checksum.
+ * @param mode                  FBL_CHECKSUM_MODE_ASCII, FBL_CHECKSUM_MODE_RAW or FBL_CHECKSUM_MODE_SECTOR_MAP
+ * @return                      0 if the mode is supported, otherwise the negative response code
+ */
+uint8_t flashingSetChecksumMode(uint8_t mode) {
+    if(mode != FBL_CHECKSUM_MODE_ASCII && mode != FBL_CHECKSUM_MODE_RAW && mode != FBL_CHECKSUM_MODE_SECTOR_MAP)
+        return FBL_RC_REQUEST_OUT_OF_RANGE;
+
+    flashing_int_data.checksumMode = mode;
+    return 0;
+}
+
+/**
+ * @brief                       Selects whether TransferData is confirmed before or after programming, e.g. for a comparison
+ *                              run of the simulated ECU. flashingInit restores FLASHING_PIPELINED_TRANSFER_DATA.
+ * @param pipelined             1 = Confirmed before programming, 0 = Programmed before the response
+ */
+void flashingSetPipelined(uint8_t pipelined) {
+    flashing_int_data.pipelined = pipelined;
+}
+
+/**
+ * @brief                       Returns the sector checksums of the last Request Upload with FBL_CHECKSUM_MODE_SECTOR_MAP.
+ *                              The first one covers the sector (FBL_CHECKSUM_SECTOR_LENGTH) containing the start address.
+ *
+ * @param checksums             Set to the checksums
+ * @return                      Number of checksums, 0 if the last Request Upload returns a single checksum
+ */
+uint32_t flashingGetSectorChecksums(const uint32_t **checksums) {
+    *checksums = flashSectorChecksums;
+    return flashing_int_data.numSectorChecksums;
+}
+
+/**
+ * @brief                       Returns how far the sectors of the current download are erased ahead of the TransferData.
+ *                              Without erase-ahead the download counts as erased, the sectors are erased while programming.
+ *
+ * @param total                 Set to the number of bytes of the Request Download, 0 if there is no download
+ * @return                      Number of bytes from the start address on that are erased, equal to total once done
+ */
+uint32_t flashingGetEraseProgress(uint32_t *total) {
+    if(flashing_int_data.state != FLASHING_TRANSFER_DATA){
+        *total = 0;
+        return 0;
+    }
+
+    *total = flashing_int_data.endAddr - flashing_int_data.startAddr + 1;
+    return flashing_int_data.eraseAddr - flashing_int_data.startAddr;
+}
+
+/**
+ * @brief                       Returns the data of the last download that is programmed, it is kept after TransferExit and
+ *                              session changes until the next Request Download. The tester continues an interrupted download
+ *                              with a Request Download at the start address plus the programmed bytes.
+ *
+ * @param start                 Set to the start address of the last download, 0 if the programmed data is unknown
+ * @return                      Number of bytes from the start address on that are programmed without a gap
+ */
+uint32_t flashingGetProgrammedOffset(uint32_t *start) {
+    *start = flashing_int_data.programmedStart;
+    return flashing_int_data.programmedEnd - flashing_int_data.programmedStart;
+}
+
+/**
+ * @brief                       Checks if the data is completely within one of the write address ranges of the memory layout
+ *
+ * @param address               Start address of the data
+ * @param data_len              Number of bytes
+ * @return                      True if the data may be written
+ */
+bool flashingAddrInRange(uint32_t address, uint32_t data_len){
+    const Memory_Layout *layout = getMemoryLayout();
+    for(int i = 0; i < MEMORY_LAYOUT_REGIONS; i++){
+        if(addrInCoreRangeCheck(address, data_len, &layout->regions[i]))
+            return true;
+    }
+    return false;
+}
+
 uint32_t flashingGetGoodKey(void){
-    return flashingGetDIDData(FBL_DID_BL_KEY_GOOD_VALUE);
+    return getMemoryLayout()->key_good_value;
 }
 
 uint32_t flashingGetGoodKeyStored(void){
-    uint32_t goodKeyAddr = flashingGetDIDData(FBL_DID_BL_KEY_ADDRESS);
+    uint32_t goodKeyAddr = getMemoryLayout()->key_address;
 
     uint32_t goodKeyStored = MEM(goodKeyAddr);
     if(FLASHING_GOOD_KEY_STORED_ENDIANNESS){
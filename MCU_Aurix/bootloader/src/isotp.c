@@ -5,7 +5,7 @@
 //============================================================================
 // Name        : isotp.c
 // Author      : Leon Wilms, Michael Bauer
-// Version     : 0.2
+// Version     : 0.3
 // Copyright   : MIT
 // Description : ISO-TP stack
 //============================================================================
@@ -13,6 +13,8 @@
 #include "isotp.h"
 #include "uds.h"
 #include "memory.h"
+#include "perf_counters.h"
+#include "flashing.h"
 
 #include <string.h>
 
@@ -23,6 +25,8 @@ uint8_t isoTP_RX_single_data_buffer[MAX_FRAME_LEN_CANFD];
 
 isoTP_RX* iso_RX_Multi;
 uint8_t isoTP_RX_multi_data_buffer[MAX_ISOTP_MESSAGE_LEN];
+
+uint8_t isoTP_RX_canfd;     // Last request was received with CAN FD frames, the response uses the same frame format
 //============================================================================
 // Init / Deinit / Resetting
 //============================================================================
@@ -39,6 +43,8 @@ void rx_reset_isotp_single_buffer(){
     iso_RX_Single->data_in_len = 0;
     iso_RX_Single->ready_to_read = 0;
     iso_RX_Single->last_consecutive_ctr = 0;
+    iso_RX_Single->block_ctr = 0;
+    iso_RX_Single->block_size = 0;
 }
 
 /*
@@ -53,6 +59,8 @@ void rx_reset_isotp_multi_buffer(){
     iso_RX_Multi->data_in_len = 0;
     iso_RX_Multi->ready_to_read = 0;
     iso_RX_Multi->last_consecutive_ctr = 0;
+    iso_RX_Multi->block_ctr = 0;
+    iso_RX_Multi->block_size = 0;
 }
 
 /*
@@ -119,6 +127,8 @@ isoTP* isotp_init(){
     // Reset the content
     rx_reset_isotp_multi_buffer();
 
+    isoTP_RX_canfd = 0;
+
     return isotp_TX;
 }
 
@@ -291,26 +301,67 @@ uint8_t* isotp_multi_rcv(uint32_t* total_length){
     return iso_RX_Multi->data;
 }
 
+/*
+ * @brief                       This function returns the frame length for responses. The tester is answered with
+ *                              CAN FD frames if the last request used frames with more than 8 bytes.
+ *
+ * @return                      MAX_FRAME_LEN_CANFD or MAX_FRAME_LEN_CAN, to be used for iso->max_len_per_frame.
+ */
+uint8_t isotp_get_max_len_per_frame(void){
+#if CAN_DRIVER_CANFD
+    if(isoTP_RX_canfd)
+        return MAX_FRAME_LEN_CANFD;
+#endif
+    return MAX_FRAME_LEN_CAN;
+}
+
 //============================================================================
 // Processing
 //============================================================================
 
+/*
+ * @brief                       This function sends a Flow Control Frame to the tester.
+ *                              In legacy mode BS and STmin are 0 and every Consecutive Frame is acknowledged,
+ *                              otherwise the configured block size and separation time are requested.
+ *                              While the flash is programmed in the background the block size is limited to ISOTP_RX_FC_BLOCK_SIZE_BUSY.
+ *
+ * @param flag                  Flow Status (ISOTP_FC_FLAG_*)
+ *
+ * @return                      Block size of the sent Flow Control
+ *
+ */
+static uint8_t isotp_send_flow_control(uint8_t flag){
+
+    uint8_t block_size = ISOTP_RX_ACK_CONSECUTIVE_FRAMES ? 0 : ISOTP_RX_FC_BLOCK_SIZE;
+    if(!ISOTP_RX_ACK_CONSECUTIVE_FRAMES && flashingBusy() && (block_size == 0 || block_size > ISOTP_RX_FC_BLOCK_SIZE_BUSY))
+        block_size = ISOTP_RX_FC_BLOCK_SIZE_BUSY;
+    uint8_t st_min = ISOTP_RX_ACK_CONSECUTIVE_FRAMES ? 0 : ISOTP_RX_FC_ST_MIN;
+
+    uint32_t flow_ctrl_len = 0;
+    uint8_t *flow_ctrl = tx_flow_control_frame(&flow_ctrl_len, flag, block_size, st_min, 0);
+    if(flow_ctrl == NULL)
+        return block_size;
+
+    canTransmitMessage(getID(), flow_ctrl, flow_ctrl_len);
+    free(flow_ctrl);
+    return block_size;
+}
 
 /*
  * @brief                       This function extracts the isoTP message from multiple CAN messages.
- *                              It is called inside the receive interrupt 'canIsrRxFifo0Handler' of the CAN driver.
  *
  * @param rxData                This is a pointer to the received data.
  *
  * @param dlc                   Data Length Code, this represents the length of the currently received CAN message.
  *
  */
-void process_can_to_isotp(uint32_t* rxData, IfxCan_DataLengthCode dlc){
+static void rx_process_frame(uint32_t* rxData, IfxCan_DataLengthCode dlc){
 
     if(dlc <= 0) // Need to assume that the data is also empty, using FBL_NEGATIVE_RESPONSE instead
         uds_neg_response(FBL_NEGATIVE_RESPONSE, FBL_RC_INCORRECT_MSG_LEN_OR_INV_FORMAT);
 
     uint8_t* data_ptr = (uint8_t*)rxData;
+    uint32_t frame_len = canDlcToLength(dlc); // CAN FD: DLC 9-15 encode 12-64 bytes
 
     //######################################################################################################
     // Single Frame Processing
@@ -318,15 +369,27 @@ void process_can_to_isotp(uint32_t* rxData, IfxCan_DataLengthCode dlc){
     // Single Frame get length of whole isoTP message
     if(((0xF0 & rxData[0]) >> 4) == 0){
 
-        if(MAX_FRAME_LEN_CANFD - (iso_RX_Single->write_ptr - iso_RX_Single->data) < dlc || iso_RX_Single->ready_to_read != 0){
-            uds_neg_response(data_ptr[1], FBL_RC_BUSY_REPEAT_REQUEST);
+        // CAN FD frames with more than 8 bytes use the escape sequence, length in the second byte
+        uint32_t pci_len = 1;
+        uint32_t sf_len = 0xF & data_ptr[0];
+        if(sf_len == 0 && frame_len > MAX_FRAME_LEN_CAN){
+            pci_len = 2;
+            sf_len = data_ptr[1];
+        }
+        if(sf_len > frame_len - pci_len) // Length exceeds the frame, use the available bytes
+            sf_len = frame_len - pci_len;
+
+        if(MAX_FRAME_LEN_CANFD - (iso_RX_Single->write_ptr - iso_RX_Single->data) < sf_len || iso_RX_Single->ready_to_read != 0){
+            uds_neg_response(data_ptr[pci_len], FBL_RC_BUSY_REPEAT_REQUEST);
             return;
         }
 
-        iso_RX_Single->data_in_len = 0xF & data_ptr[0];
+        isoTP_RX_canfd = frame_len > MAX_FRAME_LEN_CAN;
+        iso_RX_Single->data_in_len = sf_len;
 
-        memcpy(iso_RX_Single->write_ptr, &data_ptr[1], dlc - 1);
-        iso_RX_Single->write_ptr += dlc - 1;
+        // Padding of CAN FD frames is not copied
+        memcpy(iso_RX_Single->write_ptr, &data_ptr[pci_len], sf_len);
+        iso_RX_Single->write_ptr += sf_len;
 
         if(iso_RX_Single->write_ptr - iso_RX_Single->data >= iso_RX_Single->data_in_len){
             iso_RX_Single->ready_to_read = 1;
@@ -340,9 +403,17 @@ void process_can_to_isotp(uint32_t* rxData, IfxCan_DataLengthCode dlc){
         // First Frame get length of whole isoTP message
         if(((0xF0 & rxData[0]) >> 4) == 1){
 
+            // Messages longer than 4095 bytes use the escape sequence with 32 bit length
+            uint32_t pci_len = 2;
+            uint32_t ff_len = (((uint32_t)(data_ptr[0] & 0x0F)) << 8) | data_ptr[1];
+            if(ff_len == 0){
+                pci_len = 6;
+                ff_len = ((uint32_t)data_ptr[2] << 24) | ((uint32_t)data_ptr[3] << 16) | ((uint32_t)data_ptr[4] << 8) | data_ptr[5];
+            }
+
             if(iso_RX_Multi->ready_to_read != 0){
                 // Client sends new ISO TP but old is still not processed -> Reject until old is processed
-                uds_neg_response(data_ptr[1], FBL_RC_BUSY_REPEAT_REQUEST);
+                uds_neg_response(data_ptr[pci_len], FBL_RC_BUSY_REPEAT_REQUEST);
                 return;
             }
             else {
@@ -350,28 +421,43 @@ void process_can_to_isotp(uint32_t* rxData, IfxCan_DataLengthCode dlc){
                 rx_reset_isotp_multi_buffer();
             }
 
-            iso_RX_Multi->data_in_len = (((uint32_t)(data_ptr[0] & 0x0F)) << 8) | data_ptr[1];
+            iso_RX_Multi->data_in_len = ff_len;
+
+            if(iso_RX_Multi->data_in_len > MAX_ISOTP_MESSAGE_LEN || frame_len <= pci_len){
+                // Message does not fit into the buffer -> Abort transmission
+                isotp_send_flow_control(ISOTP_FC_FLAG_OVERFLOW);
+                rx_reset_isotp_multi_buffer();
+                return;
+            }
+
+            isoTP_RX_canfd = frame_len > MAX_FRAME_LEN_CAN;
 
-            memcpy(iso_RX_Multi->write_ptr, &data_ptr[2], dlc - 2);
-            iso_RX_Multi->write_ptr += dlc - 2;
+            uint32_t payload_len = frame_len - pci_len;
+            if(payload_len > iso_RX_Multi->data_in_len)
+                payload_len = iso_RX_Multi->data_in_len;
+            memcpy(iso_RX_Multi->write_ptr, &data_ptr[pci_len], payload_len);
+            iso_RX_Multi->write_ptr += payload_len;
 
             // Send Flow Control Frame as response
-            uint32_t flow_ctrl_len = 0;
-            uint8_t *flow_ctrl = tx_flow_control_frame(&flow_ctrl_len, 0, 0, 0, 0);
-            canTransmitMessage(getID(), flow_ctrl, flow_ctrl_len);
-            free(flow_ctrl);
+            iso_RX_Multi->block_size = isotp_send_flow_control(ISOTP_FC_FLAG_CONTINUE_TO_SEND);
         }
 
         // Consecutive Frame
         else if(((0xF0 & rxData[0]) >> 4) == 2){
 
+            // The last Consecutive Frame of CAN FD is padded, only copy the missing bytes
+            uint32_t received = iso_RX_Multi->write_ptr - iso_RX_Multi->data;
+            uint32_t payload_len = frame_len - 1;
+            if(received < iso_RX_Multi->data_in_len && payload_len > iso_RX_Multi->data_in_len - received)
+                payload_len = iso_RX_Multi->data_in_len - received;
+
             if(iso_RX_Multi->ready_to_read != 0){
                 // Client sends new ISO TP but old is still not processed -> Reject until old is processed
                 uds_neg_response(FBL_NEGATIVE_RESPONSE, FBL_RC_BUSY_REPEAT_REQUEST);
                 return;
             }
 
-            else if(MAX_ISOTP_MESSAGE_LEN - (iso_RX_Multi->write_ptr - iso_RX_Multi->data) < dlc){
+            else if(MAX_ISOTP_MESSAGE_LEN - received < payload_len){
                 // Client sends consecutive frame but buffer is full
                 uds_neg_response(FBL_NEGATIVE_RESPONSE, FBL_RC_REQUEST_OUT_OF_RANGE);
                 return;
@@ -379,15 +465,25 @@ void process_can_to_isotp(uint32_t* rxData, IfxCan_DataLengthCode dlc){
 
 
             // Only copy if counter is different. Sender needs to make sure that correct sequence is transmitted
-            if(iso_RX_Multi->last_consecutive_ctr != data_ptr[0]){
-                memcpy(iso_RX_Multi->write_ptr, &data_ptr[1], dlc - 1);
-                iso_RX_Multi->write_ptr += dlc - 1;
+            uint8_t new_frame = iso_RX_Multi->last_consecutive_ctr != data_ptr[0];
+            if(new_frame){
+                memcpy(iso_RX_Multi->write_ptr, &data_ptr[1], payload_len);
+                iso_RX_Multi->write_ptr += payload_len;
             }
 
             if(ISOTP_RX_ACK_CONSECUTIVE_FRAMES){
                 // Send response for Consecutive Frame
                 canTransmitMessage(getID(), &data_ptr[0], 1);
             }
+            else if(new_frame){
+                // Request the next block once the current one is complete and the message still needs data
+                iso_RX_Multi->block_ctr++;
+                if(iso_RX_Multi->block_size > 0 && iso_RX_Multi->block_ctr >= iso_RX_Multi->block_size
+                        && iso_RX_Multi->write_ptr - iso_RX_Multi->data < iso_RX_Multi->data_in_len){
+                    iso_RX_Multi->block_ctr = 0;
+                    iso_RX_Multi->block_size = isotp_send_flow_control(ISOTP_FC_FLAG_CONTINUE_TO_SEND);
+                }
+            }
 
             // Store the counter
             iso_RX_Multi->last_consecutive_ctr = data_ptr[0];
@@ -414,3 +510,18 @@ void process_can_to_isotp(uint32_t* rxData, IfxCan_DataLengthCode dlc){
     }
     return;
 }
+
+/*
+ * @brief                       Processes one received CAN frame (PERF_ISOTP_RX).
+ *                              It is called inside the receive interrupt 'canIsrRxFifo0Handler' of the CAN driver.
+ *
+ * @param rxData                This is a pointer to the received data.
+ *
+ * @param dlc                   Data Length Code, this represents the length of the currently received CAN message.
+ *
+ */
+void process_can_to_isotp(uint32_t* rxData, IfxCan_DataLengthCode dlc){
+    Ifx_TickTime start = perfStart();
+    rx_process_frame(rxData, dlc);
+    perfStop(PERF_ISOTP_RX, start);
+}
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : lz4.c
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Decompression of LZ4 blocks (Transfer Data with FBL_DATA_FORMAT_LZ4)
+//============================================================================
+
+#include "lz4.h"
+
+//============================================================================
+// Internal helper function
+//============================================================================
+
+/**
+ * @brief                       Reads the extension bytes of a literal or match length (255 = more bytes follow)
+ *
+ * @param src                   Current position in the block, advanced behind the extension
+ * @param end                   End of the block
+ * @param len                   Length of the token nibble, the extension is added
+ * @return                      0 if the extension is complete, else 1
+ */
+static inline uint8_t readLength(const uint8_t **src, const uint8_t *end, uint32_t *len){
+    uint8_t value;
+    do {
+        if(*src >= end)
+            return 1;
+        value = *(*src)++;
+        *len += value;
+    } while(value == 255);
+    return 0;
+}
+
+//============================================================================
+// Public
+//============================================================================
+
+/**
+ * @brief                       Decompresses a LZ4 block (no frame header). The block is checked while decoding,
+ *                              corrupted data never reads or writes outside of the buffers.
+ *
+ * @param src                   Compressed block
+ * @param src_len               Number of bytes of the compressed block
+ * @param dst                   Buffer for the decompressed data, matches reference the data written before
+ * @param dst_capacity          Size of dst
+ * @return                      Number of decompressed bytes, -1 if the block is corrupted or does not fit into dst
+ */
+int32_t lz4DecompressBlock(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_capacity){
+    const uint8_t *in = src;
+    const uint8_t *in_end = src + src_len;
+    uint32_t out = 0;
+
+    if(src_len == 0)
+        return -1;
+
+    while(1){
+        uint8_t token = *in++;
+
+        // Literals
+        uint32_t literals = token >> 4;
+        if(literals == 15 && readLength(&in, in_end, &literals))
+            return -1;
+        if(literals > (uint32_t)(in_end - in) || literals > dst_capacity - out)
+            return -1;
+        for(uint32_t i = 0; i < literals; i++)
+            dst[out++] = *in++;
+
+        // The last sequence has no match
+        if(in == in_end)
+            break;
+
+        // Match
+        if(in_end - in < 2)
+            return -1;
+        uint32_t offset = (uint32_t)in[0] | ((uint32_t)in[1] << 8);
+        in += 2;
+        if(offset == 0 || offset > out)
+            return -1;
+
+        uint32_t match = token & 0x0F;
+        if(match == 15 && readLength(&in, in_end, &match))
+            return -1;
+        match += LZ4_MIN_MATCH;
+        if(match > dst_capacity - out)
+            return -1;
+
+        // Byte wise, the match may overlap the bytes being written (runs of the same pattern)
+        for(uint32_t i = 0; i < match; i++, out++)
+            dst[out] = dst[out - offset];
+
+        if(in >= in_end)
+            return -1;
+    }
+    return (int32_t)out;
+}
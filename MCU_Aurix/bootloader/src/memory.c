@@ -6,41 +6,75 @@
 //============================================================================
 // Name        : memory.c
 // Author      : Dorothea Ehrl, Sebastian Rodriguez, Michael Bauer
-// Version     : 0.3
+// Version     : 0.8
 // Copyright   : MIT
 // Description : Manages writing and returning data in memory
 //============================================================================
 
 #include <string.h>
 #include <stdlib.h>     /* calloc, exit, free */
+#include <stddef.h>     /* offsetof */
 
 #include "memory.h"
 #include "uds_comm_spec.h"
 #include "flash_driver.h"
+#include "flashing.h"
+#include "crc.h"
+#include "perf_counters.h"
 
+// Header of a log sector, programmed after the records of a compaction
 typedef struct {
-        uint8_t did_structure_version[FBL_STRUCTURE_VERSION];
-        uint8_t did_app_id[FBL_DID_APP_ID_BYTES_SIZE];
-        uint8_t did_system_name[FBL_DID_SYSTEM_NAME_BYTES_SIZE];
-        uint8_t did_programming_date[FBL_DID_PROGRAMMING_DATE_BYTES_SIZE];
-        uint8_t did_bl_key_address[FBL_DID_BL_KEY_ADDRESS_BYTES_SIZE];
-        uint8_t did_bl_key_good_value[FBL_DID_BL_KEY_GOOD_VALUE_BYTES_SIZE];
-        uint8_t did_can_base_mask[FBL_DID_CAN_BASE_MASK_BYTES_SIZE];
-        uint8_t did_can_id[FBL_DID_CAN_ID_BYTES_SIZE];
-        uint8_t did_bl_write_start_add_core0[FBL_DID_BL_WRITE_START_ADD_CORE0_BYTES_SIZE];
-        uint8_t did_bl_write_end_add_core0[FBL_DID_BL_WRITE_END_ADD_CORE0_BYTES_SIZE];
-        uint8_t did_bl_write_start_add_core1[FBL_DID_BL_WRITE_START_ADD_CORE1_BYTES_SIZE];
-        uint8_t did_bl_write_end_add_core1[FBL_DID_BL_WRITE_END_ADD_CORE1_BYTES_SIZE];
-        uint8_t did_bl_write_start_add_core2[FBL_DID_BL_WRITE_START_ADD_CORE2_BYTES_SIZE];
-        uint8_t did_bl_write_end_add_core2[FBL_DID_BL_WRITE_END_ADD_CORE2_BYTES_SIZE];
-        uint8_t did_bl_write_start_add_asw_key[FBL_DID_BL_WRITE_START_ADD_ASW_KEY_BYTES_SIZE];
-        uint8_t did_bl_write_end_add_asw_key[FBL_DID_BL_WRITE_END_ADD_ASW_KEY_BYTES_SIZE];
-        uint8_t did_bl_write_start_add_cal_data[FBL_DID_BL_WRITE_START_ADD_CAL_DATA_BYTES_SIZE];
-        uint8_t did_bl_write_end_add_cal_data[FBL_DID_BL_WRITE_END_ADD_CAL_DATA_BYTES_SIZE];
-} Memory_Data;
+        uint32_t magic;
+        uint32_t sequence;                                  // Incremented per compaction, the highest valid sector is active
+        uint8_t structure_version[FBL_STRUCTURE_VERSION];
+        uint32_t reserved;
+} Memory_Log_Header;
+
+// Header of a record, followed by the data padded to DID_LOG_ALIGNMENT
+typedef struct {
+        uint16_t did;
+        uint8_t len;
+        uint8_t marker;
+        uint32_t crc;                                       // CRC of did, len, marker and data, detects a torn write
+} Memory_Log_Record;
+
+// Persistent DIDs, the variable in memData holds the current value
+typedef struct {
+        uint16_t did;
+        uint8_t *var;
+        uint8_t len;
+} Memory_Log_Entry;
 
 boolean init = FALSE;
 Memory_Data memData;
+Memory_Layout memLayout;
+
+#if MEMORY_DID_LOG
+static const Memory_Log_Entry memory_log_entries[] = {
+        {FBL_DID_APP_ID, memData.did_app_id, FBL_DID_APP_ID_BYTES_SIZE},
+        {FBL_DID_SYSTEM_NAME, memData.did_system_name, FBL_DID_SYSTEM_NAME_BYTES_SIZE},
+        {FBL_DID_PROGRAMMING_DATE, memData.did_programming_date, FBL_DID_PROGRAMMING_DATE_BYTES_SIZE},
+        {FBL_DID_BL_KEY_ADDRESS, memData.did_bl_key_address, FBL_DID_BL_KEY_ADDRESS_BYTES_SIZE},
+        {FBL_DID_BL_KEY_GOOD_VALUE, memData.did_bl_key_good_value, FBL_DID_BL_KEY_GOOD_VALUE_BYTES_SIZE},
+        {FBL_DID_CAN_BASE_MASK, memData.did_can_base_mask, FBL_DID_CAN_BASE_MASK_BYTES_SIZE},
+        {FBL_DID_CAN_ID, memData.did_can_id, FBL_DID_CAN_ID_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_START_ADD_CORE0, memData.did_bl_write_start_add_core0, FBL_DID_BL_WRITE_START_ADD_CORE0_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_END_ADD_CORE0, memData.did_bl_write_end_add_core0, FBL_DID_BL_WRITE_END_ADD_CORE0_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_START_ADD_CORE1, memData.did_bl_write_start_add_core1, FBL_DID_BL_WRITE_START_ADD_CORE1_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_END_ADD_CORE1, memData.did_bl_write_end_add_core1, FBL_DID_BL_WRITE_END_ADD_CORE1_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_START_ADD_CORE2, memData.did_bl_write_start_add_core2, FBL_DID_BL_WRITE_START_ADD_CORE2_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_END_ADD_CORE2, memData.did_bl_write_end_add_core2, FBL_DID_BL_WRITE_END_ADD_CORE2_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_START_ADD_ASW_KEY, memData.did_bl_write_start_add_asw_key, FBL_DID_BL_WRITE_START_ADD_ASW_KEY_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_END_ADD_ASW_KEY, memData.did_bl_write_end_add_asw_key, FBL_DID_BL_WRITE_END_ADD_ASW_KEY_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_START_ADD_CAL_DATA, memData.did_bl_write_start_add_cal_data, FBL_DID_BL_WRITE_START_ADD_CAL_DATA_BYTES_SIZE},
+        {FBL_DID_BL_WRITE_END_ADD_CAL_DATA, memData.did_bl_write_end_add_cal_data, FBL_DID_BL_WRITE_END_ADD_CAL_DATA_BYTES_SIZE},
+};
+
+#define MEMORY_LOG_ENTRIES          (sizeof(memory_log_entries) / sizeof(memory_log_entries[0]))
+#define MEMORY_LOG_MAX_RECORD_SIZE  (sizeof(Memory_Log_Record) + FBL_DID_SYSTEM_NAME_BYTES_SIZE) // Largest DID
+
+Memory_Log memLog;
+#endif
 
 //============================================================================
 // Internal helper function
@@ -51,6 +85,28 @@ static inline void write_to_variable(uint8_t len, uint8_t *data, uint8_t* var){
     }
 }
 
+static inline uint32_t decode_uint32(uint8_t *data){
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+/**
+ * Decodes the layout DIDs once, so the address checks of flashing and flash driver do not need readData
+ */
+static void updateMemoryLayout(void){
+    memLayout.regions[MEMORY_REGION_CORE0].start_addr = decode_uint32(memData.did_bl_write_start_add_core0);
+    memLayout.regions[MEMORY_REGION_CORE0].end_addr = decode_uint32(memData.did_bl_write_end_add_core0);
+    memLayout.regions[MEMORY_REGION_CORE1].start_addr = decode_uint32(memData.did_bl_write_start_add_core1);
+    memLayout.regions[MEMORY_REGION_CORE1].end_addr = decode_uint32(memData.did_bl_write_end_add_core1);
+    memLayout.regions[MEMORY_REGION_CORE2].start_addr = decode_uint32(memData.did_bl_write_start_add_core2);
+    memLayout.regions[MEMORY_REGION_CORE2].end_addr = decode_uint32(memData.did_bl_write_end_add_core2);
+    memLayout.regions[MEMORY_REGION_ASW_KEY].start_addr = decode_uint32(memData.did_bl_write_start_add_asw_key);
+    memLayout.regions[MEMORY_REGION_ASW_KEY].end_addr = decode_uint32(memData.did_bl_write_end_add_asw_key);
+    memLayout.regions[MEMORY_REGION_CAL_DATA].start_addr = decode_uint32(memData.did_bl_write_start_add_cal_data);
+    memLayout.regions[MEMORY_REGION_CAL_DATA].end_addr = decode_uint32(memData.did_bl_write_end_add_cal_data);
+    memLayout.key_address = decode_uint32(memData.did_bl_key_address);
+    memLayout.key_good_value = decode_uint32(memData.did_bl_key_good_value);
+}
+
 static inline uint8_t *prepare_message(uint8_t *len, uint8_t *data){
     uint8_t* ret_data = (uint8_t*)calloc(*len, sizeof(uint8_t));
     for(int i = 0; i < *len; i++){
@@ -124,87 +180,262 @@ static boolean validateMemory(){
     return valid;
 }
 
-//============================================================================
-// Init
-//============================================================================
-
 /**
- * This function reads all the data from the memory and fills the variables (TBD)
+ * Fills the variables with the default values
  */
-void init_memory(void){
+static void loadDefaults(void){
+    
+    uint8_t did_structure_version[] = FBL_STRUCTURE_DATA_FLASH_STRUCTURE_VERSION;
+    write_to_variable(FBL_STRUCTURE_VERSION, did_structure_version, memData.did_structure_version);
 
-    // Reading from memory
-    size_t len = sizeof(memData);
-    uint8_t *dataRead = flashRead((uint32)DID_DATA_FLASH_ADDR, len);
+    uint8_t did_app_id[] = FBL_DID_APP_ID_DEFAULT;
+    write_to_variable(sizeof(did_app_id), did_app_id, memData.did_app_id);
 
-    // Copy content to Variables
-    write_to_variable(len, dataRead, (uint8_t*)(&memData));
-    free(dataRead);
+    // Info: Size of default System name usually < 32 Byte
+    uint8_t did_system_name[] = FBL_DID_SYSTEM_NAME_DEFAULT;
+    write_to_variable(sizeof(did_system_name), did_system_name, memData.did_system_name);
 
-    // Validate the Memory Based on Programming Date and System Name
-    init = validateMemory();
+    uint8_t did_programming_date[] = FBL_DID_PROGRAMMING_DATE_DEFAULT;
+    write_to_variable(FBL_DID_PROGRAMMING_DATE_BYTES_SIZE, did_programming_date, memData.did_programming_date);
 
-    // Check Init
-    if(!init){
-        
-        uint8_t did_structure_version[] = FBL_STRUCTURE_DATA_FLASH_STRUCTURE_VERSION;
-        write_to_variable(FBL_STRUCTURE_VERSION, did_structure_version, memData.did_structure_version);
+    uint8_t did_bl_key_address[] = FBL_DID_BL_KEY_ADDRESS_DEFAULT;
+    write_to_variable(FBL_DID_BL_KEY_ADDRESS_BYTES_SIZE, did_bl_key_address, memData.did_bl_key_address);
 
-        uint8_t did_app_id[] = FBL_DID_APP_ID_DEFAULT;
-        write_to_variable(sizeof(did_app_id), did_app_id, memData.did_app_id);
+    uint8_t did_bl_key_good_value[] = FBL_DID_BL_KEY_GOOD_VALUE_DEFAULT;
+    write_to_variable(FBL_DID_BL_KEY_GOOD_VALUE_BYTES_SIZE, did_bl_key_good_value, memData.did_bl_key_good_value);
 
-        // Info: Size of default System name usually < 32 Byte
-        uint8_t did_system_name[] = FBL_DID_SYSTEM_NAME_DEFAULT;
-        write_to_variable(sizeof(did_system_name), did_system_name, memData.did_system_name);
+    uint8_t did_can_base_mask[] = FBL_DID_CAN_BASE_MASK_DEFAULT;
+    write_to_variable(FBL_DID_CAN_BASE_MASK_BYTES_SIZE, did_can_base_mask, memData.did_can_base_mask);
 
-        uint8_t did_programming_date[] = FBL_DID_PROGRAMMING_DATE_DEFAULT;
-        write_to_variable(FBL_DID_PROGRAMMING_DATE_BYTES_SIZE, did_programming_date, memData.did_programming_date);
+    uint8_t did_can_id[] = FBL_DID_CAN_ID_DEFAULT;
+    write_to_variable(FBL_DID_CAN_ID_BYTES_SIZE, did_can_id, memData.did_can_id);
 
-        uint8_t did_bl_key_address[] = FBL_DID_BL_KEY_ADDRESS_DEFAULT;
-        write_to_variable(FBL_DID_BL_KEY_ADDRESS_BYTES_SIZE, did_bl_key_address, memData.did_bl_key_address);
+    uint8_t did_bl_write_start_add_core0[] = FBL_DID_BL_WRITE_START_ADD_CORE0_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_START_ADD_CORE0_BYTES_SIZE, did_bl_write_start_add_core0, memData.did_bl_write_start_add_core0);
 
-        uint8_t did_bl_key_good_value[] = FBL_DID_BL_KEY_GOOD_VALUE_DEFAULT;
-        write_to_variable(FBL_DID_BL_KEY_GOOD_VALUE_BYTES_SIZE, did_bl_key_good_value, memData.did_bl_key_good_value);
+    uint8_t did_bl_write_end_add_core0[] = FBL_DID_BL_WRITE_END_ADD_CORE0_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_END_ADD_CORE0_BYTES_SIZE, did_bl_write_end_add_core0, memData.did_bl_write_end_add_core0);
 
-        uint8_t did_can_base_mask[] = FBL_DID_CAN_BASE_MASK_DEFAULT;
-        write_to_variable(FBL_DID_CAN_BASE_MASK_BYTES_SIZE, did_can_base_mask, memData.did_can_base_mask);
+    uint8_t did_bl_write_start_add_core1[] = FBL_DID_BL_WRITE_START_ADD_CORE1_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_START_ADD_CORE1_BYTES_SIZE, did_bl_write_start_add_core1, memData.did_bl_write_start_add_core1);
 
-        uint8_t did_can_id[] = FBL_DID_CAN_ID_DEFAULT;
-        write_to_variable(FBL_DID_CAN_ID_BYTES_SIZE, did_can_id, memData.did_can_id);
+    uint8_t did_bl_write_end_add_core1[] = FBL_DID_BL_WRITE_END_ADD_CORE1_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_END_ADD_CORE1_BYTES_SIZE, did_bl_write_end_add_core1, memData.did_bl_write_end_add_core1);
 
-        uint8_t did_bl_write_start_add_core0[] = FBL_DID_BL_WRITE_START_ADD_CORE0_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_START_ADD_CORE0_BYTES_SIZE, did_bl_write_start_add_core0, memData.did_bl_write_start_add_core0);
+    uint8_t did_bl_write_start_add_core2[] = FBL_DID_BL_WRITE_START_ADD_CORE2_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_START_ADD_CORE2_BYTES_SIZE, did_bl_write_start_add_core2, memData.did_bl_write_start_add_core2);
 
-        uint8_t did_bl_write_end_add_core0[] = FBL_DID_BL_WRITE_END_ADD_CORE0_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_END_ADD_CORE0_BYTES_SIZE, did_bl_write_end_add_core0, memData.did_bl_write_end_add_core0);
+    uint8_t did_bl_write_end_add_core2[] = FBL_DID_BL_WRITE_END_ADD_CORE2_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_END_ADD_CORE2_BYTES_SIZE, did_bl_write_end_add_core2, memData.did_bl_write_end_add_core2);
 
-        uint8_t did_bl_write_start_add_core1[] = FBL_DID_BL_WRITE_START_ADD_CORE1_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_START_ADD_CORE1_BYTES_SIZE, did_bl_write_start_add_core1, memData.did_bl_write_start_add_core1);
+    uint8_t did_bl_write_start_add_asw_key[] = FBL_DID_BL_WRITE_START_ADD_ASW_KEY_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_START_ADD_ASW_KEY_BYTES_SIZE, did_bl_write_start_add_asw_key, memData.did_bl_write_start_add_asw_key);
 
-        uint8_t did_bl_write_end_add_core1[] = FBL_DID_BL_WRITE_END_ADD_CORE1_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_END_ADD_CORE1_BYTES_SIZE, did_bl_write_end_add_core1, memData.did_bl_write_end_add_core1);
+    uint8_t did_bl_write_end_add_asw_key[] = FBL_DID_BL_WRITE_END_ADD_ASW_KEY_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_END_ADD_ASW_KEY_BYTES_SIZE, did_bl_write_end_add_asw_key, memData.did_bl_write_end_add_asw_key);
 
-        uint8_t did_bl_write_start_add_core2[] = FBL_DID_BL_WRITE_START_ADD_CORE2_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_START_ADD_CORE2_BYTES_SIZE, did_bl_write_start_add_core2, memData.did_bl_write_start_add_core2);
 
-        uint8_t did_bl_write_end_add_core2[] = FBL_DID_BL_WRITE_END_ADD_CORE2_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_END_ADD_CORE2_BYTES_SIZE, did_bl_write_end_add_core2, memData.did_bl_write_end_add_core2);
+    uint8_t did_bl_write_start_add_cal_data[] = FBL_DID_BL_WRITE_START_ADD_CAL_DATA_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_START_ADD_CAL_DATA_BYTES_SIZE, did_bl_write_start_add_cal_data, memData.did_bl_write_start_add_cal_data);
 
-        uint8_t did_bl_write_start_add_asw_key[] = FBL_DID_BL_WRITE_START_ADD_ASW_KEY_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_START_ADD_ASW_KEY_BYTES_SIZE, did_bl_write_start_add_asw_key, memData.did_bl_write_start_add_asw_key);
+    uint8_t did_bl_write_end_add_cal_data[] = FBL_DID_BL_WRITE_END_ADD_CAL_DATA_DEFAULT;
+    write_to_variable(FBL_DID_BL_WRITE_END_ADD_CAL_DATA_BYTES_SIZE, did_bl_write_end_add_cal_data, memData.did_bl_write_end_add_cal_data);
+}
 
-        uint8_t did_bl_write_end_add_asw_key[] = FBL_DID_BL_WRITE_END_ADD_ASW_KEY_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_END_ADD_ASW_KEY_BYTES_SIZE, did_bl_write_end_add_asw_key, memData.did_bl_write_end_add_asw_key);
+#if MEMORY_DID_LOG
+static const Memory_Log_Entry *getLogEntry(uint16_t did){
+    for(size_t i = 0; i < MEMORY_LOG_ENTRIES; i++){
+        if(memory_log_entries[i].did == did)
+            return &memory_log_entries[i];
+    }
+    return NULL;
+}
 
+static inline uint32_t getLogRecordSize(uint8_t len){
+    return sizeof(Memory_Log_Record) + ((len + DID_LOG_ALIGNMENT - 1) / DID_LOG_ALIGNMENT) * DID_LOG_ALIGNMENT;
+}
 
-        uint8_t did_bl_write_start_add_cal_data[] = FBL_DID_BL_WRITE_START_ADD_CAL_DATA_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_START_ADD_CAL_DATA_BYTES_SIZE, did_bl_write_start_add_cal_data, memData.did_bl_write_start_add_cal_data);
+static uint32_t getLogRecordCrc(const Memory_Log_Record *record, const uint8_t *data){
+    crc_t crc = crc_init();
+    crc = crc_update(crc, record, offsetof(Memory_Log_Record, crc));
+    crc = crc_update(crc, data, record->len);
+    return (uint32_t)crc_finalize(crc);
+}
 
-        uint8_t did_bl_write_end_add_cal_data[] = FBL_DID_BL_WRITE_END_ADD_CAL_DATA_DEFAULT;
-        write_to_variable(FBL_DID_BL_WRITE_END_ADD_CAL_DATA_BYTES_SIZE, did_bl_write_end_add_cal_data, memData.did_bl_write_end_add_cal_data);
+/**
+ * Programs the current value of the DID as record, the pages need to be erased
+ */
+static boolean programLogRecord(uint32_t addr, const Memory_Log_Entry *entry){
+    uint32_t buffer[MEMORY_LOG_MAX_RECORD_SIZE / sizeof(uint32_t)];
+    memset(buffer, 0, sizeof(buffer));
+
+    Memory_Log_Record *record = (Memory_Log_Record*)buffer;
+    record->did = entry->did;
+    record->len = entry->len;
+    record->marker = DID_LOG_RECORD_MARKER;
+    memcpy(((uint8_t*)buffer) + sizeof(Memory_Log_Record), entry->var, entry->len);
+    record->crc = getLogRecordCrc(record, entry->var);
+
+    return flashProgramData(addr, buffer, getLogRecordSize(entry->len) / sizeof(uint32_t));
+}
+
+/**
+ * Writes the current values of all DIDs into the other log sector, which becomes the active one.
+ * The header is programmed last, an interrupted compaction leaves the former sector active.
+ */
+static boolean compactLog(void){
+    // Without log the first compaction keeps the data block of the former format at DID_DATA_FLASH_ADDR intact
+    uint32_t sector = (memLog.sector == DID_DATA_FLASH_ADDR + DID_LOG_SECTOR_SIZE) ? DID_DATA_FLASH_ADDR : DID_DATA_FLASH_ADDR + DID_LOG_SECTOR_SIZE;
 
+    if(!flashEraseData(sector, 1))
+        return false;
 
+    uint32_t offset = sizeof(Memory_Log_Header);
+    for(size_t i = 0; i < MEMORY_LOG_ENTRIES; i++){
+        if(!programLogRecord(sector + offset, &memory_log_entries[i]))
+            return false;
+        offset += getLogRecordSize(memory_log_entries[i].len);
     }
+
+    uint8_t did_structure_version[] = FBL_STRUCTURE_DATA_FLASH_STRUCTURE_VERSION;
+    Memory_Log_Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DID_LOG_MAGIC;
+    header.sequence = memLog.sequence + 1;
+    write_to_variable(FBL_STRUCTURE_VERSION, did_structure_version, header.structure_version);
+    if(!flashProgramData(sector, (uint32_t*)(&header), sizeof(header) / sizeof(uint32_t)))
+        return false;
+
+    memLog.sector = sector;
+    memLog.sequence = header.sequence;
+    memLog.offset = offset;
+    return true;
+}
+
+/**
+ * Stores the current value of the DID: appended to the active sector, compaction if the sector is full
+ */
+static boolean appendLog(const Memory_Log_Entry *entry){
+    if(entry == NULL)
+        return true; // Not persistent
+
+    uint32_t size = getLogRecordSize(entry->len);
+    if(memLog.sector == 0 || memLog.offset + size > DID_LOG_SECTOR_SIZE)
+        return compactLog();
+
+    if(!programLogRecord(memLog.sector + memLog.offset, entry))
+        return false;
+
+    memLog.offset += size;
+    return true;
+}
+
+/**
+ * Searches the active log sector and applies its records to the variables
+ *
+ * @return True if there is a valid log sector
+ */
+static boolean loadLog(void){
+    uint8_t did_structure_version[] = FBL_STRUCTURE_DATA_FLASH_STRUCTURE_VERSION;
+
+    memLog.sector = 0;
+    memLog.sequence = 0;
+    memLog.offset = 0;
+
+    for(int i = 0; i < DID_LOG_SECTORS; i++){
+        uint32_t sector = DID_DATA_FLASH_ADDR + i * DID_LOG_SECTOR_SIZE;
+        Memory_Log_Header *header = (Memory_Log_Header*)flashRead(sector, sizeof(Memory_Log_Header));
+        if(header == NULL)
+            continue;
+
+        if(header->magic == DID_LOG_MAGIC && memcmp(header->structure_version, did_structure_version, FBL_STRUCTURE_VERSION) == 0 &&
+           (memLog.sector == 0 || header->sequence > memLog.sequence)){
+            memLog.sector = sector;
+            memLog.sequence = header->sequence;
+        }
+        free(header);
+    }
+
+    if(memLog.sector == 0)
+        return false;
+
+    uint8_t *content = flashRead(memLog.sector, DID_LOG_SECTOR_SIZE);
+    if(content == NULL)
+        return false;
+
+    uint32_t offset = sizeof(Memory_Log_Header);
+    while(offset + sizeof(Memory_Log_Record) <= DID_LOG_SECTOR_SIZE){
+        Memory_Log_Record *record = (Memory_Log_Record*)(content + offset);
+        if(record->marker != DID_LOG_RECORD_MARKER)
+            break; // Free space
+
+        const Memory_Log_Entry *entry = getLogEntry(record->did);
+        uint32_t size = getLogRecordSize(record->len);
+        uint8_t *data = content + offset + sizeof(Memory_Log_Record);
+        if(entry == NULL || record->len != entry->len || offset + size > DID_LOG_SECTOR_SIZE || record->crc != getLogRecordCrc(record, data)){
+            // Torn or unknown record, the next write compacts the log
+            offset = DID_LOG_SECTOR_SIZE;
+            break;
+        }
+
+        write_to_variable(entry->len, data, entry->var);
+        offset += size;
+    }
+    memLog.offset = offset;
+
+    free(content);
+    return true;
+}
+#endif
+
+//============================================================================
+// Init
+//============================================================================
+
+/**
+ * This function reads all the data from the memory and fills the variables (TBD)
+ */
+void init_memory(void){
+
+#if MEMORY_DID_LOG
+    // Defaults first, the records of the log overwrite them
+    loadDefaults();
+    if(loadLog()){
+        init = validateMemory();
+        if(!init){
+            // The records of the log are replaced by the defaults with the next write, appending would keep them invalid
+            loadDefaults();
+            memLog.offset = DID_LOG_SECTOR_SIZE;
+        }
+        updateMemoryLayout();
+        return;
+    }
+#endif
+
+    // Reading from memory (data block of the former format, replaced by the log on the first write)
+    size_t len = sizeof(memData);
+    uint8_t *dataRead = flashRead((uint32)DID_DATA_FLASH_ADDR, len);
+
+    // Copy content to Variables
+    write_to_variable(len, dataRead, (uint8_t*)(&memData));
+    free(dataRead);
+
+    // Validate the Memory Based on Programming Date and System Name
+    init = validateMemory();
+
+    // Check Init
+    if(!init){
+        loadDefaults();
+    }
+
+    updateMemoryLayout();
+}
+
+/**
+ * Returns the decoded memory layout, valid after init_memory
+ */
+const Memory_Layout* getMemoryLayout(void){
+    return &memLayout;
 }
 
 //============================================================================
@@ -267,6 +498,37 @@ uint8_t* readData(uint16_t identifier, uint8_t* len, uint8_t* nrc){
             *len = FBL_DID_CAN_ID_BYTES_SIZE;
             return prepare_message(len, memData.did_can_id);
 
+        case FBL_DID_CHECKSUM_MODE: {
+            uint8_t checksum_mode = flashingGetChecksumMode();
+            *len = FBL_DID_CHECKSUM_MODE_BYTES_SIZE;
+            return prepare_message(len, &checksum_mode);
+        }
+
+        case FBL_DID_ERASE_PROGRESS: {
+            uint32_t total = 0;
+            uint32_t erased = flashingGetEraseProgress(&total);
+            uint8_t progress[FBL_DID_ERASE_PROGRESS_BYTES_SIZE] = {(uint8_t)(erased >> 24), (uint8_t)(erased >> 16), (uint8_t)(erased >> 8), (uint8_t)erased,
+                                                                   (uint8_t)(total >> 24), (uint8_t)(total >> 16), (uint8_t)(total >> 8), (uint8_t)total};
+            *len = FBL_DID_ERASE_PROGRESS_BYTES_SIZE;
+            return prepare_message(len, progress);
+        }
+
+        case FBL_DID_PROGRAMMED_OFFSET: {
+            uint32_t start = 0;
+            uint32_t programmed = flashingGetProgrammedOffset(&start);
+            uint8_t offset[FBL_DID_PROGRAMMED_OFFSET_BYTES_SIZE] = {(uint8_t)(start >> 24), (uint8_t)(start >> 16), (uint8_t)(start >> 8), (uint8_t)start,
+                                                                    (uint8_t)(programmed >> 24), (uint8_t)(programmed >> 16), (uint8_t)(programmed >> 8), (uint8_t)programmed};
+            *len = FBL_DID_PROGRAMMED_OFFSET_BYTES_SIZE;
+            return prepare_message(len, offset);
+        }
+
+        case FBL_DID_PERF_COUNTERS: {
+            uint8_t counters[FBL_DID_PERF_COUNTERS_BYTES_SIZE];
+            perfSerialize(counters);
+            *len = FBL_DID_PERF_COUNTERS_BYTES_SIZE;
+            return prepare_message(len, counters);
+        }
+
         case FBL_DID_BL_WRITE_START_ADD_CORE0:
             *len = FBL_DID_BL_WRITE_START_ADD_CORE0_BYTES_SIZE;
             return prepare_message(len, memData.did_bl_write_start_add_core0);
@@ -354,12 +616,14 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_KEY_ADDRESS_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_key_address);
+            updateMemoryLayout();
             break;
 
         case FBL_DID_BL_KEY_GOOD_VALUE:
             if(len != FBL_DID_BL_KEY_GOOD_VALUE_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_key_good_value);
+            updateMemoryLayout();
             break;
 
         case FBL_DID_CAN_BASE_MASK:
@@ -374,10 +638,24 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             write_to_variable(len, data, memData.did_can_id);
             break;
 
+        case FBL_DID_CHECKSUM_MODE:
+            if(len != FBL_DID_CHECKSUM_MODE_BYTES_SIZE)
+                return FBL_RC_REQUEST_OUT_OF_RANGE;
+            // Only kept in RAM, nothing to store in the data flash
+            return flashingSetChecksumMode(data[0]);
+
+        case FBL_DID_PERF_COUNTERS:
+            if(len != 1 || data[0] != FBL_PERF_COUNTERS_RESET)
+                return FBL_RC_REQUEST_OUT_OF_RANGE;
+            // Only kept in RAM, nothing to store in the data flash
+            perfReset();
+            return 0;
+
         case FBL_DID_BL_WRITE_START_ADD_CORE0:
             if(len != FBL_DID_BL_WRITE_START_ADD_CORE0_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_start_add_core0);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -387,6 +665,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_END_ADD_CORE0_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_end_add_core0);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -397,6 +676,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_START_ADD_CORE1_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_start_add_core1);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -406,6 +686,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_END_ADD_CORE1_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_end_add_core1);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -416,6 +697,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_START_ADD_CORE2_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_start_add_core2);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -425,6 +707,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_END_ADD_CORE2_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_end_add_core2);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -434,6 +717,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_START_ADD_ASW_KEY_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_start_add_asw_key);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -443,6 +727,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_END_ADD_ASW_KEY_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_end_add_asw_key);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -452,6 +737,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_START_ADD_CAL_DATA_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_start_add_cal_data);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -461,6 +747,7 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             if(len != FBL_DID_BL_WRITE_END_ADD_CAL_DATA_BYTES_SIZE)
                 return FBL_RC_REQUEST_OUT_OF_RANGE;
             write_to_variable(len, data, memData.did_bl_write_end_add_cal_data);
+            updateMemoryLayout();
 
             // Update the flash driver
             flashDriverInit();
@@ -470,8 +757,14 @@ uint8_t writeData(uint16_t identifier, uint8_t* data, uint8_t len){
             return FBL_RC_SUB_FUNC_NOT_SUPPORTED;
     }
 
+#if MEMORY_DID_LOG
+    // Finally append the changed value to the log in the data flash
+    if(!appendLog(getLogEntry(identifier)))
+        return FBL_RC_GENERAL_PROGRAMMING_FAILURE;
+#else
     // Finally store the changed values to flash
     flashWrite((uint32)DID_DATA_FLASH_ADDR, (uint32_t*)(&memData), sizeof(memData) / sizeof(uint32_t));
+#endif
 
     return 0; // return 0 on success
 }
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : perf_counters.c
+// Author      : Michael Bauer
+// Version     : 0.3
+// Copyright   : MIT
+// Description : Performance counters of the bootloader, readable via FBL_DID_PERF_COUNTERS
+//============================================================================
+
+#include <string.h>
+
+#include "perf_counters.h"
+#include "uds_comm_spec.h"
+
+Perf_Counters perfCounters;
+
+//============================================================================
+// Private Helper Functions
+//============================================================================
+
+static uint8_t *put_uint32(uint8_t *data, uint32_t value){
+    data[0] = (uint8_t)(value >> 24);
+    data[1] = (uint8_t)(value >> 16);
+    data[2] = (uint8_t)(value >> 8);
+    data[3] = (uint8_t)value;
+    return data + 4;
+}
+
+//============================================================================
+// Counting
+//============================================================================
+
+/**
+ * Returns the start of a measurement for perfStop
+ */
+Ifx_TickTime perfStart(void){
+#if PERF_COUNTERS
+    return now();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Adds the ticks since start to the counter of the section
+ *
+ * @param section   Measured section
+ * @param start     Start of the measurement (perfStart)
+ */
+void perfStop(Perf_Section section, Ifx_TickTime start){
+#if PERF_COUNTERS
+    Ifx_TickTime ticks = now() - start;
+    if(ticks < 0 || section >= PERF_SECTIONS)
+        return;
+
+    Perf_Counter *counter = &perfCounters.sections[section];
+    counter->count++;
+    counter->ticks += (uint64_t)ticks;
+    if((uint64_t)ticks > counter->max_ticks)
+        counter->max_ticks = ticks > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)ticks;
+#else
+    (void)section;
+    (void)start;
+#endif
+}
+
+/**
+ * Counts a negative response, called for every NRC sent by uds_neg_response. Called from the main loop and from the
+ * CAN RX interrupt (Busy Repeat Request of isotp.c), the increments are done with locked interrupts.
+ *
+ * @param neg_code  Negative Response Code
+ */
+void perfCountNegativeResponse(uint8_t neg_code){
+#if PERF_COUNTERS
+    boolean interruptState = IfxCpu_disableInterrupts();
+    perfCounters.negative_responses++;
+    if(neg_code == FBL_RC_BUSY_REPEAT_REQUEST)
+        perfCounters.busy_repeat_responses++;
+    IfxCpu_restoreInterrupts(interruptState);
+#else
+    (void)neg_code;
+#endif
+}
+
+/**
+ * Counts an overrun of the RX FIFO, the number of frames lost in it is not known
+ */
+void perfCountRxFifoOverrun(void){
+#if PERF_COUNTERS
+    perfCounters.rx_fifo_overrun_events++;
+#endif
+}
+
+//============================================================================
+// Readout
+//============================================================================
+
+/**
+ * Sets all counters to 0, e.g. before a flashing session that is measured
+ */
+void perfReset(void){
+    memset(&perfCounters, 0, sizeof(perfCounters));
+}
+
+/**
+ * Writes the counters in the format of FBL_DID_PERF_COUNTERS (big-endian)
+ *
+ * @param data  Buffer of PERF_COUNTERS_BYTES_SIZE bytes
+ */
+void perfSerialize(uint8_t *data){
+    data = put_uint32(data, (uint32_t)IfxStm_getFrequency(BSP_DEFAULT_TIMER));
+    *data++ = PERF_SECTIONS;
+
+    for(int i = 0; i < PERF_SECTIONS; i++){
+        const Perf_Counter *counter = &perfCounters.sections[i];
+        data = put_uint32(data, counter->count);
+        data = put_uint32(data, (uint32_t)(counter->ticks >> 32));
+        data = put_uint32(data, (uint32_t)counter->ticks);
+        data = put_uint32(data, counter->max_ticks);
+    }
+
+    data = put_uint32(data, perfCounters.negative_responses);
+    data = put_uint32(data, perfCounters.busy_repeat_responses);
+    put_uint32(data, perfCounters.rx_fifo_overrun_events);
+}
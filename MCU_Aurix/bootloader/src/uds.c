@@ -7,7 +7,7 @@
 //============================================================================
 // Name        : uds.c
 // Author      : Dorothea Ehrl, Sebastian Rodriguez, Michael Bauer, Wiktor Pilarczyk
-// Version     : 0.3
+// Version     : 0.4
 // Copyright   : MIT
 // Description : UDS Layer implementation
 //============================================================================
@@ -21,6 +21,7 @@
 #include "session_manager.h"
 #include "memory.h"
 #include "flashing.h"
+#include "perf_counters.h"
 
 #define REQUEST                                                 0
 #define RESPONSE                                                1
@@ -55,6 +56,8 @@ void uds_close(void){
 //============================================================================
 
 void uds_handleRX(uint8_t* data, uint32_t data_len){
+    Ifx_TickTime start = perfStart();
+
     UDS_Msg* msg = malloc(sizeof(UDS_Msg));
     msg->len = data_len;
     msg->data = data;
@@ -150,12 +153,13 @@ void uds_handleRX(uint8_t* data, uint32_t data_len){
                 uds_write_data_by_identifier(did, msg->data + 3, msg->len - 3);
                 break;
             case FBL_REQUEST_DOWNLOAD:
-                if(msg->len != 9){
+                if(msg->len != 9 && msg->len != 10){
                     responded = 0;
                     break;
                 }
 
-                uds_request_download(getMemoryAddress(msg), getFlashingBytes(msg));
+                // Optional dataFormatIdentifier behind the size
+                uds_request_download(getMemoryAddress(msg), getFlashingBytes(msg), msg->len == 10 ? msg->data[9] : FBL_DATA_FORMAT_UNCOMPRESSED);
                 break;
             case FBL_REQUEST_UPLOAD:
                 if(msg->len != 9){
@@ -195,11 +199,13 @@ void uds_handleRX(uint8_t* data, uint32_t data_len){
         // Call session control to indicate that valid communication was received
         sessionControl();
     } else {
-        uds_neg_response(SID, nrc);
+        uds_neg_response(SID, neg_code);
     }
 
     // Important: Free the UDS msg variable
     free(msg);
+
+    perfStop(PERF_UDS_REQUEST, start);
 }
 
 //============================================================================
@@ -215,7 +221,7 @@ void uds_handleRX(uint8_t* data, uint32_t data_len){
  */
 void uds_diagnostic_session_control(uint8_t session){
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
 
     // Set Session if possible
     uint8_t nrc = setSession(session);
@@ -234,7 +240,7 @@ void uds_diagnostic_session_control(uint8_t session){
  */
 void uds_ecu_reset(uint8_t reset_type){
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
 
     uint8_t nrc = isResetTypeAvailable(reset_type);
     if (nrc){
@@ -260,7 +266,7 @@ void uds_ecu_reset(uint8_t reset_type){
  */
 void uds_security_access(uint8_t request_type, uint8_t *key, uint8_t key_len){
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
     int len;
     uint8_t *msg = _create_security_access(&len, RESPONSE, request_type, key, key_len);
     isotp_send(iso, msg, len);
@@ -272,7 +278,7 @@ void uds_security_access(uint8_t request_type, uint8_t *key, uint8_t key_len){
  */
 void uds_tester_present(void){
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
     int len;
     uint8_t *msg = _create_tester_present(&len, RESPONSE, FBL_TESTER_PRES_WITH_RESPONSE);
     isotp_send(iso, msg, len);
@@ -299,7 +305,7 @@ void uds_read_data_by_identifier(uint16_t did){
     tx_reset_isotp_buffer(iso);
     int response_len;
     uint8_t* response_msg = _create_read_data_by_ident(&response_len, RESPONSE, did, data, len);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
     isotp_send(iso, response_msg, response_len);
     free(response_msg);
     free(data);
@@ -310,7 +316,7 @@ void uds_read_data_by_identifier(uint16_t did){
  */
 void uds_read_memory_by_address(uint32_t address, uint16_t noBytesToRead){
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
     int len;
 
     uint8_t data[noBytesToRead];
@@ -333,7 +339,7 @@ void uds_write_data_by_identifier(uint16_t did, uint8_t* data, uint8_t data_len)
         return;
     }
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
     int len;
     uint8_t *msg = _create_write_data_by_ident(&len, RESPONSE, did, 0, 0);
     isotp_send(iso, msg, len);
@@ -346,8 +352,8 @@ void uds_write_data_by_identifier(uint16_t did, uint8_t* data, uint8_t data_len)
 /**
  * Method to send the response for request download
  */
-void uds_request_download(uint32_t address, uint32_t data_len){
-    uint8_t nrc = flashingRequestDownload(address, data_len);
+void uds_request_download(uint32_t address, uint32_t data_len, uint8_t data_format){
+    uint8_t nrc = flashingRequestDownload(address, data_len, data_format);
     if(nrc){
         uds_neg_response(FBL_REQUEST_DOWNLOAD, nrc);
         return;
@@ -355,7 +361,7 @@ void uds_request_download(uint32_t address, uint32_t data_len){
 
     // Prepare TX
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
 
     // Read out the flashing buffer size from flashing
     uint32_t flashingBuffer = flashingGetFlashBufferSize();
@@ -379,14 +385,20 @@ void uds_request_upload(uint32_t address, uint32_t data_len){
 
     // Prepare TX
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
 
-    // Read out the flashing buffer size from flashing
+    // Read out the checksum from flashing, either one for the range or one per sector
     uint32_t checksum = flashingGetChecksum();
+    const uint32_t *sector_checksums = NULL;
+    uint32_t num_sector_checksums = flashingGetSectorChecksums(&sector_checksums);
 
     // Create msg
     int len;
-    uint8_t *msg = _create_request_upload(&len, RESPONSE, address, checksum);
+    uint8_t *msg;
+    if(num_sector_checksums > 0)
+        msg = _create_request_upload_sector_map(&len, address, sector_checksums, num_sector_checksums);
+    else
+        msg = _create_request_upload(&len, RESPONSE, address, checksum);
     isotp_send(iso, msg, len);
     free(msg);
 }
@@ -403,7 +415,7 @@ void uds_transfer_data(uint32_t address, uint8_t* data, uint32_t data_len){
 
     // Prepare TX
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
 
     // Create msg
     int len;
@@ -425,7 +437,7 @@ void uds_request_transfer_exit(uint32_t address){
 
     // Prepare TX
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
 
     // Create msg
     int len;
@@ -438,8 +450,10 @@ void uds_request_transfer_exit(uint32_t address){
 // Negative Response - Common Response Codes
 
 void uds_neg_response(uint8_t rej_sid ,uint8_t neg_code){
+    perfCountNegativeResponse(neg_code);
+
     tx_reset_isotp_buffer(iso);
-    iso->max_len_per_frame = MAX_FRAME_LEN_CAN;
+    iso->max_len_per_frame = isotp_get_max_len_per_frame();
     int len;
     uint8_t *msg = _create_neg_response(&len, rej_sid, neg_code);
     isotp_send(iso, msg, len);
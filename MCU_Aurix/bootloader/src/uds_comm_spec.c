@@ -5,7 +5,7 @@
 //============================================================================
 // Name        : uds_comm_spec.c
 // Author      : Michael Bauer, Leon Wilms, Wiktor Pilarczyk
-// Version     : 1.0
+// Version     : 1.1
 // Copyright   : MIT
 // Description : UDS communication specification implementation
 //============================================================================
@@ -18,6 +18,7 @@ extern "C" {
 #include "uds_comm_spec.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 // TODO: Check on Error Handling for calloc -> Mainly relevant for MCU
 
@@ -25,9 +26,25 @@ extern "C" {
 // ISO TP Handling - TX
 //////////////////////////////////////////////////////////////////////////////
 
+/*
+ * @brief                       Rounds the given frame length up to the next length that can be encoded in the DLC.
+ *                              Classic CAN frames (up to 8 bytes) are not padded.
+ */
+static uint32_t tx_padded_frame_len(uint32_t len){
+    static const uint8_t canfd_len[] = {12, 16, 20, 24, 32, 48, 64};
+
+    if (len <= MAX_FRAME_LEN_CAN)
+        return len;
+
+    for(uint32_t i = 0; i < sizeof(canfd_len); i++){
+        if (len <= canfd_len[i])
+            return canfd_len[i];
+    }
+    return MAX_FRAME_LEN_CANFD;
+}
+
 uint8_t *tx_starting_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t max_len_per_frame, uint8_t* data_in, uint32_t data_in_len, uint32_t* data_out_idx_ctr){
     // Caller need to free the memory after processing
-    uint8_t can = (max_len_per_frame <= MAX_FRAME_LEN_CAN);
 
     if (data_in_len == 0){
         *data_out_len = 0;
@@ -37,64 +54,64 @@ uint8_t *tx_starting_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t m
         return msg;
     }
 
-    if (can){
-        if (data_in_len < max_len_per_frame){
-            // Generate Single Frame (Code = 0; Size 0-7) -> Data consists of 0 - 7 bytes of payload
-            *data_out_len = data_in_len + 1; // Include Protocol Control Information (PCI)
-            *has_next = 0;       // No further frames necessary
+    // Single Frame: 4 bit length in the PCI (0-7 bytes), CAN FD uses the escape sequence with the length in the second byte (8-62 bytes)
+    uint32_t sf_pci_len = (data_in_len < MAX_FRAME_LEN_CAN) ? 1 : 2;
+    if (data_in_len + sf_pci_len <= max_len_per_frame){
+        *data_out_len = tx_padded_frame_len(data_in_len + sf_pci_len);
+        *has_next = 0;       // No further frames necessary
 
-            uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
+        uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
 
-            if (msg == NULL){
-                *data_out_len = 0;
-                return msg;
-            }
+        if (msg == NULL){
+            *data_out_len = 0;
+            return msg;
+        }
 
+        if (sf_pci_len == 1){
             msg[0] = (uint8_t)(data_in_len & 0xF); // PCI
-            for(uint32_t i = 0; i < data_in_len; i++)
-                msg[1+i] = data_in[i];  // Payload
-            *data_out_idx_ctr = 0; // No further frame
-            return msg;
         }
         else {
-            // Generate First Frame (Code = 1, Data 0+1 (=0x1008..0x1FFF)) -> Data consists of initial payload (6 bytes), Size 8-4095
-            *data_out_len = max_len_per_frame; // Include Protocol Control Information (PCI)
-            *has_next = 1;      // Further frames necessary
-
-            uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
-
-            if (msg == NULL){
-                *data_out_len = 0;
-                return msg;
-            }
-
-            msg[0] = (1<<4);    // PCI
+            msg[0] = 0;                             // PCI (Escape Sequence)
+            msg[1] = (uint8_t)data_in_len;
+        }
+        memcpy(&msg[sf_pci_len], data_in, data_in_len);                                                         // Payload
+        memset(&msg[sf_pci_len + data_in_len], ISOTP_PADDING_BYTE, *data_out_len - (sf_pci_len + data_in_len));  // Padding (CAN FD)
+        *data_out_idx_ctr = 0; // No further frame
+        return msg;
+    }
 
-            if (data_in_len > 0xFFF)    // Restrict length to max length
-                data_in_len = 0xFFF;
+    // First Frame: 12 bit length in the PCI (up to 4095 bytes), longer messages use the escape sequence with 32 bit length
+    uint32_t ff_pci_len = (data_in_len <= ISOTP_FF_DL_12BIT_MAX) ? 2 : 6;
+    *data_out_len = max_len_per_frame; // Include Protocol Control Information (PCI)
+    *has_next = 1;      // Further frames necessary
 
-            msg[0] |= (uint8_t)(data_in_len>>8 & 0xF);
-            msg[1] = (uint8_t)(data_in_len & 0xFF);
+    uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
 
-            *data_out_idx_ctr = 6; // Add the first 6 bytes, next frame starts at idx 6
-            for(uint32_t i = 0; i < *data_out_idx_ctr; i++)
-                msg[2+i] = data_in[i];  // Payload
-            return msg;
-        }
+    if (msg == NULL){
+        *data_out_len = 0;
+        return msg;
     }
 
-    // Other, e.g. CAN FD
+    msg[0] = (1<<4);    // PCI
+    if (ff_pci_len == 2){
+        msg[0] |= (uint8_t)(data_in_len>>8 & 0xF);
+        msg[1] = (uint8_t)(data_in_len & 0xFF);
+    }
     else {
-        printf("TODO: Not yet implemented!");
-        *data_out_len = 0;
-        *has_next = 0;
-        return (uint8_t*)calloc(0, sizeof(uint8_t));
+        msg[1] = 0;     // Escape Sequence
+        msg[2] = (uint8_t)((data_in_len>>24) & 0xFF);
+        msg[3] = (uint8_t)((data_in_len>>16) & 0xFF);
+        msg[4] = (uint8_t)((data_in_len>>8)  & 0xFF);
+        msg[5] = (uint8_t)((data_in_len)     & 0xFF);
     }
+
+    *data_out_idx_ctr = max_len_per_frame - ff_pci_len; // Next frame starts after the payload of the First Frame
+    memcpy(&msg[ff_pci_len], data_in, *data_out_idx_ctr);  // Payload
+    return msg;
 }
 
 uint8_t *tx_consecutive_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t max_len_per_frame, uint8_t* data_in, uint32_t data_in_len, uint32_t* data_out_idx_ctr, uint8_t* frame_idx){
     // Caller need to free the memory after processing
-    uint8_t can = (max_len_per_frame <= MAX_FRAME_LEN_CAN);
 
     if (data_in_len == 0){
         *data_out_len = 0;
@@ -103,38 +120,35 @@ uint8_t *tx_consecutive_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_
         return msg;
     }
 
-    if (can){
-        if (data_in_len > 0xFFF)    // Restrict length to max length
-            data_in_len = 0xFFF;
-
-        // Generate Consecutive Frame (Code = 2, Index 1-15)
-        if((*data_out_idx_ctr + (max_len_per_frame-1)) < data_in_len){
-            *data_out_len = max_len_per_frame; // Include Protocol Control Information (PCI)
-            *has_next = 1;
-        }
-        else { // Last Frame reached
-            *data_out_len = data_in_len - *data_out_idx_ctr + 1;
-            *has_next = 0;
-        }
+    // Generate Consecutive Frame (Code = 2, Index 1-15)
+    uint32_t payload_len;
+    if((*data_out_idx_ctr + (max_len_per_frame-1)) < data_in_len){
+        payload_len = max_len_per_frame - 1;
+        *has_next = 1;
+    }
+    else { // Last Frame reached
+        payload_len = data_in_len - *data_out_idx_ctr;
+        *has_next = 0;
+    }
+    *data_out_len = tx_padded_frame_len(payload_len + 1); // Include Protocol Control Information (PCI)
 
-        uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
-        msg[0] = (2<<4);    // PCI
-        *frame_idx += 1;
-        if ((*frame_idx % 0x10) == 0)
-            *frame_idx = 1;
-        msg[0] |= *frame_idx;
-
-        for(uint8_t i = 0; i < *data_out_len-1; i++){
-            msg[1+i] = data_in[*data_out_idx_ctr];
-            *data_out_idx_ctr += 1;
-        }
+    uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
+    if (msg == NULL){
+        *data_out_len = 0;
+        *has_next = 0;
         return msg;
     }
 
-    printf("TODO: Not yet implemented!");
-    *data_out_len = 0;
-    *has_next = 0;
-    return (uint8_t*)calloc(0, sizeof(uint8_t));
+    msg[0] = (2<<4);    // PCI
+    *frame_idx += 1;
+    if ((*frame_idx % 0x10) == 0)
+        *frame_idx = 1;
+    msg[0] |= *frame_idx;
+
+    memcpy(&msg[1], &data_in[*data_out_idx_ctr], payload_len);
+    memset(&msg[1 + payload_len], ISOTP_PADDING_BYTE, *data_out_len - (1 + payload_len)); // Padding (CAN FD)
+    *data_out_idx_ctr += payload_len;
+    return msg;
 }
 
 // TODO: think about a better solution with sep_time ~ Leon
@@ -187,73 +201,41 @@ uint8_t *tx_flow_control_frame(uint32_t *data_out_len, uint8_t flag, uint8_t blo
 // ISO TP Handling - RX
 //////////////////////////////////////////////////////////////////////////////
 
-uint8_t rx_is_starting_frame(uint8_t* data_in, uint32_t data_in_len, uint8_t max_len_per_frame){
-    uint8_t can = (max_len_per_frame <= MAX_FRAME_LEN_CAN);
-
+uint8_t rx_is_starting_frame(uint8_t* data_in, uint32_t data_in_len){
     if (data_in_len == 0)
         return 0xFF; // Error
 
-    if(can){
-        uint8_t result = (((0xF0 & data_in[0])>> 4) == 0) || (((0xF0 & data_in[0])>> 4) == 1);
-        //printf("UDS_Comm_Spec - rx_is_starting_frame: %d\n", result);
-        return result;
-    }
-
-    printf("TODO: Not yet implemented!");
-    return 0xFF; // Error
+    // Same PCI for CAN and CAN FD, the escape sequences only change the length fields
+    uint8_t result = (((0xF0 & data_in[0])>> 4) == 0) || (((0xF0 & data_in[0])>> 4) == 1);
+    return result;
 }
 
-uint8_t rx_is_consecutive_frame(uint8_t* data_in, uint32_t data_in_len, uint8_t max_len_per_frame){
-    uint8_t can = (max_len_per_frame <= MAX_FRAME_LEN_CAN);
-
+uint8_t rx_is_consecutive_frame(uint8_t* data_in, uint32_t data_in_len){
     if (data_in_len == 0)
         return 0xFF; // Error
 
-    if(can){
-        uint8_t result = ((0xF0 & data_in[0])>> 4) == 2;
-        //printf("UDS_Comm_Spec - rx_is_consecutive_frame: %d\n", result);
-        return result;
-    }
-
-    printf("TODO: Not yet implemented!");
-    return 0xFF; // Error
+    uint8_t result = ((0xF0 & data_in[0])>> 4) == 2;
+    return result;
 }
 
-uint8_t rx_is_single_Frame(uint8_t* data_in, uint32_t data_in_len, uint8_t max_len_per_frame){
-    uint8_t can = (max_len_per_frame <= MAX_FRAME_LEN_CAN);
-
+uint8_t rx_is_single_Frame(uint8_t* data_in, uint32_t data_in_len){
     if (data_in_len == 0)
         return 0xFF; // Error
 
-    if(can){
-        uint8_t result = (((0xF0 & data_in[0])>> 4) == 0);
-        //printf("UDS_Comm_Spec - rx_is_single_frame: %d\n", result);
-        return result;
-    }
-
-    printf("TODO: Not yet implemented!");
-    return 0xFF; // Error
+    uint8_t result = (((0xF0 & data_in[0])>> 4) == 0);
+    return result;
 }
 
-uint8_t rx_is_flow_control_frame(uint8_t* data_in, uint32_t data_in_len, uint8_t max_len_per_frame){
-    uint8_t can = (max_len_per_frame <= MAX_FRAME_LEN_CAN);
-
+uint8_t rx_is_flow_control_frame(uint8_t* data_in, uint32_t data_in_len){
     if (data_in_len == 0)
         return 0xFF; // Error
 
-    if(can){
-        uint8_t result = (((0xF0 & data_in[0])>> 4) == 3);
-        //printf("UDS_Comm_Spec - rx_is_flow_control_frame: %d\n", result);
-        return result;
-    }
-
-    printf("TODO: Not yet implemented!");
-    return 0xFF; // Error
+    uint8_t result = (((0xF0 & data_in[0])>> 4) == 3);
+    return result;
 }
 
-uint8_t *rx_starting_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t max_len_per_frame, uint8_t* data_in, uint32_t data_in_len){
+uint8_t *rx_starting_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t* data_in, uint32_t data_in_len){
     // Caller need to free the memory after processing
-    uint8_t can = (max_len_per_frame <= MAX_FRAME_LEN_CAN);
 
     if (data_in_len == 0){
         *data_out_len = 0;
@@ -261,49 +243,52 @@ uint8_t *rx_starting_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t m
         return msg;
     }
 
-    if (can){
-        if(((0xF0 & data_in[0]) >> 4) == 0){ // Single Frame
-            *data_out_len = 0xF & data_in[0];
-            uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
-            *has_next = 0;
-
-            if (msg == NULL){
-                *data_out_len = 0;
-                return msg;
-            }
-
-            // Copy content
-            for(unsigned int i = 0; i < *data_out_len; i++){
-                msg[i] = data_in[i+1];
-            }
-            return msg;
+    if(((0xF0 & data_in[0]) >> 4) == 0){ // Single Frame
+        uint32_t pci_len = 1;
+        *data_out_len = 0xF & data_in[0];
+        if (*data_out_len == 0 && data_in_len > 1){ // Escape Sequence (CAN FD), length in second byte
+            pci_len = 2;
+            *data_out_len = data_in[1];
         }
+        if (*data_out_len > data_in_len - pci_len)  // Length exceeds the frame
+            *data_out_len = data_in_len - pci_len;
 
-        else if(((0xF0 & data_in[0])>>4) == 1){ // First Frame
-            *data_out_len = ((data_in[0] & 0x0F) << 4) | data_in[1];
-            uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
-            *has_next = 1;
-
-            if (msg == NULL){
-                *data_out_len = 0;
-                return msg;
-            }
+        uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
+        *has_next = 0;
 
-            // Copy content
-            for(unsigned int i = 0; i < data_in_len - 2; i++){
-                msg[i] = data_in[i+2];
-            }
+        if (msg == NULL){
+            *data_out_len = 0;
             return msg;
         }
-        else{
+
+        // Copy content, padding is dropped
+        memcpy(msg, &data_in[pci_len], *data_out_len);
+        return msg;
+    }
+
+    else if(((0xF0 & data_in[0])>>4) == 1 && data_in_len >= 2){ // First Frame
+        uint32_t pci_len = 2;
+        *data_out_len = ((data_in[0] & 0x0F) << 8) | data_in[1];
+        if (*data_out_len == 0 && data_in_len >= 6){ // Escape Sequence, 32 bit length
+            pci_len = 6;
+            *data_out_len = ((uint32_t)data_in[2] << 24) | ((uint32_t)data_in[3] << 16) | ((uint32_t)data_in[4] << 8) | data_in[5];
+        }
+        uint8_t *msg = (uint8_t*)calloc(*data_out_len, sizeof(uint8_t));
+        *has_next = 1;
+
+        if (msg == NULL){
             *data_out_len = 0;
-            *has_next = 0;
-            return (uint8_t*)calloc(0, sizeof(uint8_t));
+            return msg;
         }
+
+        // Copy content
+        uint32_t payload_len = data_in_len - pci_len;
+        if (payload_len > *data_out_len)
+            payload_len = *data_out_len;
+        memcpy(msg, &data_in[pci_len], payload_len);
+        return msg;
     }
-    // Other, e.g. CAN FD
-    else {
-        printf("TODO: Not yet implemented!");
+    else{
         *data_out_len = 0;
         *has_next = 0;
         return (uint8_t*)calloc(0, sizeof(uint8_t));
@@ -317,17 +302,20 @@ uint8_t rx_consecutive_frame(uint32_t *data_out_len, uint8_t *data_out, uint32_t
         return 0;
     }
 
-    if ((*idx + (data_in_len - 1)) > *data_out_len){
+    // The last frame of CAN FD is padded up to the next valid DLC, only the remaining bytes are payload
+    uint32_t payload_len = data_in_len - 1;
+    if (*idx + payload_len > *data_out_len && data_in_len > MAX_FRAME_LEN_CAN)
+        payload_len = *data_out_len - *idx;
+
+    if ((*idx + payload_len) > *data_out_len){
         *has_next = 0;
         printf("UDS Comm Spec Usage Error: Received data is too long for data buffer - IDX: %d, Data_In_Len: %d, Data_out_len: %d\n", *idx, data_in_len, *data_out_len);
         return 0;
     }
 
     // Write all the data that fits into available data_out buffer
-    for(unsigned int i = 1; i < data_in_len; i++){
-        data_out[*idx] = data_in[i];
-        *idx = *idx + 1;
-    }
+    memcpy(&data_out[*idx], &data_in[1], payload_len);
+    *idx = *idx + payload_len;
 
     if (*idx < *data_out_len )
         *has_next = 1;
@@ -449,12 +437,15 @@ uint8_t *_create_write_data_by_ident(int *len, uint8_t response, uint16_t did, u
  * Specification for Upload | Download
  */
 
-void upload_download_message(uint8_t *msg, uint32_t addr, uint8_t response, uint32_t bytes_size) {
+void upload_download_message(uint8_t *msg, int len, uint32_t addr, uint8_t response, uint32_t bytes_size) {
     msg[1] = (uint8_t)((addr>>24) & 0xFF);                      // Address Byte 4
     msg[2] = (uint8_t)((addr>>16) & 0xFF);                      // Address Byte 3
     msg[3] = (uint8_t)((addr>>8)  & 0xFF);                      // Address Byte 2
     msg[4] = (uint8_t)((addr)     & 0xFF);                      // Address Byte 1
 
+    if(len < 9)
+        return;
+
     // Request = Number of Bytes, Response = Buffer Side on Receiver side (bigger messages get rejected during transfer)
     msg[5] = (uint8_t)((bytes_size>>24) & 0xFF);            // Size Byte 4
     msg[6] = (uint8_t)((bytes_size>>16) & 0xFF);            // Size Byte 3
@@ -467,7 +458,18 @@ uint8_t *_create_request_download(int *len, uint8_t response, uint32_t addr, uin
     uint8_t *msg = prepare_message(len, response, FBL_REQUEST_DOWNLOAD, 0, 9);
     if (msg == NULL)
         return msg;
-    upload_download_message(msg, addr, response, bytes_size);
+    upload_download_message(msg, *len, addr, response, bytes_size);
+
+    return msg;
+}
+
+// Request Download (0x34) - Request with dataFormatIdentifier, e.g. FBL_DATA_FORMAT_LZ4
+uint8_t *_create_request_download_format(int *len, uint32_t addr, uint32_t bytes_size, uint8_t data_format){
+    uint8_t *msg = prepare_message(len, 0, FBL_REQUEST_DOWNLOAD, 0, 10);
+    if (msg == NULL)
+        return msg;
+    upload_download_message(msg, *len, addr, 0, bytes_size);
+    msg[9] = data_format;                                       // dataFormatIdentifier
 
     return msg;
 }
@@ -478,7 +480,23 @@ uint8_t *_create_request_upload(int *len, uint8_t response, uint32_t addr, uint3
     if (msg == NULL)
         return msg;
 
-    upload_download_message(msg, addr, response, bytes_size);
+    upload_download_message(msg, *len, addr, response, bytes_size);
+    return msg;
+}
+
+// Request Upload (0x35) - Response with one checksum per sector (FBL_CHECKSUM_MODE_SECTOR_MAP)
+uint8_t *_create_request_upload_sector_map(int *len, uint32_t addr, const uint32_t *checksums, uint32_t num_checksums){
+    uint8_t *msg = prepare_message(len, 1, FBL_REQUEST_UPLOAD, 0, 5 + 4 * num_checksums);
+    if (msg == NULL)
+        return msg;
+
+    upload_download_message(msg, 5, addr, 1, 0);
+    for(uint32_t i = 0; i < num_checksums; i++){
+        msg[5+4*i] = (uint8_t)((checksums[i]>>24) & 0xFF);      // Checksum Byte 4
+        msg[6+4*i] = (uint8_t)((checksums[i]>>16) & 0xFF);      // Checksum Byte 3
+        msg[7+4*i] = (uint8_t)((checksums[i]>>8)  & 0xFF);      // Checksum Byte 2
+        msg[8+4*i] = (uint8_t)((checksums[i])     & 0xFF);      // Checksum Byte 1
+    }
     return msg;
 }
 
@@ -493,7 +511,7 @@ uint8_t *_create_transfer_data(int *len, uint8_t response, uint32_t addr, uint8_
     if (msg == NULL)
         return msg;
 
-    upload_download_message(msg, addr, 1, 0);
+    upload_download_message(msg, *len, addr, 1, 0);
     for(uint32_t i = 0; i < data_len; i++)
         msg[5+i] = data[i];                                     // Payload
     return msg;
@@ -20,6 +20,20 @@
 #include <string.h>
 #include <stdint.h>
 
+#include "uds_comm_spec.h"
+
+/**
+ * Acceptance of a received frame: Several ECUs share the bus, only frames addressed to the own ECU ID or to all ECUs
+ * (ECU ID 0) are processed
+ * @param rxID CAN ID of the received frame
+ * @param ownID CAN ID the ECU is transmitting with (getID)
+ * @return 1 if the frame is processed, otherwise 0
+ */
+static inline uint8_t canRxIDAccepted(uint32_t rxID, uint32_t ownID){
+    uint32_t ecu_id = rxID & FBLCAN_ECU_ID_MASK;
+    return (rxID & ~(uint32_t)0xFFFF) == FBLCAN_BASE_ADDRESS && (ecu_id == 0 || ecu_id == (ownID & FBLCAN_ECU_ID_MASK));
+}
+
 int canTransmitMessage(uint32_t canMessageID, uint8_t* data, size_t size);
 
 #endif /*CAN_DRIVER_H*/
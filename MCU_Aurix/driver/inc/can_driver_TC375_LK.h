@@ -4,7 +4,7 @@
 //============================================================================
 // Name        : can_driver_TC375.h
 // Author      : Sebastian Rodriguez
-// Version     : 0.1
+// Version     : 0.2
 // Copyright   : MIT
 // Description : Header for CAN Driver with AURIX Includes
 //============================================================================
@@ -25,7 +25,10 @@
 /**MACROS*/
 /*********/
 #define DEBUGGING                   0 //Debug Prints
-#define MAXIMUM_CAN_DATA_PAYLOAD    2 /*8Byte CAN-MESSAGE*/
+#define CAN_DRIVER_CANFD            1 /*CAN FD with bit rate switch, classic CAN frames are still received and sent*/
+#define CAN_FD_DATA_BAUDRATE        2000000 /*Bit rate of the data phase (CAN FD)*/
+#define MAXIMUM_CAN_DATA_PAYLOAD    16 /*64Byte CAN FD-MESSAGE*/
+#define CAN_RX_FIFO0_SIZE           15 /*Frames buffered in RX FIFO0 until the RX interrupt reads them*/
 #define INTERRUPT_PRIO_RX           1 /*Priority for RX Interrupt*/
 #define INTERRUPT_PRIO_TX           2 /*Prio for TX Interrupt*/
 
@@ -56,5 +59,6 @@ typedef struct Can_Msg
 }Can_Msg;
 
 void canInitDriver(void (*processData)(uint32_t*, IfxCan_DataLengthCode));
+uint8_t canDlcToLength(IfxCan_DataLengthCode dlc);
 
 #endif /* CAN_INIT_H */
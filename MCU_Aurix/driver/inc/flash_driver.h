@@ -6,7 +6,7 @@
 //============================================================================
 // Name        : flash_driver.h
 // Author      : Dorothea Ehrl, Michael Bauer, Paul Roy
-// Version     : 0.3
+// Version     : 0.5
 // Copyright   : MIT
 // Description : Flash wrapper for Bootloader
 //============================================================================
@@ -43,10 +43,15 @@
 /*********************************************************************************************************************/
 void flashDriverInit(void);
 void flashResetErasedSectionsCtr(void);
+void flashSetSectorErased(uint32_t flashStartAddr);
 
 bool flashWrite(uint32_t flashStartAddr, uint32_t data[], size_t dataSize);
+bool flashEraseProgram(uint32_t flashStartAddr, uint32_t lengthInBytes);
 bool flashVerify(uint32_t flashStartAddr, uint32_t data[], size_t dataSize);
+bool flashEraseData(uint32_t flashStartAddr, uint32_t numSectors);
+bool flashProgramData(uint32_t flashStartAddr, uint32_t data[], size_t dataSize);
 uint8_t *flashRead(uint32_t flashStartAddr, size_t dataBytesToRead);
 uint32_t flashCalculateChecksum(uint32_t flashStartAddr, uint32_t lengthInBytes);
+uint32_t flashCalculateChecksumRaw(uint32_t flashStartAddr, uint32_t lengthInBytes);
 
 #endif /* FLASH_H_ */
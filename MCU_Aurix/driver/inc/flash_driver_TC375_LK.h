@@ -68,6 +68,9 @@
 #define PROGRAM_FLASH_1_BASE_ADDR       0xA0300000  // Writeable Start Address (hard coded boundary to avoid overwriting reserved areas)
 #define PROGRAM_FLASH_1_END_ADDR        0xA05FFFFF  // Writeable End Address (hard coded boundary to avoid overwriting reserved areas)
 
+/* Logical sectors of PFLASH 0 and 1 (contiguous), the driver remembers which of them are erased */
+#define PFLASH_LOG_SECTORS              ((PROGRAM_FLASH_1_PHY_END_ADDR - PROGRAM_FLASH_0_PHY_BASE_ADDR + 1) / PFLASH_SECTOR_LENGTH)
+
 #define PFLASH_PAGE_LENGTH          IFXFLASH_PFLASH_PAGE_LENGTH /* 0x20 = 32 Bytes (smallest unit that can be
                                                                  * programmed in the Program Flash memory (PFLASH)) */
 #define PFLASH_LAST_PAGE_SIZE       (PFLASH_PAGE_LENGTH / 4)    /* 32 byte for 8 double words (uint32_t) */
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Dorothea Ehrl <dorothea.ehrl@fau.de>
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : flash_eraser.h
+// Author      : Dorothea Ehrl, Michael Bauer, Paul Roy
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Sector bookkeeping of the PFLASH, shared by the flash driver and the simulated ECU
+//============================================================================
+
+#ifndef FLASH_ERASER_H_
+#define FLASH_ERASER_H_
+
+/*********************************************************************************************************************/
+/*-----------------------------------------------------Includes------------------------------------------------------*/
+/*********************************************************************************************************************/
+#include "Ifx_types.h"
+#include "flash_driver_TC375_LK.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*********************************************************************************************************************/
+/*-------------------------------------------------Data Structures---------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/* Writeable regions of the memory layout and the logical sectors erased in the current session */
+typedef struct
+{
+        uint32_t init;
+        uint32_t core0_start_addr;
+        uint32_t core0_end_addr;
+        uint32_t core1_start_addr;
+        uint32_t core1_end_addr;
+        uint32_t core2_start_addr;
+        uint32_t core2_end_addr;
+        uint32_t asw_key_start_addr;
+        uint32_t asw_key_end_addr;
+        uint32_t cal_data_start_addr;
+        uint32_t cal_data_end_addr;
+        uint32_t erased_sectors[(PFLASH_LOG_SECTORS + 31) / 32];   // One bit per logical sector, set once erased in the current session
+} Flash_Eraser;
+
+/*********************************************************************************************************************/
+/*-------------------------------------------------Global variables--------------------------------------------------*/
+/*********************************************************************************************************************/
+extern Flash_Eraser pflash_eraser;
+
+/*********************************************************************************************************************/
+/*------------------------------------------------Function Prototypes------------------------------------------------*/
+/*********************************************************************************************************************/
+uint32_t flashGetNumPerSize(size_t sectionLength, size_t dataSize, bool upscale_to_byte);
+uint32_t flashErasePFlashSectors(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, uint32_t lengthInBytes);
+
+/* Backend of the flash driver: Erases logical sectors of the PFLASH within one physical sector */
+void flashEraseLogSectors(IfxFlash_FlashType flashModule, uint32_t sectorAddr, uint32_t numSectors);
+
+#endif /* FLASH_ERASER_H_ */
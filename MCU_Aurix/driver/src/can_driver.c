@@ -4,7 +4,7 @@
 //============================================================================
 // Name        : can_driver.c
 // Author      : Sebastian Rodriguez, Leon Wilms
-// Version     : 0.2
+// Version     : 0.3
 // Copyright   : MIT
 // Description : C File for CAN Driver
 //============================================================================
@@ -13,11 +13,16 @@
 #include "can_driver_TC375_LK.h"
 #include "led_driver.h"
 #include "led_driver_TC375_LK.h"
+#include "memory.h"
+#include "perf_counters.h"
 
 #include "Ifx_types.h"
 
 void (*processDataFunction)(uint32_t*, IfxCan_DataLengthCode);
 
+/*Number of data bytes for the DLC 0-15 (CAN FD: 9-15 encode 12-64 bytes)*/
+static const uint8_t canDlcLength[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
 //TODO: Implement the processDataFunction we want to use
 
 
@@ -46,9 +51,19 @@ void canIsrTxHandler(void){
 */
 void canIsrRxFifo0Handler(){
         IfxCan_Node_clearInterruptFlag(can_g.canTXandRXNode.node, IfxCan_Interrupt_rxFifo0NewMessage); /*Clear Message Stored Flag*/
+
+        // The flag is set without enabling its interrupt, frames were lost since the last frame (e.g. interrupts locked for PFLASH)
+        if(IfxCan_Node_getInterruptFlagStatus(can_g.canTXandRXNode.node, IfxCan_Interrupt_rxFifo0MessageLost)){
+            IfxCan_Node_clearInterruptFlag(can_g.canTXandRXNode.node, IfxCan_Interrupt_rxFifo0MessageLost);
+            perfCountRxFifoOverrun();
+        }
+
         IfxCan_Can_readMessage(&can_g.canTXandRXNode, &can_g.rxMsg, (uint32*)can_g.rxData);
 
-        // TODO: Filter for Own ECU ID or Broadcast messages - Do not call processDataFunction if message is for other ECU
+        // Frames for other ECUs on the bus are dropped
+        if(!canRxIDAccepted(can_g.rxMsg.messageId, getID()))
+            return;
+
         processDataFunction(can_g.rxData, can_g.rxMsg.dataLengthCode); //has to be casted in ISO-Tp
 
 }
@@ -77,8 +92,13 @@ static void canInitTXandRXNode(void){
     
     /*FRAME TYPE RX AND TX*/
     can_g.canNodeConfig.frame.type = IfxCan_FrameType_transmitAndReceive;
+#if CAN_DRIVER_CANFD
+    can_g.canNodeConfig.frame.mode = IfxCan_FrameMode_fdLongAndFast;                    /*CAN FD with bit rate switch*/
+    can_g.canNodeConfig.fastBaudRate.baudrate = CAN_FD_DATA_BAUDRATE;
+    can_g.canNodeConfig.txConfig.txBufferDataFieldSize = IfxCan_DataFieldSize_64;
+#endif
     can_g.canNodeConfig.rxConfig.rxFifo0DataFieldSize = IfxCan_DataFieldSize_64;
-    can_g.canNodeConfig.rxConfig.rxFifo0Size = 15;
+    can_g.canNodeConfig.rxConfig.rxFifo0Size = CAN_RX_FIFO0_SIZE;
     can_g.canNodeConfig.rxConfig.rxMode = IfxCan_RxMode_fifo0;
 
     /*PIN Definition*/
@@ -125,6 +145,27 @@ void canInitDriver(void (*processData)(uint32_t*, IfxCan_DataLengthCode)){
     processDataFunction = processData;
 }
 
+/**
+ * Converts the Data Length Code into the number of data bytes
+ * @param dlc Data Length Code of the CAN message
+ * @return Number of data bytes
+*/
+uint8_t canDlcToLength(IfxCan_DataLengthCode dlc){
+    return canDlcLength[dlc & 0xF];
+}
+
+/**
+ * Converts the number of data bytes into the smallest Data Length Code that fits them
+ * @param size Number of data bytes (0-64)
+ * @return Data Length Code of the CAN message
+*/
+static IfxCan_DataLengthCode canLengthToDlc(size_t size){
+    uint8_t dlc = 0;
+    while(canDlcLength[dlc] < size)
+        dlc++;
+    return (IfxCan_DataLengthCode)dlc;
+}
+
 /**
  * Transmits a CAN Message: Initialize new TX message, TX is transmitted
  * @param canMessageID, ID of CAN Message for Prio in BUS
@@ -137,20 +178,22 @@ int canTransmitMessage(uint32_t canMessageID, uint8_t* data, size_t size){
     can_g.txMsg.messageId = canMessageID;
     can_g.txMsg.messageIdLength = IfxCan_MessageIdLength_extended;
 
-    //Not sure if necessary ~Leon
-    // Ensure that the size of data does not exceed 8 bytes (32 bits)
-    if (size > 8) {
-        // Handle error: data size exceeds 4 bytes
+    // Ensure that the size of data does not exceed the CAN (FD) frame
+    if (size > (CAN_DRIVER_CANFD ? 64 : 8)) {
+        // Handle error: data size exceeds the frame
         return -1;
     }
 
     // Initialize g_can.txData to zero
-    can_g.txData[0] = 0;
-    can_g.txData[1] = 0;
+    memset(can_g.txData, 0, sizeof(can_g.txData));
 
-    can_g.txMsg.dataLengthCode = size;
+    can_g.txMsg.dataLengthCode = canLengthToDlc(size);
+#if CAN_DRIVER_CANFD
+    if (size > 8)
+        can_g.txMsg.frameMode = IfxCan_FrameMode_fdLongAndFast; /*Frames up to 8 bytes stay classic CAN*/
+#endif
 
-    // Copy up to 8 bytes of data into can_g.txData
+    // Copy up to 64 bytes of data into can_g.txData
     memcpy(can_g.txData, data, size);
 
 
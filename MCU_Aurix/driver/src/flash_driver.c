@@ -5,7 +5,7 @@
 //============================================================================
 // Name        : flash_driver.c
 // Author      : Dorothea Ehrl, Michael Bauer, Paul Roy
-// Version     : 0.3
+// Version     : 0.8
 // Copyright   : MIT
 // Description : Flash wrapper for Bootloader
 //============================================================================
@@ -20,8 +20,10 @@
 
 #include "flash_driver.h"
 #include "flash_driver_TC375_LK.h"
+#include "flash_eraser.h"
 #include "crc.h"
 #include "memory.h"
+#include "perf_counters.h"
 #include "uds_comm_spec.h"
 
 #define PMU_FLASH_MODULE             0               /* Macro to select the flash (PMU) module           */
@@ -59,7 +61,7 @@ typedef struct
     void (*load2X32bits)(uint32 pageAddr, uint32 wordL, uint32 wordU);
     void (*writePage)(uint32 pageAddr);
     void (*erasePFlash)(IfxFlash_FlashType flashModule, uint32_t sectorAddr, uint32_t numSectors);
-    void (*writePFlash)(IfxFlash_FlashType flashModule, uint32_t startingAddr, uint32_t numPages, uint32_t data[], size_t dataSize);
+    void (*writePFlashPage)(IfxFlash_FlashType flashModule, uint32_t pageAddr, uint32_t data[]);
 } Flash_Function;
 
 Flash_Function g_functionsFromPSPR;
@@ -67,49 +69,10 @@ Flash_Function g_functionsFromPSPR;
 uint32_t flash_driver_last_flashpage[PFLASH_LAST_PAGE_SIZE];
 
 
-
-typedef struct
-{
-        uint32_t init;
-        uint32_t core0_start_addr;
-        uint32_t core0_end_addr;
-        uint32_t core0_erased_sections;
-        uint32_t core1_start_addr;
-        uint32_t core1_end_addr;
-        uint32_t core1_erased_sections;
-        uint32_t core2_start_addr;
-        uint32_t core2_end_addr;
-        uint32_t core2_erased_sections;
-        uint32_t asw_key_start_addr;
-        uint32_t asw_key_end_addr;
-        uint32_t asw_key_erased_sections;
-        uint32_t cal_data_start_addr;
-        uint32_t cal_data_end_addr;
-        uint32_t cal_data_erased_sections;
-} Flash_Eraser;
-
-Flash_Eraser pflash_eraser;
 /*********************************************************************************************************************/
 /*--------------------------------------------Private Helper Functions-----------------------------------------------*/
 /*********************************************************************************************************************/
 
-static uint32_t flashGetDIDData(uint16_t DID){
-    uint32_t data = 0;
-
-    uint8_t len, nrc;
-    uint8_t *read = readData(DID, &len, &nrc);
-    if(!nrc){
-        if(len == 4){ // uint32_t
-            data |= (read[0] << 24);
-            data |= (read[1] << 16);
-            data |= (read[2] << 8);
-            data |= read[3];
-        }
-    }
-    free(read);
-    return data;
-}
-
 static void createLastFlashPage(uint32_t last_page_addr, uint32_t *data, size_t dataSize){
 
     /* Write 32 bytes (8 double words) into the last page buffer */
@@ -144,50 +107,33 @@ static void erasePFlash(IfxFlash_FlashType flashModule, uint32_t sectorAddr, uin
     g_functionsFromPSPR.waitUnbusy(PMU_FLASH_MODULE, flashModule);
 }
 
-/* This function writes the Program Flash memory. The function is copied in the PSPR through copyFunctionsToPSPR().
- * Because of this, inside the function, only routines from the PSPR or inline functions can be called,
- * otherwise a Context Type (CTYP) trap can be triggered.
+/* This function writes one page of the Program Flash memory. The function is copied in the PSPR through
+ * copyFunctionsToPSPR(). Because of this, inside the function, only routines from the PSPR or inline functions
+ * can be called, otherwise a Context Type (CTYP) trap can be triggered.
  */
-static void writePFlash(IfxFlash_FlashType flashModule, uint32_t startingAddr, uint32_t numPages, uint32_t data[], size_t dataSize)
+static void writePFlashPage(IfxFlash_FlashType flashModule, uint32_t pageAddr, uint32_t data[])
 {
-    uint32_t page;
     uint32_t offset;
 
     /* Get the current password of the Safety WatchDog module */
     uint16 endInitSafetyPassword = IfxScuWdt_getSafetyWatchdogPasswordInline();
-    uint32_t index = 0;
-
-    for(page = 0; page < numPages; page++)
-    {
-        uint32_t pageAddr = startingAddr + (page * PFLASH_PAGE_LENGTH);
-        uint32* data_for_page = (uint32*) (((uint8*) data) + (page * PFLASH_PAGE_LENGTH));
 
-        g_functionsFromPSPR.enterPageMode(pageAddr); // enter page mode to be able to write in page
-
-        /* Wait until page mode is entered */
-        g_functionsFromPSPR.waitUnbusy(PMU_FLASH_MODULE, flashModule);
+    g_functionsFromPSPR.enterPageMode(pageAddr); // enter page mode to be able to write in page
 
-        index = 0;
-        /* Write 32 bytes (8 double words) into the assembly buffer */
-        for(offset = 0; (offset * sizeof(uint32)) < PFLASH_PAGE_LENGTH; offset += 2)
-        {
-
-            if(page < numPages-1)
-                g_functionsFromPSPR.load2X32bits(pageAddr, data_for_page[offset], data_for_page[offset + 1]); // Load 2 words of 32 bits each
-            else // Act different for last page
-                g_functionsFromPSPR.load2X32bits(pageAddr, flash_driver_last_flashpage[index], flash_driver_last_flashpage[index + 1]); // Load 2 words of 32 bits each
+    /* Wait until page mode is entered */
+    g_functionsFromPSPR.waitUnbusy(PMU_FLASH_MODULE, flashModule);
 
-            index += 2;
-        }
+    /* Write 32 bytes (8 double words) into the assembly buffer */
+    for(offset = 0; (offset * sizeof(uint32)) < PFLASH_PAGE_LENGTH; offset += 2)
+        g_functionsFromPSPR.load2X32bits(pageAddr, data[offset], data[offset + 1]); // Load 2 words of 32 bits each
 
-        /* Write the page */
-        IfxScuWdt_clearSafetyEndinitInline(endInitSafetyPassword);      /* Disable EndInit protection               */
-        g_functionsFromPSPR.writePage(pageAddr);
-        IfxScuWdt_setSafetyEndinitInline(endInitSafetyPassword);        /* Enable EndInit protection                */
+    /* Write the page */
+    IfxScuWdt_clearSafetyEndinitInline(endInitSafetyPassword);      /* Disable EndInit protection               */
+    g_functionsFromPSPR.writePage(pageAddr);
+    IfxScuWdt_setSafetyEndinitInline(endInitSafetyPassword);        /* Enable EndInit protection                */
 
-        /* Wait until the page is written in the Program Flash memory */
-        g_functionsFromPSPR.waitUnbusy(PMU_FLASH_MODULE, flashModule);
-    }
+    /* Wait until the page is written in the Program Flash memory */
+    g_functionsFromPSPR.waitUnbusy(PMU_FLASH_MODULE, flashModule);
 }
 
 /* This function copies the erase and program routines to the Program Scratch-Pad SRAM (PSPR) of the CPU0 and assigns
@@ -214,226 +160,42 @@ static void copyFunctionsToPSPR(void)
     memcpy((void *)ERASEPFLASH_ADDR, (const void *)erasePFlash, ERASEPFLASH_LEN);
     g_functionsFromPSPR.erasePFlash = (void *)ERASEPFLASH_ADDR;
 
-    memcpy((void *)WRITEPFLASH_ADDR, (const void *)writePFlash, WRITEPFLASH_LEN);
-    g_functionsFromPSPR.writePFlash = (void *)WRITEPFLASH_ADDR;
-}
-
-static uint32_t getNumPerSize(size_t sectionLength, size_t dataSize, bool upscale_to_byte)
-{
-    if(upscale_to_byte)
-        dataSize *= sizeof(uint32_t); // dataSize is in uint32_t values, but bytes needed
-    uint32_t num_pages = dataSize / sectionLength;
-    if (dataSize % sectionLength) // we need a page more because there is data left that does not fill a full page
-    {
-        num_pages++;
-    }
-    return num_pages;
+    memcpy((void *)WRITEPFLASH_ADDR, (const void *)writePFlashPage, WRITEPFLASH_LEN);
+    g_functionsFromPSPR.writePFlashPage = (void *)WRITEPFLASH_ADDR;
 }
 
 static uint32_t getDFlashNumPages(size_t dataSize)
 {
-    return getNumPerSize(DFLASH_PAGE_LENGTH, dataSize, 1);
+    return flashGetNumPerSize(DFLASH_PAGE_LENGTH, dataSize, 1);
 }
 
 static uint32_t getDFlashNumSectors(size_t dataSize)
 {
-    return getNumPerSize(DFLASH_SECTOR_LENGTH, dataSize, 1);
+    return flashGetNumPerSize(DFLASH_SECTOR_LENGTH, dataSize, 1);
 }
 
 static uint32_t getPFlashNumPages(size_t dataSize)
 {
-    return getNumPerSize(PFLASH_PAGE_LENGTH, dataSize, 1);
+    return flashGetNumPerSize(PFLASH_PAGE_LENGTH, dataSize, 1);
 }
 
 static uint32_t getPFlashNumSectors(size_t dataSize)
 {
-    return getNumPerSize(PFLASH_SECTOR_LENGTH, dataSize, 0);
+    return flashGetNumPerSize(PFLASH_SECTOR_LENGTH, dataSize, 0);
 }
 
 static uint32_t getPFlashNumPhySectors()
 {
-    return getNumPerSize(PFLASH_SECTOR_LENGTH, PFLASH_PHY_SECTOR_LENGTH, 0);
+    return flashGetNumPerSize(PFLASH_SECTOR_LENGTH, PFLASH_PHY_SECTOR_LENGTH, 0);
 }
 
-static uint32_t getPFlashLogSecWithinPhySectors(uint32_t eraseStartAddr, size_t numLogSectorsReqToErase){
-
-    // In general: logSectorAddr == eraseStartAddr -> Need to be the same if parameter is correctly used (calculation is done for safety reasons)
-
-    // FILE * f3 = fopen("terminal window 3", "rw");
-    uint32_t withinLogSectorIdx = 0;
-    uint32_t logSectorAddr = 0;
-    uint32_t withinPhySectorIdx = 0;
-    uint32_t phySectorAddr = 0;
-
-    uint32_t logSectorsToNextPhySec = 0;
-
-
-    // Check on address range - PFLASH 0
-    if(eraseStartAddr >= PROGRAM_FLASH_0_PHY_BASE_ADDR && eraseStartAddr <= PROGRAM_FLASH_0_PHY_END_ADDR){
-
-        withinLogSectorIdx =  (eraseStartAddr - PROGRAM_FLASH_0_PHY_BASE_ADDR) / PFLASH_SECTOR_LENGTH;
-        logSectorAddr = PROGRAM_FLASH_0_PHY_BASE_ADDR + (withinLogSectorIdx * PFLASH_SECTOR_LENGTH);
-        withinPhySectorIdx = (eraseStartAddr - PROGRAM_FLASH_0_PHY_BASE_ADDR) / PFLASH_PHY_SECTOR_LENGTH;
-        phySectorAddr = PROGRAM_FLASH_0_PHY_BASE_ADDR + (withinPhySectorIdx * PFLASH_PHY_SECTOR_LENGTH);
-
-        logSectorsToNextPhySec = ((phySectorAddr + PFLASH_PHY_SECTOR_LENGTH) - logSectorAddr) / PFLASH_SECTOR_LENGTH;
-
-
-        /*
-        fprintf(f3, "ER Add: 0x%X, WLogSecIdx: %u, LogSecAddr: 0x%X, \nwPhySectIdx: %u, PhySecAddr: 0x%X, \nlogSectorsToNextPhy: %u, ER Req: %u\n",
-                        eraseStartAddr, withinLogSectorIdx, logSectorAddr, withinPhySectorIdx, phySectorAddr, logSectorsToNextPhySec, numLogSectorsReqToErase);
-        fclose(f3);
-        */
-
-
-        if(logSectorsToNextPhySec < numLogSectorsReqToErase){
-            return logSectorsToNextPhySec;
-        }else{
-            return numLogSectorsReqToErase;
-        }
-
-
-    }
-
-    // Check on address range - PFLASH 1
-    else if(eraseStartAddr >= PROGRAM_FLASH_1_PHY_BASE_ADDR && eraseStartAddr <= PROGRAM_FLASH_1_PHY_END_ADDR){
-        withinLogSectorIdx =  (eraseStartAddr - PROGRAM_FLASH_1_PHY_BASE_ADDR) / PFLASH_SECTOR_LENGTH;
-        logSectorAddr = PROGRAM_FLASH_1_PHY_BASE_ADDR + (withinLogSectorIdx * PFLASH_SECTOR_LENGTH);
-        withinPhySectorIdx = (eraseStartAddr - PROGRAM_FLASH_1_PHY_BASE_ADDR) / PFLASH_PHY_SECTOR_LENGTH;
-        phySectorAddr = PROGRAM_FLASH_1_PHY_BASE_ADDR + (withinPhySectorIdx * PFLASH_PHY_SECTOR_LENGTH);
-
-        logSectorsToNextPhySec = ((phySectorAddr + PFLASH_PHY_SECTOR_LENGTH) - logSectorAddr) / PFLASH_SECTOR_LENGTH;
-
-
-        /*
-        fprintf(f3, "ER Add: 0x%X, WLogSecIdx: %u, LogSecAddr: 0x%X, \nwPhySectIdx: %u, PhySecAddr: 0x%X, \nlogSectorsToNextPhy: %u, ER Req: %u\n\n",
-                        eraseStartAddr, withinLogSectorIdx, logSectorAddr, withinPhySectorIdx, phySectorAddr, logSectorsToNextPhySec, numLogSectorsReqToErase);
-        fclose(f3);
-        */
-
-
-        if(logSectorsToNextPhySec < numLogSectorsReqToErase){
-            return logSectorsToNextPhySec;
-        }else{
-            return numLogSectorsReqToErase;
-        }
-    }
-    return 0; // Address range not covered -> If 0 is returned, there is a if case missing!
-
-}
-
-static void erasePFlashSectors(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, size_t dataSize){
-    uint32_t num_bytes = 0;
-    uint32_t num_sectors = 0;
-
-    uint32_t num_sectors_to_erase = 0;
-    uint32_t num_sectors_delta = 0;
-    uint32_t erase_start_addr = 0;
-
-    // Address belongs to core 0
-    if(flashStartAddr >= pflash_eraser.core0_start_addr && flashStartAddr < pflash_eraser.core0_end_addr){
-        num_bytes = (flashStartAddr + dataSize*sizeof(uint32_t)) - pflash_eraser.core0_start_addr;
-        num_sectors = getPFlashNumSectors(num_bytes);
-
-        num_sectors_delta = num_sectors - pflash_eraser.core0_erased_sections;
-        num_sectors_to_erase = num_sectors_delta;
-        while(num_sectors_delta > 0 && num_sectors_to_erase > 0){ // There went something wrong when num_sectors_to_erase == 0 -> Do not further try to erase
-            erase_start_addr = pflash_eraser.core0_start_addr + (pflash_eraser.core0_erased_sections * PFLASH_SECTOR_LENGTH);
-            num_sectors_to_erase = getPFlashLogSecWithinPhySectors(erase_start_addr, num_sectors_delta);
-
-            if(num_sectors_to_erase == 0)
-                break;
-
-            g_functionsFromPSPR.erasePFlash(flashModule, erase_start_addr, num_sectors_to_erase);
-
-            pflash_eraser.core0_erased_sections += num_sectors_to_erase;
-            num_sectors_delta = num_sectors - pflash_eraser.core0_erased_sections;
-        }
-    }
-
-    // Address belongs to core 1
-    if(flashStartAddr >= pflash_eraser.core1_start_addr && flashStartAddr < pflash_eraser.core1_end_addr){
-        num_bytes = (flashStartAddr + dataSize*sizeof(uint32_t)) - pflash_eraser.core1_start_addr;
-        num_sectors = getPFlashNumSectors(num_bytes);
-
-        num_sectors_delta = num_sectors - pflash_eraser.core1_erased_sections;
-        num_sectors_to_erase = num_sectors_delta;
-        while(num_sectors_delta > 0 && num_sectors_to_erase > 0){ // There went something wrong when num_sectors_to_erase == 0 -> Do not further try to erase
-            erase_start_addr = pflash_eraser.core1_start_addr + (pflash_eraser.core1_erased_sections * PFLASH_SECTOR_LENGTH);
-            num_sectors_to_erase = getPFlashLogSecWithinPhySectors(erase_start_addr, num_sectors_delta);
-
-            if(num_sectors_to_erase == 0)
-                break;
-
-            g_functionsFromPSPR.erasePFlash(flashModule, erase_start_addr, num_sectors_to_erase);
-
-            pflash_eraser.core1_erased_sections += num_sectors_to_erase;
-            num_sectors_delta = num_sectors - pflash_eraser.core1_erased_sections;
-        }
-    }
-
-    // Address belongs to core 2
-    if(flashStartAddr >= pflash_eraser.core2_start_addr && flashStartAddr < pflash_eraser.core2_end_addr){
-        num_bytes = (flashStartAddr + dataSize*sizeof(uint32_t)) - pflash_eraser.core2_start_addr;
-        num_sectors = getPFlashNumSectors(num_bytes);
-
-        num_sectors_delta = num_sectors - pflash_eraser.core2_erased_sections;
-        num_sectors_to_erase = num_sectors_delta;
-        while(num_sectors_delta > 0 && num_sectors_to_erase > 0){ // There went something wrong when num_sectors_to_erase == 0 -> Do not further try to erase
-            erase_start_addr = pflash_eraser.core2_start_addr + (pflash_eraser.core2_erased_sections * PFLASH_SECTOR_LENGTH);
-            num_sectors_to_erase = getPFlashLogSecWithinPhySectors(erase_start_addr, num_sectors_delta);
-
-            if(num_sectors_to_erase == 0)
-                break;
-
-            g_functionsFromPSPR.erasePFlash(flashModule, erase_start_addr, num_sectors_to_erase);
-
-            pflash_eraser.core2_erased_sections += num_sectors_to_erase;
-            num_sectors_delta = num_sectors - pflash_eraser.core2_erased_sections;
-        }
-    }
-
-    // Address belongs to asw key
-    if(flashStartAddr >= pflash_eraser.asw_key_start_addr && flashStartAddr < pflash_eraser.asw_key_end_addr){
-        num_bytes = (flashStartAddr + dataSize*sizeof(uint32_t)) - pflash_eraser.asw_key_start_addr;
-        num_sectors = getPFlashNumSectors(num_bytes);
-
-        num_sectors_delta = num_sectors - pflash_eraser.asw_key_erased_sections;
-        num_sectors_to_erase = num_sectors_delta;
-        while(num_sectors_delta > 0 && num_sectors_to_erase > 0){ // There went something wrong when num_sectors_to_erase == 0 -> Do not further try to erase
-            erase_start_addr = pflash_eraser.asw_key_start_addr + (pflash_eraser.asw_key_erased_sections * PFLASH_SECTOR_LENGTH);
-            num_sectors_to_erase = getPFlashLogSecWithinPhySectors(erase_start_addr, num_sectors_delta);
-
-            if(num_sectors_to_erase == 0)
-                break;
-
-            g_functionsFromPSPR.erasePFlash(flashModule, erase_start_addr, num_sectors_to_erase);
-
-            pflash_eraser.asw_key_erased_sections += num_sectors_to_erase;
-            num_sectors_delta = num_sectors - pflash_eraser.asw_key_erased_sections;
-        }
-    }
-
-    // Address belongs to cal data
-    if(flashStartAddr >= pflash_eraser.cal_data_start_addr && flashStartAddr < pflash_eraser.cal_data_end_addr){
-        num_bytes = (flashStartAddr + dataSize*sizeof(uint32_t)) - pflash_eraser.cal_data_start_addr;
-        num_sectors = getPFlashNumSectors(num_bytes);
-
-        num_sectors_delta = num_sectors - pflash_eraser.cal_data_erased_sections;
-        num_sectors_to_erase = num_sectors_delta;
-        while(num_sectors_delta > 0 && num_sectors_to_erase > 0){ // There went something wrong when num_sectors_to_erase == 0 -> Do not further try to erase
-            erase_start_addr = pflash_eraser.cal_data_start_addr + (pflash_eraser.cal_data_erased_sections * PFLASH_SECTOR_LENGTH);
-            num_sectors_to_erase = getPFlashLogSecWithinPhySectors(erase_start_addr, num_sectors_delta);
-
-            if(num_sectors_to_erase == 0)
-                break;
-
-            g_functionsFromPSPR.erasePFlash(flashModule, erase_start_addr, num_sectors_to_erase);
-
-            pflash_eraser.cal_data_erased_sections += num_sectors_to_erase;
-            num_sectors_delta = num_sectors - pflash_eraser.cal_data_erased_sections;
-        }
-    }
+/* Backend of flash_eraser.c: Erases logical sectors within one physical sector, interrupts are only locked per erase */
+void flashEraseLogSectors(IfxFlash_FlashType flashModule, uint32_t sectorAddr, uint32_t numSectors){
+    Ifx_TickTime start = perfStart(); // Measured outside of the PSPR routine, the STM keeps running with locked interrupts
+    boolean interruptState = IfxCpu_disableInterrupts();
+    g_functionsFromPSPR.erasePFlash(flashModule, sectorAddr, numSectors);
+    IfxCpu_restoreInterrupts(interruptState);
+    perfStop(PERF_ERASE, start);
 }
 
 /* This function flashes the Program Flash memory calling the routines from the PSPR */
@@ -452,41 +214,59 @@ static bool flashWriteProgram(IfxFlash_FlashType flashModule, uint32_t flashStar
     uint32_t *data_for_last_page = (uint32_t*) (((uint8*) data) + ((num_pages-1) * PFLASH_PAGE_LENGTH));
     createLastFlashPage(last_page_addr, data_for_last_page, dataSize%PFLASH_LAST_PAGE_SIZE == 0 ? PFLASH_LAST_PAGE_SIZE : dataSize%PFLASH_LAST_PAGE_SIZE);
 
-    boolean interruptState = IfxCpu_disableInterrupts();
-
     copyFunctionsToPSPR(); // avoid overwriting functions while writing flash by copying them into PSPR
 
-    erasePFlashSectors(flashModule, flashStartAddr, dataSize);
-    g_functionsFromPSPR.writePFlash(flashModule, flashStartAddr, num_pages, data, dataSize);
+    flashErasePFlashSectors(flashModule, flashStartAddr, dataSize * sizeof(uint32_t));
 
-    IfxCpu_restoreInterrupts(interruptState);
+    // Interrupts are only locked while a page is written, the CAN RX interrupt empties the FIFO in between
+    Ifx_TickTime start = perfStart();
+    for(uint32_t page = 0; page < num_pages; page++){
+        uint32_t *data_for_page = page < num_pages-1 ? (uint32_t*) (((uint8*) data) + (page * PFLASH_PAGE_LENGTH)) : flash_driver_last_flashpage;
+
+        boolean interruptState = IfxCpu_disableInterrupts();
+        g_functionsFromPSPR.writePFlashPage(flashModule, flashStartAddr + (page * PFLASH_PAGE_LENGTH), data_for_page);
+        IfxCpu_restoreInterrupts(interruptState);
+    }
+    perfStop(PERF_PROGRAM, start);
     return true;
 }
 
+static void flashEraseDataSectors(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, uint32_t num_sectors);
+static bool flashProgramDataPages(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, uint32_t data[], uint32_t num_pages);
+
 /* This function flashes the Data Flash memory.
  * It is not needed to run this function from the PSPR, thus functions from the Program Flash memory can be called
  * inside.
  */
 static bool flashWriteData(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, uint32_t data[], size_t dataSize)
 {
-    uint32_t num_sectors = getDFlashNumSectors(dataSize);
-    uint32_t num_pages = getDFlashNumPages(dataSize);
-
-    uint32_t page;
+    flashEraseDataSectors(flashModule, flashStartAddr, getDFlashNumSectors(dataSize));
+    return flashProgramDataPages(flashModule, flashStartAddr, data, getDFlashNumPages(dataSize));
+}
 
-    /* --------------- ERASE PROCESS --------------- */
+/* Erases the given sectors of the Data Flash memory */
+static void flashEraseDataSectors(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, uint32_t num_sectors)
+{
     uint16 endInitSafetyPassword = IfxScuWdt_getSafetyWatchdogPassword(); /* Get the current password of the Safety WatchDog module */
+    Ifx_TickTime start = perfStart();
 
     /* Erase the sector */
- 
     IfxScuWdt_clearSafetyEndinit(endInitSafetyPassword);        /* Disable EndInit protection                       */
     IfxFlash_eraseMultipleSectors(flashStartAddr, num_sectors);
     IfxScuWdt_setSafetyEndinit(endInitSafetyPassword);          /* Enable EndInit protection                        */
 
     /* Wait until the sector is erased */
     IfxFlash_waitUnbusy(PMU_FLASH_MODULE, flashModule);
+    perfStop(PERF_ERASE, start);
+}
+
+/* Programs the given pages of the Data Flash memory, the pages need to be erased before */
+static bool flashProgramDataPages(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, uint32_t data[], uint32_t num_pages)
+{
+    uint16 endInitSafetyPassword = IfxScuWdt_getSafetyWatchdogPassword(); /* Get the current password of the Safety WatchDog module */
+    uint32_t page;
+    Ifx_TickTime start = perfStart();
 
-    /* --------------- WRITE PROCESS --------------- */
     for(page = 0; page < num_pages; page++)
     {
         uint32_t page_addr = flashStartAddr + (page * DFLASH_PAGE_LENGTH);
@@ -508,6 +288,7 @@ static bool flashWriteData(IfxFlash_FlashType flashModule, uint32_t flashStartAd
         /* Wait until the data is written in the Data Flash memory */
         IfxFlash_waitUnbusy(PMU_FLASH_MODULE, flashModule);
     }
+    perfStop(PERF_PROGRAM, start);
     return true;
 }
 
@@ -515,66 +296,32 @@ static bool flashWriteData(IfxFlash_FlashType flashModule, uint32_t flashStartAd
 /*------------------------------------------------Function Prototypes------------------------------------------------*/
 /*********************************************************************************************************************/
 
-/* This function inits the flash driver and makes sure that the CORE addresses are correctly setup for flashing into PFLASH */
-void flashDriverInit(void){
-
-    pflash_eraser.init = 0;
-    pflash_eraser.core0_start_addr = flashGetDIDData(FBL_DID_BL_WRITE_START_ADD_CORE0);
-    pflash_eraser.core0_end_addr = flashGetDIDData(FBL_DID_BL_WRITE_END_ADD_CORE0);
-    pflash_eraser.core1_start_addr = flashGetDIDData(FBL_DID_BL_WRITE_START_ADD_CORE1);
-    pflash_eraser.core1_end_addr = flashGetDIDData(FBL_DID_BL_WRITE_END_ADD_CORE1);
-    pflash_eraser.core2_start_addr = flashGetDIDData(FBL_DID_BL_WRITE_START_ADD_CORE2);
-    pflash_eraser.core2_end_addr = flashGetDIDData(FBL_DID_BL_WRITE_END_ADD_CORE2);
-    pflash_eraser.asw_key_start_addr = flashGetDIDData(FBL_DID_BL_WRITE_START_ADD_ASW_KEY);
-    pflash_eraser.asw_key_end_addr = flashGetDIDData(FBL_DID_BL_WRITE_END_ADD_ASW_KEY);
-    pflash_eraser.cal_data_start_addr = flashGetDIDData(FBL_DID_BL_WRITE_START_ADD_CAL_DATA);
-    pflash_eraser.cal_data_end_addr = flashGetDIDData(FBL_DID_BL_WRITE_END_ADD_CAL_DATA);
-    flashResetErasedSectionsCtr();
-
-    // First order conditions
-    if( (pflash_eraser.core0_start_addr <= pflash_eraser.core0_end_addr) &&
-        (pflash_eraser.core1_start_addr <= pflash_eraser.core1_end_addr) &&
-        (pflash_eraser.core2_start_addr <= pflash_eraser.core2_end_addr) &&
-        (pflash_eraser.asw_key_start_addr <= pflash_eraser.asw_key_end_addr) &&
-        (pflash_eraser.cal_data_start_addr <= pflash_eraser.cal_data_end_addr)){
-
-        // Second order conditions
-        if((pflash_eraser.core0_end_addr - pflash_eraser.core0_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
-            if(pflash_eraser.core0_start_addr != pflash_eraser.core0_end_addr)
-                return;
-        }
-
-        if((pflash_eraser.core1_end_addr - pflash_eraser.core1_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
-            if(pflash_eraser.core1_start_addr != pflash_eraser.core1_end_addr)
-                return;
-        }
-
-        if((pflash_eraser.core2_end_addr - pflash_eraser.core2_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
-            if(pflash_eraser.core2_start_addr != pflash_eraser.core2_end_addr)
-                return;
-        }
-
-        if((pflash_eraser.asw_key_end_addr - pflash_eraser.asw_key_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
-            if(pflash_eraser.asw_key_start_addr != pflash_eraser.asw_key_end_addr)
-                return;
-        }
-
-        if((pflash_eraser.cal_data_end_addr - pflash_eraser.cal_data_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
-            if(pflash_eraser.cal_data_start_addr != pflash_eraser.cal_data_end_addr)
-                return;
-        }
-
-        pflash_eraser.init = 1;
+/* This function erases sectors of the Data Flash memory, e.g. for an append-only log that is programmed with flashProgramData */
+bool flashEraseData(uint32_t flashStartAddr, uint32_t numSectors) {
+    if (flashStartAddr >= DATA_FLASH_0_BASE_ADDR && flashStartAddr + numSectors * (DFLASH_SECTOR_LENGTH + 1) - 1 <= DATA_FLASH_0_END_ADDR)
+    {
+        flashEraseDataSectors(DATA_FLASH_0, flashStartAddr, numSectors);
+        return true;
     }
+    else if (flashStartAddr >= DATA_FLASH_1_BASE_ADDR && flashStartAddr + numSectors * (DFLASH_SECTOR_LENGTH + 1) - 1 <= DATA_FLASH_1_END_ADDR)
+    {
+        flashEraseDataSectors(DATA_FLASH_1, flashStartAddr, numSectors);
+        return true;
+    }
+    return false;
 }
 
-/* This function resets the erased sections counters for the PFLASH */
-void flashResetErasedSectionsCtr(void){
-    pflash_eraser.core0_erased_sections = 0;
-    pflash_eraser.core1_erased_sections = 0;
-    pflash_eraser.core2_erased_sections = 0;
-    pflash_eraser.asw_key_erased_sections = 0;
-    pflash_eraser.cal_data_erased_sections = 0;
+/* This function programs the Data Flash memory without erasing it before, the pages need to be erased already (flashEraseData) */
+bool flashProgramData(uint32_t flashStartAddr, uint32_t data[], size_t dataSize) {
+    if (flashStartAddr >= DATA_FLASH_0_BASE_ADDR && flashStartAddr + dataSize * sizeof(uint32) - 1 <= DATA_FLASH_0_END_ADDR)
+    {
+        return flashProgramDataPages(DATA_FLASH_0, flashStartAddr, data, getDFlashNumPages(dataSize));
+    }
+    else if (flashStartAddr >= DATA_FLASH_1_BASE_ADDR && flashStartAddr + dataSize * sizeof(uint32) - 1 <= DATA_FLASH_1_END_ADDR)
+    {
+        return flashProgramDataPages(DATA_FLASH_1, flashStartAddr, data, getDFlashNumPages(dataSize));
+    }
+    return false;
 }
 
 /* This function calls the correct writing function, either flashWriteProgramm or flashWriteData, depending on flashStartAddr,
@@ -613,6 +360,32 @@ bool flashWrite(uint32_t flashStartAddr, uint32_t data[], size_t dataSize) {
     return false;
 } 
 
+/* This function erases the logical sectors of the Program Flash memory touched by the range that are not erased yet in this
+ * session, e.g. ahead of the TransferData of a download. The following flashWrite into these sectors does not erase them again.
+ * Returns false if the range is not within one Program Flash module */
+bool flashEraseProgram(uint32_t flashStartAddr, uint32_t lengthInBytes) {
+    IfxFlash_FlashType flashModule;
+    if (lengthInBytes == 0)
+        return false;
+
+    if (flashStartAddr >= PROGRAM_FLASH_0_BASE_ADDR && flashStartAddr + lengthInBytes - 1 <= PROGRAM_FLASH_0_END_ADDR)
+        flashModule = PROGRAM_FLASH_0;
+    else if (flashStartAddr >= PROGRAM_FLASH_1_BASE_ADDR && flashStartAddr + lengthInBytes - 1 <= PROGRAM_FLASH_1_END_ADDR)
+        flashModule = PROGRAM_FLASH_1;
+    else
+        return false;
+
+    if(pflash_eraser.init == 0){
+        flashDriverInit();
+        if(pflash_eraser.init == 0) // Init was not successful
+            return false;
+    }
+
+    copyFunctionsToPSPR(); // avoid overwriting functions while erasing flash by copying them into PSPR
+    flashErasePFlashSectors(flashModule, flashStartAddr, lengthInBytes);
+    return true;
+}
+
 /* This function verifies that the data at the given address matches the data of the array data*/
 bool flashVerify(uint32_t flashStartAddr, uint32_t data[], size_t dataSize)
 {
@@ -669,6 +442,7 @@ uint32_t flashCalculateChecksum(uint32_t flashStartAddr, uint32_t length) {
     uint32_t addr = flashStartAddr;
     uint32_t endAddr = flashStartAddr + length;
 
+    Ifx_TickTime start = perfStart();
     crc_t crc = crc_init();
     uint32_t nextFourBytes = 0;
     while (addr < endAddr) {
@@ -695,6 +469,23 @@ uint32_t flashCalculateChecksum(uint32_t flashStartAddr, uint32_t length) {
     }
 
     crc = crc_finalize(crc);
+    perfStop(PERF_CRC, start);
+
+    return (uint32_t) crc;
+}
+
+/**
+ * Calculates Checksum for the given part of memory over the raw bytes (FBL_CHECKSUM_MODE_RAW)
+ * The flash is memory mapped, so the CRC is calculated directly on the flash content without a copy
+ */
+
+uint32_t flashCalculateChecksumRaw(uint32_t flashStartAddr, uint32_t length) {
+
+    Ifx_TickTime start = perfStart();
+    crc_t crc = crc_init();
+    crc = crc_update(crc, (const void *) flashStartAddr, length);
+    crc = crc_finalize(crc);
+    perfStop(PERF_CRC, start);
 
     return (uint32_t) crc;
 }
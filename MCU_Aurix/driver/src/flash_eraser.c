@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Dorothea Ehrl <dorothea.ehrl@fau.de>
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : flash_eraser.c
+// Author      : Dorothea Ehrl, Michael Bauer, Paul Roy
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Sector bookkeeping of the PFLASH, shared by the flash driver and the simulated ECU
+//============================================================================
+
+#include <string.h>
+
+#include "flash_driver.h"
+#include "flash_eraser.h"
+#include "memory.h"
+
+/*********************************************************************************************************************/
+/*--------------------------------------------Private Variables/Constants--------------------------------------------*/
+/*********************************************************************************************************************/
+
+Flash_Eraser pflash_eraser;
+
+/*********************************************************************************************************************/
+/*--------------------------------------------Private Helper Functions-----------------------------------------------*/
+/*********************************************************************************************************************/
+
+static uint32_t getPFlashLogSecWithinPhySectors(uint32_t eraseStartAddr, size_t numLogSectorsReqToErase){
+
+    // In general: logSectorAddr == eraseStartAddr -> Need to be the same if parameter is correctly used (calculation is done for safety reasons)
+    uint32_t phyBaseAddr = 0;
+
+    // Check on address range - PFLASH 0 and PFLASH 1
+    if(eraseStartAddr >= PROGRAM_FLASH_0_PHY_BASE_ADDR && eraseStartAddr <= PROGRAM_FLASH_0_PHY_END_ADDR)
+        phyBaseAddr = PROGRAM_FLASH_0_PHY_BASE_ADDR;
+    else if(eraseStartAddr >= PROGRAM_FLASH_1_PHY_BASE_ADDR && eraseStartAddr <= PROGRAM_FLASH_1_PHY_END_ADDR)
+        phyBaseAddr = PROGRAM_FLASH_1_PHY_BASE_ADDR;
+    else
+        return 0; // Address range not covered -> If 0 is returned, there is a if case missing!
+
+    uint32_t logSectorAddr = phyBaseAddr + ((eraseStartAddr - phyBaseAddr) / PFLASH_SECTOR_LENGTH) * PFLASH_SECTOR_LENGTH;
+    uint32_t phySectorAddr = phyBaseAddr + ((eraseStartAddr - phyBaseAddr) / PFLASH_PHY_SECTOR_LENGTH) * PFLASH_PHY_SECTOR_LENGTH;
+    uint32_t logSectorsToNextPhySec = ((phySectorAddr + PFLASH_PHY_SECTOR_LENGTH) - logSectorAddr) / PFLASH_SECTOR_LENGTH;
+
+    return logSectorsToNextPhySec < numLogSectorsReqToErase ? logSectorsToNextPhySec : numLogSectorsReqToErase;
+}
+
+static inline bool isPFlashSectorErased(uint32_t sector){
+    return (pflash_eraser.erased_sectors[sector / 32] >> (sector % 32)) & 1;
+}
+
+/* Erases the logical sectors of a region touched by the data that are not erased yet in this session. Only the sectors
+ * of the data are erased, sectors skipped by the tester (e.g. unchanged sectors of differential flashing) keep their content.
+ */
+static uint32_t erasePFlashRegionSectors(IfxFlash_FlashType flashModule, uint32_t regionStartAddr, uint32_t regionEndAddr, uint32_t flashStartAddr, uint32_t lengthInBytes){
+    uint32_t erased = 0;
+
+    if(!(flashStartAddr >= regionStartAddr && flashStartAddr < regionEndAddr))
+        return 0;
+
+    uint32_t sector = (flashStartAddr - PROGRAM_FLASH_0_PHY_BASE_ADDR) / PFLASH_SECTOR_LENGTH;
+    uint32_t last_sector = (flashStartAddr + lengthInBytes - 1 - PROGRAM_FLASH_0_PHY_BASE_ADDR) / PFLASH_SECTOR_LENGTH;
+    if(flashStartAddr < PROGRAM_FLASH_0_PHY_BASE_ADDR || last_sector >= PFLASH_LOG_SECTORS)
+        return 0;
+
+    // The sectors behind the end of the region belong to another one (e.g. erase-ahead of a range exceeding it)
+    uint32_t region_last_sector = (regionEndAddr - PROGRAM_FLASH_0_PHY_BASE_ADDR) / PFLASH_SECTOR_LENGTH;
+    if(last_sector > region_last_sector)
+        last_sector = region_last_sector;
+
+    while(sector <= last_sector){
+        if(isPFlashSectorErased(sector)){
+            sector++;
+            continue;
+        }
+
+        // Erase the following sectors that are not erased yet together, but not across a physical sector
+        uint32_t erase_start_addr = PROGRAM_FLASH_0_PHY_BASE_ADDR + sector * PFLASH_SECTOR_LENGTH;
+        uint32_t num_sectors_to_erase = 1;
+        while(sector + num_sectors_to_erase <= last_sector && !isPFlashSectorErased(sector + num_sectors_to_erase))
+            num_sectors_to_erase++;
+        num_sectors_to_erase = getPFlashLogSecWithinPhySectors(erase_start_addr, num_sectors_to_erase);
+
+        if(num_sectors_to_erase == 0) // There went something wrong -> Do not further try to erase
+            break;
+
+        flashEraseLogSectors(flashModule, erase_start_addr, num_sectors_to_erase);
+        erased += num_sectors_to_erase;
+
+        for(uint32_t i = 0; i < num_sectors_to_erase; i++, sector++)
+            pflash_eraser.erased_sectors[sector / 32] |= (1u << (sector % 32));
+    }
+    return erased;
+}
+
+/*********************************************************************************************************************/
+/*------------------------------------------------Function Prototypes------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/* Number of sections (pages, sectors) needed for the data, dataSize is in uint32_t values if upscale_to_byte is set */
+uint32_t flashGetNumPerSize(size_t sectionLength, size_t dataSize, bool upscale_to_byte)
+{
+    if(upscale_to_byte)
+        dataSize *= sizeof(uint32_t); // dataSize is in uint32_t values, but bytes needed
+    uint32_t num_pages = dataSize / sectionLength;
+    if (dataSize % sectionLength) // we need a page more because there is data left that does not fill a full page
+    {
+        num_pages++;
+    }
+    return num_pages;
+}
+
+/* Erases the sectors of all regions (cores, asw key, cal data) touched by the data that are not erased yet in this session
+ * via flashEraseLogSectors of the driver. Returns the number of erased logical sectors */
+uint32_t flashErasePFlashSectors(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, uint32_t lengthInBytes){
+    uint32_t erased = 0;
+    erased += erasePFlashRegionSectors(flashModule, pflash_eraser.core0_start_addr, pflash_eraser.core0_end_addr, flashStartAddr, lengthInBytes);
+    erased += erasePFlashRegionSectors(flashModule, pflash_eraser.core1_start_addr, pflash_eraser.core1_end_addr, flashStartAddr, lengthInBytes);
+    erased += erasePFlashRegionSectors(flashModule, pflash_eraser.core2_start_addr, pflash_eraser.core2_end_addr, flashStartAddr, lengthInBytes);
+    erased += erasePFlashRegionSectors(flashModule, pflash_eraser.asw_key_start_addr, pflash_eraser.asw_key_end_addr, flashStartAddr, lengthInBytes);
+    erased += erasePFlashRegionSectors(flashModule, pflash_eraser.cal_data_start_addr, pflash_eraser.cal_data_end_addr, flashStartAddr, lengthInBytes);
+    return erased;
+}
+
+/* This function inits the flash driver and makes sure that the CORE addresses are correctly setup for flashing into PFLASH */
+void flashDriverInit(void){
+
+    pflash_eraser.init = 0;
+    const Memory_Layout *layout = getMemoryLayout();
+    pflash_eraser.core0_start_addr = layout->regions[MEMORY_REGION_CORE0].start_addr;
+    pflash_eraser.core0_end_addr = layout->regions[MEMORY_REGION_CORE0].end_addr;
+    pflash_eraser.core1_start_addr = layout->regions[MEMORY_REGION_CORE1].start_addr;
+    pflash_eraser.core1_end_addr = layout->regions[MEMORY_REGION_CORE1].end_addr;
+    pflash_eraser.core2_start_addr = layout->regions[MEMORY_REGION_CORE2].start_addr;
+    pflash_eraser.core2_end_addr = layout->regions[MEMORY_REGION_CORE2].end_addr;
+    pflash_eraser.asw_key_start_addr = layout->regions[MEMORY_REGION_ASW_KEY].start_addr;
+    pflash_eraser.asw_key_end_addr = layout->regions[MEMORY_REGION_ASW_KEY].end_addr;
+    pflash_eraser.cal_data_start_addr = layout->regions[MEMORY_REGION_CAL_DATA].start_addr;
+    pflash_eraser.cal_data_end_addr = layout->regions[MEMORY_REGION_CAL_DATA].end_addr;
+    flashResetErasedSectionsCtr();
+
+    // First order conditions
+    if( (pflash_eraser.core0_start_addr <= pflash_eraser.core0_end_addr) &&
+        (pflash_eraser.core1_start_addr <= pflash_eraser.core1_end_addr) &&
+        (pflash_eraser.core2_start_addr <= pflash_eraser.core2_end_addr) &&
+        (pflash_eraser.asw_key_start_addr <= pflash_eraser.asw_key_end_addr) &&
+        (pflash_eraser.cal_data_start_addr <= pflash_eraser.cal_data_end_addr)){
+
+        // Second order conditions
+        if((pflash_eraser.core0_end_addr - pflash_eraser.core0_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
+            if(pflash_eraser.core0_start_addr != pflash_eraser.core0_end_addr)
+                return;
+        }
+
+        if((pflash_eraser.core1_end_addr - pflash_eraser.core1_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
+            if(pflash_eraser.core1_start_addr != pflash_eraser.core1_end_addr)
+                return;
+        }
+
+        if((pflash_eraser.core2_end_addr - pflash_eraser.core2_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
+            if(pflash_eraser.core2_start_addr != pflash_eraser.core2_end_addr)
+                return;
+        }
+
+        if((pflash_eraser.asw_key_end_addr - pflash_eraser.asw_key_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
+            if(pflash_eraser.asw_key_start_addr != pflash_eraser.asw_key_end_addr)
+                return;
+        }
+
+        if((pflash_eraser.cal_data_end_addr - pflash_eraser.cal_data_start_addr + 1) % PFLASH_SECTOR_LENGTH != 0){
+            if(pflash_eraser.cal_data_start_addr != pflash_eraser.cal_data_end_addr)
+                return;
+        }
+
+        pflash_eraser.init = 1;
+    }
+}
+
+/* This function resets the erased sectors of the PFLASH, the next write into a sector erases it again */
+void flashResetErasedSectionsCtr(void){
+    memset(pflash_eraser.erased_sectors, 0, sizeof(pflash_eraser.erased_sectors));
+}
+
+/* Marks the logical PFLASH sector containing the address as erased in the current session, e.g. the partly programmed last
+ * sector of an interrupted download that is continued. flashWrite and flashEraseProgram don't erase it again afterwards. */
+void flashSetSectorErased(uint32_t flashStartAddr){
+    if(pflash_eraser.init == 0)
+        flashDriverInit();
+
+    if(flashStartAddr < PROGRAM_FLASH_0_PHY_BASE_ADDR || flashStartAddr > PROGRAM_FLASH_1_PHY_END_ADDR)
+        return;
+
+    uint32_t sector = (flashStartAddr - PROGRAM_FLASH_0_PHY_BASE_ADDR) / PFLASH_SECTOR_LENGTH;
+    pflash_eraser.erased_sectors[sector / 32] |= (1u << (sector % 32));
+}
@@ -0,0 +1,1314 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : benchmark.cpp
+// Author      : Michael Bauer
+// Version     : 0.7
+// Copyright   : MIT
+// Description : Class for host side benchmarks (Testing GUI only)
+//============================================================================
+
+#include "benchmark.hpp"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QDir>
+
+#include <algorithm>
+
+#include "../../WINDOWS_GUI/UDS_Spec/uds_comm_spec.h"
+#include "../../WINDOWS_GUI/waitstatistics.h"
+#include "../../WINDOWS_GUI/validatemanager.h"
+#include "../../WINDOWS_GUI/lz4compressor.h"
+#include "../../WINDOWS_GUI/flashcontainer.h"
+#include "../../WINDOWS_GUI/CCRC32.h"
+
+#if defined(FBL_SIMULATED_ECU)
+#include "../../MCU_Aurix/bootloader/inc/crc.h"
+#include "../../WINDOWS_GUI/Simulation/simulated_ecu.h"
+#include "../../WINDOWS_GUI/Communication/SimulatedEcuDriver.hpp"
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// ISO TP Loopback
+//////////////////////////////////////////////////////////////////////////////
+
+ISOTP_Loopback::ISOTP_Loopback(Communication *comm, uint32_t ecu_send_id, uint8_t ack_mode, uint8_t block_size, uint8_t st_min){
+    this->comm = comm;
+    this->ecu_send_id = ecu_send_id;
+    this->ack_mode = ack_mode;
+    this->block_size = block_size;
+    this->st_min = st_min;
+
+    rx_len = 0;
+    rx_received = 0;
+    rx_block_ctr = 0;
+
+    tester_frames = 0;
+    tester_bytes = 0;
+    ecu_frames = 0;
+    ecu_bytes = 0;
+    rx_messages = 0;
+    rx_payload_bytes = 0;
+}
+
+void ISOTP_Loopback::txFrame(const QByteArray &frame){
+    ecu_frames++;
+    ecu_bytes += frame.size();
+    comm->rxCANDataSlot(ecu_send_id, frame);
+}
+
+void ISOTP_Loopback::txFlowControl(){
+    uint32_t len = 0;
+    uint8_t *fc = tx_flow_control_frame(&len, ISOTP_FC_FLAG_CONTINUE_TO_SEND, ack_mode ? 0 : block_size, ack_mode ? 0 : st_min, 0);
+    QByteArray frame((const char*)fc, len);
+    free(fc);
+    txFrame(frame);
+}
+
+void ISOTP_Loopback::rxFrame(const QByteArray &frame){
+    if(frame.size() == 0)
+        return;
+
+    tester_frames++;
+    tester_bytes += frame.size();
+
+    uint8_t pci = ((uint8_t)frame[0] & 0xF0) >> 4;
+
+    if(pci == 1){ // First Frame
+        rx_len = (((uint32_t)(frame[0] & 0x0F)) << 8) | (uint8_t)frame[1];
+        rx_received = frame.size() - 2;
+        rx_block_ctr = 0;
+        txFlowControl();
+    }
+
+    else if(pci == 2){ // Consecutive Frame
+        rx_received += frame.size() - 1;
+
+        // The last Consecutive Frame might be padded
+        if(rx_len > 0 && rx_received >= rx_len){
+            rx_messages++;
+            rx_payload_bytes += rx_len;
+            rx_len = 0;
+        }
+
+        if(ack_mode){
+            txFrame(frame.left(1));
+        }
+        else{
+            rx_block_ctr++;
+            if(block_size > 0 && rx_block_ctr >= block_size && rx_received < rx_len){
+                rx_block_ctr = 0;
+                txFlowControl();
+            }
+        }
+    }
+}
+
+void ISOTP_Loopback::rxFrames(const QList<QByteArray> &frames){
+    for(const QByteArray &frame : frames)
+        rxFrame(frame);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// UDS Delayed Responder
+//////////////////////////////////////////////////////////////////////////////
+
+UDS_DelayedResponder::UDS_DelayedResponder(UDS *uds, uint32_t ecu_send_id){
+    this->uds = uds;
+    this->ecu_send_id = ecu_send_id;
+    this->tester_send_id = 0;
+    this->thread = nullptr;
+}
+
+UDS_DelayedResponder::~UDS_DelayedResponder(){
+    if(thread != nullptr){
+        thread->wait();
+        delete thread;
+    }
+}
+
+void UDS_DelayedResponder::setTesterID(uint32_t id){
+    tester_send_id = id;
+}
+
+void UDS_DelayedResponder::rxRequest(const QByteArray &data){
+    if(data.size() == 0)
+        return;
+
+    // Requests to other ECUs
+    if(tester_send_id != 0 && (tester_send_id & FBLCAN_ECU_ID_MASK) != (ecu_send_id & FBLCAN_ECU_ID_MASK))
+        return;
+
+    if(thread != nullptr){
+        thread->wait();
+        delete thread;
+    }
+
+    // Positive response: Request with SID | 0x40
+    QByteArray response = data;
+    response[0] = (char)((uint8_t)data[0] | FBL_SID_ACK);
+
+    UDS *uds = this->uds;
+    uint32_t id = this->ecu_send_id;
+    thread = QThread::create([uds, id, response](){
+        QThread::msleep(BENCHMARK_WAIT_RESPONSE_DELAY_MS);
+        uds->rxDataReceiverSlot(id, response);
+    });
+    thread->start();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Benchmark
+//////////////////////////////////////////////////////////////////////////////
+
+Benchmark::Benchmark(uint8_t gui_id) : Testcase(gui_id){
+    this->passed = false;
+}
+
+Benchmark::~Benchmark(){
+
+}
+
+/**
+ * @brief Returns the result of the last run
+ * @return true if all benchmarks produced the expected results
+ */
+bool Benchmark::hasPassed(){
+    return passed;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Public - RX
+//////////////////////////////////////////////////////////////////////////////
+
+void Benchmark::messageChecker(const unsigned int id, const QByteArray &rec){
+    // Benchmarks run on local loopbacks only, bus traffic is ignored
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Public - TX
+//////////////////////////////////////////////////////////////////////////////
+
+void Benchmark::startTests(){
+    emit toConsole("Start of Benchmarks");
+    passed = true;
+
+    benchmarkISOTPFlowControl();
+    benchmarkWaitCPUTime();
+    benchmarkAsyncRequests();
+    benchmarkRXFramePath();
+    benchmarkCRC();
+    benchmarkS19Parser();
+    benchmarkFileFormats();
+    benchmarkTransformData();
+    benchmarkFlashContainer();
+    benchmarkMemoryLayout();
+    benchmarkDIDWrites();
+    benchmarkCompressedTransfer();
+
+    emit toConsole(passed ? ">> Testcase - PASSED - Benchmarks" : ">> Testcase - ERROR - Benchmarks");
+    emit toConsole("End of Benchmarks\n");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Private - Helper
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Prints the name and the setup of a benchmark
+ * @param name Name of the benchmark
+ * @param description What is measured
+ */
+void Benchmark::printHeader(const QString &name, const QString &description){
+    emit toConsole("Benchmark " + name + ": " + description);
+}
+
+/**
+ * @brief Prints the measurement of one variant
+ * @param name Name of the variant
+ * @param result Measured values
+ */
+void Benchmark::printResult(const QString &name, const QString &result){
+    emit toConsole(">> " + name + ": " + result);
+}
+
+/**
+ * @brief Prints that a benchmark of the bootloader sources is not available in this build
+ * @param name Name of the benchmark
+ */
+void Benchmark::skipWithoutBootloader(const QString &name){
+    printHeader(name, "Skipped, the bootloader sources are only built with the simulated ECU");
+}
+
+/**
+ * @brief Checks a result of a benchmark, the testcase fails if it is wrong
+ * @param ok Result is as expected
+ * @param error Description of the wrong result
+ * @return ok
+ */
+bool Benchmark::check(bool ok, const QString &error){
+    if(!ok){
+        emit toConsole(">> Testcase - ERROR - " + error);
+        passed = false;
+    }
+    return ok;
+}
+
+/**
+ * @brief Elapsed time of a timer
+ * @param timer Started timer
+ * @return Time in s
+ */
+static double elapsedS(const QElapsedTimer &timer){
+    return timer.nsecsElapsed() / 1000000000.0;
+}
+
+/**
+ * @brief Formats a time for the console
+ * @param s Time in s
+ * @return Time in ms
+ */
+static QString formatMs(double s){
+    return QString::number(s * 1000.0, 'f', 1) + " ms";
+}
+
+/**
+ * @brief Formats a throughput for the console
+ * @param bytes Processed bytes
+ * @param s Time in s
+ * @return Throughput in MB/s
+ */
+static QString formatMBps(double bytes, double s){
+    return QString::number(s > 0 ? bytes / s / 1000000.0 : 0.0, 'f', 1) + " MB/s";
+}
+
+typedef QList<QPair<uint32_t, uint32_t>> Core_Ranges;       // Start and end address per core
+
+static const Core_Ranges wide_core_ranges = {               // One range of 16 MB in the PFLASH for the file loaders
+    {0xA0000000, 0xA0FFFFFF}
+};
+
+static const Core_Ranges default_core_ranges = {            // Default ranges of the bootloader (memory.h), Core 2 is not available
+    {0xA0090000, 0xA01FFFFF},                               // Core 0
+    {0xA0304000, 0xA04F7FFF},                               // Core 1
+    {0xFFFFFFFF, 0xFFFFFFFF},                               // Core 2
+    {0xA04F8000, 0xA04FBFFF},                               // ASW Key
+    {0xA04FC000, 0xA04FFFFF}                                // Cal Data
+};
+
+/**
+ * @brief Address ranges in the format of the Mainwindow ECU list
+ * @param ranges Start and end address per core
+ * @return Ranges with the core index as key
+ */
+static QMap<uint16_t, QMap<QString, QString>> coreAddr(const Core_Ranges &ranges){
+    QMap<uint16_t, QMap<QString, QString>> core_addr;
+    for(uint16_t core = 0; core < ranges.size(); core++){
+        core_addr[core]["start"] = "0x" + QString("%1").arg(ranges[core].first, 8, 16, QChar('0')).toUpper();
+        core_addr[core]["end"] = "0x" + QString("%1").arg(ranges[core].second, 8, 16, QChar('0')).toUpper();
+    }
+    return core_addr;
+}
+
+/**
+ * @brief Modelled time on the bus for the given frames
+ * @param frames Number of frames
+ * @param bytes Number of data bytes of all frames
+ * @return Time in us
+ */
+double Benchmark::canFrameTimeUs(uint64_t frames, uint64_t bytes){
+    return (double)(frames * BENCHMARK_CAN_FRAME_OVERHEAD_BITS + bytes * 8) * 1000000.0 / BENCHMARK_CAN_BAUDRATE;
+}
+
+/**
+ * @brief Creates a S19 file with S3 records of consecutive data, starting in the PFLASH of Core 0
+ * @return S19 content with BENCHMARK_S19_FILE_BYTES bytes
+ */
+QByteArray Benchmark::createS19File(){
+    QByteArray content;
+    content.reserve(BENCHMARK_S19_FILE_BYTES + 128);
+    content.append("S00600004844521B\r\n");
+
+    uint32_t address = 0xA0090000;
+    uint32_t value = 0;
+    char line[4 + 2 * (BENCHMARK_S19_RECORD_DATA_BYTES + 5) + 3];
+    while(content.size() < BENCHMARK_S19_FILE_BYTES){
+        uint8_t record[BENCHMARK_S19_RECORD_DATA_BYTES + 5];
+        uint8_t count = sizeof(record);
+        record[0] = (address >> 24) & 0xFF;
+        record[1] = (address >> 16) & 0xFF;
+        record[2] = (address >> 8) & 0xFF;
+        record[3] = address & 0xFF;
+        uint8_t sum = count + record[0] + record[1] + record[2] + record[3];
+        for(int i = 0; i < BENCHMARK_S19_RECORD_DATA_BYTES; i++){
+            value = value * 1103515245u + 12345u;
+            record[4 + i] = (uint8_t)(value >> 16);
+            sum += record[4 + i];
+        }
+        record[count - 1] = 0xFF - sum;
+
+        int len = snprintf(line, sizeof(line), "S3%02X", count);
+        for(int i = 0; i < count; i++)
+            len += snprintf(line + len, sizeof(line) - len, "%02X", record[i]);
+        content.append(line, len);
+        content.append("\r\n");
+
+        address += BENCHMARK_S19_RECORD_DATA_BYTES;
+    }
+    return content;
+}
+
+/**
+ * @brief Decodes the S3 records like the ValidateManager before the single pass parser (split into lines,
+ *        hex conversion per byte via QString), reference for benchmarkS19Parser
+ * @param content S19 content
+ * @return Map of start address -> continuous data
+ */
+static QMap<uint32_t, QByteArray> legacyDecodeS19(const QByteArray &content){
+    QMap<uint32_t, QByteArray> blocks;
+    uint32_t block_addr = 0;
+    uint32_t block_end = 0;
+
+    QList<QByteArray> lines = content.split('\n');
+    for(QByteArray &line : lines){
+        if(line.endsWith('\r'))
+            line.chop(1);
+        if(line.size() < 4 || line.at(1) != '3')
+            continue;
+
+        QByteArray trimmed = line.mid(2);
+        int sum = 0;
+        for(int i = 0; i < trimmed.size() - 2; i += 2)
+            sum += trimmed.mid(i, 2).toInt(NULL, 16);
+        if(trimmed.right(2).toInt(NULL, 16) != 0xFF - (sum & 0xFF))
+            return QMap<uint32_t, QByteArray>();
+
+        uint32_t addr = QString(trimmed.mid(2, 8)).toUInt(NULL, 16);
+        QByteArray hex = trimmed.mid(10, trimmed.size() - 12);
+        QByteArray data;
+        for(int i = 0; i < hex.size(); i += 2)
+            data.append((uint8_t)(0xFF & QString(hex.mid(i, 2)).toUInt(NULL, 16)));
+
+        if(blocks.isEmpty() || addr != block_end){
+            block_addr = addr;
+            blocks.insert(addr, data);
+        }
+        else {
+            blocks[block_addr].append(data);
+        }
+        block_end = addr + data.size();
+    }
+    return blocks;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Private - Benchmarks
+//////////////////////////////////////////////////////////////////////////////
+
+void Benchmark::benchmarkISOTPFlowControl(){
+    printHeader("ISO TP", "Legacy ACK mode vs. Flow Control mode");
+    emit toConsole("\tBus model: " + QString::number(BENCHMARK_CAN_BAUDRATE) + " bit/s, ECU turnaround " + QString::number(BENCHMARK_ECU_TURNAROUND_US) + " us");
+
+    runISOTPFlowControl("ACK per Consecutive Frame", 1, 0, 0);
+    runISOTPFlowControl("Flow Control BS=8, STmin=0", 0, 8, 0);
+    runISOTPFlowControl("Flow Control BS=32, STmin=0", 0, 32, 0);
+    runISOTPFlowControl("Flow Control BS=0, STmin=0", 0, 0, 0);
+}
+
+void Benchmark::runISOTPFlowControl(const QString &name, uint8_t ack_mode, uint8_t block_size, uint8_t st_min){
+
+    uint32_t ecu_send_id = createCommonID(FBLCAN_BASE_ADDRESS, 0, this->ecu_id);
+
+    // Communication is not initialized with a driver, frames are looped back directly
+    Communication *loop_comm = new Communication();
+    loop_comm->setISOTPMode(ack_mode ? Communication::ISOTP_ACK_CONSECUTIVE_FRAMES : Communication::ISOTP_FLOW_CONTROL);
+    ISOTP_Loopback *loopback = new ISOTP_Loopback(loop_comm, ecu_send_id, ack_mode, block_size, st_min);
+    connect(loop_comm, SIGNAL(txCANDataSignal(QByteArray)), loopback, SLOT(rxFrame(QByteArray)), Qt::DirectConnection);
+    connect(loop_comm, SIGNAL(txCANDataBatchSignal(QList<QByteArray>)), loopback, SLOT(rxFrames(QList<QByteArray>)), Qt::DirectConnection);
+
+    QByteArray msg;
+    msg.resize(BENCHMARK_ISOTP_MESSAGE_LEN);
+    for(int i = 0; i < msg.size(); i++)
+        msg[i] = (char)i;
+    msg[0] = FBL_TRANSFER_DATA;
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < BENCHMARK_ISOTP_MESSAGES; i++)
+        loop_comm->txDataSlot(msg);
+    double host_us = timer.nsecsElapsed() / 1000.0;
+
+    // Every frame of the ECU is awaited by the tester
+    double bus_us = canFrameTimeUs(loopback->tester_frames, loopback->tester_bytes)
+                    + canFrameTimeUs(loopback->ecu_frames, loopback->ecu_bytes)
+                    + loopback->ecu_frames * BENCHMARK_ECU_TURNAROUND_US;
+
+    double payload = (double)BENCHMARK_ISOTP_MESSAGES * BENCHMARK_ISOTP_MESSAGE_LEN;
+    double bytes_per_s = payload * 1000000.0 / (host_us + bus_us);
+
+    printResult(name, QString::number((uint64_t)payload) + " bytes, "
+                      + QString::number(loopback->tester_frames) + " tester frames, "
+                      + QString::number(loopback->ecu_frames) + " ECU frames, host "
+                      + formatMs(host_us / 1000000.0) + ", bus " + formatMs(bus_us / 1000000.0) + " => "
+                      + QString::number(bytes_per_s, 'f', 0) + " bytes/s");
+    check(loopback->rx_messages == BENCHMARK_ISOTP_MESSAGES && loopback->rx_payload_bytes == (uint64_t)payload,
+          "ISO TP: " + name + " received " + QString::number(loopback->rx_messages) + " of " + QString::number(BENCHMARK_ISOTP_MESSAGES)
+          + " messages (" + QString::number(loopback->rx_payload_bytes) + " of " + QString::number((uint64_t)payload) + " bytes)");
+
+    disconnect(loop_comm, nullptr, nullptr, nullptr);
+    delete loopback;
+    delete loop_comm;
+}
+
+void Benchmark::benchmarkWaitCPUTime(){
+    printHeader("Waiting", "CPU time of the tester thread while waiting on delayed UDS responses");
+    emit toConsole("\t" + QString::number(BENCHMARK_WAIT_REQUESTS) + " requests, response delay " + QString::number(BENCHMARK_WAIT_RESPONSE_DELAY_MS) + " ms");
+
+    uint32_t ecu_send_id = createCommonID(FBLCAN_BASE_ADDRESS, 0, this->ecu_id);
+
+    UDS *loop_uds = new UDS(this->gui_id);
+    UDS_DelayedResponder *responder = new UDS_DelayedResponder(loop_uds, ecu_send_id);
+    connect(loop_uds, SIGNAL(txData(QByteArray)), responder, SLOT(rxRequest(QByteArray)), Qt::DirectConnection);
+
+    uint32_t ok = 0;
+    for(int i = 0; i < BENCHMARK_WAIT_REQUESTS; i++){
+        if(loop_uds->diagnosticSessionControl(this->ecu_id, FBL_DIAG_SESSION_DEFAULT) == UDS::TX_RX_OK)
+            ok++;
+    }
+
+    const WaitStatistics &stats = loop_uds->getWaitStatistics();
+    printResult("Event-driven wait (UDS)", QString::number(ok) + "/" + QString::number(BENCHMARK_WAIT_REQUESTS) + " responses, "
+                + QString::number(stats.waits) + " waits, wall " + formatMs(stats.wall_ns / 1000000000.0)
+                + ", CPU " + formatMs(stats.cpu_ns / 1000000000.0));
+    check(ok == BENCHMARK_WAIT_REQUESTS, "Waiting: " + QString::number(BENCHMARK_WAIT_REQUESTS - ok) + " requests without positive response");
+
+    // Reference: Polling a mutex protected flag for the same wall time as the former wait loops did
+    QMutex mutex;
+    bool busy = true;
+    WaitStatistics poll_stats;
+    {
+        WaitStatisticsScope scope(&poll_stats);
+        QElapsedTimer timer;
+        timer.start();
+        do {
+            mutex.lock();
+            if(timer.nsecsElapsed() >= (qint64)stats.wall_ns)
+                busy = false;
+            mutex.unlock();
+        } while(busy);
+    }
+    printResult("Busy-spin polling (reference)", "wall " + formatMs(poll_stats.wall_ns / 1000000000.0)
+                + ", CPU " + formatMs(poll_stats.cpu_ns / 1000000000.0));
+
+    disconnect(loop_uds, nullptr, nullptr, nullptr);
+    delete responder;
+    delete loop_uds;
+}
+
+void Benchmark::benchmarkAsyncRequests(){
+    printHeader("Asynchronous Requests", "Synchronous vs. asynchronous UDS requests to " + QString::number(BENCHMARK_ASYNC_ECUS) + " ECUs");
+    emit toConsole("\t" + QString::number(BENCHMARK_ASYNC_REQUESTS) + " requests per ECU, response delay " + QString::number(BENCHMARK_WAIT_RESPONSE_DELAY_MS) + " ms");
+
+    UDS *loop_uds = new UDS(this->gui_id);
+    QList<UDS_DelayedResponder*> responders;
+    for(uint32_t ecu = 1; ecu <= BENCHMARK_ASYNC_ECUS; ecu++){
+        UDS_DelayedResponder *responder = new UDS_DelayedResponder(loop_uds, createCommonID(FBLCAN_BASE_ADDRESS, 0, ecu));
+        connect(loop_uds, SIGNAL(setID(uint32_t)), responder, SLOT(setTesterID(uint32_t)), Qt::DirectConnection);
+        connect(loop_uds, SIGNAL(txData(QByteArray)), responder, SLOT(rxRequest(QByteArray)), Qt::DirectConnection);
+        responders.append(responder);
+    }
+
+    // Synchronous: One request after the other
+    uint32_t sync_ok = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < BENCHMARK_ASYNC_REQUESTS; i++){
+        for(uint32_t ecu = 1; ecu <= BENCHMARK_ASYNC_ECUS; ecu++){
+            if(loop_uds->diagnosticSessionControl(ecu, FBL_DIAG_SESSION_DEFAULT) == UDS::TX_RX_OK)
+                sync_ok++;
+        }
+    }
+    qint64 sync_ms = timer.elapsed();
+
+    // Asynchronous: One outstanding request per ECU (default window)
+    QList<UDS::AsyncRequest> requests;
+    timer.restart();
+    for(int i = 0; i < BENCHMARK_ASYNC_REQUESTS; i++){
+        for(uint32_t ecu = 1; ecu <= BENCHMARK_ASYNC_ECUS; ecu++)
+            requests.append(loop_uds->diagnosticSessionControlAsync(ecu, FBL_DIAG_SESSION_DEFAULT));
+    }
+    loop_uds->waitForAsync();
+    qint64 async_ms = timer.elapsed();
+
+    uint32_t async_ok = 0;
+    for(const UDS::AsyncRequest &request : requests){
+        if(request.result().resp == UDS::TX_RX_OK)
+            async_ok++;
+    }
+
+    uint32_t total = BENCHMARK_ASYNC_ECUS * BENCHMARK_ASYNC_REQUESTS;
+    printResult("Synchronous", QString::number(sync_ok) + "/" + QString::number(total) + " responses in " + QString::number(sync_ms) + " ms");
+    printResult("Asynchronous", QString::number(async_ok) + "/" + QString::number(total) + " responses in " + QString::number(async_ms) + " ms (x"
+                + QString::number(async_ms > 0 ? (double)sync_ms / async_ms : 0.0, 'f', 1) + ")");
+    check(sync_ok == total && async_ok == total, "Asynchronous Requests: Requests without positive response");
+
+    disconnect(loop_uds, nullptr, nullptr, nullptr);
+    for(UDS_DelayedResponder *responder : responders)
+        delete responder;
+    delete loop_uds;
+}
+
+void Benchmark::benchmarkRXFramePath(){
+    printHeader("RX Frame Path", "Frames/s from the CAN Driver through Communication::handleCANEvent to the UDS receiver");
+
+    uint32_t ecu_send_id = createCommonID(FBLCAN_BASE_ADDRESS, 0, this->ecu_id);
+
+    // Frames of the ECU: Max length ISO TP message (First Frame + Consecutive Frames) followed by a Single Frame
+    QList<CANFrame> frames;
+    CANFrame frame;
+    frame.id = ecu_send_id;
+    frame.dlc = CAN_CLASSIC_MAX_DLC;
+
+    uint32_t msg_len = BENCHMARK_ISOTP_MESSAGE_LEN;
+    frame.data[0] = 0x10 | ((msg_len >> 8) & 0x0F);
+    frame.data[1] = msg_len & 0xFF;
+    for(int i = 2; i < CAN_CLASSIC_MAX_DLC; i++)
+        frame.data[i] = (uint8_t)i;
+    frames.append(frame);
+
+    uint32_t sent = CAN_CLASSIC_MAX_DLC - 2;
+    uint8_t sn = 1;
+    while(sent < msg_len){
+        uint32_t len = (msg_len - sent) < (CAN_CLASSIC_MAX_DLC - 1) ? (msg_len - sent) : (CAN_CLASSIC_MAX_DLC - 1);
+        frame.dlc = len + 1;
+        frame.data[0] = 0x20 | (sn & 0x0F);
+        for(uint32_t i = 0; i < len; i++)
+            frame.data[i + 1] = (uint8_t)(sent + i);
+        frames.append(frame);
+        sent += len;
+        sn++;
+    }
+
+    frame.dlc = 4;
+    frame.data[0] = 0x03;
+    frame.data[1] = FBL_NEGATIVE_RESPONSE;
+    frame.data[2] = FBL_TRANSFER_DATA;
+    frame.data[3] = FBL_RC_BUSY_REPEAT_REQUEST;
+    frames.append(frame);
+
+    runRXFramePath("Per frame copies (former path, emulated)", true, frames);
+    runRXFramePath("CANFrame by value, reassembler owned buffer", false, frames);
+}
+
+void Benchmark::runRXFramePath(const QString &name, bool legacy_copies, const QList<CANFrame> &frames){
+
+    // Communication is not initialized with a driver, frames are passed to the RX slots directly
+    Communication *loop_comm = new Communication();
+
+    uint64_t rx_messages = 0;
+    uint64_t rx_bytes = 0;
+    connect(loop_comm, &Communication::rxDataReceived, loop_comm, [&rx_messages, &rx_bytes, legacy_copies](const unsigned int id, const QByteArray &ba){
+        if(legacy_copies){
+            // Former UDS::rxDataReceiverSlot: Copy into own buffer
+            uint8_t *msg = (uint8_t*)calloc(ba.size(), sizeof(uint8_t));
+            for(int i = 0; i < ba.size(); i++)
+                msg[i] = ba[i];
+            volatile uint8_t last = msg[ba.size() - 1];
+            (void)last;
+            free(msg);
+        }
+        rx_bytes += ba.size();
+        rx_messages++;
+    }, Qt::DirectConnection);
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < BENCHMARK_FRAME_PATH_MESSAGES; i++){
+        for(const CANFrame &frame : frames){
+            if(legacy_copies){
+                // Former driver: QByteArray built byte by byte incl. hex string (also without logging)
+                QString bytes_data = "";
+                QByteArray ba;
+                ba.resize(frame.dlc);
+                for(int j = 0; j < frame.dlc; j++){
+                    ba[j] = frame.data[j];
+                    bytes_data.append(QString("%1").arg(uint8_t(ba[j]), 2, 16, QLatin1Char( '0' )) + " ");
+                }
+
+                // Former Communication::rxCANDataSlot: Copy and hex string again
+                uint8_t *data = (uint8_t*)calloc(ba.size(), sizeof(uint8_t));
+                QString comm_bytes_data = "";
+                for(int j = 0; j < ba.size(); j++){
+                    data[j] = ba[j];
+                    comm_bytes_data.append(QString("%1").arg(uint8_t(data[j]), 2, 16, QLatin1Char( '0' )) + " ");
+                }
+                loop_comm->rxCANDataSlot(frame.id, QByteArray::fromRawData((const char*)data, ba.size()));
+                free(data);
+            }
+            else
+                loop_comm->rxCANFrameSlot(frame);
+        }
+    }
+    double host_s = elapsedS(timer);
+
+    // ISO TP message and Single Frame per run
+    uint64_t total_frames = (uint64_t)frames.size() * BENCHMARK_FRAME_PATH_MESSAGES;
+    printResult(name, QString::number(total_frames) + " frames, "
+                      + QString::number(rx_messages) + " messages (" + QString::number(rx_bytes) + " bytes) in "
+                      + formatMs(host_s) + " => " + QString::number(host_s > 0 ? total_frames / host_s : 0.0, 'f', 0) + " frames/s");
+    check(rx_messages == 2 * BENCHMARK_FRAME_PATH_MESSAGES, "RX Frame Path: " + name + " received "
+          + QString::number(rx_messages) + " instead of " + QString::number(2 * BENCHMARK_FRAME_PATH_MESSAGES) + " messages");
+
+    disconnect(loop_comm, nullptr, nullptr, nullptr);
+    delete loop_comm;
+}
+
+void Benchmark::benchmarkCRC(){
+#if defined(FBL_SIMULATED_ECU)
+    printHeader("CRC", "Variants of crc_update of the bootloader (crc.c) on the host, CRC_ALGO = " + QString::number(CRC_ALGO));
+
+    QByteArray data;
+    data.resize(BENCHMARK_CRC_BYTES);
+    for(int i = 0; i < data.size(); i++)
+        data[i] = (char)((i * 2654435761u) >> 13);
+
+    struct Variant {
+        const char *name;
+        crc_t (*update)(crc_t, const void *, size_t);
+        crc_t (*finalize)(crc_t);
+    };
+    const Variant variants[] = {
+        {"bit-by-bit-fast", crc_update_bit_by_bit_fast, crc_finalize_bit_by_bit_fast},
+        {"slicing-by-4", crc_update_slicing_by_4, crc_finalize_table_driven},
+        {"slicing-by-8", crc_update_slicing_by_8, crc_finalize_table_driven},
+    };
+
+    crc_t reference = 0;
+    for(const Variant &variant : variants){
+        QElapsedTimer timer;
+        timer.start();
+        crc_t crc = variant.finalize(variant.update(crc_init(), data.constData(), data.size()));
+        double host_s = elapsedS(timer);
+
+        if(variant.update == crc_update_bit_by_bit_fast)
+            reference = crc;
+
+        printResult(variant.name, "CRC " + QString("0x%1").arg((uint32_t)crc, 8, 16, QLatin1Char( '0' )) + ", "
+                                  + formatMs(host_s) + " => " + formatMBps(data.size(), host_s));
+        check(crc == reference, "CRC: " + QString(variant.name) + " differs from bit-by-bit-fast");
+    }
+#else
+    skipWithoutBootloader("CRC");
+#endif
+}
+
+void Benchmark::benchmarkS19Parser(){
+    printHeader("S19", "Legacy line based decoding vs. single pass parser of the ValidateManager ("
+                       + QString::number(BENCHMARK_S19_FILE_BYTES / (1024 * 1024)) + " MB file)");
+
+    QByteArray content = createS19File();
+
+    ValidateManager validMan;
+    validMan.setCoreAddr(coreAddr(wide_core_ranges));
+
+    QElapsedTimer timer;
+    timer.start();
+    QMap<uint32_t, QByteArray> legacy = legacyDecodeS19(content);
+    double legacy_s = elapsedS(timer);
+
+    timer.restart();
+    QMap<uint32_t, QByteArray> parsed = validMan.validateFile(content.constData(), content.size());
+    double parser_s = elapsedS(timer);
+
+    qsizetype data_bytes = 0;
+    for(const QByteArray &block : parsed)
+        data_bytes += block.size();
+
+    printResult("Legacy line based decoding", formatMs(legacy_s) + " => " + formatMBps(content.size(), legacy_s));
+    printResult("Single pass parser", formatMs(parser_s) + " => " + formatMBps(content.size(), parser_s) + ", "
+                + QString::number(parsed.size()) + " blocks with " + QString::number(data_bytes) + " bytes");
+    check(!parsed.isEmpty() && parsed == legacy, "S19: Single pass parser differs from the line based decoding");
+}
+
+/**
+ * @brief Writes an image as Intel HEX file with data records of BENCHMARK_S19_RECORD_DATA_BYTES bytes and an
+ *        extended linear address record for every 64 KB segment
+ * @param image Map of start address -> continuous data
+ * @return Intel HEX content
+ */
+static QByteArray createIntelHexFile(const QMap<uint32_t, QByteArray> &image){
+    QByteArray content;
+    char line[1 + 2 * (BENCHMARK_S19_RECORD_DATA_BYTES + 5) + 3];
+
+    // Writes one record: Count, address, type, data and checksum (two's complement of the sum)
+    auto append_record = [&content, &line](uint16_t offset, uint8_t type, const uint8_t *data, int count){
+        uint8_t sum = count + (offset >> 8) + (offset & 0xFF) + type;
+        int len = snprintf(line, sizeof(line), ":%02X%04X%02X", count, offset, type);
+        for(int i = 0; i < count; i++){
+            len += snprintf(line + len, sizeof(line) - len, "%02X", data[i]);
+            sum += data[i];
+        }
+        len += snprintf(line + len, sizeof(line) - len, "%02X", (uint8_t)(0x100 - sum));
+        content.append(line, len);
+        content.append("\r\n");
+    };
+
+    uint32_t segment = 0xFFFFFFFF;
+    for(auto block = image.constBegin(); block != image.constEnd(); ++block){
+        for(qsizetype pos = 0; pos < block.value().size();){
+            uint32_t address = block.key() + pos;
+            if(address >> 16 != segment){
+                segment = address >> 16;
+                uint8_t upper[2] = {(uint8_t)(segment >> 8), (uint8_t)segment};
+                append_record(0, 0x04, upper, 2);
+            }
+
+            // A record does not cross a 64 KB segment
+            int count = (int)std::min<qsizetype>({(qsizetype)BENCHMARK_S19_RECORD_DATA_BYTES, block.value().size() - pos,
+                                                   (qsizetype)(0x10000 - (address & 0xFFFF))});
+            append_record(address & 0xFFFF, 0x00, (const uint8_t *)block.value().constData() + pos, count);
+            pos += count;
+        }
+    }
+    append_record(0, 0x01, nullptr, 0);
+    return content;
+}
+
+/**
+ * @brief Writes an image as 32 bit little-endian ELF file (TriCore) with one PT_LOAD segment per block
+ * @param image Map of start address -> continuous data
+ * @return ELF content
+ */
+static QByteArray createElfFile(const QMap<uint32_t, QByteArray> &image){
+    const uint32_t header_size = 52;
+    const uint32_t ph_size = 32;
+
+    QByteArray content(header_size + image.size() * ph_size, 0);
+    uint8_t *elf = (uint8_t *)content.data();
+
+    auto put16 = [](uint8_t *dst, uint16_t value){ dst[0] = value & 0xFF; dst[1] = value >> 8; };
+    auto put32 = [](uint8_t *dst, uint32_t value){ for(int i = 0; i < 4; i++) dst[i] = (value >> (8 * i)) & 0xFF; };
+
+    memcpy(elf, "\x7F" "ELF", 4);
+    elf[4] = 1;                                 // ELFCLASS32
+    elf[5] = 1;                                 // ELFDATA2LSB
+    elf[6] = 1;                                 // EV_CURRENT
+    put16(elf + 0x10, 2);                       // ET_EXEC
+    put16(elf + 0x12, 44);                      // EM_TRICORE
+    put32(elf + 0x14, 1);                       // e_version
+    put32(elf + 0x1C, header_size);             // e_phoff
+    put16(elf + 0x28, header_size);             // e_ehsize
+    put16(elf + 0x2A, ph_size);                 // e_phentsize
+    put16(elf + 0x2C, image.size());            // e_phnum
+
+    uint32_t offset = content.size();
+    uint8_t *ph = elf + header_size;
+    for(auto block = image.constBegin(); block != image.constEnd(); ++block, ph += ph_size){
+        put32(ph + 0x00, 1);                    // PT_LOAD
+        put32(ph + 0x04, offset);               // p_offset
+        put32(ph + 0x08, block.key());          // p_vaddr
+        put32(ph + 0x0C, block.key());          // p_paddr
+        put32(ph + 0x10, block.value().size()); // p_filesz
+        put32(ph + 0x14, block.value().size()); // p_memsz
+        put32(ph + 0x18, 5);                    // PF_R | PF_X
+        offset += block.value().size();
+    }
+
+    for(const QByteArray &block : image)
+        content.append(block);
+    return content;
+}
+
+void Benchmark::benchmarkFileFormats(){
+    printHeader("File Formats", "Loaders of the ValidateManager for the same image as S19, Intel HEX, ELF and raw binary");
+
+    ValidateManager validMan;
+    validMan.setCoreAddr(coreAddr(wide_core_ranges));
+
+    QByteArray s19 = createS19File();
+    QMap<uint32_t, QByteArray> image = validMan.validateFile(s19.constData(), s19.size(), ValidateManager::S19);
+    if(!check(image.size() == 1, "File Formats: The S19 file does not result in one block"))
+        return;
+    validMan.setBinaryBaseAddress(image.firstKey());
+
+    struct FileFormat {
+        QString name;
+        ValidateManager::FILE_FORMAT format;
+        QByteArray content;
+    };
+
+    QList<FileFormat> formats = {
+        {"S19", ValidateManager::S19, s19},
+        {"Intel HEX", ValidateManager::INTEL_HEX, createIntelHexFile(image)},
+        {"ELF", ValidateManager::ELF, createElfFile(image)},
+        {"Raw binary", ValidateManager::BINARY, image.first()},
+    };
+
+    for(const FileFormat &file : formats){
+        ValidateManager::FILE_FORMAT detected = ValidateManager::detectFormat(file.content.constData(), file.content.size(),
+                                                                             file.format == ValidateManager::BINARY ? "bin" : "");
+
+        QElapsedTimer timer;
+        timer.start();
+        QMap<uint32_t, QByteArray> parsed = validMan.validateFile(file.content.constData(), file.content.size(), detected);
+        double parser_s = elapsedS(timer);
+
+        printResult(file.name, QString::number(file.content.size() / 1024) + " KB in " + formatMs(parser_s) + " => "
+                               + formatMBps(file.content.size(), parser_s) + " file, " + formatMBps(image.first().size(), parser_s) + " data");
+        check(detected == file.format, "File Formats: " + file.name + " is not detected");
+        check(parsed == image, "File Formats: " + file.name + " differs from the S19 image");
+    }
+}
+
+void Benchmark::benchmarkTransformData(){
+    printHeader("Flash Alignment", "ValidateManager::transformData on a full-size image of the TC375 ranges");
+
+    ValidateManager validMan;
+    validMan.setCoreAddr(coreAddr(default_core_ranges));
+
+    // Both ASW ranges completely filled (end address is excluded by the validation), one block per 64 KB section
+    QMap<uint32_t, QByteArray> blocks;
+    qsizetype image_bytes = 0;
+    uint32_t value = 0;
+    for(int core = 0; core < 2; core++){
+        const auto &range = default_core_ranges[core];
+        for(uint32_t addr = range.first; addr < range.second; addr += 0x10000){
+            QByteArray block(qMin<uint32_t>(0x10000, range.second - addr), 0);
+            for(char &c : block){
+                value = value * 1103515245u + 12345u;
+                c = (char)(value >> 16);
+            }
+            blocks.insert(addr, block);
+            image_bytes += block.size();
+        }
+    }
+
+    QMap<uint32_t, QByteArray> transformed;
+    QElapsedTimer timer;
+    timer.start();
+    for(int run = 0; run < BENCHMARK_TRANSFORM_RUNS; run++)
+        transformed = validMan.transformData(blocks);
+    double host_s = elapsedS(timer) / BENCHMARK_TRANSFORM_RUNS;
+
+    // Every input block has to be found unchanged in the output
+    bool match = true;
+    for(auto [addr, block] : blocks.asKeyValueRange()){
+        auto it = transformed.upperBound(addr);
+        if(it == transformed.begin()){
+            match = false;
+            break;
+        }
+        it = std::prev(it);
+        if(addr - it.key() + block.size() > (uint32_t)it.value().size() || it.value().mid(addr - it.key(), block.size()) != block){
+            match = false;
+            break;
+        }
+    }
+
+    printResult("transformData", QString::number(image_bytes) + " bytes in " + QString::number(blocks.size()) + " blocks => "
+                                 + QString::number(transformed.size()) + " blocks in " + formatMs(host_s) + " => " + formatMBps(image_bytes, host_s));
+    check(match, "Flash Alignment: Aligned image does not contain every input block unchanged");
+}
+
+void Benchmark::benchmarkFlashContainer(){
+    printHeader("Flash Container", "Loading a S19 file (validation, flash alignment, checksums) vs. loading its compiled container");
+
+    ValidateManager validMan;
+    validMan.setCoreAddr(coreAddr(wide_core_ranges));
+
+    QString s19_path = QDir::tempPath() + "/fbl_benchmark_container.s19";
+    QString container_path = QDir::tempPath() + "/fbl_benchmark_container." + FLASH_CONTAINER_SUFFIX;
+    QFile s19_file(s19_path);
+    QByteArray content = createS19File();
+    if(!check(s19_file.open(QFile::WriteOnly | QFile::Truncate) && s19_file.write(content) == content.size(),
+              "Flash Container: Could not write " + s19_path))
+        return;
+    s19_file.close();
+
+    CCRC32 crc;
+    crc.Initialize();
+
+    // Loading of the file like the Mainwindow and the FlashManager without container
+    QElapsedTimer timer;
+    timer.start();
+    QMap<uint32_t, QByteArray> data = validMan.transformData(validMan.validateFile(content.constData(), content.size()));
+    QMap<uint32_t, uint32_t> checksums_raw;
+    QMap<uint32_t, uint32_t> checksums_ascii;
+    for(auto [address, bytes] : data.asKeyValueRange()){
+        QByteArray ascii = bytes.toHex().toUpper();
+        checksums_raw.insert(address, (uint32_t) crc.FullCRC((const unsigned char *) bytes.constData(), bytes.size()));
+        checksums_ascii.insert(address, (uint32_t) crc.FullCRC((const unsigned char *) ascii.constData(), ascii.size()));
+    }
+    QMap<uint32_t, uint32_t> sectors = FlashContainer::calculateSectorChecksums(data);
+    double file_s = elapsedS(timer);
+
+    // Compile step, once per file and layout
+    timer.restart();
+    bool written = FlashContainer::write(container_path, data, "BENCHMARK", validMan.getRegions(), FlashContainer::hashFile(s19_path));
+    double compile_s = elapsedS(timer);
+
+    // Loading of the container: Key of the cache and mapping, the checksums are read from the tables
+    timer.restart();
+    FlashContainer container;
+    FlashContainer::hashFile(s19_path);
+    bool opened = written && container.open(container_path) && container.matchesLayout(validMan.getRegions());
+    QMap<uint32_t, QByteArray> mapped = container.getSegments();
+    QMap<uint32_t, uint32_t> mapped_raw = container.getChecksums(true);
+    QMap<uint32_t, uint32_t> mapped_ascii = container.getChecksums(false);
+    QMap<uint32_t, uint32_t> mapped_sectors = container.getSectorChecksums();
+    double container_s = elapsedS(timer);
+
+    qsizetype data_bytes = 0;
+    for(const QByteArray &block : data)
+        data_bytes += block.size();
+
+    printResult("S19 file (" + QString::number(content.size() / 1024) + " KB, " + QString::number(data_bytes / 1024) + " KB data)", formatMs(file_s));
+    printResult("Compiling the container", formatMs(compile_s));
+    printResult("Container incl. SHA-256 of the S19 file", formatMs(container_s));
+    if(check(opened, "Flash Container: Could not open the compiled container")){
+        check(mapped == data, "Flash Container: Segments differ from the S19 file");
+        check(mapped_raw == checksums_raw && mapped_ascii == checksums_ascii && mapped_sectors == sectors,
+              "Flash Container: Checksums differ from the S19 file");
+    }
+
+    container.close();
+    QFile::remove(container_path);
+    QFile::remove(s19_path);
+}
+
+#if defined(FBL_SIMULATED_ECU)
+/**
+ * @brief Address check of the bootloader before the memory layout cache: Every range reads both DIDs via readData
+ *        (allocated copy, decoded and freed), reference for benchmarkMemoryLayout
+ * @param address Start address
+ * @param len Number of bytes
+ * @return true if the range may be written
+ */
+static bool legacyAddrInRange(uint32_t address, uint32_t len){
+    const uint16_t dids[][2] = {{FBL_DID_BL_WRITE_START_ADD_CORE0, FBL_DID_BL_WRITE_END_ADD_CORE0},
+                                {FBL_DID_BL_WRITE_START_ADD_CORE1, FBL_DID_BL_WRITE_END_ADD_CORE1},
+                                {FBL_DID_BL_WRITE_START_ADD_CORE2, FBL_DID_BL_WRITE_END_ADD_CORE2},
+                                {FBL_DID_BL_WRITE_START_ADD_ASW_KEY, FBL_DID_BL_WRITE_END_ADD_ASW_KEY},
+                                {FBL_DID_BL_WRITE_START_ADD_CAL_DATA, FBL_DID_BL_WRITE_END_ADD_CAL_DATA}};
+
+    for(const auto &did : dids){
+        uint32_t range[2] = {0, 0};
+        for(int i = 0; i < 2; i++){
+            uint8_t data[SIM_ECU_MAX_DID_LEN];
+            uint8_t data_len = 0;
+            if(simEcuReadDID(did[i], data, &data_len) == 0 && data_len == 4)
+                range[i] = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+        }
+
+        if(range[0] > 0 && range[1] > 0 && address >= range[0] && address < range[1] && address + (len - 1) <= range[1])
+            return true;
+    }
+    return false;
+}
+#endif
+
+void Benchmark::benchmarkMemoryLayout(){
+#if defined(FBL_SIMULATED_ECU)
+    printHeader("Memory Layout", "Address checks of Request Download/Upload on the host, " + QString::number(BENCHMARK_LAYOUT_CHECKS) + " checks");
+
+    // Initializes the bootloader (DIDs of the data flash or default values)
+    SimulatedEcuAccess ecu(0);
+    simEcuPowerOn(nullptr, nullptr, nullptr);
+
+    const uint32_t addresses[] = {0xA0090000, 0xA01FFFE0, 0xA0304000, 0xA04F8000, 0xA04FC000, 0xA0200000, 0x80000000, 0xA04FFFF0};
+
+    uint32_t legacy_accepted = 0;
+    for(int legacy = 1; legacy >= 0; legacy--){
+        uint32_t accepted = 0;
+
+        QElapsedTimer timer;
+        timer.start();
+        for(int i = 0; i < BENCHMARK_LAYOUT_CHECKS; i++){
+            uint32_t address = addresses[i % (sizeof(addresses) / sizeof(addresses[0]))];
+            if(legacy ? legacyAddrInRange(address, 0x20) : simEcuAddrInRange(address, 0x20))
+                accepted++;
+        }
+        double host_s = elapsedS(timer);
+
+        printResult(legacy ? "DID read per check (former)" : "Memory layout cache", QString::number(accepted) + " accepted in "
+                    + formatMs(host_s) + " => " + QString::number(host_s * 1000000000.0 / BENCHMARK_LAYOUT_CHECKS, 'f', 1) + " ns/check");
+        if(legacy)
+            legacy_accepted = accepted;
+        else
+            check(accepted == legacy_accepted, "Memory Layout: Cache accepts other ranges than the DID read per check");
+    }
+
+    simEcuPowerOff();
+#else
+    skipWithoutBootloader("Memory Layout");
+#endif
+}
+
+void Benchmark::benchmarkDIDWrites(){
+#if defined(FBL_SIMULATED_ECU)
+    printHeader("DID Writes", "Programming date and application ID written alternately into the data flash, "
+                              + QString::number(BENCHMARK_DID_WRITES) + " writes (MEMORY_DID_LOG in memory.h set to 0 for comparison)");
+
+    // Empty data flash, the bootloader starts with the default values
+    SimulatedEcuAccess ecu(0);
+    simEcuEraseFlash();
+    simEcuPowerOn(nullptr, nullptr, nullptr);
+    simEcuResetStatistics();
+
+    uint8_t last_date[6] = {0};
+    QByteArray last_app_id;
+    uint32_t failed = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < BENCHMARK_DID_WRITES; i++){
+        if(i % 2 == 0){
+            // BCD [dd][MM][yy][HH][mm][ss]
+            uint8_t date[6] = {0x17, 0x10, 0x24, (uint8_t)(((i / 10) % 2) << 4 | (i % 10)), 0x00, (uint8_t)(((i / 20) % 6) << 4)};
+            memcpy(last_date, date, sizeof(date));
+            if(simEcuWriteDID(FBL_DID_PROGRAMMING_DATE, date, sizeof(date)))
+                failed++;
+        }
+        else{
+            last_app_id = QString("app %1").arg(i).toLatin1();
+            if(simEcuWriteDID(FBL_DID_APP_ID, (uint8_t*)last_app_id.data(), last_app_id.size()))
+                failed++;
+        }
+    }
+    double host_s = elapsedS(timer);
+
+    SimEcuStatistics stats;
+    simEcuGetStatistics(&stats);
+
+    // Power cycle, the values need to be restored from the data flash
+    simEcuPowerOff();
+    simEcuPowerOn(nullptr, nullptr, nullptr);
+
+    uint8_t data[SIM_ECU_MAX_DID_LEN];
+    uint8_t len = 0;
+    bool restored = !simEcuReadDID(FBL_DID_PROGRAMMING_DATE, data, &len) && len == sizeof(last_date) && !memcmp(data, last_date, len);
+    restored = restored && !simEcuReadDID(FBL_DID_APP_ID, data, &len) && QByteArray((char*)data, len).startsWith(last_app_id);
+    simEcuPowerOff();
+
+    printResult("Data flash", QString::number(stats.dflash_erased_sectors) + " erased sectors, "
+                + QString::number(stats.dflash_programmed_pages) + " programmed pages => "
+                + QString::number((double)stats.dflash_erased_sectors / BENCHMARK_DID_WRITES, 'f', 3) + " erases/write, "
+                + QString::number((double)stats.dflash_programmed_pages / BENCHMARK_DID_WRITES, 'f', 2) + " pages/write");
+    printResult("Time", "Modelled flash " + formatMs(stats.flash_busy_us / 1000000.0) + ", host " + formatMs(host_s));
+    check(failed == 0, "DID Writes: " + QString::number(failed) + " writes failed");
+    check(stats.program_errors == 0, "DID Writes: " + QString::number(stats.program_errors) + " pages were programmed without being erased");
+    check(restored, "DID Writes: Values are not restored after the power cycle");
+#else
+    skipWithoutBootloader("DID Writes");
+#endif
+}
+
+#if defined(FBL_SIMULATED_ECU)
+/**
+ * @brief Tester side of the loopback with the simulated ECU for benchmarkCompressedTransfer
+ */
+struct CompressionLoopback {
+    uint8_t response[9];                        // Beginning of the last response, e.g. the buffer size of Request Download
+    uint32_t response_len;                      // Bytes of the response received so far
+    uint64_t frames;                            // Frames sent by the tester
+    uint64_t bytes;                             // Data bytes (incl. PCI) sent by the tester
+};
+
+static void compressionLoopbackTx(void *context, uint32_t id, const uint8_t *data, uint8_t len){
+    CompressionLoopback *loopback = (CompressionLoopback*)context;
+    uint8_t pci = data[0] >> 4;
+    uint8_t pci_len = pci == 1 ? 2 : 1;
+    if(pci == 3 || len <= pci_len) // Flow Control
+        return;
+    if(pci != 2)
+        loopback->response_len = 0;
+
+    // The bootloader transmits the Consecutive Frames without waiting for a Flow Control
+    uint32_t copy = qMin<uint32_t>(len - pci_len, sizeof(loopback->response) - loopback->response_len);
+    memcpy(loopback->response + loopback->response_len, data + pci_len, copy);
+    loopback->response_len += copy;
+}
+
+/**
+ * @brief Sends a UDS request in 8 byte frames to the simulated ECU and processes it
+ * @param loopback Tester side, receives the response
+ * @param msg Request, freed afterwards
+ * @param len Length of the request
+ * @return SID of the response
+ */
+static uint8_t compressionLoopbackRequest(CompressionLoopback *loopback, uint8_t *msg, int len){
+    uint32_t frame_len = 0;
+    uint32_t has_next = 0;
+    uint32_t idx = 0;
+    uint8_t frame_idx = 0;
+
+    memset(loopback->response, 0, sizeof(loopback->response));
+    loopback->response_len = 0;
+    uint8_t *frame = tx_starting_frame(&frame_len, &has_next, 8, msg, len, &idx);
+    while(frame != NULL){
+        loopback->frames++;
+        loopback->bytes += frame_len;
+        simEcuRxFrame(simEcuGetID(), frame, frame_len); // Addressed with the ECU ID of the simulated ECU
+        free(frame);
+
+        frame = has_next ? tx_consecutive_frame(&frame_len, &has_next, 8, msg, len, &idx, &frame_idx) : NULL;
+    }
+    free(msg);
+
+    simEcuCyclic();
+    return loopback->response[0];
+}
+#endif
+
+/**
+ * @brief Image for the compression benchmark: The S19 file of FBL_BENCHMARK_IMAGE (aligned like the Mainwindow) or a
+ *        generated image with code-like data, constant tables and the zero filler of the flash alignment
+ * @return Map with Address -> Data
+ */
+QMap<uint32_t, QByteArray> Benchmark::createCompressionImage(){
+    ValidateManager validMan;
+    validMan.setCoreAddr(coreAddr(default_core_ranges));
+
+    const char *file = getenv("FBL_BENCHMARK_IMAGE");
+    if(file != NULL && file[0] != '\0'){
+        QFile s19(file);
+        QByteArray content;
+        if(s19.open(QIODevice::ReadOnly))
+            content = s19.readAll();
+
+        QMap<uint32_t, QByteArray> parsed = validMan.validateFile(content.constData(), content.size());
+        if(!parsed.isEmpty())
+            return validMan.transformData(parsed);
+        emit toConsole(">> " + QString(file) + " is not valid for the TC375 ranges, using the generated image");
+    }
+
+    // Instructions are taken from a small set with varying operands, tables are ascending values
+    QMap<uint32_t, QByteArray> blocks;
+    uint32_t value = 0;
+    const uint32_t sections[] = {0xA0090000, 0xA00E0000, 0xA0304000};
+    for(uint32_t section : sections){
+        QByteArray code(BENCHMARK_COMPRESSION_CODE_BYTES, 0);
+        for(int i = 0; i < code.size(); i += 4){
+            value = value * 1103515245u + 12345u;
+            uint32_t instruction = 0x0000006Du + ((value >> 16) % 48) * 0x01000100u;
+            if((value >> 8) % 4 == 0)
+                instruction ^= (value >> 12) & 0xFF;
+            memcpy(code.data() + i, &instruction, 4);
+        }
+        blocks.insert(section, code);
+
+        QByteArray table(BENCHMARK_COMPRESSION_TABLE_BYTES, 0);
+        for(int i = 0; i < table.size(); i += 4){
+            uint32_t entry = section + i * 3;
+            memcpy(table.data() + i, &entry, 4);
+        }
+        blocks.insert(section + BENCHMARK_COMPRESSION_CODE_BYTES + 0x2000, table);
+    }
+    return validMan.transformData(blocks);
+}
+
+void Benchmark::benchmarkCompressedTransfer(){
+#if defined(FBL_SIMULATED_ECU)
+    QMap<uint32_t, QByteArray> image = createCompressionImage();
+    qsizetype image_bytes = 0;
+    for(const QByteArray &block : image)
+        image_bytes += block.size();
+
+    printHeader("Compressed Transfer Data", "Download of " + QString::number(image_bytes) + " bytes in "
+                                            + QString::number(image.size()) + " blocks into the simulated ECU with CAN frames of 8 bytes at "
+                                            + QString::number(BENCHMARK_CAN_BAUDRATE / 1000) + " kbit/s (image of FBL_BENCHMARK_IMAGE or generated)");
+
+    runCompressedTransfer("Uncompressed", image, FBL_DATA_FORMAT_UNCOMPRESSED);
+    runCompressedTransfer("LZ4", image, FBL_DATA_FORMAT_LZ4);
+#else
+    skipWithoutBootloader("Compressed Transfer Data");
+#endif
+}
+
+void Benchmark::runCompressedTransfer(const QString &name, const QMap<uint32_t, QByteArray> &image, uint8_t data_format){
+#if defined(FBL_SIMULATED_ECU)
+    SimulatedEcuAccess ecu(0);
+    simEcuEraseFlash();
+    CompressionLoopback loopback = {};
+    simEcuPowerOn(compressionLoopbackTx, nullptr, &loopback);
+
+    int len = 0;
+    uint8_t *msg = _create_diagnostic_session_control(&len, 0, FBL_DIAG_SESSION_PROGRAMMING);
+    compressionLoopbackRequest(&loopback, msg, len);
+    loopback.frames = 0;
+    loopback.bytes = 0;
+
+    uint32_t failed = 0;
+    uint64_t payload_bytes = 0;
+    qint64 compress_ns = 0;
+
+    QElapsedTimer timer;
+    QElapsedTimer compress_timer;
+    timer.start();
+    for(auto [address, block] : image.asKeyValueRange()){
+        if(data_format == FBL_DATA_FORMAT_UNCOMPRESSED)
+            msg = _create_request_download(&len, 0, address, block.size());
+        else
+            msg = _create_request_download_format(&len, address, block.size(), data_format);
+        if(compressionLoopbackRequest(&loopback, msg, len) != (FBL_REQUEST_DOWNLOAD | FBL_SID_ACK)){
+            failed++;
+            continue;
+        }
+
+        // Package size like the FlashManager
+        uint32_t buffer_size = ((uint32_t)loopback.response[5] << 24) | ((uint32_t)loopback.response[6] << 16)
+                               | ((uint32_t)loopback.response[7] << 8) | loopback.response[8];
+        buffer_size = qMin<uint32_t>(buffer_size, MAX_ISOTP_MESSAGE_LEN - 5);
+        if(data_format == FBL_DATA_FORMAT_LZ4)
+            buffer_size = qMin<uint32_t>(buffer_size, lz4MaxInputSize(MAX_ISOTP_MESSAGE_LEN - 5) / 32 * 32);
+
+        for(qsizetype offset = 0; offset < block.size(); offset += buffer_size){
+            uint32_t package_len = qMin<qsizetype>(buffer_size, block.size() - offset);
+            const uint8_t *package = (const uint8_t*)block.constData() + offset;
+
+            QByteArray compressed;
+            if(data_format == FBL_DATA_FORMAT_LZ4){
+                compress_timer.start();
+                compressed = lz4CompressBlock(package, package_len);
+                compress_ns += compress_timer.nsecsElapsed();
+                package = (const uint8_t*)compressed.constData();
+                package_len = compressed.size();
+            }
+            payload_bytes += package_len;
+
+            msg = _create_transfer_data(&len, 0, address + offset, (uint8_t*)package, package_len);
+            if(compressionLoopbackRequest(&loopback, msg, len) != (FBL_TRANSFER_DATA | FBL_SID_ACK))
+                failed++;
+        }
+
+        msg = _create_request_transfer_exit(&len, 0, address);
+        if(compressionLoopbackRequest(&loopback, msg, len) != (FBL_REQUEST_TRANSFER_EXIT | FBL_SID_ACK))
+            failed++;
+    }
+    double host_s = elapsedS(timer);
+
+    // Content of the flash model
+    bool match = true;
+    uint64_t image_bytes = 0;
+    for(auto [address, block] : image.asKeyValueRange()){
+        QByteArray flash(block.size(), 0);
+        simEcuReadMemory(address, (uint8_t*)flash.data(), flash.size());
+        match = match && flash == block;
+        image_bytes += block.size();
+    }
+    simEcuPowerOff();
+
+    double bus_s = canFrameTimeUs(loopback.frames, loopback.bytes) / 1000000.0;
+    printResult(name, "Transfer Data payload " + QString::number(payload_bytes) + " bytes ("
+                      + QString::number(image_bytes > 0 ? 100.0 * payload_bytes / image_bytes : 0.0, 'f', 1) + " %), "
+                      + QString::number(loopback.frames) + " frames => bus " + QString::number(bus_s, 'f', 2) + " s, "
+                      + QString::number(bus_s > 0 ? image_bytes / bus_s / 1000.0 : 0.0, 'f', 1) + " KB/s, host "
+                      + formatMs(host_s) + " (compression " + formatMs(compress_ns / 1000000000.0) + ")");
+    check(failed == 0, "Compressed Transfer Data: " + name + ": " + QString::number(failed) + " requests failed");
+    check(match, "Compressed Transfer Data: " + name + ": Content of the flash model differs from the image");
+#endif
+}
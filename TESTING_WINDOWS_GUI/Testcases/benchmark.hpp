@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : benchmark.hpp
+// Author      : Michael Bauer
+// Version     : 0.6
+// Copyright   : MIT
+// Description : Class for host side benchmarks (Testing GUI only)
+//============================================================================
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "../testcase.hpp"
+
+#define BENCHMARK_CAN_BAUDRATE              (500000)   // Modelled bus baudrate in bit/s
+#define BENCHMARK_CAN_FRAME_OVERHEAD_BITS   (67)       // Extended CAN frame without data bytes (SOF..IFS)
+#define BENCHMARK_ECU_TURNAROUND_US         (1000)     // Modelled latency until the tester sees a response frame of the ECU
+#define BENCHMARK_ISOTP_MESSAGES            (64)       // Number of ISO TP messages per run
+#define BENCHMARK_ISOTP_MESSAGE_LEN         (0xFFF)    // Max length of ISO TP message with 12 bit First Frame length
+#define BENCHMARK_WAIT_REQUESTS             (20)       // Number of UDS requests for the wait benchmark
+#define BENCHMARK_WAIT_RESPONSE_DELAY_MS    (50)       // Delay until the responder answers a UDS request
+#define BENCHMARK_ASYNC_ECUS                (5)        // Number of responding ECUs for the asynchronous request benchmark
+#define BENCHMARK_ASYNC_REQUESTS            (4)        // Number of UDS requests per ECU for the asynchronous request benchmark
+#define BENCHMARK_FRAME_PATH_MESSAGES       (500)      // Number of received ISO TP messages for the RX frame path benchmark
+#define BENCHMARK_CRC_BYTES                 (0x400000) // Bytes per CRC variant (4 MB, size of the PFLASH regions)
+#define BENCHMARK_S19_FILE_BYTES            (0x800000) // Size of the generated S19 file (8 MB)
+#define BENCHMARK_S19_RECORD_DATA_BYTES     (32)       // Data bytes per S3 record
+#define BENCHMARK_TRANSFORM_RUNS            (5)        // Number of flash alignments of the full-size image
+#define BENCHMARK_LAYOUT_CHECKS             (200000)   // Number of address checks against the memory layout of the ECU
+#define BENCHMARK_DID_WRITES                (1000)     // Number of DID writes into the data flash
+#define BENCHMARK_COMPRESSION_CODE_BYTES    (0x30000)  // Generated image: Bytes of code-like data per section
+#define BENCHMARK_COMPRESSION_TABLE_BYTES   (0x4000)   // Generated image: Bytes of constant tables per section
+
+/**
+ * @brief Loopback of the ECU ISO TP receiver (see isotp.c), answers the frames of a Communication instance
+ */
+class ISOTP_Loopback : public QObject {
+    Q_OBJECT
+
+private:
+    Communication *comm;
+    uint32_t ecu_send_id;
+
+    uint8_t ack_mode;                           // Legacy mode: Acknowledge every Consecutive Frame
+    uint8_t block_size;                         // Flow Control block size (Flow Control mode)
+    uint8_t st_min;                             // Flow Control separation time (Flow Control mode)
+
+    uint32_t rx_len;                            // Length of the currently received ISO TP message
+    uint32_t rx_received;                       // Received bytes of the current ISO TP message
+    uint8_t rx_block_ctr;                       // Consecutive Frames in current block
+
+public:
+    uint64_t tester_frames;                     // Frames sent by the tester
+    uint64_t tester_bytes;                      // Data bytes (incl. PCI) sent by the tester
+    uint64_t ecu_frames;                        // Frames sent by the ECU (Flow Control/ACK)
+    uint64_t ecu_bytes;                         // Data bytes (incl. PCI) sent by the ECU
+    uint64_t rx_messages;                       // ISO TP messages received completely
+    uint64_t rx_payload_bytes;                  // Payload bytes of the messages received completely
+
+    ISOTP_Loopback(Communication *comm, uint32_t ecu_send_id, uint8_t ack_mode, uint8_t block_size, uint8_t st_min);
+
+private:
+    void txFrame(const QByteArray &frame);
+    void txFlowControl();
+
+public slots:
+    /**
+     * @brief Slot for a frame transmitted by the tester
+     * @param frame CAN frame data
+     */
+    void rxFrame(const QByteArray &frame);
+
+    /**
+     * @brief Slot for several frames transmitted by the tester at once
+     * @param frames CAN frames data
+     */
+    void rxFrames(const QList<QByteArray> &frames);
+};
+
+/**
+ * @brief Answers UDS requests of a UDS instance with a positive response from another thread after a delay
+ */
+class UDS_DelayedResponder : public QObject {
+    Q_OBJECT
+
+private:
+    UDS *uds;
+    uint32_t ecu_send_id;
+    uint32_t tester_send_id;                    // TX ID of the next request, 0 answers all requests
+    QThread *thread;
+
+public:
+    UDS_DelayedResponder(UDS *uds, uint32_t ecu_send_id);
+    ~UDS_DelayedResponder();
+
+public slots:
+    /**
+     * @brief Slot for the TX ID of the next request, only requests to the ECU ID of the responder are answered
+     * @param id TX ID of the tester
+     */
+    void setTesterID(uint32_t id);
+
+    /**
+     * @brief Slot for a UDS request transmitted by the tester
+     * @param data UDS request
+     */
+    void rxRequest(const QByteArray &data);
+};
+
+class Benchmark : public Testcase {
+
+private:
+    bool passed;                                // Result of the last run, false if a benchmark produced wrong results
+
+public:
+    Benchmark(uint8_t gui_id);
+    ~Benchmark();
+
+    bool hasPassed();
+
+    void messageChecker(const unsigned int id, const QByteArray &rec) override;
+    void startTests() override;
+
+private:
+    double canFrameTimeUs(uint64_t frames, uint64_t bytes);
+
+    // Console output and result
+    void printHeader(const QString &name, const QString &description);
+    void printResult(const QString &name, const QString &result);
+    void skipWithoutBootloader(const QString &name);
+    bool check(bool ok, const QString &error);
+
+    // ISO TP
+    void benchmarkISOTPFlowControl();
+    void runISOTPFlowControl(const QString &name, uint8_t ack_mode, uint8_t block_size, uint8_t st_min);
+
+    // Waiting
+    void benchmarkWaitCPUTime();
+
+    // Asynchronous UDS requests
+    void benchmarkAsyncRequests();
+
+    // RX frame path
+    void benchmarkRXFramePath();
+    void runRXFramePath(const QString &name, bool legacy_copies, const QList<CANFrame> &frames);
+
+    // Bootloader CRC
+    void benchmarkCRC();
+
+    // S19 parsing
+    void benchmarkS19Parser();
+    QByteArray createS19File();
+
+    // Intel HEX, ELF and raw binary loading
+    void benchmarkFileFormats();
+
+    // Flash alignment
+    void benchmarkTransformData();
+
+    // Precompiled flash container
+    void benchmarkFlashContainer();
+
+    // Address checks of the bootloader
+    void benchmarkMemoryLayout();
+
+    // DID storage in the data flash of the bootloader
+    void benchmarkDIDWrites();
+
+    // Compressed Transfer Data
+    void benchmarkCompressedTransfer();
+    void runCompressedTransfer(const QString &name, const QMap<uint32_t, QByteArray> &image, uint8_t data_format);
+    QMap<uint32_t, QByteArray> createCompressionImage();
+};
+
+#endif /* BENCHMARK_H_ */
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : parallel_flashing.cpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Flashes several simulated ECUs on one bus at the same time (Testing GUI only)
+//============================================================================
+
+#include "parallel_flashing.hpp"
+
+#include <QElapsedTimer>
+
+#include "../../WINDOWS_GUI/parallelflashmanager.h"
+#include "../../WINDOWS_GUI/Simulation/simulated_ecu.h"
+#include "../../WINDOWS_GUI/Communication/SimulatedEcuDriver.hpp"
+
+ParallelFlashing::ParallelFlashing(uint8_t gui_id, uint8_t ecu_count) : SimulatedFlashing(gui_id, ecu_count){
+    this->ecu_count = ecu_count;
+}
+
+ParallelFlashing::~ParallelFlashing(){
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////////
+
+void ParallelFlashing::startTests(){
+    emit toConsole("Start of Parallel Flashing");
+    passed = false;
+
+    // =========================================================================
+    // Prepare the file and the ECUs
+    QByteArray file_content;
+    if(!readFile(file_content))
+        return;
+
+    QList<uint8_t> instances = comm->getSimulatedEcuInstances();
+    if(instances.size() != ecu_count){
+        emit toConsole(">> Testcase - ERROR - " + QString::number(instances.size()) + " of " + QString::number(ecu_count) + " simulated ECUs are on the bus");
+        return;
+    }
+
+    QList<uint32_t> ecu_ids;
+    for(uint8_t instance : instances){
+        SimulatedEcuAccess ecu(instance);
+        simEcuEraseFlash();
+        simEcuResetStatistics();
+        ecu_ids.append((simEcuGetID() >> 4) & 0xFFF);
+    }
+
+    QString ids;
+    for(uint32_t id : ecu_ids)
+        ids += (ids.isEmpty() ? "" : ", ") + QString("0x%1").arg(id, 3, 16, QLatin1Char('0'));
+    emit toConsole("\tFlashing " + QString::number(ecu_count) + " ECUs on one bus, ECU IDs " + ids);
+
+    // All ECUs have the same address ranges, the first one is used for the validation
+    QMap<uint32_t, QByteArray> flash_data;
+    uint32_t key_address = 0;
+    uint32_t key_good_value = 0;
+    if(!validateFile(file_content, flash_data, key_address, key_good_value))
+        return;
+
+    size_t flash_bytes = 0;
+    for(const QByteArray &block : flash_data)
+        flash_bytes += block.size();
+
+    // =========================================================================
+    // One flashing session per ECU, sharing the Communication
+    ParallelFlashManager flashMan;
+    connect(&flashMan, SIGNAL(infoPrint(QString)), this, SLOT(consoleForward(QString)), Qt::DirectConnection);
+    connect(&flashMan, SIGNAL(errorPrint(QString)), this, SLOT(consoleForward(QString)), Qt::DirectConnection);
+
+    for(uint32_t id : ecu_ids)
+        flashMan.addECU(id, comm);
+    flashMan.setFlashFile(flash_data);
+    flashMan.setASWKeyContent(key_address, key_good_value);
+
+    QElapsedTimer timer;
+    timer.start();
+    flashMan.startFlashing(this->gui_id);
+    bool timed_out = !flashMan.waitForFinished(SIMULATED_FLASHING_TIMEOUT_MS);
+    if(timed_out){
+        flashMan.stopFlashing();
+        flashMan.waitForFinished(SIMULATED_FLASHING_TIMEOUT_MS);
+    }
+    qint64 flash_ms = timer.elapsed();
+
+    // =========================================================================
+    // Check the content of every ECU
+    QList<ParallelFlashManager::Result> results = flashMan.getResults();
+    bool all_passed = !timed_out;
+    qint64 sum_ms = 0;
+
+    for(int i = 0; i < instances.size(); i++){
+        const ParallelFlashManager::Result &result = results[i];
+        QString ecu_str = "ECU " + QString("0x%1").arg(result.ecu_id, 3, 16, QLatin1Char('0'));
+
+        bool content_ok = verifyFlash(flash_data, instances[i]);
+
+        uint8_t key[4] = {0};
+        SimEcuStatistics stats;
+        {
+            SimulatedEcuAccess ecu(instances[i]);
+            simEcuReadMemory(key_address, key, sizeof(key));
+            simEcuGetStatistics(&stats);
+        }
+        uint32_t key_value = ((uint32_t)key[0] << 24) | ((uint32_t)key[1] << 16) | ((uint32_t)key[2] << 8) | key[3];
+        bool key_ok = key_value == key_good_value;
+
+        bool ecu_passed = result.finished && result.passed && content_ok && key_ok && stats.program_errors == 0;
+        all_passed &= ecu_passed;
+        sum_ms += result.flash_ms;
+
+        emit toConsole(">> " + ecu_str + ": " + (ecu_passed ? "PASSED" : "ERROR") + " after " + QString::number(result.flash_ms) + " ms, "
+                       + QString::number(result.transfer_data_bytes) + " Transfer Data bytes, " + QString::number(stats.rx_frames) + " RX frames, "
+                       + QString::number(stats.tx_frames) + " TX frames, PFLASH " + QString::number(stats.pflash_erased_sectors) + " sectors erased/"
+                       + QString::number(stats.pflash_programmed_pages) + " pages programmed, flash busy "
+                       + QString::number(stats.flash_busy_us / 1000.0, 'f', 1) + " ms");
+
+        if(!result.finished || !result.passed)
+            emit toConsole(">> Testcase - ERROR - " + ecu_str + ": FlashManager aborted the flashing");
+        if(stats.program_errors > 0)
+            emit toConsole(">> Testcase - ERROR - " + ecu_str + ": " + QString::number(stats.program_errors) + " pages were programmed without being erased");
+        if(!key_ok)
+            emit toConsole(">> Testcase - ERROR - " + ecu_str + ": ASW Key is " + QString("0x%1").arg(key_value, 8, 16, QLatin1Char('0')) + " instead of "
+                           + QString("0x%1").arg(key_good_value, 8, 16, QLatin1Char('0')));
+    }
+
+    if(timed_out)
+        emit toConsole(">> Testcase - ERROR - Parallel flashing timed out");
+
+    emit toConsole(">> Flashing " + QString::number(flash_bytes) + " bytes into " + QString::number(ecu_count) + " ECUs took " + QString::number(flash_ms)
+                   + " ms (sum of the sessions " + QString::number(sum_ms) + " ms) => "
+                   + QString::number(flash_ms > 0 ? (double)flash_bytes * ecu_count * 1000.0 / flash_ms : 0.0, 'f', 0) + " bytes/s in total");
+
+    passed = all_passed;
+    emit toConsole(passed ? ">> Testcase - PASSED - Parallel Flashing" : ">> Testcase - ERROR - Parallel Flashing");
+
+    emit toConsole("End of Parallel Flashing\n");
+}
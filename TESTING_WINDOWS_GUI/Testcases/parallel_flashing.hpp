@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : parallel_flashing.hpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Flashes several simulated ECUs on one bus at the same time (Testing GUI only)
+//============================================================================
+
+#ifndef PARALLEL_FLASHING_H_
+#define PARALLEL_FLASHING_H_
+
+#include "simulated_flashing.hpp"
+
+#define PARALLEL_FLASHING_DEFAULT_ECUS      (3)         // Simulated ECUs on the bus if not given
+
+class ParallelFlashing : public SimulatedFlashing {
+
+private:
+    uint8_t ecu_count;                          // Simulated ECUs on the bus
+
+public:
+    ParallelFlashing(uint8_t gui_id, uint8_t ecu_count);
+    ~ParallelFlashing();
+
+    void startTests() override;
+};
+
+#endif /* PARALLEL_FLASHING_H_ */
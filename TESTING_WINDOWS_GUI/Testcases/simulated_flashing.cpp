@@ -0,0 +1,621 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : simulated_flashing.cpp
+// Author      : Michael Bauer
+// Version     : 0.6
+// Copyright   : MIT
+// Description : Flashes a S19 file end-to-end into the simulated ECU in several variants (Testing GUI only)
+//============================================================================
+
+#include "simulated_flashing.hpp"
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSemaphore>
+#include <QSet>
+#include <QThread>
+
+#include "../../WINDOWS_GUI/flashmanager.h"
+#include "../../WINDOWS_GUI/validatemanager.h"
+#include "../../WINDOWS_GUI/UDS_Spec/uds_comm_spec.h"
+#include "../../WINDOWS_GUI/Simulation/simulated_ecu.h"
+#include "../../WINDOWS_GUI/Communication/SimulatedEcuDriver.hpp"
+
+SimulatedFlashing::SimulatedFlashing(uint8_t gui_id) : SimulatedFlashing(gui_id, 0){
+
+}
+
+/**
+ * @brief Constructor with the number of simulated ECUs on the bus
+ * @param gui_id GUI ID for TX
+ * @param ecu_count Number of ECUs, 0 for the default of the driver (FBL_SIM_ECUS)
+ */
+SimulatedFlashing::SimulatedFlashing(uint8_t gui_id, uint8_t ecu_count) : Testcase(gui_id){
+    this->passed = false;
+
+    // The base class initialized the platform CAN Driver, the simulated ECU replaces it
+    comm->setCommunicationType(Communication::SIMULATED_ECU_DRIVER);
+    if(ecu_count > 0)
+        comm->setSimulatedEcuCount(ecu_count);
+    comm->init(Communication::SIMULATED_ECU_DRIVER);
+
+    // With several ECUs on the bus (FBL_SIM_ECUS) the first one is flashed
+    this->ecu_instance = comm->getSimulatedEcuInstances().value(0, 0);
+
+    // ECU ID is part of the CAN ID the simulated ECU is transmitting with (see spec)
+    SimulatedEcuAccess ecu(ecu_instance);
+    this->ecu_id = (simEcuGetID() >> 4) & 0xFFF;
+}
+
+SimulatedFlashing::~SimulatedFlashing(){
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Sets the S19 file to be flashed
+ * @param file Path of the file, empty to flash a generated image
+ */
+void SimulatedFlashing::setFile(const QString &file){
+    this->s19_file = file;
+}
+
+/**
+ * @brief Returns the result of the last run
+ * @return true if the flashed content and the ASW key matched
+ */
+bool SimulatedFlashing::hasPassed(){
+    return passed;
+}
+
+void SimulatedFlashing::messageChecker(const unsigned int id, const QByteArray &rec){
+    // Responses are handled by the FlashManager
+}
+
+void SimulatedFlashing::startTests(){
+    emit toConsole("Start of Simulated Flashing");
+    passed = false;
+
+    // =========================================================================
+    // Prepare the file
+    QByteArray file_content;
+    if(!readFile(file_content))
+        return;
+
+    SimEcuTiming timing;
+    {
+        SimulatedEcuAccess ecu(ecu_instance);
+        simEcuGetTiming(&timing);
+        simEcuEraseFlash();
+        simEcuResetStatistics();
+    }
+    emit toConsole("\tFlash timing: PFLASH erase " + QString::number(timing.pflash_erase_sector_us) + " us/sector, program "
+                   + QString::number(timing.pflash_program_page_us) + " us/page, DFLASH erase "
+                   + QString::number(timing.dflash_erase_sector_us) + " us/sector, program "
+                   + QString::number(timing.dflash_program_page_us) + " us/page");
+
+    // =========================================================================
+    // Validate the file with the address ranges of the ECU (same as Mainwindow)
+    QMap<uint32_t, QByteArray> flash_data;
+    uint32_t key_address = 0;
+    uint32_t key_good_value = 0;
+    if(!validateFile(file_content, flash_data, key_address, key_good_value))
+        return;
+
+    // =========================================================================
+    // Flash with the FlashManager in its own thread (same as Mainwindow)
+    size_t flash_bytes = 0;
+    for(const QByteArray &block : flash_data)
+        flash_bytes += block.size();
+
+    size_t skipped_bytes = 0;
+    size_t resumed_bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    bool aborted = !flashFile(flash_data, key_address, key_good_value, skipped_bytes, resumed_bytes);
+    qint64 flash_ms = timer.elapsed();
+
+    // =========================================================================
+    // Check the content of the flash model
+    bool content_ok = verifyFlash(flash_data, ecu_instance);
+    bool key_ok = verifyKey(key_address, key_good_value);
+
+    SimEcuStatistics stats;
+    {
+        SimulatedEcuAccess ecu(ecu_instance);
+        simEcuGetStatistics(&stats);
+    }
+
+    emit toConsole(">> Flashing " + QString::number(flash_bytes) + " bytes took " + QString::number(flash_ms) + " ms => "
+                   + QString::number(flash_ms > 0 ? (double)flash_bytes * 1000.0 / flash_ms : 0.0, 'f', 0) + " bytes/s");
+    emit toConsole(">> ECU: " + QString::number(stats.rx_frames) + " RX frames, " + QString::number(stats.tx_frames) + " TX frames, "
+                   + QString::number(stats.resets) + " resets, PFLASH " + QString::number(stats.pflash_erased_sectors) + " sectors erased/"
+                   + QString::number(stats.pflash_programmed_pages) + " pages programmed, DFLASH " + QString::number(stats.dflash_erased_sectors)
+                   + " sectors erased/" + QString::number(stats.dflash_programmed_pages) + " pages programmed, flash busy "
+                   + QString::number(stats.flash_busy_us / 1000.0, 'f', 1) + " ms, " + QString::number(stats.rx_frames_flash_busy)
+                   + " RX frames while flash busy");
+
+    if(aborted)
+        emit toConsole(">> Testcase - ERROR - FlashManager aborted the flashing");
+    if(stats.program_errors > 0)
+        emit toConsole(">> Testcase - ERROR - " + QString::number(stats.program_errors) + " pages were programmed without being erased");
+
+    passed = !aborted && content_ok && key_ok && stats.program_errors == 0;
+
+    // =========================================================================
+    // Flash the erased ECU again with every Transfer Data programmed before its response, the gain of the pipelining
+    if(passed)
+        passed = flashSequential(flash_data, key_address, key_good_value, flash_ms);
+
+    // =========================================================================
+    // Flash again with one changed byte per block, only the changed sectors are transferred (DIFFERENTIAL_FLASHING)
+    if(passed){
+        // Only the sectors with a changed byte need to be erased again
+        QSet<uint32_t> changed_sectors;
+        for(auto it = flash_data.begin(); it != flash_data.end(); ++it){
+            QByteArray &block = it.value();
+            block[block.size() / 2] = (char)~block[block.size() / 2];
+            uint32_t address = it.key() + block.size() / 2;
+            changed_sectors.insert(address - address % FBL_CHECKSUM_SECTOR_LENGTH);
+        }
+
+        {
+            SimulatedEcuAccess ecu(ecu_instance);
+            simEcuResetStatistics();
+        }
+        timer.restart();
+        aborted = !flashFile(flash_data, key_address, key_good_value, skipped_bytes, resumed_bytes);
+        flash_ms = timer.elapsed();
+
+        content_ok = verifyFlash(flash_data, ecu_instance);
+        {
+            SimulatedEcuAccess ecu(ecu_instance);
+            simEcuGetStatistics(&stats);
+        }
+
+        emit toConsole(">> Flashing with one changed byte per block took " + QString::number(flash_ms) + " ms, "
+                       + QString::number(skipped_bytes) + " of " + QString::number(flash_bytes) + " bytes skipped, PFLASH "
+                       + QString::number(stats.pflash_erased_sectors) + " sectors erased/" + QString::number(stats.pflash_programmed_pages)
+                       + " pages programmed");
+
+        if(aborted)
+            emit toConsole(">> Testcase - ERROR - FlashManager aborted the second flashing");
+        if(stats.program_errors > 0)
+            emit toConsole(">> Testcase - ERROR - " + QString::number(stats.program_errors) + " pages were programmed without being erased");
+
+        // Unchanged sectors must neither be transferred nor erased
+        bool skipped_ok = skipped_bytes > 0;
+        if(!skipped_ok)
+            emit toConsole(">> Testcase - ERROR - No bytes were skipped, the complete file was transferred again");
+        bool erased_ok = stats.pflash_erased_sectors <= changed_sectors.size() + SIMULATED_FLASHING_KEY_ERASES;
+        if(!erased_ok)
+            emit toConsole(">> Testcase - ERROR - " + QString::number(stats.pflash_erased_sectors) + " PFLASH sectors were erased, but only "
+                           + QString::number(changed_sectors.size()) + " sectors changed");
+
+        passed = !aborted && content_ok && stats.program_errors == 0 && skipped_ok && erased_ok;
+    }
+
+    // =========================================================================
+    // Flash the erased ECU, interrupt the flashing and start it again (RESUMABLE_FLASHING)
+    if(passed)
+        passed = flashInterrupted(flash_data, key_address, key_good_value);
+
+    emit toConsole(passed ? ">> Testcase - PASSED - Simulated Flashing" : ">> Testcase - ERROR - Simulated Flashing");
+
+    emit toConsole("End of Simulated Flashing\n");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Reads the S19 file to be flashed or creates the generated image
+ * @param file_content Content of the file
+ * @return false if the file could not be opened
+ */
+bool SimulatedFlashing::readFile(QByteArray &file_content){
+    if(s19_file.isEmpty()){
+        file_content = createImage();
+        emit toConsole("\tFlashing generated image with " + QString::number(file_content.size()) + " bytes S19 content");
+        return true;
+    }
+
+    QFile file(s19_file);
+    if(!file.open(QFile::ReadOnly)){
+        emit toConsole(">> Testcase - ERROR - Could not open " + s19_file + ": " + file.errorString());
+        return false;
+    }
+    file_content = file.readAll();
+    file.close();
+    emit toConsole("\tFlashing " + s19_file + " (" + QString::number(file_content.size()) + " bytes)");
+    return true;
+}
+
+/**
+ * @brief Validates the file with the address ranges of the ECU (same as Mainwindow)
+ * @param file_content Content of the S19 file
+ * @param flash_data Map with Address -> Data of the valid file
+ * @param key_address Address of the ASW key of the ECU
+ * @param key_good_value Value of the ASW key after a successful flashing
+ * @return false if the file is not valid
+ */
+bool SimulatedFlashing::validateFile(const QByteArray &file_content, QMap<uint32_t, QByteArray> &flash_data, uint32_t &key_address, uint32_t &key_good_value){
+    QMap<uint16_t, QMap<QString, QString>> core_addr;
+    core_addr[0]["start"] = readDIDAddress(FBL_DID_BL_WRITE_START_ADD_CORE0);
+    core_addr[0]["end"] = readDIDAddress(FBL_DID_BL_WRITE_END_ADD_CORE0);
+    core_addr[1]["start"] = readDIDAddress(FBL_DID_BL_WRITE_START_ADD_CORE1);
+    core_addr[1]["end"] = readDIDAddress(FBL_DID_BL_WRITE_END_ADD_CORE1);
+    core_addr[2]["start"] = readDIDAddress(FBL_DID_BL_WRITE_START_ADD_CORE2);
+    core_addr[2]["end"] = readDIDAddress(FBL_DID_BL_WRITE_END_ADD_CORE2);
+    core_addr[3]["start"] = readDIDAddress(FBL_DID_BL_WRITE_START_ADD_ASW_KEY);
+    core_addr[3]["end"] = readDIDAddress(FBL_DID_BL_WRITE_END_ADD_ASW_KEY);
+    core_addr[4]["start"] = readDIDAddress(FBL_DID_BL_WRITE_START_ADD_CAL_DATA);
+    core_addr[4]["end"] = readDIDAddress(FBL_DID_BL_WRITE_END_ADD_CAL_DATA);
+    key_address = readDIDAddress(FBL_DID_BL_KEY_ADDRESS).toUInt(nullptr, 16);
+    key_good_value = readDIDAddress(FBL_DID_BL_KEY_GOOD_VALUE).toUInt(nullptr, 16);
+
+    ValidateManager *validMan = new ValidateManager();
+    validMan->setCoreAddr(core_addr);
+
+    QSemaphore validated;
+    connect(validMan, &ValidateManager::validationDone, validMan, [&flash_data, &validated](const QMap<uint32_t, QByteArray> result){
+        flash_data = result;
+        validated.release();
+    }, Qt::DirectConnection);
+    connect(validMan, SIGNAL(errorPrint(QString)), this, SLOT(consoleForward(QString)), Qt::DirectConnection);
+
+    QElapsedTimer timer;
+    timer.start();
+    validMan->validateFileAsync(file_content);
+    if(!validated.tryAcquire(1, SIMULATED_FLASHING_TIMEOUT_MS) || flash_data.size() == 0){
+        emit toConsole(">> Testcase - ERROR - File is not valid for the ranges of the simulated ECU");
+        validMan->deleteLater();
+        return false;
+    }
+    emit toConsole("\tValidation finished after " + QString::number(timer.elapsed()) + " ms, " + QString::number(flash_data.size()) + " blocks");
+
+    // Validation thread might still be returning from the signal
+    validMan->deleteLater();
+    return true;
+}
+
+/**
+ * @brief Creates a S19 file (S3 records) with a counting pattern for Core 0, Core 1 and the Calibration data
+ * @return Content of the file
+ */
+QByteArray SimulatedFlashing::createImage(){
+    const struct {
+        uint32_t address;
+        uint32_t bytes;
+    } regions[] = {
+        {TESTFILE_CORE0_START_ADD, SIMULATED_FLASHING_CORE0_BYTES},
+        {TESTFILE_CORE1_START_ADD, SIMULATED_FLASHING_CORE1_BYTES},
+        {TESTFILE_CAL_DATA_START_ADD, SIMULATED_FLASHING_CAL_DATA_BYTES},
+    };
+
+    // S-Record with count, address, data and checksum
+    auto record = [](const QByteArray &type, const QByteArray &address, const QByteArray &data){
+        QByteArray content;
+        content.append((char)(address.size() + data.size() + 1));
+        content.append(address);
+        content.append(data);
+
+        uint8_t sum = 0;
+        for(char c : content)
+            sum += (uint8_t)c;
+        content.append((char)~sum);
+
+        return type + content.toHex().toUpper() + "\r\n";
+    };
+
+    QByteArray file = record("S0", QByteArray(2, 0), "SIMULATED_ECU");
+
+    for(const auto &region : regions){
+        for(uint32_t offset = 0; offset < region.bytes; offset += SIMULATED_FLASHING_RECORD_BYTES){
+            uint32_t address = region.address + offset;
+
+            QByteArray address_bytes;
+            address_bytes.append((char)(address >> 24));
+            address_bytes.append((char)(address >> 16));
+            address_bytes.append((char)(address >> 8));
+            address_bytes.append((char)address);
+
+            QByteArray data;
+            for(uint32_t i = 0; i < SIMULATED_FLASHING_RECORD_BYTES; i++)
+                data.append((char)((address + i) * 7 + (address >> 12)));
+
+            file += record("S3", address_bytes, data);
+        }
+    }
+    return file;
+}
+
+/**
+ * @brief Reads an address DID of the simulated ECU
+ * @param did Data Identifier
+ * @return Address as hex string (format of the Mainwindow ECU list)
+ */
+QString SimulatedFlashing::readDIDAddress(uint16_t did){
+    uint8_t data[SIM_ECU_MAX_DID_LEN];
+    uint8_t len = 0;
+    SimulatedEcuAccess ecu(ecu_instance);
+    if(simEcuReadDID(did, data, &len) != 0)
+        return "";
+    return QByteArray((const char*)data, len).toHex();
+}
+
+/**
+ * @brief Flashes the data with the FlashManager in its own thread (same as Mainwindow)
+ * @param data Map with Address -> Data
+ * @param key_address Address of the ASW key
+ * @param key_good_value Value of the ASW key after a successful flashing
+ * @param skipped_bytes Bytes not transferred since the sectors were already equal on the ECU
+ * @param resumed_bytes Bytes not transferred since an interrupted flashing left them on the ECU
+ * @param stop_pages Stops the FlashManager once the ECU programmed this number of PFLASH pages, 0 to flash completely
+ * @return false if the FlashManager aborted the flashing or timed out
+ */
+bool SimulatedFlashing::flashFile(const QMap<uint32_t, QByteArray> &data, uint32_t key_address, uint32_t key_good_value, size_t &skipped_bytes,
+                                  size_t &resumed_bytes, uint32_t stop_pages){
+    QThread *threadFlashing = new QThread();
+    FlashManager *flashMan = new FlashManager();
+    flashMan->moveToThread(threadFlashing);
+
+    bool aborted = false;
+    connect(flashMan, SIGNAL(flashingStartThreadRequested()), threadFlashing, SLOT(start()), Qt::DirectConnection);
+    connect(threadFlashing, SIGNAL(started()), flashMan, SLOT(runThread()));
+    connect(flashMan, SIGNAL(flashingThreadFinished()), threadFlashing, SLOT(quit()), Qt::DirectConnection);
+    connect(flashMan, &FlashManager::errorPrint, flashMan, [&aborted](const QString &text){
+        if(text.contains("Aborting flashing"))
+            aborted = true;
+    }, Qt::DirectConnection);
+    connect(flashMan, SIGNAL(errorPrint(QString)), this, SLOT(consoleForward(QString)), Qt::DirectConnection);
+
+    flashMan->setFlashFile(data);
+    flashMan->setASWKeyContent(key_address, key_good_value);
+
+    flashMan->startFlashing(this->ecu_id, this->gui_id, comm);
+
+    // Interruption like the Stop button of the Mainwindow, the FlashManager stops after the current Transfer Data
+    QDeadlineTimer deadline(SIMULATED_FLASHING_TIMEOUT_MS);
+    while(stop_pages > 0 && !threadFlashing->wait(SIMULATED_FLASHING_POLL_MS)){
+        SimEcuStatistics stats;
+        {
+            SimulatedEcuAccess ecu(ecu_instance);
+            simEcuGetStatistics(&stats);
+        }
+        if(stats.pflash_programmed_pages >= stop_pages || deadline.hasExpired()){
+            flashMan->stopFlashing();
+            break;
+        }
+    }
+
+    if(!threadFlashing->wait(deadline)){
+        flashMan->stopFlashing();
+        threadFlashing->wait();
+        aborted = true;
+    }
+    skipped_bytes = flashMan->getSkippedBytes();
+    resumed_bytes = flashMan->getResumedBytes();
+
+    disconnect(flashMan, nullptr, nullptr, nullptr);
+    delete flashMan;
+    delete threadFlashing;
+
+    return !aborted;
+}
+
+/**
+ * @brief Compares the given data with the content of the flash model
+ * @param data Map with Address -> Data
+ * @param instance Simulated ECU
+ * @return true if all bytes are equal
+ */
+bool SimulatedFlashing::verifyFlash(const QMap<uint32_t, QByteArray> &data, uint8_t instance){
+    bool result = true;
+
+    for(auto it = data.constBegin(); it != data.constEnd(); ++it){
+        QByteArray flash(it.value().size(), 0);
+        uint8_t read_status;
+        {
+            SimulatedEcuAccess ecu(instance);
+            read_status = simEcuReadMemory(it.key(), (uint8_t*)flash.data(), flash.size());
+        }
+        if(read_status != 0){
+            emit toConsole(">> Testcase - ERROR - Block " + QString("0x%1").arg(it.key(), 8, 16, QLatin1Char('0')) + " is outside of the flash model");
+            result = false;
+            continue;
+        }
+
+        if(flash != it.value()){
+            int idx = 0;
+            while(idx < flash.size() && flash[idx] == it.value()[idx])
+                idx++;
+            emit toConsole(">> Testcase - ERROR - Content is different at address " + QString("0x%1").arg(it.key() + idx, 8, 16, QLatin1Char('0')));
+            result = false;
+        }
+    }
+
+    if(result)
+        emit toConsole(">> Testcase - PASSED - Content of " + QString::number(data.size()) + " blocks is equal");
+    return result;
+}
+
+/**
+ * @brief Compares the ASW key of the simulated ECU with the value after a successful flashing
+ * @param key_address Address of the ASW key
+ * @param key_good_value Value of the ASW key after a successful flashing
+ * @return true if the key is equal
+ */
+bool SimulatedFlashing::verifyKey(uint32_t key_address, uint32_t key_good_value){
+    uint8_t key[4] = {0};
+    {
+        SimulatedEcuAccess ecu(ecu_instance);
+        simEcuReadMemory(key_address, key, sizeof(key));
+    }
+    uint32_t key_value = ((uint32_t)key[0] << 24) | ((uint32_t)key[1] << 16) | ((uint32_t)key[2] << 8) | key[3];
+
+    if(key_value != key_good_value)
+        emit toConsole(">> Testcase - ERROR - ASW Key is " + QString("0x%1").arg(key_value, 8, 16, QLatin1Char('0')) + " instead of "
+                       + QString("0x%1").arg(key_good_value, 8, 16, QLatin1Char('0')));
+    return key_value == key_good_value;
+}
+
+/**
+ * @brief Flashes the erased ECU with every Transfer Data programmed before its response and compares the time with the
+ *        pipelined flashing (FLASHING_PIPELINED_TRANSFER_DATA), where the next Transfer Data is on the bus meanwhile
+ * @param data Map with Address -> Data
+ * @param key_address Address of the ASW key
+ * @param key_good_value Value of the ASW key after a successful flashing
+ * @param pipelined_ms Time of the pipelined flashing of the erased ECU
+ * @return true if the content is equal
+ */
+bool SimulatedFlashing::flashSequential(const QMap<uint32_t, QByteArray> &data, uint32_t key_address, uint32_t key_good_value, qint64 pipelined_ms){
+    {
+        SimulatedEcuAccess ecu(ecu_instance);
+        simEcuEraseFlash();
+        simEcuResetStatistics();
+        simEcuSetSequentialTransferData(1);
+    }
+
+    size_t skipped_bytes = 0;
+    size_t resumed_bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    bool aborted = !flashFile(data, key_address, key_good_value, skipped_bytes, resumed_bytes);
+    qint64 flash_ms = timer.elapsed();
+
+    SimEcuStatistics stats;
+    {
+        SimulatedEcuAccess ecu(ecu_instance);
+        simEcuSetSequentialTransferData(0);
+        simEcuGetStatistics(&stats);
+    }
+    bool content_ok = verifyFlash(data, ecu_instance);
+    bool key_ok = verifyKey(key_address, key_good_value);
+
+    emit toConsole(">> Flashing with Transfer Data programmed before the response took " + QString::number(flash_ms) + " ms, "
+                   + QString::number(stats.rx_frames_flash_busy) + " RX frames while flash busy => pipelined flashing is "
+                   + QString::number(pipelined_ms > 0 ? (double)flash_ms / pipelined_ms : 0.0, 'f', 2) + " times as fast");
+
+    if(aborted)
+        emit toConsole(">> Testcase - ERROR - FlashManager aborted the flashing without pipelining");
+    if(stats.program_errors > 0)
+        emit toConsole(">> Testcase - ERROR - " + QString::number(stats.program_errors) + " pages were programmed without being erased");
+
+    return !aborted && content_ok && key_ok && stats.program_errors == 0;
+}
+
+/**
+ * @brief Flashes the erased ECU, stops the FlashManager within the transfer and starts it again. The second flashing has
+ *        to continue after the data on the ECU (RESUMABLE_FLASHING), completely written sectors are neither transferred
+ *        nor erased again.
+ * @param data Map with Address -> Data
+ * @param key_address Address of the ASW key
+ * @param key_good_value Value of the ASW key after a successful flashing
+ * @return true if the content is equal and no completely written sector was transferred again
+ */
+bool SimulatedFlashing::flashInterrupted(const QMap<uint32_t, QByteArray> &data, uint32_t key_address, uint32_t key_good_value){
+    size_t flash_bytes = 0;
+    for(const QByteArray &block : data)
+        flash_bytes += block.size();
+
+    {
+        SimulatedEcuAccess ecu(ecu_instance);
+        simEcuEraseFlash();
+        simEcuResetStatistics();
+    }
+
+    size_t skipped_bytes = 0;
+    size_t resumed_bytes = 0;
+    uint32_t stop_pages = flash_bytes * SIMULATED_FLASHING_STOP_PERCENT / 100 / SIMULATED_FLASHING_PAGE_BYTES;
+    bool aborted = !flashFile(data, key_address, key_good_value, skipped_bytes, resumed_bytes, stop_pages);
+
+    // Sectors of the file that are completely on the ECU after the interruption, a sector may be shared by several blocks
+    QMap<uint32_t, bool> sector_written;
+    QMap<uint32_t, size_t> sector_bytes;
+    for(auto it = data.constBegin(); it != data.constEnd(); ++it){
+        uint32_t end = it.key() + it.value().size();
+        for(uint32_t sector = it.key() - it.key() % FBL_CHECKSUM_SECTOR_LENGTH; sector < end; sector += FBL_CHECKSUM_SECTOR_LENGTH){
+            uint32_t from = qMax(sector, it.key());
+            uint32_t to = qMin(sector + FBL_CHECKSUM_SECTOR_LENGTH, end);
+
+            QByteArray flash(to - from, 0);
+            {
+                SimulatedEcuAccess ecu(ecu_instance);
+                simEcuReadMemory(from, (uint8_t*)flash.data(), flash.size());
+            }
+            sector_written[sector] = sector_written.value(sector, true) && flash == it.value().mid(from - it.key(), to - from);
+            sector_bytes[sector] += to - from;
+        }
+    }
+
+    size_t written_bytes = 0;
+    uint32_t written_sectors = 0;
+    for(auto it = sector_written.constBegin(); it != sector_written.constEnd(); ++it){
+        if(it.value()){
+            written_bytes += sector_bytes.value(it.key());
+            written_sectors++;
+        }
+    }
+
+    emit toConsole(">> Flashing interrupted with " + QString::number(written_sectors) + " of " + QString::number(sector_written.size())
+                   + " sectors (" + QString::number(written_bytes) + " of " + QString::number(flash_bytes) + " bytes) completely written");
+
+    if(aborted){
+        emit toConsole(">> Testcase - ERROR - FlashManager aborted the interrupted flashing");
+        return false;
+    }
+    if(written_bytes == 0 || written_bytes == flash_bytes){
+        emit toConsole(">> Testcase - ERROR - Flashing was not interrupted within the transfer");
+        return false;
+    }
+
+    // =========================================================================
+    // Start the flashing again, it continues after the data on the ECU
+    {
+        SimulatedEcuAccess ecu(ecu_instance);
+        simEcuResetStatistics();
+    }
+    QElapsedTimer timer;
+    timer.start();
+    aborted = !flashFile(data, key_address, key_good_value, skipped_bytes, resumed_bytes);
+    qint64 flash_ms = timer.elapsed();
+
+    bool content_ok = verifyFlash(data, ecu_instance);
+    bool key_ok = verifyKey(key_address, key_good_value);
+
+    SimEcuStatistics stats;
+    {
+        SimulatedEcuAccess ecu(ecu_instance);
+        simEcuGetStatistics(&stats);
+    }
+
+    emit toConsole(">> Continuing the interrupted flashing took " + QString::number(flash_ms) + " ms, " + QString::number(skipped_bytes)
+                   + " bytes skipped, " + QString::number(resumed_bytes) + " bytes resumed, PFLASH " + QString::number(stats.pflash_erased_sectors)
+                   + " sectors erased/" + QString::number(stats.pflash_programmed_pages) + " pages programmed");
+
+    if(aborted)
+        emit toConsole(">> Testcase - ERROR - FlashManager aborted the continued flashing");
+    if(stats.program_errors > 0)
+        emit toConsole(">> Testcase - ERROR - " + QString::number(stats.program_errors) + " pages were programmed without being erased");
+
+    // Completely written sectors are skipped (DIFFERENTIAL_FLASHING) or verified on the ECU (RESUMABLE_FLASHING)
+    bool resent_ok = skipped_bytes + resumed_bytes >= written_bytes;
+    if(!resent_ok)
+        emit toConsole(">> Testcase - ERROR - Only " + QString::number(skipped_bytes + resumed_bytes) + " of the "
+                       + QString::number(written_bytes) + " bytes of completely written sectors were not transferred again");
+    uint32_t missing_sectors = sector_written.size() - written_sectors;
+    bool erased_ok = stats.pflash_erased_sectors <= missing_sectors + SIMULATED_FLASHING_KEY_ERASES;
+    if(!erased_ok)
+        emit toConsole(">> Testcase - ERROR - " + QString::number(stats.pflash_erased_sectors) + " PFLASH sectors were erased, but only "
+                       + QString::number(missing_sectors) + " sectors were not completely written");
+
+    return !aborted && content_ok && key_ok && stats.program_errors == 0 && resent_ok && erased_ok;
+}
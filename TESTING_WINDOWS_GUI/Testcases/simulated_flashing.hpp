@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : simulated_flashing.hpp
+// Author      : Michael Bauer
+// Version     : 0.6
+// Copyright   : MIT
+// Description : Flashes a S19 file end-to-end into the simulated ECU in several variants (Testing GUI only)
+//============================================================================
+
+#ifndef SIMULATED_FLASHING_H_
+#define SIMULATED_FLASHING_H_
+
+#include "../testcase.hpp"
+
+#define SIMULATED_FLASHING_CORE0_BYTES      (0x40000)   // Generated image: Bytes for Core 0
+#define SIMULATED_FLASHING_CORE1_BYTES      (0x40000)   // Generated image: Bytes for Core 1
+#define SIMULATED_FLASHING_CAL_DATA_BYTES   (0x1000)    // Generated image: Bytes for Calibration data
+#define SIMULATED_FLASHING_RECORD_BYTES     (32)        // Generated image: Data bytes per S3 record
+#define SIMULATED_FLASHING_TIMEOUT_MS       (600000)    // Max time for validation and flashing
+#define SIMULATED_FLASHING_KEY_ERASES       (2)         // The sector of the ASW key is erased for the Bad Key and again for the Good Key
+#define SIMULATED_FLASHING_STOP_PERCENT     (50)        // Interrupted flashing: Share of the file programmed before the FlashManager is stopped
+#define SIMULATED_FLASHING_PAGE_BYTES       (32)        // Interrupted flashing: Bytes per PFLASH page (see SimEcuStatistics)
+#define SIMULATED_FLASHING_POLL_MS          (10)        // Interrupted flashing: Cycle time to check the programmed pages
+
+class SimulatedFlashing : public Testcase {
+
+protected:
+    QString s19_file;                           // File to be flashed, empty for a generated image
+    bool passed;                                // Result of the last run
+    uint8_t ecu_instance;                       // Simulated ECU that is flashed, see SimulatedEcuAccess
+
+public:
+    SimulatedFlashing(uint8_t gui_id);
+    ~SimulatedFlashing();
+
+    void setFile(const QString &file);
+    bool hasPassed();
+
+    void messageChecker(const unsigned int id, const QByteArray &rec) override;
+    void startTests() override;
+
+protected:
+    SimulatedFlashing(uint8_t gui_id, uint8_t ecu_count);
+
+    bool readFile(QByteArray &file_content);
+    bool validateFile(const QByteArray &file_content, QMap<uint32_t, QByteArray> &flash_data, uint32_t &key_address, uint32_t &key_good_value);
+    QByteArray createImage();
+    QString readDIDAddress(uint16_t did);
+    bool flashFile(const QMap<uint32_t, QByteArray> &data, uint32_t key_address, uint32_t key_good_value, size_t &skipped_bytes,
+                   size_t &resumed_bytes, uint32_t stop_pages = 0);
+    bool verifyFlash(const QMap<uint32_t, QByteArray> &data, uint8_t instance);
+    bool verifyKey(uint32_t key_address, uint32_t key_good_value);
+    bool flashSequential(const QMap<uint32_t, QByteArray> &data, uint32_t key_address, uint32_t key_good_value, qint64 pipelined_ms);
+    bool flashInterrupted(const QMap<uint32_t, QByteArray> &data, uint32_t key_address, uint32_t key_good_value);
+};
+
+#endif /* SIMULATED_FLASHING_H_ */
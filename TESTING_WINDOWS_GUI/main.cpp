@@ -3,12 +3,66 @@
 
 #include <QApplication>
 #include <QMessageBox>
+#include <QTimer>
 
 #include "mainwindow.h"
+#include "testcasecontroller.hpp"
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // Command line: --simulated-flashing [file.s19] flashes the simulated ECU without GUI (e.g. CI with QT_QPA_PLATFORM=offscreen)
+    QStringList args = a.arguments();
+    int sim_idx = args.indexOf("--simulated-flashing");
+    if(sim_idx >= 0){
+        QString file = (sim_idx + 1 < args.size()) ? args[sim_idx + 1] : "";
+
+        Testcasecontroller tests;
+        QObject::connect(&tests, &Testcasecontroller::toConsole, [](const QString &text){
+            qInfo().noquote() << text;
+        });
+
+        QTimer::singleShot(0, [&tests, file](){
+            QCoreApplication::exit(tests.simulatedFlashing(file) ? 0 : 1);
+        });
+        return a.exec();
+    }
+
+    // Command line: --simulated-parallel-flashing N [file.s19] flashes N simulated ECUs on one bus at the same time
+    int parallel_idx = args.indexOf("--simulated-parallel-flashing");
+    if(parallel_idx >= 0){
+        uint8_t ecu_count = (parallel_idx + 1 < args.size()) ? (uint8_t)args[parallel_idx + 1].toUInt() : 0;
+        QString file = (parallel_idx + 2 < args.size()) ? args[parallel_idx + 2] : "";
+        if(ecu_count == 0){
+            qInfo().noquote() << "Usage: --simulated-parallel-flashing N [file.s19] with N simulated ECUs";
+            return 1;
+        }
+
+        Testcasecontroller tests;
+        QObject::connect(&tests, &Testcasecontroller::toConsole, [](const QString &text){
+            qInfo().noquote() << text;
+        });
+
+        QTimer::singleShot(0, [&tests, ecu_count, file](){
+            QCoreApplication::exit(tests.simulatedParallelFlashing(ecu_count, file) ? 0 : 1);
+        });
+        return a.exec();
+    }
+
+    // Command line: --benchmarks runs the host side benchmarks, fails if a benchmark produced wrong results
+    if(args.contains("--benchmarks")){
+        Testcasecontroller tests;
+        QObject::connect(&tests, &Testcasecontroller::toConsole, [](const QString &text){
+            qInfo().noquote() << text;
+        });
+
+        QTimer::singleShot(0, [&tests](){
+            QCoreApplication::exit(tests.benchmarks() ? 0 : 1);
+        });
+        return a.exec();
+    }
+
     QMessageBox::about(nullptr, "License", 
                        "The app was developed with usage of QT Open Source under LGPLv3.\nThe license can be found in file \"LGPLv3\".");
     MainWindow w;
@@ -30,7 +30,10 @@ MainWindow::MainWindow(QWidget *parent)
     this->ui->testSelectionBox->addItems({"Testcase: UDS Selftest (Testing GUI only)",
                                           "Testcase: Send UDS Messages to ECU (Testing GUI <-> ECU)",
                                           "Testcase: UDS Listening only (ECU/GUI -> Testing GUI)",
-                                          "Testcase: Send ISO TP Frames to ECU (Testing GUI -> ECU)"
+                                          "Testcase: Send ISO TP Frames to ECU (Testing GUI -> ECU)",
+                                          "Testcase: Benchmarks (Testing GUI only)",
+                                          "Testcase: Flash Simulated ECU (Testing GUI only)",
+                                          "Testcase: Flash Simulated ECUs in parallel (Testing GUI only)"
                                         });
 
     // Default:
@@ -78,5 +81,26 @@ void MainWindow::on_testSelectionBox_currentTextChanged(const QString &arg1)
 
         tests->setTestMode(Testcasecontroller::ECUISOTP);
     }
+
+    else if(arg1 == "Testcase: Benchmarks (Testing GUI only)"){
+        // Start Benchmarks
+        this->ui->consoleOut->appendPlainText("Starting Benchmarks\n\tRuns on local loopbacks only, no CAN Bus traffic is needed\n");
+
+        tests->setTestMode(Testcasecontroller::BENCHMARK);
+    }
+
+    else if(arg1 == "Testcase: Flash Simulated ECU (Testing GUI only)"){
+        // Start Simulated Flashing
+        this->ui->consoleOut->appendPlainText("Starting Simulated Flashing\n\tFlashes a generated S19 image into the simulated ECU (bootloader sources running on the host), no CAN Bus is needed\n");
+
+        tests->setTestMode(Testcasecontroller::SIMULATION);
+    }
+
+    else if(arg1 == "Testcase: Flash Simulated ECUs in parallel (Testing GUI only)"){
+        // Start Parallel Flashing
+        this->ui->consoleOut->appendPlainText("Starting Parallel Flashing\n\tFlashes a generated S19 image into several simulated ECUs on one bus at the same time, no CAN Bus is needed\n");
+
+        tests->setTestMode(Testcasecontroller::PARALLEL_SIMULATION);
+    }
 }
 
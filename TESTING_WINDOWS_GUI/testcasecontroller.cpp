@@ -4,7 +4,7 @@
 //============================================================================
 // Name        : testcasecontroller.cpp
 // Author      : Michael Bauer
-// Version     : 0.1
+// Version     : 0.3
 // Copyright   : MIT
 // Description : Testcase Controller for different UDS tests
 //============================================================================
@@ -20,6 +20,11 @@ Testcasecontroller::Testcasecontroller(){
     uds_listening = nullptr;
     ecu_isotp = nullptr;
     ecu_test = nullptr;
+    benchmark = nullptr;
+#if defined(FBL_SIMULATED_ECU)
+    simulated_flashing = nullptr;
+    parallel_flashing = nullptr;
+#endif
 }
 
 Testcasecontroller::~Testcasecontroller() {
@@ -68,6 +73,32 @@ void Testcasecontroller::setTestMode(Testcasecontroller::TESTMODES mode){
         connect(ecu_test, SIGNAL(toConsole(QString)), this, SLOT(consoleForward(QString)));
     }
 
+    else if(mode == BENCHMARK){
+        this->benchmark = new Benchmark(0x1);
+
+        // GUI Console Print
+        connect(benchmark, SIGNAL(toConsole(QString)), this, SLOT(consoleForward(QString)));
+    }
+
+    else if(mode == SIMULATION){
+#if defined(FBL_SIMULATED_ECU)
+        this->simulated_flashing = new SimulatedFlashing(0x1);
+
+        // GUI Console Print
+        connect(simulated_flashing, SIGNAL(toConsole(QString)), this, SLOT(consoleForward(QString)));
+#else
+        emit toConsole("\tERROR: Simulated ECU is not part of this build (GCC/Clang only)\n");
+#endif
+    }
+
+    else if(mode == PARALLEL_SIMULATION){
+#if defined(FBL_SIMULATED_ECU)
+        createParallelFlashing(PARALLEL_FLASHING_DEFAULT_ECUS);
+#else
+        emit toConsole("\tERROR: Simulated ECU is not part of this build (GCC/Clang only)\n");
+#endif
+    }
+
     // Set the testcase
     this->testcase = mode;
 
@@ -89,6 +120,68 @@ void Testcasecontroller::startTests(){
     else if(this->testcase == ECUTEST){
         ecu_test->startTests();
     }
+
+    else if(this->testcase == BENCHMARK){
+        benchmark->startTests();
+    }
+
+#if defined(FBL_SIMULATED_ECU)
+    else if(this->testcase == SIMULATION){
+        simulated_flashing->startTests();
+    }
+
+    else if(this->testcase == PARALLEL_SIMULATION){
+        parallel_flashing->startTests();
+    }
+#endif
+}
+
+/**
+ * @brief Runs the host side benchmarks without GUI (Command line usage, e.g. CI)
+ * @return true if all benchmarks produced the expected results
+ */
+bool Testcasecontroller::benchmarks(){
+    setTestMode(BENCHMARK);
+    benchmark->startTests();
+    return benchmark->hasPassed();
+}
+
+/**
+ * @brief Flashes the given file into the simulated ECU without GUI (Command line usage, e.g. CI)
+ * @param file S19 file, empty for a generated image
+ * @return true if the flashing passed
+ */
+bool Testcasecontroller::simulatedFlashing(const QString &file){
+#if defined(FBL_SIMULATED_ECU)
+    setTestMode(SIMULATION);
+    simulated_flashing->setFile(file);
+    simulated_flashing->startTests();
+    return simulated_flashing->hasPassed();
+#else
+    emit toConsole("ERROR: Simulated ECU is not part of this build (GCC/Clang only)");
+    return false;
+#endif
+}
+
+/**
+ * @brief Flashes the given file into several simulated ECUs on one bus at the same time without GUI (Command line usage, e.g. CI)
+ * @param ecu_count Number of simulated ECUs
+ * @param file S19 file, empty for a generated image
+ * @return true if the flashing of all ECUs passed
+ */
+bool Testcasecontroller::simulatedParallelFlashing(uint8_t ecu_count, const QString &file){
+#if defined(FBL_SIMULATED_ECU)
+    cleanUpTestcases();
+    createParallelFlashing(ecu_count);
+    this->testcase = PARALLEL_SIMULATION;
+
+    parallel_flashing->setFile(file);
+    parallel_flashing->startTests();
+    return parallel_flashing->hasPassed();
+#else
+    emit toConsole("ERROR: Simulated ECU is not part of this build (GCC/Clang only)");
+    return false;
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -115,6 +208,36 @@ void Testcasecontroller::cleanUpTestcases(){
         delete this->ecu_test;
         this->ecu_test = nullptr;
     }
+
+    if(this->benchmark != nullptr){
+        delete this->benchmark;
+        this->benchmark = nullptr;
+    }
+
+#if defined(FBL_SIMULATED_ECU)
+    if(this->simulated_flashing != nullptr){
+        delete this->simulated_flashing;
+        this->simulated_flashing = nullptr;
+    }
+
+    if(this->parallel_flashing != nullptr){
+        delete this->parallel_flashing;
+        this->parallel_flashing = nullptr;
+    }
+#endif
+}
+
+/**
+ * @brief Creates the testcase for the parallel flashing of simulated ECUs
+ * @param ecu_count Number of simulated ECUs on the bus
+ */
+void Testcasecontroller::createParallelFlashing(uint8_t ecu_count){
+#if defined(FBL_SIMULATED_ECU)
+    this->parallel_flashing = new ParallelFlashing(0x1, ecu_count);
+
+    // GUI Console Print
+    connect(parallel_flashing, SIGNAL(toConsole(QString)), this, SLOT(consoleForward(QString)));
+#endif
 }
 
 //============================================================================
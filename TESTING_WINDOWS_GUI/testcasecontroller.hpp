@@ -4,7 +4,7 @@
 //============================================================================
 // Name        : testcasecontroller.hpp
 // Author      : Michael Bauer
-// Version     : 0.1
+// Version     : 0.3
 // Copyright   : MIT
 // Description : Testcase Controller for different UDS tests
 //============================================================================
@@ -19,12 +19,17 @@
 #include "Testcases/uds_listening.hpp"
 #include "Testcases/ecu_isotp.hpp"
 #include "Testcases/ecu_test.hpp"
+#include "Testcases/benchmark.hpp"
+#if defined(FBL_SIMULATED_ECU)
+ #include "Testcases/simulated_flashing.hpp"
+ #include "Testcases/parallel_flashing.hpp"
+#endif
 
 class Testcasecontroller : public QObject{
     Q_OBJECT
 
 public:
-    enum TESTMODES {SELFTEST, LISTENING, ECUISOTP, GUITEST, ECUTEST};
+    enum TESTMODES {SELFTEST, LISTENING, ECUISOTP, GUITEST, ECUTEST, BENCHMARK, SIMULATION, PARALLEL_SIMULATION};
 
 private:
     Testcasecontroller::TESTMODES testcase;
@@ -32,6 +37,11 @@ private:
     UDS_Listening *uds_listening;
     ECU_ISOTP *ecu_isotp;
     ECU_Test *ecu_test;
+    Benchmark *benchmark;
+#if defined(FBL_SIMULATED_ECU)
+    SimulatedFlashing *simulated_flashing;
+    ParallelFlashing *parallel_flashing;
+#endif
 
 public:
     Testcasecontroller();
@@ -39,9 +49,13 @@ public:
 
     void setTestMode(Testcasecontroller::TESTMODES mode);
     void startTests();
+    bool benchmarks();
+    bool simulatedFlashing(const QString &file);
+    bool simulatedParallelFlashing(uint8_t ecu_count, const QString &file);
 
 private:
     void cleanUpTestcases();
+    void createParallelFlashing(uint8_t ecu_count);
 
 signals:
     /**
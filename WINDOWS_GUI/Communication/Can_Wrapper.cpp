@@ -12,6 +12,8 @@
 #include <QDebug>
 #include <QString>
 
+#include <string.h>
+
 #include "Can_Wrapper.hpp"
 
 //============================================================================
@@ -421,17 +423,15 @@ void CAN_Wrapper::doRX(){
                         continue;
                     }
 
-                    QString bytes_data = "";
-                    QByteArray ba;
-                    ba.resize(event.tagData.msg.dlc);
-                    for(int i = 0; i < event.tagData.msg.dlc; i++){
-                        ba[i] = event.tagData.msg.data[i];
-                        bytes_data.append(QString("%1").arg(uint8_t(ba[i]), 2, 16, QLatin1Char( '0' )) + " ");
-                    }
-                    if(RX_TX_CAN_DRIVER) qInfo() << ">> CAN_Wrapper: Received"<<event.tagData.msg.dlc<<"byte CAN message with Data:" << bytes_data.trimmed().toStdString() << "from"<<QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
-                    if(VERBOSE_CAN_DRIVER) qInfo() << "CAN_Wrapper: Sending Signal rxDataReceived for ID" << QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
+                    CANFrame frame;
+                    frame.id = id;
+                    frame.dlc = event.tagData.msg.dlc > CAN_CLASSIC_MAX_DLC ? CAN_CLASSIC_MAX_DLC : event.tagData.msg.dlc;
+                    memcpy(frame.data, event.tagData.msg.data, frame.dlc);
+
+                    if(RX_TX_CAN_DRIVER) qInfo() << ">> CAN_Wrapper: Received"<<frame.dlc<<"byte CAN message with Data:" << QByteArray((const char*)frame.data, frame.dlc).toHex(' ').toStdString() << "from"<<QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
+                    if(VERBOSE_CAN_DRIVER) qInfo() << "CAN_Wrapper: Sending Signal rxFrameReceived for ID" << QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
 
-                    emit rxDataReceived(id, ba);
+                    emit rxFrameReceived(frame);
 				}
 			}
 		}
@@ -56,6 +56,32 @@ uint8_t CommInterface::txData(uint8_t *data, uint8_t no_bytes){
 	return 0;
 }
 
+/**
+ * @brief Method to send several frames in order. Can be overwritten in inheriting class if the driver supports sending multiple frames at once.
+ * @param frames Given frames
+ * @return 1 if all frames were transmitted
+ */
+uint8_t CommInterface::txDataBatch(const QList<QByteArray> &frames){
+    uint8_t ok = 1;
+    for(const QByteArray &frame : frames){
+        if(!this->txData((uint8_t*)frame.constData(), frame.size()))
+            ok = 0;
+    }
+    return ok;
+}
+
+/**
+ * @brief Method to switch between classic CAN and CAN FD. Needs to be overwritten in the inheriting class if the driver supports CAN FD.
+ * @param enabled true to transmit CAN FD frames with up to 64 bytes
+ * @param data_baudrate Bit rate of the data phase, 0 to keep the current one
+ * @return true if the requested mode is used
+ */
+bool CommInterface::setCANFD(bool enabled, unsigned int data_baudrate){
+    if(enabled)
+        emit errorPrint("CAN FD is not supported by the selected channel, using classic CAN");
+    return !enabled;
+}
+
 /**
  * @brief Method that is called by the startRX Thread. Here comes the RX receiving loop. Need to be overwritten in the inheriting class.
  */
@@ -91,6 +117,11 @@ void CommInterface::txDataSlot(const QByteArray &data){
     }
 }
 
+void CommInterface::txDataBatchSlot(const QList<QByteArray> &frames){
+    if(VERBOSE_COMMINTERFACE) qInfo() << "CommInterface: Slot - Received TX Batch to be transmitted - Frames =" << frames.size();
+    this->txDataBatch(frames);
+}
+
 /**
  * @brief default implementation for setBaudrate
  * @param baudrate
@@ -14,12 +14,27 @@
 
 #define VERBOSE_COMMINTERFACE   0   // switch for verbose console information
 
+#define CAN_FRAME_MAX_DLC       64  // Max data bytes of a received frame (CAN FD)
+#define CAN_CLASSIC_MAX_DLC     8   // Max data bytes of a classic CAN frame
+
 #include <QObject>
 #include <QMutex>
 #include <QByteArray>
+#include <QList>
+#include <QMetaType>
 
 #include <stdint.h>
 
+/**
+ * @brief Received frame, passed by value from the driver to the Communication Layer (no heap allocation per frame)
+ */
+struct CANFrame {
+    uint32_t id;                    // ID of the Sender
+    uint8_t dlc;                    // Number of data bytes
+    uint8_t data[CAN_FRAME_MAX_DLC];
+};
+Q_DECLARE_METATYPE(CANFrame)
+
 class CommInterface : public QObject{
     Q_OBJECT
 
@@ -42,6 +57,13 @@ public:
 		return this->type;
 	}
 
+    /**
+     * @brief Max data bytes per frame of the currently used protocol, used for the ISO TP segmentation
+     */
+    uint8_t getMaxFrameLen(){
+        return this->type == 2 ? CAN_FRAME_MAX_DLC : CAN_CLASSIC_MAX_DLC;
+    }
+
 	uint8_t getInterfaceID(){
 		return this->own_id;
 	}
@@ -67,7 +89,6 @@ public:
         emit rxStopThreadRequested();
     }
 
-protected:
 	virtual void setID(uint32_t id){
 		this->id = id;
 	}
@@ -78,7 +99,10 @@ protected:
 
 	virtual uint8_t initDriver();
     virtual uint8_t txData(uint8_t *data, uint8_t no_bytes);
+    virtual uint8_t txDataBatch(const QList<QByteArray> &frames);
+    virtual bool setCANFD(bool enabled, unsigned int data_baudrate);
 
+protected:
     virtual void doRX();
 
 signals:
@@ -133,11 +157,10 @@ signals:
     void rxThreadFinished();
 
     /**
-     * @brief Signals that RX Data is received
-     * @param id ID of the Sender
-     * @param ba ByteArray with the data
+     * @brief Signals that a RX Frame is received
+     * @param frame Received frame
      */
-    void rxDataReceived (const unsigned int id, const QByteArray &ba );
+    void rxFrameReceived(const CANFrame &frame);
 
 public slots:
 
@@ -152,6 +175,12 @@ public slots:
      */
     void txDataSlot(const QByteArray &data);
 
+    /**
+     * @brief Slot to send several frames in order via Interface
+     * @param frames List of ByteArrays with data to be transmitted
+     */
+    void txDataBatchSlot(const QList<QByteArray> &frames);
+
     /**
      * @brief Slot to change baudrate
      * @param baudrate
@@ -0,0 +1,487 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : SimulatedEcuDriver.cpp
+// Author      : Michael Bauer
+// Version     : 0.2
+// Copyright   : MIT
+// Description : Qt Driver connecting to the simulated ECU (bootloader sources running on the host)
+//============================================================================
+
+#include <QDebug>
+#include <QString>
+#include <QThread>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SimulatedEcuDriver.hpp"
+#include "../UDS_Spec/uds_comm_spec.h"
+
+// The simulated ECUs share the global variables of the bootloader sources, only one thread at a time may run one of them.
+// ecuMutex also protects the assignment of the ECUs to the driver instances.
+static QMutex ecuMutex;
+static SimulatedEcuDriver *ecuOwnerInstance[SIM_ECU_MAX_INSTANCES] = {nullptr};
+
+/**
+ * @brief Reads an unsigned timing value from the environment
+ * @param name Name of the environment variable
+ * @param fallback Value if the variable is not set
+ * @return Value of the variable or fallback
+ */
+static uint32_t envTiming(const char *name, uint32_t fallback){
+    const char *env = getenv(name);
+    if(env == nullptr || env[0] == '\0')
+        return fallback;
+    return (uint32_t)strtoul(env, nullptr, 10);
+}
+
+//============================================================================
+// Public
+//============================================================================
+
+/**
+ * Constructor for SimulatedEcuDriver. The timing is taken from the environment variables, see SimulatedEcuDriver.hpp
+ */
+SimulatedEcuDriver::SimulatedEcuDriver(){
+    this->type = envTiming("FBL_SIM_CANFD", 0) ? 2 : 1; // CAN_FD or CAN
+    this->frameLatencyUs = envTiming("FBL_SIM_FRAME_LATENCY_US", 0);
+    this->fdFrameLatencyUs = envTiming("FBL_SIM_FD_FRAME_LATENCY_US", frameLatencyUs);
+    this->flashTiming.pflash_erase_sector_us = envTiming("FBL_SIM_PFLASH_ERASE_SECTOR_US", 0);
+    this->flashTiming.pflash_program_page_us = envTiming("FBL_SIM_PFLASH_PROGRAM_PAGE_US", 0);
+    this->flashTiming.dflash_erase_sector_us = envTiming("FBL_SIM_DFLASH_ERASE_SECTOR_US", 0);
+    this->flashTiming.dflash_program_page_us = envTiming("FBL_SIM_DFLASH_PROGRAM_PAGE_US", 0);
+    setEcuCount((uint8_t)envTiming("FBL_SIM_ECUS", SIMULATED_ECU_DEFAULT_COUNT));
+    clock.start();
+}
+
+/**
+ * Deconstructor for SimulatedEcuDriver. Stops the ECUs and releases them for other instances.
+ */
+SimulatedEcuDriver::~SimulatedEcuDriver(){
+    stopRX();
+
+    bool waitOnStop = true;
+    do{
+        busCond.wakeAll();
+        mutex.lock();
+        waitOnStop = _working;
+        mutex.unlock();
+    } while(waitOnStop);
+
+    ecuMutex.lock();
+    for(SimulatedEcu *ecu : ecus){
+        simEcuSelect(ecu->instance);
+        simEcuPowerOff();
+        ecuOwnerInstance[ecu->instance] = nullptr;
+        delete ecu;
+    }
+    ecus.clear();
+    ecuMutex.unlock();
+    qInfo() << "SimulatedEcuDriver: Destructor of SimulatedEcuDriver finished";
+}
+
+/**
+ * Method to init the driver. Powers on the simulated ECUs (see setEcuCount), the flash content of a former power on is
+ * kept. Missing ECUs are created with erased flash and the next free ECU ID.
+ *
+ * @return uint8_t 0 if init was successful, 1 if not enough simulated ECUs are free
+ */
+uint8_t SimulatedEcuDriver::initDriver(){
+
+    ecuMutex.lock();
+    if(ecus.isEmpty()){
+        QList<uint8_t> instances;
+        for(uint8_t instance = 0; instance < simEcuInstances() && instances.size() < ecuCount; instance++){
+            if(ecuOwnerInstance[instance] == nullptr)
+                instances.append(instance);
+        }
+        while(instances.size() < ecuCount){
+            uint8_t instance = simEcuCreate();
+            if(instance == SIM_ECU_NO_INSTANCE)
+                break;
+            instances.append(instance);
+        }
+
+        if(instances.size() < ecuCount){
+            ecuMutex.unlock();
+            emit errorPrint("Simulated ECU Driver: Only " + QString::number(instances.size()) + " of " + QString::number(ecuCount) + " simulated ECUs are free, the others are used by another Communication instance");
+            emit driverInit("Simulated ECU in use");
+            return 1;
+        }
+
+        busMutex.lock();
+        for(uint8_t instance : instances){
+            SimulatedEcu *ecu = new SimulatedEcu();
+            ecu->driver = this;
+            ecu->instance = instance;
+            ecus.append(ecu);
+            ecuOwnerInstance[instance] = this;
+        }
+        busMutex.unlock();
+    }
+
+    QString ids;
+    for(SimulatedEcu *ecu : ecus){
+        simEcuSelect(ecu->instance);
+        simEcuSetTiming(&flashTiming);
+        simEcuPowerOn(&SimulatedEcuDriver::ecuTxCallback, &SimulatedEcuDriver::ecuBusyCallback, ecu);
+
+        // With erased DFLASH every ECU uses the default CAN ID of the first one (ECU ID 1), the further ones get 2, 3, ...
+        if(ecu->instance > 0 && (simEcuGetID() & FBLCAN_ECU_ID_MASK) == (1 << 4)){
+            uint8_t can_id[2] = {(uint8_t)((ecu->instance + 1) >> 8), (uint8_t)(ecu->instance + 1)};
+            simEcuWriteDID(FBL_DID_CAN_ID, can_id, sizeof(can_id));
+        }
+
+        busMutex.lock();
+        ecu->id = simEcuGetID();
+        busMutex.unlock();
+        ids += (ids.isEmpty() ? "" : ", ") + QString("0x%1").arg(ecu->id, 8, 16, QLatin1Char( '0' ));
+    }
+    ecuMutex.unlock();
+
+    emit infoPrint("Simulated ECU Driver: Init successfully, " + QString::number(ecus.size()) + " ECU(s) transmit with ID " + ids);
+    qInfo() << "SimulatedEcuDriver: Initialization of the driver finished," << ecus.size() << "ECU(s), frame latency" << frameLatencyUs << "us, CAN FD frame latency" << fdFrameLatencyUs << "us" << (type == 2 ? "(CAN FD)" : "");
+    emit driverInit("Simulated ECU");
+    return 0;
+}
+
+/**
+ * Method to set the TX ID for the transmission of CAN messages. The ID will be used directly after it is set
+ *
+ * @param id ID for the TX
+ */
+void SimulatedEcuDriver::setID(uint32_t id){
+    txID = id;
+    if(VERBOSE_SIMULATED_ECU_DRIVER) qInfo("SimulatedEcuDriver: TX ID is set to 0x%08X\n", txID);
+}
+
+/**
+ * Transmits given number of bytes of the given data to the simulated ECU
+ *
+ * @param data Given data (Maximal 8 byte array is possible, 64 byte with CAN FD)
+ * @param no_bytes Set the number of bytes to be transmitted (Maximum of 8 byte is possible, 64 byte with CAN FD)
+ * @return 1 if message could be transmitted
+ */
+uint8_t SimulatedEcuDriver::txData(uint8_t *data, uint8_t no_bytes){
+    QList<QByteArray> frames;
+    frames.append(QByteArray((const char*)data, no_bytes));
+    return txDataBatch(frames);
+}
+
+/**
+ * Queues the given frames for the simulated ECUs. Every frame occupies the modelled bus for the frame latency.
+ * Like the RX filter of the CAN driver of the ECU, a frame is only received by the addressed ECU or by all ECUs for
+ * ECU ID 0 (broadcast).
+ *
+ * @param frames CAN frames to be transmitted in order (Maximum of 8 byte per frame is possible, 64 byte with CAN FD)
+ * @return 1 if all messages could be transmitted
+ */
+uint8_t SimulatedEcuDriver::txDataBatch(const QList<QByteArray> &frames){
+
+    for(const QByteArray &frame : frames){
+        if(frame.size() > getMaxFrameLen()){
+            qInfo() << "SimulatedEcuDriver: Maximum number of Bytes is" << getMaxFrameLen();
+            return 0;
+        }
+    }
+    emit txDataSentRequested("SimulatedEcuDriver: TX requested");
+
+    busMutex.lock();
+    for(const QByteArray &frame : frames){
+        BusFrame bus_frame;
+        bus_frame.id = txID;
+        bus_frame.data = frame;
+        bus_frame.due_ns = occupyBus(frame.size());
+        for(SimulatedEcu *ecu : ecus){
+            uint32_t ecu_id = txID & FBLCAN_ECU_ID_MASK;
+            if(ecu_id == 0 || ecu_id == (ecu->id & FBLCAN_ECU_ID_MASK))
+                ecu->busQueue.enqueue(bus_frame);
+        }
+
+        if(RX_TX_SIMULATED_ECU_DRIVER) qInfo() << "<< SimulatedEcuDriver: Transmitting"<<frame.size()<<"byte CAN message (Data=" << frame.toHex(' ').toStdString() << ") with ID" << QString("0x%1").arg(txID, 8, 16, QLatin1Char( '0' ));
+    }
+    busCond.wakeAll();
+    busMutex.unlock();
+
+    emit txDataSentStatus("Success");
+    return 1;
+}
+
+/**
+ * RX Thread of the driver: Runs the first simulated ECU, every further ECU runs in its own thread
+ */
+void SimulatedEcuDriver::doRX(){
+    emit infoPrint("Simulated ECU Driver: Simulated ECU is running");
+
+    QList<QThread*> threads;
+    for(int i = 1; i < ecus.size(); i++){
+        SimulatedEcu *ecu = ecus[i];
+        QThread *thread = QThread::create([this, ecu](){ runEcu(ecu); });
+        thread->start();
+        threads.append(thread);
+    }
+
+    if(!ecus.isEmpty())
+        runEcu(ecus.first());
+    else{
+        // Init failed, wait on the abort
+        while(true){
+            mutex.lock();
+            bool abort = _abort;
+            mutex.unlock();
+            if(abort)
+                break;
+            QThread::msleep(SIMULATED_ECU_IDLE_WAIT_MS);
+        }
+    }
+
+    for(QThread *thread : threads){
+        thread->wait();
+        delete thread;
+    }
+
+    busMutex.lock();
+    for(SimulatedEcu *ecu : ecus)
+        ecu->busQueue.clear();
+    busMutex.unlock();
+
+    qInfo() << "SimulatedEcuDriver: Simulated ECU stopped";
+    emit rxThreadFinished();
+
+    mutex.lock();
+    _working = false;
+    mutex.unlock();
+}
+
+/**
+ * Switches between classic CAN and CAN FD. The data bit rate is not modelled, see setFrameLatency.
+ *
+ * @param enabled true to transmit CAN FD frames with up to 64 bytes
+ * @param data_baudrate Bit rate of the data phase (ignored)
+ * @return true, the simulated bus supports both
+ */
+bool SimulatedEcuDriver::setCANFD(bool enabled, unsigned int data_baudrate){
+    this->type = enabled ? 2 : 1; // CAN_FD or CAN
+    return true;
+}
+
+/**
+ * Method to set the modelled time per frame on the bus, e.g. 260 us for 8 byte frames at 500 kbit/s
+ * and about 200 us for 64 byte CAN FD frames at 500 kbit/s / 2 Mbit/s
+ *
+ * @param frame_latency_us Time per frame with up to 8 bytes in us, 0 for host speed
+ * @param fd_frame_latency_us Time per CAN FD frame with more than 8 bytes in us, 0 for host speed
+ */
+void SimulatedEcuDriver::setFrameLatency(uint32_t frame_latency_us, uint32_t fd_frame_latency_us){
+    this->frameLatencyUs = frame_latency_us;
+    this->fdFrameLatencyUs = fd_frame_latency_us;
+}
+
+/**
+ * Method to set the modelled erase and program times of the simulated flash of all ECUs
+ *
+ * @param timing Busy times of the flash, 0 for host speed
+ */
+void SimulatedEcuDriver::setFlashTiming(const SimEcuTiming &timing){
+    this->flashTiming = timing;
+
+    ecuMutex.lock();
+    for(SimulatedEcu *ecu : ecus){
+        simEcuSelect(ecu->instance);
+        simEcuSetTiming(&timing);
+    }
+    ecuMutex.unlock();
+}
+
+/**
+ * Method to set the number of simulated ECUs on the bus, needs to be called before initDriver
+ *
+ * @param count Number of ECUs, at most SIM_ECU_MAX_INSTANCES
+ */
+void SimulatedEcuDriver::setEcuCount(uint8_t count){
+    this->ecuCount = qBound((uint8_t)1, count, (uint8_t)SIM_ECU_MAX_INSTANCES);
+}
+
+/**
+ * Method to get the simulated ECUs on the bus, e.g. for SimulatedEcuAccess
+ *
+ * @return Instances of the ECUs in the order of their threads, empty before initDriver
+ */
+QList<uint8_t> SimulatedEcuDriver::getEcuInstances(){
+    QList<uint8_t> instances;
+    ecuMutex.lock();
+    for(SimulatedEcu *ecu : ecus)
+        instances.append(ecu->instance);
+    ecuMutex.unlock();
+    return instances;
+}
+
+//============================================================================
+// Private
+//============================================================================
+
+/**
+ * @brief Reserves the bus for the next frame, busMutex needs to be locked
+ * @param len Number of data bytes of the frame
+ * @return Time at which the frame is completely on the bus
+ */
+qint64 SimulatedEcuDriver::occupyBus(int len){
+    qint64 now_ns = clock.nsecsElapsed();
+    if(busFreeNs < now_ns)
+        busFreeNs = now_ns;
+    busFreeNs += (qint64)(len > CAN_CLASSIC_MAX_DLC ? fdFrameLatencyUs : frameLatencyUs) * 1000;
+    return busFreeNs;
+}
+
+/**
+ * @brief Runs a simulated ECU, which receives its queued frames once they are completely on the bus
+ * @param ecu ECU of this instance
+ */
+void SimulatedEcuDriver::runEcu(SimulatedEcu *ecu){
+    while(true){
+        mutex.lock();
+        bool abort = _abort;
+        mutex.unlock();
+        if(abort)
+            break;
+
+        BusFrame frame;
+        qint64 wait_ns = 0;
+
+        busMutex.lock();
+        if(ecu->busQueue.isEmpty())
+            busCond.wait(&busMutex, SIMULATED_ECU_IDLE_WAIT_MS);
+        else{
+            wait_ns = ecu->busQueue.head().due_ns - clock.nsecsElapsed();
+            if(wait_ns <= 0)
+                frame = ecu->busQueue.dequeue();
+        }
+        busMutex.unlock();
+
+        if(wait_ns > 0){
+            QThread::usleep((unsigned long)(wait_ns / 1000) + 1);
+            continue;
+        }
+
+        ecuMutex.lock();
+        simEcuSelect(ecu->instance);
+        if(!frame.data.isEmpty())
+            simEcuRxFrame(frame.id, (const uint8_t*)frame.data.constData(), (uint8_t)frame.data.size());
+        simEcuCyclic();
+
+        // The CAN ID can be changed via FBL_DID_CAN_ID
+        uint32_t id = simEcuGetID();
+        ecuMutex.unlock();
+
+        busMutex.lock();
+        ecu->id = id;
+        busMutex.unlock();
+    }
+}
+
+/**
+ * @brief Transmits a frame of the simulated ECU to the tester, called from the ECU thread
+ * @param frame Frame with the CAN ID of the ECU
+ */
+void SimulatedEcuDriver::ecuTransmit(const CANFrame &frame){
+    busMutex.lock();
+    qint64 due_ns = occupyBus(frame.dlc);
+    busMutex.unlock();
+
+    // The ECU is blocked until the frame is sent (see canTransmitMessage)
+    qint64 wait_ns = due_ns - clock.nsecsElapsed();
+    if(wait_ns > 0)
+        QThread::usleep((unsigned long)(wait_ns / 1000));
+
+    // Same acceptance as the RX filter of the CAN drivers
+    if(rxFilterMask != 0 && (frame.id & ~rxFilterMask) != 0)
+        return;
+
+    if(RX_TX_SIMULATED_ECU_DRIVER) qInfo() << ">> SimulatedEcuDriver: Received"<<frame.dlc<<"byte CAN message (Data=" << QByteArray((const char*)frame.data, frame.dlc).toHex(' ').toStdString() << ") with ID" << QString("0x%1").arg(frame.id, 8, 16, QLatin1Char( '0' ));
+    emit rxFrameReceived(frame);
+}
+
+/**
+ * @brief Blocks the ECU main loop while the flash is busy, called from the ECU thread. Frames that are completely
+ * on the bus meanwhile are received like by the RX interrupt, so the bus transfer overlaps with the flash operation.
+ * The other ECUs run meanwhile, their flash operations overlap as well.
+ * @param ecu ECU with the busy flash, selected
+ * @param busy_us Modelled busy time of the flash
+ */
+void SimulatedEcuDriver::ecuBusy(SimulatedEcu *ecu, uint64_t busy_us){
+    qint64 end_ns = clock.nsecsElapsed() + (qint64)busy_us * 1000;
+    ecuMutex.unlock();
+
+    while(true){
+        qint64 now_ns = clock.nsecsElapsed();
+        qint64 wait_ns = end_ns - now_ns;
+        if(wait_ns <= 0)
+            break;
+
+        BusFrame frame;
+        bool frame_pending = false;
+
+        busMutex.lock();
+        if(ecu->busQueue.isEmpty()){
+            // Woken up by txDataBatch if the tester queues a frame
+            QDeadlineTimer deadline(Qt::PreciseTimer);
+            deadline.setPreciseRemainingTime(0, wait_ns, Qt::PreciseTimer);
+            busCond.wait(&busMutex, deadline);
+        }
+        else{
+            qint64 due_ns = ecu->busQueue.head().due_ns - now_ns;
+            if(due_ns <= 0)
+                frame = ecu->busQueue.dequeue();
+            else if(due_ns < wait_ns)
+                wait_ns = due_ns;
+            frame_pending = frame.data.isEmpty();
+        }
+        busMutex.unlock();
+
+        if(!frame.data.isEmpty()){
+            ecuMutex.lock();
+            simEcuSelect(ecu->instance);
+            simEcuRxFrame(frame.id, (const uint8_t*)frame.data.constData(), (uint8_t)frame.data.size());
+            ecuMutex.unlock();
+        }
+        else if(frame_pending)
+            QThread::usleep((unsigned long)(wait_ns / 1000) + 1);
+    }
+
+    // The main loop of the ECU continues
+    ecuMutex.lock();
+    simEcuSelect(ecu->instance);
+}
+
+void SimulatedEcuDriver::ecuTxCallback(void *context, uint32_t id, const uint8_t *data, uint8_t len){
+    CANFrame frame;
+    frame.id = id;
+    frame.dlc = len > CAN_FRAME_MAX_DLC ? CAN_FRAME_MAX_DLC : len;
+    memcpy(frame.data, data, frame.dlc);
+    static_cast<SimulatedEcu*>(context)->driver->ecuTransmit(frame);
+}
+
+void SimulatedEcuDriver::ecuBusyCallback(void *context, uint64_t busy_us){
+    SimulatedEcu *ecu = static_cast<SimulatedEcu*>(context);
+    ecu->driver->ecuBusy(ecu, busy_us);
+}
+
+//============================================================================
+// SimulatedEcuAccess
+//============================================================================
+
+/**
+ * Blocks the ECU threads and selects the given simulated ECU for the simEcu functions
+ *
+ * @param instance ECU, see SimulatedEcuDriver::getEcuInstances
+ */
+SimulatedEcuAccess::SimulatedEcuAccess(uint8_t instance){
+    ecuMutex.lock();
+    simEcuSelect(instance);
+}
+
+SimulatedEcuAccess::~SimulatedEcuAccess(){
+    ecuMutex.unlock();
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : SimulatedEcuDriver.hpp
+// Author      : Michael Bauer
+// Version     : 0.2
+// Copyright   : MIT
+// Description : Header for Qt Driver connecting to the simulated ECU (bootloader sources running on the host)
+//============================================================================
+
+#ifndef SIMULATEDECUDRIVER_HPP_
+#define SIMULATEDECUDRIVER_HPP_
+
+#define VERBOSE_SIMULATED_ECU_DRIVER    0       // switch for verbose console information
+#define RX_TX_SIMULATED_ECU_DRIVER      0       // switch for verbose RX + TX information to console
+
+#define SIMULATED_ECU_IDLE_WAIT_MS      10      // Wait time of the ECU thread without frames to check on abort
+#define SIMULATED_ECU_DEFAULT_COUNT     1       // Simulated ECUs on the bus of one driver, see FBL_SIM_ECUS
+
+#include <QByteArray>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+#include "CommInterface.hpp"
+#include "../Simulation/simulated_ecu.h"
+
+/**
+ * @brief Driver with the simulated ECU on the other side of a modelled CAN bus. The RX thread of the driver runs the ECU.
+ *
+ * Timing can be configured with the environment variables FBL_SIM_FRAME_LATENCY_US, FBL_SIM_FD_FRAME_LATENCY_US,
+ * FBL_SIM_PFLASH_ERASE_SECTOR_US, FBL_SIM_PFLASH_PROGRAM_PAGE_US, FBL_SIM_DFLASH_ERASE_SECTOR_US and
+ * FBL_SIM_DFLASH_PROGRAM_PAGE_US (default 0 = host speed). FBL_SIM_CANFD=1 uses CAN FD frames with up to 64 bytes.
+ *
+ * FBL_SIM_ECUS (or setEcuCount) puts several simulated ECUs on the bus, each with its own flash and its own thread.
+ * The ECU IDs are 1, 2, 3, ... (FBL_DID_CAN_ID of a new ECU). An ECU can only be driven by one instance at a time,
+ * its flash content is kept for the next instance.
+ */
+class SimulatedEcuDriver : public CommInterface {
+
+    // Variables
+    private:
+        struct BusFrame {
+            uint32_t id;                                                    // CAN ID of the tester
+            QByteArray data;
+            qint64 due_ns;                                                  // Time at which the frame is completely on the bus
+        };
+
+        struct SimulatedEcu {
+            SimulatedEcuDriver *driver;
+            uint8_t instance;                                               // See simEcuSelect
+            uint32_t id;                                                    // CAN ID the ECU transmits with, frames for other ECUs are not queued
+            QQueue<BusFrame> busQueue;                                      // Frames of the tester, not received by the ECU yet
+        };
+
+        unsigned int txID                       = 0;                        // TX ID for sending CAN messages
+        uint32_t frameLatencyUs                 = 0;                        // Modelled time per frame on the bus
+        uint32_t fdFrameLatencyUs               = 0;                        // Modelled time per CAN FD frame with more than 8 bytes
+        SimEcuTiming flashTiming;                                           // Modelled busy times of the flash of all ECUs
+        uint8_t ecuCount                        = SIMULATED_ECU_DEFAULT_COUNT;
+        QList<SimulatedEcu*> ecus;                                          // ECUs driven by this instance
+
+        QElapsedTimer clock;                                                // Time base of the modelled bus
+        QMutex busMutex;                                                    // Protects the bus queues, the ECU IDs and busFreeNs
+        QWaitCondition busCond;                                             // Signalled with busMutex when a frame is queued for an ECU
+        qint64 busFreeNs                        = 0;                        // Time at which the bus is free for the next frame
+
+    // Methods
+    public:
+        SimulatedEcuDriver();
+        ~SimulatedEcuDriver();
+
+        void setID(uint32_t id) override;
+        uint8_t initDriver() override;
+
+        uint8_t txData(uint8_t *data, uint8_t no_bytes) override;
+        uint8_t txDataBatch(const QList<QByteArray> &frames) override;
+        bool setCANFD(bool enabled, unsigned int data_baudrate) override;
+        void doRX() override;
+
+        void setFrameLatency(uint32_t frame_latency_us, uint32_t fd_frame_latency_us);
+        void setFlashTiming(const SimEcuTiming &timing);
+        void setEcuCount(uint8_t count);
+        QList<uint8_t> getEcuInstances();
+
+    private:
+        qint64 occupyBus(int len);
+        void runEcu(SimulatedEcu *ecu);
+        void ecuTransmit(const CANFrame &frame);
+        void ecuBusy(SimulatedEcu *ecu, uint64_t busy_us);
+        static void ecuTxCallback(void *context, uint32_t id, const uint8_t *data, uint8_t len);
+        static void ecuBusyCallback(void *context, uint64_t busy_us);
+};
+
+/**
+ * @brief Access to a simulated ECU from another thread, e.g. to check the flash content in a testcase. The ECU threads
+ * of the drivers are blocked meanwhile, no Communication must be used while the access is held.
+ */
+class SimulatedEcuAccess {
+    public:
+        explicit SimulatedEcuAccess(uint8_t instance = 0);
+        ~SimulatedEcuAccess();
+};
+
+#endif /* SIMULATEDECUDRIVER_HPP_ */
@@ -0,0 +1,400 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : SocketCAN_Wrapper.cpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Qt CAN Wrapper for Linux SocketCAN (raw AF_CAN sockets)
+//============================================================================
+
+#include <QDebug>
+#include <QString>
+#include <QThread>
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#include "SocketCAN_Wrapper.hpp"
+
+//============================================================================
+// Public
+//============================================================================
+
+/**
+ * Constructor for SocketCAN_Wrapper. The interface is taken from the environment variable FBL_SOCKETCAN_INTERFACE,
+ * otherwise SOCKETCAN_DEFAULT_INTERFACE is used. FBL_SOCKETCAN_FD=1 transmits CAN FD frames if the interface supports it.
+ */
+SocketCAN_Wrapper::SocketCAN_Wrapper(){
+    const char *env = getenv("FBL_SOCKETCAN_INTERFACE");
+    this->ifName = (env != nullptr && env[0] != '\0') ? QString(env) : QString(SOCKETCAN_DEFAULT_INTERFACE);
+    const char *env_fd = getenv("FBL_SOCKETCAN_FD");
+    this->fdRequested = env_fd != nullptr && strcmp(env_fd, "1") == 0;
+    this->type = 1; // CAN
+}
+
+/**
+ * Constructor for SocketCAN_Wrapper with a given network interface
+ *
+ * @param ifName Name of the network interface, e.g. can0 or vcan0
+ */
+SocketCAN_Wrapper::SocketCAN_Wrapper(const QString &ifName){
+    this->ifName = ifName;
+    this->type = 1; // CAN
+}
+
+/**
+ * Deconstructor for SocketCAN_Wrapper. Stops the RX Thread and closes the socket.
+ */
+SocketCAN_Wrapper::~SocketCAN_Wrapper(){
+    stopRX();
+
+    bool waitOnStop = true;
+    do{
+        mutex.lock();
+        waitOnStop = _working;
+        mutex.unlock();
+    } while(waitOnStop);
+
+    closeSocket();
+    qInfo() << "SocketCAN_Wrapper: Destructor of SocketCAN_Wrapper finished";
+}
+
+/**
+ * Method to init the driver. Opens a raw CAN socket and binds it to the network interface.
+ *
+ * @return uint8_t 0 if init was successful, 1 if there was an error
+ */
+uint8_t SocketCAN_Wrapper::initDriver(){
+
+    closeSocket();
+
+    sock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if(sock < 0){
+        emit errorPrint("SocketCAN Driver: Could not open CAN socket - " + QString(strerror(errno)));
+        emit driverInit(QString(strerror(errno)));
+        return 1;
+    }
+
+    // Resolve the network interface
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifName.toStdString().c_str(), IFNAMSIZ - 1);
+    if(ioctl(sock, SIOCGIFINDEX, &ifr) < 0){
+        emit errorPrint("SocketCAN Driver: Network interface " + ifName + " not found. Please bring up the interface, e.g. ip link set " + ifName + " up");
+        emit driverInit(QString(strerror(errno)));
+        closeSocket();
+        return 1;
+    }
+
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+        emit errorPrint("SocketCAN Driver: Could not bind to " + ifName + " - " + QString(strerror(errno)));
+        emit driverInit(QString(strerror(errno)));
+        closeSocket();
+        return 1;
+    }
+
+    // CAN FD frames are only passed to sockets that enable them, the interface needs the CAN FD MTU
+    int enable_fd = 1;
+    fdCapable = ioctl(sock, SIOCGIFMTU, &ifr) == 0 && ifr.ifr_mtu == CANFD_MTU
+                && setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable_fd, sizeof(enable_fd)) == 0;
+    setCANFD(fdRequested, 0);
+
+    // Receive timeout, so the RX Thread can check on abort
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = SOCKETCAN_RX_TIMEOUT_MS * 1000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    applyFilter();
+
+    emit infoPrint("SocketCAN Driver: Init successfully on " + ifName + (type == 2 ? " (CAN FD)" : ""));
+    qInfo() << "SocketCAN_Wrapper: Initialization of the driver finished for interface" << ifName;
+    emit driverInit("SocketCAN: " + ifName);
+    return 0;
+}
+
+/**
+ * Method to set the TX ID for the transmission of CAN messages. The ID will be used directly after it is set
+ *
+ * @param id ID for the TX
+ */
+void SocketCAN_Wrapper::setID(uint32_t id){
+    txID = id;
+    if(VERBOSE_SOCKETCAN_DRIVER) qInfo("SocketCAN_Wrapper: TX ID is set to 0x%08X\n", txID);
+}
+
+/**
+ * Method to set the RX filter mask. Messages with ID bits outside of the mask are dropped by the kernel.
+ *
+ * @param mask Filter mask, 0 to receive every message
+ */
+void SocketCAN_Wrapper::setFilterMask(uint32_t mask){
+    this->rxFilterMask = mask;
+    qInfo("SocketCAN_Wrapper: Filter mask is set to 0x%08X\n", rxFilterMask);
+    emit infoPrint("SocketCAN Driver: RX Filter Mask is set to "+QString("0x%8").arg(rxFilterMask, 8, 16, QLatin1Char( '0' )));
+
+    applyFilter();
+}
+
+/**
+ * Transmits given number of bytes of the given data by using CAN
+ *
+ * @param data Given data (Maximal 8 byte array is possible, 64 byte with CAN FD)
+ * @param no_bytes Set the number of bytes to be transmitted (Maximum of 8 byte is possible, 64 byte with CAN FD)
+ * @return 1 if message could be transmitted
+ */
+uint8_t SocketCAN_Wrapper::txData(uint8_t *data, uint8_t no_bytes){
+    QList<QByteArray> frames;
+    frames.append(QByteArray((const char*)data, no_bytes));
+    return txDataBatch(frames);
+}
+
+/**
+ * Transmits the given frames with as few syscalls as possible (sendmmsg)
+ *
+ * @param frames CAN frames to be transmitted in order (Maximum of 8 byte per frame is possible, 64 byte with CAN FD)
+ * @return 1 if all messages could be transmitted
+ */
+uint8_t SocketCAN_Wrapper::txDataBatch(const QList<QByteArray> &frames){
+
+    if(sock < 0){
+        qInfo("SocketCAN_Wrapper: Could not transmit, socket is not open. Init was not successfull");
+        return 0;
+    }
+
+    bool fd = type == 2;
+    for(const QByteArray &frame : frames){
+        if(frame.size() > (fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN)){
+            qInfo() << "SocketCAN_Wrapper: Maximum number of Bytes is" << (fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN);
+            return 0;
+        }
+    }
+    if(VERBOSE_SOCKETCAN_DRIVER) qInfo("SocketCAN_Wrapper: Sending Signal txDataSentRequested");
+    emit txDataSentRequested("SocketCAN_Wrapper: TX requested");
+
+    // struct can_frame is the first part of struct canfd_frame, the MTU passed to the kernel selects the frame type
+    struct canfd_frame cf[SOCKETCAN_TX_BATCH_SIZE];
+    struct iovec iov[SOCKETCAN_TX_BATCH_SIZE];
+    struct mmsghdr msgs[SOCKETCAN_TX_BATCH_SIZE];
+
+    int idx = 0;
+    int retries = 0;
+    while(idx < frames.size()){
+        int batch = frames.size() - idx;
+        if(batch > SOCKETCAN_TX_BATCH_SIZE)
+            batch = SOCKETCAN_TX_BATCH_SIZE;
+
+        memset(cf, 0, sizeof(cf[0]) * batch);
+        memset(msgs, 0, sizeof(msgs[0]) * batch);
+        for(int i = 0; i < batch; i++){
+            const QByteArray &frame = frames[idx + i];
+            cf[i].can_id = (txID & CAN_EFF_MASK) | CAN_EFF_FLAG; // Setting Extended ID Msg
+            cf[i].len = frame.size();
+            cf[i].flags = fd ? CANFD_BRS : 0;           // Data phase with the data bit rate
+            memcpy(cf[i].data, frame.constData(), frame.size());
+
+            iov[i].iov_base = &cf[i];
+            iov[i].iov_len = fd ? CANFD_MTU : CAN_MTU;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int sent = sendmmsg(sock, msgs, batch, 0);
+        if(sent < 0){
+            // TX queue of the interface is full, give the bus time to drain
+            if((errno == ENOBUFS || errno == EAGAIN) && retries < SOCKETCAN_TX_RETRIES){
+                retries++;
+                QThread::usleep(SOCKETCAN_TX_RETRY_WAIT_US);
+                continue;
+            }
+            qInfo() << "<< SocketCAN_Wrapper: Transmitting failed for ID" << QString("0x%1").arg(txID, 8, 16, QLatin1Char( '0' )) << "- Info:" << strerror(errno);
+            emit txDataSentStatus(QString(strerror(errno)));
+            return 0;
+        }
+
+        if(RX_TX_SOCKETCAN_DRIVER){
+            for(int i = 0; i < sent; i++)
+                qInfo() << "<< SocketCAN_Wrapper: Transmitting"<<cf[i].len<<"byte CAN message (Data=" << frames[idx + i].toHex(' ').toStdString() << ") with ID" << QString("0x%1").arg(txID, 8, 16, QLatin1Char( '0' ));
+        }
+
+        idx += sent;
+        retries = 0;
+    }
+
+    if(VERBOSE_SOCKETCAN_DRIVER) qInfo("SocketCAN_Wrapper: Sending Signal txDataSentStatus");
+    emit txDataSentStatus("Success");
+    return 1;
+}
+
+/**
+ * Switches between classic CAN and CAN FD frames for the transmission. CAN FD needs an interface with the CAN FD MTU,
+ * the bit rates are part of the network configuration (see setChannelBaudrate).
+ *
+ * @param enabled true to transmit CAN FD frames with up to 64 bytes
+ * @param data_baudrate Bit rate of the data phase, only used for the hint to configure the interface
+ * @return true if the requested mode is used
+ */
+bool SocketCAN_Wrapper::setCANFD(bool enabled, unsigned int data_baudrate){
+    fdRequested = enabled;
+    if(!enabled){
+        this->type = 1; // CAN
+        return true;
+    }
+
+    if(sock < 0) // Checked on init
+        return true;
+
+    if(!fdCapable){
+        this->type = 1; // CAN
+        emit errorPrint("SocketCAN Driver: " + ifName + " does not support CAN FD, using classic CAN. Please use: ip link set " + ifName
+                        + " type can bitrate 500000 dbitrate " + QString::number(data_baudrate ? data_baudrate : 2000000) + " fd on");
+        return false;
+    }
+
+    this->type = 2; // CAN_FD
+    if(data_baudrate != 0)
+        emit infoPrint("SocketCAN Driver: Data bitrate can not be changed by the application. Please use: ip link set " + ifName
+                       + " type can bitrate 500000 dbitrate " + QString::number(data_baudrate) + " fd on");
+    return true;
+}
+
+//============================================================================
+// Private
+//============================================================================
+
+/**
+ * @brief Closes the socket
+ */
+void SocketCAN_Wrapper::closeSocket(){
+    if(sock >= 0){
+        close(sock);
+        if(DEBUGGING_SOCKETCAN_DRIVER) qInfo() << "SocketCAN_Wrapper: Closed socket for interface" << ifName;
+    }
+    sock = -1;
+}
+
+/**
+ * @brief Installs the kernel receive filter matching the rxFilterMask (see CAN_Wrapper::doRX)
+ * @return 1 if the filter is applied
+ */
+uint8_t SocketCAN_Wrapper::applyFilter(){
+    if(sock < 0)
+        return 0;
+
+    // Accept extended frames only, whose ID has no bits set outside of rxFilterMask
+    struct can_filter filter;
+    filter.can_id = CAN_EFF_FLAG;
+    filter.can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG | (~rxFilterMask & CAN_EFF_MASK);
+    if(rxFilterMask == 0){
+        filter.can_id = 0;
+        filter.can_mask = 0;
+    }
+
+    if(setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter)) < 0){
+        emit errorPrint("SocketCAN Driver: Could not set RX filter - " + QString(strerror(errno)));
+        return 0;
+    }
+    return 1;
+}
+
+//============================================================================
+// Public RX Thread
+//============================================================================
+
+/**
+ * @brief Method for RX Thread. Receiving loop of the SocketCAN Wrapper, fetching up to SOCKETCAN_RX_BATCH_SIZE frames per syscall
+ */
+void SocketCAN_Wrapper::doRX(){
+
+    // Classic CAN frames are received with CAN_MTU, CAN FD frames with CANFD_MTU
+    struct canfd_frame cf[SOCKETCAN_RX_BATCH_SIZE];
+    struct iovec iov[SOCKETCAN_RX_BATCH_SIZE];
+    struct mmsghdr msgs[SOCKETCAN_RX_BATCH_SIZE];
+
+    if(sock >= 0){
+        qInfo("SocketCAN_Wrapper: Starting RX\n");
+
+        while(this->_working) {
+            // Check if thread should be canceled
+            mutex.lock();
+            bool abort = _abort;
+            mutex.unlock();
+
+            if(abort)
+                break;
+
+            memset(msgs, 0, sizeof(msgs));
+            for(int i = 0; i < SOCKETCAN_RX_BATCH_SIZE; i++){
+                iov[i].iov_base = &cf[i];
+                iov[i].iov_len = sizeof(struct canfd_frame);
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            // Blocks until at least one frame is available or SOCKETCAN_RX_TIMEOUT_MS elapsed
+            int received = recvmmsg(sock, msgs, SOCKETCAN_RX_BATCH_SIZE, MSG_WAITFORONE, nullptr);
+            if(received < 0){
+                if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                    continue;
+
+                emit errorPrint("Error: CAN Connection failed. Please connect again.");
+                break;
+            }
+
+            for(int i = 0; i < received; i++){
+                if(msgs[i].msg_len < CAN_MTU || cf[i].len == 0)
+                    continue;
+
+                if(cf[i].can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG))
+                    continue;
+
+                unsigned int id = (cf[i].can_id & CAN_EFF_FLAG) ? (cf[i].can_id & CAN_EFF_MASK) : (cf[i].can_id & CAN_SFF_MASK);
+
+                CANFrame frame;
+                frame.id = id;
+                frame.dlc = cf[i].len > CAN_FRAME_MAX_DLC ? CAN_FRAME_MAX_DLC : cf[i].len;
+                memcpy(frame.data, cf[i].data, frame.dlc);
+
+                if(RX_TX_SOCKETCAN_DRIVER) qInfo() << ">> SocketCAN_Wrapper: Received"<<frame.dlc<<"byte CAN message with Data:" << QByteArray((const char*)frame.data, frame.dlc).toHex(' ').toStdString() << "from"<<QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
+                if(VERBOSE_SOCKETCAN_DRIVER) qInfo() << "SocketCAN_Wrapper: Sending Signal rxFrameReceived for ID" << QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
+
+                emit rxFrameReceived(frame);
+            }
+        }
+    }
+    else{
+        qInfo("SocketCAN_Wrapper: Could not start RX since socket is missing. Init was not successfull");
+    }
+
+    qDebug("SocketCAN_Wrapper: RX Thread stopped");
+    emit rxThreadFinished();
+
+    // Set _working to false, meaning the process can't be aborted anymore.
+    mutex.lock();
+    _working = false;
+    mutex.unlock();
+}
+
+//============================================================================
+// Slots
+//============================================================================
+
+void SocketCAN_Wrapper::setChannelBaudrate(unsigned int baudrate) {
+    // The bitrate of a SocketCAN interface belongs to the network configuration and needs root privileges
+    emit errorPrint("SocketCAN Driver: Bitrate can not be changed by the application. Please use: ip link set " + ifName
+                    + " type can bitrate " + QString::number(baudrate));
+}
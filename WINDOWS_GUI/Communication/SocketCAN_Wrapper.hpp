@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : SocketCAN_Wrapper.hpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Header for Qt CAN Wrapper for Linux SocketCAN (raw AF_CAN sockets)
+//============================================================================
+
+#ifndef SOCKETCAN_WRAPPER_HPP_
+#define SOCKETCAN_WRAPPER_HPP_
+
+#define DEBUGGING_SOCKETCAN_DRIVER  0           // switch for debugging prints
+#define VERBOSE_SOCKETCAN_DRIVER    0           // switch for verbose console information
+#define RX_TX_SOCKETCAN_DRIVER      0           // switch for verbose RX + TX information to console
+
+#define SOCKETCAN_DEFAULT_INTERFACE "can0"      // Network interface if FBL_SOCKETCAN_INTERFACE is not set, e.g. vcan0 for testing
+#define SOCKETCAN_RX_BATCH_SIZE     32          // Max frames fetched by one recvmmsg call
+#define SOCKETCAN_TX_BATCH_SIZE     32          // Max frames handed over by one sendmmsg call
+#define SOCKETCAN_RX_TIMEOUT_MS     10          // Receive timeout to check on abort of the RX Thread
+#define SOCKETCAN_TX_RETRIES        100         // Retries if the TX queue of the interface is full
+#define SOCKETCAN_TX_RETRY_WAIT_US  100         // Wait time between retries if the TX queue is full
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "CommInterface.hpp"
+
+class SocketCAN_Wrapper : public CommInterface {
+
+    // Variables
+    private:
+        QString ifName;                                                     // Name of the network interface, e.g. can0, vcan0
+        int sock                                = -1;                       // Raw CAN socket
+        unsigned int txID                       = 0;                        // TX ID for sending CAN messages
+        bool fdCapable                          = false;                    // Interface is configured for CAN FD (MTU 72)
+        bool fdRequested                        = false;                    // CAN FD requested via FBL_SOCKETCAN_FD=1 or setCANFD
+
+    // Methods
+    public:
+        SocketCAN_Wrapper();
+        SocketCAN_Wrapper(const QString &ifName);
+        ~SocketCAN_Wrapper();
+
+        void setID(uint32_t id) override;
+        void setFilterMask(uint32_t mask) override;
+        uint8_t initDriver() override;
+
+        uint8_t txData(uint8_t *data, uint8_t no_bytes) override;
+        uint8_t txDataBatch(const QList<QByteArray> &frames) override;
+        bool setCANFD(bool enabled, unsigned int data_baudrate) override;
+        void doRX() override;
+
+    private:
+        void closeSocket();
+        uint8_t applyFilter();
+
+    public slots:
+        void setChannelBaudrate(unsigned int baudrate) override;
+};
+
+#endif /* SOCKETCAN_WRAPPER_HPP_ */
@@ -5,35 +5,46 @@
 //============================================================================
 // Name        : Communication.cpp
 // Author      : Michael Bauer Wiktor Pilarczyk
-// Version     : 0.3
+// Version     : 0.8
 // Copyright   : MIT
 // Description : Qt Communication Layer implementation
 //============================================================================
 
-#if defined(_Windows) || defined(_MSC_VER) || defined (__GNUC__)
+#if defined(_WIN32)
  #define  STRICT
  #include <windows.h>
 #endif
 
-#include <QDateTime>
+#include <QElapsedTimer>
+
+#include <string.h>
 
 #include "Communication.hpp"
+#include "../flashtrace.h"
 #include "../UDS_Spec/uds_comm_spec.h"
 
 Communication::Communication(QObject *parent): QObject(parent){
-    curr_interface_type = CAN_DRIVER; // Initial with Virtual Driver
+#if defined(_WIN32)
+    curr_interface_type = CAN_DRIVER; // Initial with Vector CAN Driver
+#else
+    curr_interface_type = SOCKETCAN_DRIVER; // Initial with SocketCAN Driver
+#endif
+    isotp_mode = COMM_ISOTP_LEGACY_ACK ? ISOTP_ACK_CONSECUTIVE_FRAMES : ISOTP_FLOW_CONTROL;
+    for(RXContext &ctx : rx_contexts){
+        ctx.id = 0;
+        ctx.buffer.reserve(MAX_ISOTP_MESSAGE_LEN); // Reassembler does not need to reallocate
+    }
+    rx_context_table.reserve(COMM_RX_CONTEXTS);
+    rx_clock.start();
+    tx_ticket_next = 0;
+    tx_ticket_serving = 0;
+    tx_id_default = 0;
+    tx_curr_id = 0;
     resetMultiFrame();
 
     threadCAN = new QThread();
-    canDriver = new CAN_Wrapper(500000);
-    canDriver->setInterfaceID(1);
-    canDriver->moveToThread(threadCAN);
-    connect(canDriver, SIGNAL(rxStartThreadRequested()), threadCAN, SLOT(start()));
-    connect(threadCAN, SIGNAL(started()), canDriver, SLOT(runThread()));
-    connect(canDriver, SIGNAL(rxThreadFinished()), threadCAN, SLOT(quit()), Qt::DirectConnection);
-    connect(canDriver, SIGNAL(infoPrint(QString)), this, SLOT(consoleForwardInfo(QString)), Qt::DirectConnection);
-    connect(canDriver, SIGNAL(debugPrint(QString)), this, SLOT(consoleForwardDebug(QString)), Qt::DirectConnection);
-    connect(canDriver, SIGNAL(errorPrint(QString)), this, SLOT(consoleForwardError(QString)), Qt::DirectConnection);
+    canDriver = nullptr;
+    createCANDriver(curr_interface_type);
 }
 
 Communication::~Communication() {
@@ -61,13 +72,15 @@ void Communication::init(INTERFACE comm_interface_type){
 
 	uint8_t init_status = 0;
 
-    if(comm_interface_type == CAN_DRIVER){ // Init CanDriver
+    if(isCANInterface(comm_interface_type)){ // Init CanDriver
+        createCANDriver(comm_interface_type);
         init_status = canDriver->initDriver();
         // Connect CAN Driver RX with Communication RX
-        connect(canDriver, SIGNAL(rxDataReceived(unsigned int, QByteArray)), this, SLOT(rxCANDataSlot(unsigned int, QByteArray)), Qt::DirectConnection);
+        connect(canDriver, SIGNAL(rxFrameReceived(CANFrame)), this, SLOT(rxCANFrameSlot(CANFrame)), Qt::DirectConnection);
 
         // Connect Communication TX with CAN Driver TX
         connect(this, SIGNAL(txCANDataSignal(QByteArray)), canDriver, SLOT(txDataSlot(QByteArray)), Qt::DirectConnection);
+        connect(this, SIGNAL(txCANDataBatchSignal(QList<QByteArray>)), canDriver, SLOT(txDataBatchSlot(QList<QByteArray>)), Qt::DirectConnection);
 
         canDriver->setFilterMask((uint32_t)(FBLCAN_BASE_ADDRESS) | 0xFFF0); // Only accept responses from valid ECUs
         canDriver->startRX();
@@ -89,39 +102,279 @@ void Communication::init(INTERFACE comm_interface_type){
 void Communication::setCommunicationType(INTERFACE comm_interface_type){
 
 	this->curr_interface_type = comm_interface_type;
+    if(isCANInterface(comm_interface_type))
+        createCANDriver(comm_interface_type);
     qInfo() << "Communication: Set interface to type " << comm_interface_type;
 }
 
+/**
+ * @brief Method to set the Flow Control handling for transmitted Multiframes
+ * @param mode ISOTP_FLOW_CONTROL follows BS/STmin of the ECU (BS=0: no further Flow Control), ISOTP_ACK_CONSECUTIVE_FRAMES waits on an ACK for every Consecutive Frame
+ */
+void Communication::setISOTPMode(ISOTP_MODE mode){
+
+    this->isotp_mode = mode;
+    qInfo() << "Communication: Set ISO TP mode to " << mode;
+}
+
+/**
+ * @brief Method to get the accumulated time spent waiting on Flow Control and ACK frames
+ * @return Wait statistics since the last reset
+ */
+const WaitStatistics &Communication::getWaitStatistics(){
+    return wait_stats;
+}
+
+/**
+ * @brief Method to reset the wait statistics, e.g. at the start of a flashing session
+ */
+void Communication::resetWaitStatistics(){
+    wait_stats.reset();
+}
+
 /**
  * @brief Method to set the Test Mode for the currently set Communication interface - Used for Testing only
  */
 void Communication::setTestMode(){
-    if(curr_interface_type == CAN_DRIVER){ // CAN Driver
-        canDriver->setTestingAppname();
+#if defined(_WIN32)
+    if(can_driver_type == CAN_DRIVER){ // CAN Driver
+        static_cast<CAN_Wrapper*>(canDriver)->setTestingAppname();
     }
+#endif
 }
 
+#if defined(FBL_SIMULATED_ECU)
+/**
+ * @brief Method to set the modelled bus and flash timing of the simulated ECU - Used for Testing only
+ * @param frame_latency_us Time per frame on the bus in us
+ * @param fd_frame_latency_us Time per CAN FD frame with more than 8 bytes in us
+ * @param timing Erase and program times of the flash
+ */
+void Communication::setSimulationTiming(uint32_t frame_latency_us, uint32_t fd_frame_latency_us, const SimEcuTiming &timing){
+    if(can_driver_type == SIMULATED_ECU_DRIVER){
+        static_cast<SimulatedEcuDriver*>(canDriver)->setFrameLatency(frame_latency_us, fd_frame_latency_us);
+        static_cast<SimulatedEcuDriver*>(canDriver)->setFlashTiming(timing);
+    }
+}
+
+/**
+ * @brief Method to set the number of simulated ECUs on the bus, needs to be called before init - Used for Testing only
+ * @param count Number of ECUs, see SimulatedEcuDriver::setEcuCount
+ */
+void Communication::setSimulatedEcuCount(uint8_t count){
+    if(can_driver_type == SIMULATED_ECU_DRIVER)
+        static_cast<SimulatedEcuDriver*>(canDriver)->setEcuCount(count);
+}
+
+/**
+ * @brief Method to get the simulated ECUs on the bus, e.g. for SimulatedEcuAccess - Used for Testing only
+ * @return Instances of the simulated ECUs, empty for other drivers
+ */
+QList<uint8_t> Communication::getSimulatedEcuInstances(){
+    if(can_driver_type == SIMULATED_ECU_DRIVER)
+        return static_cast<SimulatedEcuDriver*>(canDriver)->getEcuInstances();
+    return QList<uint8_t>();
+}
+#endif
+
 //============================================================================
 // Private
 //============================================================================
 
+/**
+ * @brief Releases all reassembly contexts and resets the Flow Control and ACK state
+ */
 void Communication::resetMultiFrame(){
     multiframe_mutex.lock();
-    multiframe_still_receiving = 0;
-    multiframe_curr_id = 0;
-
-    multiframe_curr_uds_msg_len = 0;
-    multiframe_curr_uds_msg = NULL;
-    multiframe_next_msg_available = 0;
-
-    multiframe_flow_ctr_valid = 0;
-    multiframe_flow_ctr_flag = 0;
-    multiframe_flow_ctr_blocksize = 0;
-    multiframe_flow_ctr_sep_time = 0;
-    multiframe_consecutive_frame_ctr = 0;
+    for(RXContext &ctx : rx_contexts){
+        ctx.id = 0;
+        resetRXContext(&ctx);
+    }
+    rx_context_table.clear();
+    txClearFlowControl();
+    multiframe_cond.wakeAll();
     multiframe_mutex.unlock();
 
-    qInfo() << "Communication: MultiFrame Reset";
+    if(VERBOSE_COMMUNICATION) qInfo() << "Communication: MultiFrame Reset";
+}
+
+/**
+ * @brief Resets the Flow Control and ACK state of a transmitted Multiframe, the reassemblies in progress are not affected
+ */
+void Communication::resetMultiFrameTX(){
+    multiframe_mutex.lock();
+    txClearFlowControl();
+    multiframe_cond.wakeAll();
+    multiframe_mutex.unlock();
+
+    if(VERBOSE_COMMUNICATION) qInfo() << "Communication: MultiFrame TX Reset";
+}
+
+/**
+ * @brief Returns the context of a sender, a context of the pool is assigned on its first frame.
+ *        If the pool is exhausted, the context idle for the longest time is reused. multiframe_mutex needs to be locked.
+ * @param id Sender ID
+ * @return Context of the sender, nullptr if all contexts are receiving a Multiframe
+ */
+Communication::RXContext *Communication::getRXContext(uint32_t id){
+    RXContext *ctx = rx_context_table.value(id, nullptr);
+    if(ctx != nullptr)
+        return ctx;
+
+    qint64 now = rx_clock.elapsed();
+    for(RXContext &candidate : rx_contexts){
+        if(candidate.id == 0){
+            ctx = &candidate;
+            break;
+        }
+        // Idle contexts and reassemblies of senders that stopped sending can be reused
+        bool reusable = candidate.msg_len == 0 || now - candidate.last_frame_ms > COMM_RX_TIMEOUT;
+        if(reusable && (ctx == nullptr || candidate.last_frame_ms < ctx->last_frame_ms))
+            ctx = &candidate;
+    }
+    if(ctx == nullptr)
+        return nullptr;
+
+    if(ctx->id != 0)
+        rx_context_table.remove(ctx->id);
+    ctx->id = id;
+    resetRXContext(ctx);
+    ctx->flow_ctr_valid = 0;
+    ctx->consecutive_frame_ctr = 0;
+    ctx->last_frame_ms = now;
+    rx_context_table.insert(id, ctx);
+    return ctx;
+}
+
+/**
+ * @brief Ends the reassembly of a context, the Flow Control and ACK state is not affected. multiframe_mutex needs to be locked.
+ * @param ctx Context of the sender
+ */
+void Communication::resetRXContext(RXContext *ctx){
+    ctx->msg = NULL;
+    ctx->msg_len = 0;
+    ctx->msg_idx = 0;
+    ctx->sequence = 0;
+}
+
+/**
+ * @brief Checks if a Flow Control or ACK frame belongs to the transmission currently on the bus. multiframe_mutex needs to be locked.
+ * @param id Sender ID
+ * @return true if the ECU ID of the sender is the addressed one, any ECU for a broadcast
+ */
+bool Communication::isFromTXTarget(uint32_t id){
+    uint32_t target = tx_curr_id & FBLCAN_ECU_ID_MASK;
+    return target == 0 || (id & FBLCAN_ECU_ID_MASK) == target;
+}
+
+/**
+ * @brief Looks up a Flow Control of the ECU addressed by the current transmission. multiframe_mutex needs to be locked.
+ * @param flag Flow Status of the Flow Control
+ * @param blocksize Blocksize of the Flow Control
+ * @param sep_time Separation time of the Flow Control
+ * @return 1 if a Flow Control was received, 0 otherwise
+ */
+uint8_t Communication::txFlowControlReceived(uint8_t *flag, uint8_t *blocksize, uint8_t *sep_time){
+    for(const RXContext &ctx : rx_contexts){
+        if(ctx.id != 0 && ctx.flow_ctr_valid && isFromTXTarget(ctx.id)){
+            *flag = ctx.flow_ctr_flag;
+            *blocksize = ctx.flow_ctr_blocksize;
+            *sep_time = ctx.flow_ctr_sep_time;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks if the ECU addressed by the current transmission acknowledged a Consecutive Frame. multiframe_mutex needs to be locked.
+ * @param consecutive_frame_ctr Sequence number of the Consecutive Frame
+ * @return 1 if the ACK was received, 0 otherwise
+ */
+uint8_t Communication::txACKReceived(uint8_t consecutive_frame_ctr){
+    for(const RXContext &ctx : rx_contexts){
+        if(ctx.id != 0 && ctx.consecutive_frame_ctr == consecutive_frame_ctr && isFromTXTarget(ctx.id))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Invalidates the received Flow Control and ACK frames of all senders. multiframe_mutex needs to be locked.
+ */
+void Communication::txClearFlowControl(){
+    for(RXContext &ctx : rx_contexts){
+        ctx.flow_ctr_valid = 0;
+        ctx.flow_ctr_flag = 0;
+        ctx.flow_ctr_blocksize = 0;
+        ctx.flow_ctr_sep_time = 0;
+        ctx.consecutive_frame_ctr = 0;
+    }
+}
+
+/**
+ * @brief Method to check if the given interface is handled as CAN (ISO TP) interface
+ * @param comm_interface_type
+ * @return true for the Vector CAN Driver, SocketCAN and the simulated ECU
+ */
+bool Communication::isCANInterface(INTERFACE comm_interface_type){
+    return comm_interface_type == CAN_DRIVER || comm_interface_type == SOCKETCAN_DRIVER || comm_interface_type == SIMULATED_ECU_DRIVER;
+}
+
+/**
+ * @brief Method to create the CAN Driver instance. Besides the simulated ECU only the CAN Driver of the platform is available
+ *        (Vector XL on Windows, SocketCAN on Linux), other CAN interface types fall back to it.
+ *        An existing CAN Driver of another type is replaced.
+ * @param comm_interface_type
+ */
+void Communication::createCANDriver(INTERFACE comm_interface_type){
+
+#if defined(_WIN32)
+    INTERFACE type = CAN_DRIVER;
+#else
+    INTERFACE type = SOCKETCAN_DRIVER;
+#endif
+#if defined(FBL_SIMULATED_ECU)
+    if(comm_interface_type == SIMULATED_ECU_DRIVER)
+        type = SIMULATED_ECU_DRIVER;
+#endif
+    if(comm_interface_type != type)
+        qInfo() << "Communication: CAN interface type" << comm_interface_type << "is not available on this platform. Using type" << type;
+
+    if(canDriver != nullptr){
+        if(can_driver_type == type)
+            return;
+
+        // Stop and remove the driver of the other type
+        canDriver->stopRX();
+        threadCAN->wait();
+        disconnect(canDriver, nullptr, nullptr, nullptr);
+        disconnect(this, nullptr, canDriver, nullptr);
+        disconnect(threadCAN, nullptr, canDriver, nullptr);
+        delete canDriver;
+        canDriver = nullptr;
+    }
+
+#if defined(FBL_SIMULATED_ECU)
+    if(type == SIMULATED_ECU_DRIVER)
+        canDriver = new SimulatedEcuDriver();
+    else
+#endif
+#if defined(_WIN32)
+    canDriver = new CAN_Wrapper(500000);
+#else
+    canDriver = new SocketCAN_Wrapper();
+#endif
+    can_driver_type = type;
+
+    canDriver->setInterfaceID(1);
+    canDriver->moveToThread(threadCAN);
+    connect(canDriver, SIGNAL(rxStartThreadRequested()), threadCAN, SLOT(start()));
+    connect(threadCAN, SIGNAL(started()), canDriver, SLOT(runThread()));
+    connect(canDriver, SIGNAL(rxThreadFinished()), threadCAN, SLOT(quit()), Qt::DirectConnection);
+    connect(canDriver, SIGNAL(infoPrint(QString)), this, SLOT(consoleForwardInfo(QString)), Qt::DirectConnection);
+    connect(canDriver, SIGNAL(debugPrint(QString)), this, SLOT(consoleForwardDebug(QString)), Qt::DirectConnection);
+    connect(canDriver, SIGNAL(errorPrint(QString)), this, SLOT(consoleForwardError(QString)), Qt::DirectConnection);
 }
 
 /**
@@ -129,7 +382,7 @@ void Communication::resetMultiFrame(){
  * @param id
  */
 void Communication::setID(uint32_t id){
-    if(curr_interface_type == CAN_DRIVER){ // CANDriver
+    if(isCANInterface(curr_interface_type)){ // CANDriver
         canDriver->setID(id);
     }
 }
@@ -140,12 +393,16 @@ void Communication::setID(uint32_t id){
  * @param no_bytes Number of bytes of the given data
  */
 void Communication::txData(uint8_t *data, uint32_t no_bytes) {
-    if(curr_interface_type == CAN_DRIVER) {
+    FlashTraceScope trace("can", "txData");
+    if(trace.active())
+        trace.setArg("bytes", (qint64)no_bytes);
+
+    if(isCANInterface(curr_interface_type)) {
         uint32_t sent_bytes = 0;
 
         uint32_t send_len;
         uint32_t has_next;
-        uint8_t max_len_per_frame = MAX_FRAME_LEN_CAN; // Also use CAN Message Length
+        uint8_t max_len_per_frame = canDriver->getMaxFrameLen(); // 8 bytes for CAN, 64 bytes for CAN FD
         uint32_t data_ptr = 0;
         uint8_t idx = 0;
         uint8_t *send_msg = tx_starting_frame(&send_len, &has_next, max_len_per_frame, data, no_bytes, &data_ptr);
@@ -159,31 +416,29 @@ void Communication::txData(uint8_t *data, uint32_t no_bytes) {
         if(VERBOSE_COMMUNICATION) qInfo("Communication TX: Sending out Data via CAN Driver - Started!");
         if(VERBOSE_COMMUNICATION) qInfo("Communication TX: Sending Signal txCANDataSignal with payload (Single/First Frame)");
 
-        multiframe_flow_ctr_valid = 0;
+        multiframe_mutex.lock();
+        txClearFlowControl();
+        multiframe_mutex.unlock();
         emit txCANDataSignal(qbdata);
         if (has_next) { // Check in flow control and continue sending
-            sent_bytes += send_len - 2;
+            sent_bytes = data_ptr; // Payload of the First Frame
             qInfo() << "Communication TX: Number of Bytes" << no_bytes;
 
             // Wait on flow control...
-            QDateTime start = QDateTime::currentDateTime();
-            uint8_t flow_ctr_valid = 0;
-            do{
-                multiframe_mutex.lock();
-                flow_ctr_valid = multiframe_flow_ctr_valid;
-                multiframe_mutex.unlock();
+            uint8_t blocksize = 0;
+            uint8_t sep_time = 0;
+            if(!txWaitOnFlowControl(&blocksize, &sep_time))
+                return;
 
-                if(start.msecsTo(QDateTime::currentDateTime()) > COMM_FLOW_CTR_WAIT){
-                    qInfo() << "Communication: ERROR - No Flow Control received";
-                    toConsole("Communication: ERROR - No Flow Control received");
-                    resetMultiFrame();
-                    return;
-                }
-            } while(!flow_ctr_valid);
+            // Old bootloaders acknowledge every Consecutive Frame, their Flow Control (BS=0, STmin=0) cannot be told apart from a standard one
+            uint8_t ack_mode = isotp_mode == ISOTP_ACK_CONSECUTIVE_FRAMES;
+            if(VERBOSE_COMMUNICATION) qInfo() << "Communication TX: Flow Control BS=" << blocksize << "STmin=" << sep_time << (ack_mode ? "(ACK mode)" : "(Flow Control mode)");
 
+            uint8_t block_ctr = 0;
+            QList<QByteArray> block_frames;         // Consecutive Frames of the current block without separation time
             while(has_next) {
                 send_msg = tx_consecutive_frame(&send_len, &has_next, max_len_per_frame, data, no_bytes, &data_ptr, &idx);
-                sent_bytes += send_len - 1;
+                sent_bytes = data_ptr; // Padding of the last CAN FD frame is not counted
                 // Wrap data into QByteArray for signaling
                 qbdata.clear();
                 qbdata.resize(send_len);
@@ -192,26 +447,71 @@ void Communication::txData(uint8_t *data, uint32_t no_bytes) {
                 // Free the allocated memory of msg
                 free(send_msg);
 
+                if(!ack_mode){
+                    // Stream the block, only the last Consecutive Frame of a block needs to wait for the next Flow Control
+                    block_ctr++;
+                    uint8_t end_of_block = blocksize > 0 && block_ctr >= blocksize && has_next;
+                    // Without separation time the frames of a block are handed over to the driver at once
+                    if(sep_time == 0){
+                        block_frames.append(qbdata);
+                        if(!end_of_block && has_next)
+                            continue;
+                    }
+
+                    if(end_of_block){
+                        multiframe_mutex.lock();
+                        txClearFlowControl(); // Reset before sending, Flow Control can arrive before emit returns
+                        multiframe_mutex.unlock();
+                    }
+
+                    if(sep_time == 0){
+                        if(VERBOSE_COMMUNICATION) qInfo() << "Communication TX: Sending Signal txCANDataBatchSignal with" << block_frames.size() << "Consecutive Frames";
+                        emit txCANDataBatchSignal(block_frames);
+                        block_frames.clear();
+                    }
+                    else{
+                        if(VERBOSE_COMMUNICATION) qInfo("Communication TX: Sending Signal txCANDataSignal with payload (Consecutive Frame)");
+                        emit txCANDataSignal(qbdata);
+                    }
+
+                    if(end_of_block){
+                        block_ctr = 0;
+                        if(!txWaitOnFlowControl(&blocksize, &sep_time))
+                            return;
+                    }
+                    else if(has_next){
+                        txWaitSeparationTime(sep_time);
+                    }
+                    continue;
+                }
+
                 // Wait on ACK for Consecutive Frame...
                 uint8_t consecutive_frame_ctr = idx;
                 uint8_t consecutive_frame_valid = 0;
                 for(int i = 0; !consecutive_frame_valid && i < COMM_CONSEC_RETRIES; i++){
-                    start = QDateTime::currentDateTime();
+                    WaitStatisticsScope scope(&wait_stats);
+                    FlashTraceScope trace("wait", "ACK wait");
+                    QElapsedTimer timer;
+                    timer.start();
                     if(VERBOSE_COMMUNICATION) qInfo("Communication TX: Sending Signal txCANDataSignal with payload (Consecutive Frame)");
                     emit txCANDataSignal(qbdata);
 
-                    do {
-                        multiframe_mutex.lock();
-                        consecutive_frame_valid = multiframe_consecutive_frame_ctr == consecutive_frame_ctr;
-                        multiframe_mutex.unlock();
-
-                        if(start.msecsTo(QDateTime::currentDateTime()) > COMM_CONSEC_WAIT){
-                            qInfo() << "Communication TX: ERROR - Could not receive ACK for Consecutive Frame No"<<QString::number(consecutive_frame_ctr);
-                            toConsole("Communication TX: ERROR - Could not receive ACK for Consecutive Frame No "+QString::number(consecutive_frame_ctr));
-                            resetMultiFrame();
-                            return;
-                        }
-                    } while(!consecutive_frame_valid);
+                    // Sleeps until handleCANEvent signals the ACK
+                    multiframe_mutex.lock();
+                    while(!txACKReceived(consecutive_frame_ctr)){
+                        qint64 remaining = COMM_CONSEC_WAIT - timer.elapsed();
+                        if(remaining <= 0 || !multiframe_cond.wait(&multiframe_mutex, remaining))
+                            break;
+                    }
+                    consecutive_frame_valid = txACKReceived(consecutive_frame_ctr);
+                    multiframe_mutex.unlock();
+
+                    if(!consecutive_frame_valid){
+                        qInfo() << "Communication TX: ERROR - Could not receive ACK for Consecutive Frame No"<<QString::number(consecutive_frame_ctr);
+                        toConsole("Communication TX: ERROR - Could not receive ACK for Consecutive Frame No "+QString::number(consecutive_frame_ctr));
+                        resetMultiFrameTX();
+                        return;
+                    }
                 }
             }
              qInfo() << "Communication TX: Sent" << QString::number(sent_bytes)<<"bytes. No of Bytes from Method call: "<<QString::number(no_bytes);
@@ -220,29 +520,99 @@ void Communication::txData(uint8_t *data, uint32_t no_bytes) {
     if(VERBOSE_COMMUNICATION) qInfo("Communication TX: Sending out Data via CAN Driver - Finished!");
 }
 
-
 /**
- * @brief Internal Method to process ISO TP data for Multiframe Data (Starting Frame + Consecutive Frames)
+ * @brief Internal Method to wait on a Flow Control Frame with Flow Status Continue To Send
+ * @param blocksize Blocksize of the received Flow Control
+ * @param sep_time Separation time of the received Flow Control
+ * @return 1 if sending can be continued, 0 on timeout, overflow or too many WAIT frames
  */
-void Communication::dataReceiveHandleMulti(){
+uint8_t Communication::txWaitOnFlowControl(uint8_t *blocksize, uint8_t *sep_time){
 
-    if(multiframe_still_receiving && !multiframe_next_msg_available && multiframe_curr_uds_msg != NULL){
-        QByteArray ba;
-        ba.resize(multiframe_curr_uds_msg_len);
-        for(unsigned int i = 0; i < multiframe_curr_uds_msg_len; i++)
-            ba[i] = multiframe_curr_uds_msg[i];
-        const unsigned int id_ba = multiframe_curr_id;
+    WaitStatisticsScope scope(&wait_stats);
+    FlashTraceScope trace("wait", "Flow Control wait");
 
-        // Debugging
-        _debug_printf_isotp_buffer();
+    for(int wait_frames = 0; wait_frames <= COMM_FLOW_CTR_WAIT_MAX; wait_frames++){
+        QElapsedTimer timer;
+        timer.start();
 
-        // Emit Signal
-        if(VERBOSE_COMMUNICATION) qInfo("Communication RX: Sending Signal rxDataReceived for Multi Frame");
-        emit rxDataReceived(id_ba, ba);
+        // Sleeps until handleCANEvent signals the Flow Control
+        uint8_t flow_ctr_flag = 0;
+        multiframe_mutex.lock();
+        uint8_t flow_ctr_valid = txFlowControlReceived(&flow_ctr_flag, blocksize, sep_time);
+        while(!flow_ctr_valid){
+            qint64 remaining = COMM_FLOW_CTR_WAIT - timer.elapsed();
+            if(remaining <= 0 || !multiframe_cond.wait(&multiframe_mutex, remaining))
+                break;
+            flow_ctr_valid = txFlowControlReceived(&flow_ctr_flag, blocksize, sep_time);
+        }
+        multiframe_mutex.unlock();
+
+        if(!flow_ctr_valid){
+            qInfo() << "Communication: ERROR - No Flow Control received";
+            toConsole("Communication: ERROR - No Flow Control received");
+            resetMultiFrameTX();
+            return 0;
+        }
+
+        if(flow_ctr_flag == ISOTP_FC_FLAG_CONTINUE_TO_SEND)
+            return 1;
+
+        if(flow_ctr_flag == ISOTP_FC_FLAG_OVERFLOW){
+            qInfo() << "Communication: ERROR - Flow Control reported overflow";
+            toConsole("Communication: ERROR - Flow Control reported overflow");
+            resetMultiFrameTX();
+            return 0;
+        }
 
-        // Reset multiframe variables
-        resetMultiFrame();
+        // ISOTP_FC_FLAG_WAIT: Receiver is not ready yet, wait for the next Flow Control
+        multiframe_mutex.lock();
+        txClearFlowControl();
+        multiframe_mutex.unlock();
     }
+
+    qInfo() << "Communication: ERROR - Too many Flow Control WAIT frames received";
+    toConsole("Communication: ERROR - Too many Flow Control WAIT frames received");
+    resetMultiFrameTX();
+    return 0;
+}
+
+/**
+ * @brief Internal Method to wait the Separation Time minimum (STmin) between two Consecutive Frames
+ * @param sep_time STmin as received in the Flow Control Frame
+ */
+void Communication::txWaitSeparationTime(uint8_t sep_time){
+    if(sep_time == 0)
+        return;
+
+    FlashTraceScope trace("wait", "Separation time");
+    if(sep_time <= 0x7F)
+        QThread::msleep(sep_time);                      // 0x00..0x7F: 0..127 ms
+    else if(sep_time >= 0xF1 && sep_time <= 0xF9)
+        QThread::usleep((sep_time & 0x0F) * 100);       // 0xF1..0xF9: 100..900 us
+    else
+        QThread::msleep(0x7F);                          // Reserved values: Use the longest STmin
+}
+
+/**
+ * @brief Internal Method to hand out a completely received Multiframe (Starting Frame + Consecutive Frames).
+ *        multiframe_mutex needs to be locked, it is released while the receivers are called.
+ * @param ctx Context of the sender
+ */
+void Communication::dataReceiveHandleMulti(RXContext *ctx){
+    const unsigned int id_ba = ctx->id;
+
+    // Debugging
+    _debug_printf_isotp_buffer(ctx);
+
+    // Reset before emitting, the receivers can answer and the next First Frame of the sender reuses the context
+    resetRXContext(ctx);
+
+    // Emit Signal, receivers share the buffer. It is only copied if a receiver keeps it until the next First Frame of the sender
+    if(VERBOSE_COMMUNICATION) qInfo("Communication RX: Sending Signal rxDataReceived for Multi Frame");
+    QByteArray buffer = ctx->buffer;
+    multiframe_mutex.unlock();
+    emit rxDataReceived(id_ba, buffer);
+    multiframe_mutex.lock();
 }
 
 /**
@@ -251,107 +621,191 @@ void Communication::dataReceiveHandleMulti(){
  * @param dlc Sender Data Length Code of the data
  * @param data Sender Data
  */
-void Communication::handleCANEvent(unsigned int id, unsigned short dlc, unsigned char data[]){
+void Communication::handleCANEvent(unsigned int id, unsigned short dlc, const uint8_t *data){
     if(dlc == 0){ // Ignoring Empty Messages
         return;
     }
 
-    uint8_t starting_frame = rx_is_starting_frame(data, dlc, MAX_FRAME_LEN_CAN);
+    uint8_t starting_frame = rx_is_starting_frame(data, dlc);
     if(starting_frame){
-        uint32_t temp_uds_msg_len = 0;
-        uint32_t temp_next_msg_available = 0;
-        uint8_t* temp_uds_msg = rx_starting_frame(&temp_uds_msg_len, &temp_next_msg_available, MAX_FRAME_LEN_CAN, data, dlc);
-
-        if(!temp_next_msg_available){ // Single Frame
-            QByteArray ba;
-            ba.resize(temp_uds_msg_len);
-            for(unsigned int i = 0; i < temp_uds_msg_len; i++)
-                ba[i] = temp_uds_msg[i];
+        if(rx_is_single_Frame(data, dlc)){ // Single Frame
+            // CAN FD frames with more than 8 bytes use the escape sequence, length in the second byte
+            uint32_t sf_pci_len = 1;
+            uint32_t sf_len = data[0] & 0x0F;
+            if(sf_len == 0 && dlc > MAX_FRAME_LEN_CAN){
+                sf_pci_len = 2;
+                sf_len = data[1];
+            }
+            if(sf_len > (uint32_t)(dlc - sf_pci_len))
+                sf_len = dlc - sf_pci_len;
+
+            // Buffer is reused, data() only detaches if a receiver kept the last Single Frame
+            singleframe_buffer.resize(sf_len);
+            memcpy(singleframe_buffer.data(), data + sf_pci_len, sf_len);
             const unsigned int id_ba = id;
 
             // Emit Signal
             if(VERBOSE_COMMUNICATION) qInfo("Communication RX: Sending Signal rxDataReceived for Single Frame");
-            emit rxDataReceived(id_ba, ba);
+            emit rxDataReceived(id_ba, singleframe_buffer);
         }
 
         else {
-            if(multiframe_curr_id != 0 && id != multiframe_curr_id){ // Ignore other IDs
-                if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Ignoring ID"<<id<<". Still processing communication with "<<multiframe_curr_id;
-                emit toConsole("Communication RX: Ignoring ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ". Still processing communication with " + QString("0x%1").arg(multiframe_curr_id, 8, 16, QLatin1Char( '0' )));
-                return;
-            }
             //qInfo("Call of Starting Frame\n");
             if(VERBOSE_COMMUNICATION) qInfo("Communication RX: Found ISO-TP First Frame. Waiting to receive other Frames");
 
+            if(dlc < 2)
+                return;
+
+            // Messages longer than 4095 bytes use the escape sequence with 32 bit length
+            uint32_t ff_pci_len = 2;
+            uint32_t ff_len = ((uint32_t)(data[0] & 0x0F) << 8) | data[1];
+            if(ff_len == 0 && dlc >= 6){
+                ff_pci_len = 6;
+                ff_len = ((uint32_t)data[2] << 24) | ((uint32_t)data[3] << 16) | ((uint32_t)data[4] << 8) | data[5];
+            }
+            if(ff_len > MAX_ISOTP_MESSAGE_LEN){
+                emit toConsole("Communication RX: Ignoring First Frame with " + QString::number(ff_len) + " bytes from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ", exceeds the ISO TP buffer");
+                return;
+            }
+            uint32_t ff_payload = (uint32_t)dlc - ff_pci_len;
+            if(ff_payload > ff_len)
+                ff_payload = ff_len;
+
+            // Every sender is reassembled in its own context, a new First Frame restarts the reassembly of the sender
             multiframe_mutex.lock();
-            multiframe_still_receiving = 1;
-            multiframe_curr_id = id;
-            multiframe_curr_uds_msg = temp_uds_msg;
-            multiframe_curr_uds_msg_idx = 6; // First 6 bytes contained in First Frame
-            multiframe_curr_uds_msg_len = temp_uds_msg_len;
-            multiframe_next_msg_available = temp_next_msg_available;
-            multiframe_mutex.unlock();
+            RXContext *ctx = getRXContext(id);
+            if(ctx == nullptr){
+                multiframe_mutex.unlock();
+                if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Ignoring First Frame from ID"<<id<<". All reassembly contexts are in use";
+                emit toConsole("Communication RX: Ignoring First Frame from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ". All " + QString::number(COMM_RX_CONTEXTS) + " reassembly contexts are in use");
+                return;
+            }
+
+            // Reassembler owns the buffer, data() only detaches if a receiver kept the last message of the sender
+            ctx->buffer.resize(ff_len);
+            ctx->msg = (uint8_t*)ctx->buffer.data();
+            memcpy(ctx->msg, data + ff_pci_len, ff_payload);
+
+            ctx->msg_idx = ff_payload; // Payload of the First Frame (6 bytes for CAN)
+            ctx->msg_len = ff_len;
+            ctx->sequence = 0;
+            ctx->last_frame_ms = rx_clock.elapsed();
 
             // Debugging
-            _debug_printf_isotp_buffer();
+            _debug_printf_isotp_buffer(ctx);
+            multiframe_mutex.unlock();
         }
         return;
     }
 
-    uint8_t consecutive_frame = rx_is_consecutive_frame(data, dlc, MAX_FRAME_LEN_CAN);
+    uint8_t consecutive_frame = rx_is_consecutive_frame(data, dlc);
     if(consecutive_frame){
-        if(multiframe_curr_id && id != multiframe_curr_id){ // Ignore other IDs
-            if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Ignoring Consecutive Frame from ID"<<id<<". Still processing communication with "<<multiframe_curr_id;
-            emit toConsole("Communication RX: Ignoring Consecutive Frame from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ". Still processing communication with " + QString("0x%1").arg(multiframe_curr_id, 8, 16, QLatin1Char( '0' )));
-            return;
-        }
         if(VERBOSE_COMMUNICATION) qInfo() << "Communication RX: Found ISO-TP Consecutive Frame with DLC "<<dlc;
 
-        // Check on ACK for Consecutive Frame
+        multiframe_mutex.lock();
+
+        // Check on ACK for Consecutive Frame, only from the ECU of the current transmission
         if(dlc == 1){
-            multiframe_consecutive_frame_ctr = data[0] & 0x0F;
-            if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Received ACK for Consecutive Frame No"<< QString::number(multiframe_consecutive_frame_ctr);
+            if(!isFromTXTarget(id)){
+                multiframe_mutex.unlock();
+                if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Ignoring ACK from ID"<<id<<". Transmitting to "<<tx_curr_id;
+                return;
+            }
+            RXContext *ctx = getRXContext(id);
+            if(ctx != nullptr){
+                ctx->consecutive_frame_ctr = data[0] & 0x0F;
+                ctx->last_frame_ms = rx_clock.elapsed();
+                multiframe_cond.wakeAll();
+            }
+            multiframe_mutex.unlock();
+            if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Received ACK for Consecutive Frame No"<< QString::number(data[0] & 0x0F);
             return;
         }
 
-        multiframe_mutex.lock();
-        multiframe_still_receiving = 1;
+        RXContext *ctx = rx_context_table.value(id, nullptr);
+        if(ctx == nullptr || ctx->msg_len == 0){ // No First Frame received from this ID
+            multiframe_mutex.unlock();
+            if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Ignoring Consecutive Frame from ID"<<id<<". No Multiframe is received from this ID";
+            emit toConsole("Communication RX: Ignoring Consecutive Frame from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ". No Multiframe is received from this ID");
+            return;
+        }
+
+        // Sender stopped sending for longer than N_Cr, the rest of the Multiframe is lost
+        qint64 now = rx_clock.elapsed();
+        if(now - ctx->last_frame_ms > COMM_RX_TIMEOUT){
+            resetRXContext(ctx);
+            multiframe_mutex.unlock();
+            emit toConsole("Communication RX: ERROR - Timeout of the Multiframe from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ". Consecutive Frame is ignored");
+            return;
+        }
+
+        // Sequence numbers count up to 15 and continue with 1 (see tx_consecutive_frame), 0 is accepted as well
+        uint8_t sequence = data[0] & 0x0F;
+        uint8_t expected = (ctx->sequence + 1) & 0x0F;
+        if(sequence != expected && !(ctx->sequence == 0x0F && sequence == 1)){
+            resetRXContext(ctx);
+            multiframe_mutex.unlock();
+            emit toConsole("Communication RX: ERROR - Wrong sequence number " + QString::number(sequence) + " instead of " + QString::number(expected)
+                           + " from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ". Multiframe is dropped");
+            return;
+        }
+        ctx->sequence = sequence;
+        ctx->last_frame_ms = now;
+
+        uint32_t has_next = 0;
+        if(!rx_consecutive_frame(&ctx->msg_len, ctx->msg, &has_next, dlc, data, &ctx->msg_idx)){
+            resetRXContext(ctx);
+            multiframe_mutex.unlock();
+            emit toConsole("Communication RX: ERROR - Consecutive Frame from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + " exceeds the length of the Multiframe");
+            return;
+        }
+        if(!has_next)
+            this->dataReceiveHandleMulti(ctx);
         multiframe_mutex.unlock();
-        rx_consecutive_frame(&multiframe_curr_uds_msg_len, multiframe_curr_uds_msg, &multiframe_next_msg_available, dlc, data, &multiframe_curr_uds_msg_idx);
-        this->dataReceiveHandleMulti();
         return;
     }
 
-    uint8_t flow_control_frame = rx_is_flow_control_frame(data, dlc, MAX_FRAME_LEN_CAN);
+    uint8_t flow_control_frame = rx_is_flow_control_frame(data, dlc);
     if(flow_control_frame){
-        if(multiframe_curr_id && id != multiframe_curr_id){ // Ignore other IDs
-            if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Ignoring Flow Control from ID"<<id<<". Still processing communication with "<<multiframe_curr_id;
-            emit toConsole("Communication RX: Ignoring Flow Control from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ". Still processing communication with " + QString("0x%1").arg(multiframe_curr_id, 8, 16, QLatin1Char( '0' )));
+        multiframe_mutex.lock();
+        if(!isFromTXTarget(id)){ // Ignore ECUs not addressed by the current transmission
+            uint32_t target = tx_curr_id;
+            multiframe_mutex.unlock();
+            if(VERBOSE_COMMUNICATION) qInfo()<<"Communication RX: Ignoring Flow Control from ID"<<id<<". Transmitting to "<<target;
+            emit toConsole("Communication RX: Ignoring Flow Control from ID" + QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' )) + ". Transmitting to " + QString("0x%1").arg(target, 8, 16, QLatin1Char( '0' )));
             return;
         }
         if(VERBOSE_COMMUNICATION) qInfo() << "Communication RX: Found ISO-TP Flow Control Frame with DLC "<<dlc;
 
-        multiframe_mutex.lock();
-        multiframe_flow_ctr_flag = data[0] & 0x3;
-        multiframe_flow_ctr_blocksize = data[1];
-        multiframe_flow_ctr_sep_time = data[2];
-        multiframe_flow_ctr_valid = 1;
+        RXContext *ctx = getRXContext(id);
+        if(ctx != nullptr){
+            ctx->flow_ctr_flag = data[0] & 0x3;
+            ctx->flow_ctr_blocksize = data[1];
+            ctx->flow_ctr_sep_time = data[2];
+            ctx->flow_ctr_valid = 1;
+            ctx->last_frame_ms = rx_clock.elapsed();
+            multiframe_cond.wakeAll();
+        }
         multiframe_mutex.unlock();
         return;
     }
 }
 
 /**
- * @brief Internal Method to print the current ISO TP buffer content
+ * @brief Internal Method to print the ISO TP buffer content of a sender
+ * @param ctx Context of the sender
  */
-void Communication::_debug_printf_isotp_buffer(){
-    if(multiframe_curr_uds_msg != NULL && multiframe_curr_uds_msg_len > 0){
-        QString s = "Communication RX: Current ISO-TP Data:";
-        for(unsigned int i = 0; i < multiframe_curr_uds_msg_len; i ++){
-            s.append(" "+ QString("%1").arg(uint8_t(multiframe_curr_uds_msg[i]), 2, 16, QLatin1Char( '0' )));
+void Communication::_debug_printf_isotp_buffer(const RXContext *ctx){
+    if(!VERBOSE_COMMUNICATION)
+        return;
+
+    if(ctx->msg != NULL && ctx->msg_len > 0){
+        QString s = "Communication RX: Current ISO-TP Data of ID " + QString("0x%1").arg(ctx->id, 8, 16, QLatin1Char( '0' )) + ":";
+        for(unsigned int i = 0; i < ctx->msg_len; i ++){
+            s.append(" "+ QString("%1").arg(uint8_t(ctx->msg[i]), 2, 16, QLatin1Char( '0' )));
         }
 
-        s.append(" - IDX: "+ QString::number(multiframe_curr_uds_msg_idx));
+        s.append(" - IDX: "+ QString::number(ctx->msg_idx));
 
         if(VERBOSE_COMMUNICATION) qInfo() << s.trimmed().toStdString();
     }
@@ -361,24 +815,22 @@ void Communication::_debug_printf_isotp_buffer(){
 // Slots
 //============================================================================
 
-void Communication::rxCANDataSlot(const unsigned int id, const QByteArray &ba){
+void Communication::rxCANFrameSlot(const CANFrame &frame){
     // Real processing
-    if(curr_interface_type != CAN_DRIVER) // CAN_DRIVER message are ignored if a diff interface is selected
+    if(!isCANInterface(curr_interface_type)) // CAN Driver messages are ignored if a diff interface is selected
         return;
 
-    if(VERBOSE_COMMUNICATION) qInfo("Communication RX: Slot - Received RX CAN Data to be processed");
-    uint8_t* data = (uint8_t*)calloc(ba.size(), sizeof(uint8_t));
-    if(data != nullptr){
-        QString bytes_data = "";
-        for(int i = 0; i < ba.size(); i++){
-            data[i] = ba[i];
-            bytes_data.append(QString("%1").arg(uint8_t(data[i]), 2, 16, QLatin1Char( '0' )) + " ");
+    if(VERBOSE_COMMUNICATION) qInfo() << "Communication RX: rxCANFrameSlot received data"<<QByteArray((const char*)frame.data, frame.dlc).toHex(' ')<<" from ID"<<QString("0x%1").arg(frame.id, 8, 16, QLatin1Char( '0' ));
+    this->handleCANEvent(frame.id, frame.dlc, frame.data);
+}
 
-        }
-        if(VERBOSE_COMMUNICATION) qInfo() << "Communication RX: rxCANDataSlot extracted data"<<bytes_data.trimmed()<<" from ID"<<QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
-        this->handleCANEvent(id, ba.size(), data);
-        free(data);
-    }
+void Communication::rxCANDataSlot(const unsigned int id, const QByteArray &ba){
+    // Real processing
+    if(!isCANInterface(curr_interface_type)) // CAN Driver messages are ignored if a diff interface is selected
+        return;
+
+    if(VERBOSE_COMMUNICATION) qInfo() << "Communication RX: rxCANDataSlot received data"<<ba.toHex(' ')<<" from ID"<<QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
+    this->handleCANEvent(id, ba.size(), (const uint8_t*)ba.constData());
 }
 
 void Communication::txDataSlot(const QByteArray &data){
@@ -391,23 +843,57 @@ void Communication::txDataSlot(const QByteArray &data){
             msg[i] = data[i];
             //qInfo() << "Step " << i << "Data: " << msg[i];
         }
+
+        // Wait for the turn of this transmission, several sessions alternate message by message (e.g. Transfer Data)
+        tx_mutex.lock();
+        uint32_t ticket = tx_ticket_next++;
+        while(ticket != tx_ticket_serving)
+            tx_cond.wait(&tx_mutex);
+        uint32_t id = tx_ids.value(QThread::currentThreadId(), tx_id_default);
+        tx_mutex.unlock();
+
+        multiframe_mutex.lock();
+        tx_curr_id = id;
+        multiframe_mutex.unlock();
+        this->setID(id);
         this->txData(msg, data.size());
         free(msg);
+
+        tx_mutex.lock();
+        tx_ticket_serving++;
+        tx_cond.wakeAll();
+        tx_mutex.unlock();
     }
 }
 
 void Communication::setIDSlot(uint32_t id){
     if(VERBOSE_COMMUNICATION) qInfo("Communication TX: Slot - Received setID");
-    this->setID(id);
+
+    // Set with the next transmission of the thread, the ID of a transmission in progress must not change
+    tx_mutex.lock();
+    Qt::HANDLE thread_id = QThread::currentThreadId();
+    if(!tx_ids.contains(thread_id)){
+        // Remove the ID when the worker thread finishes, a later thread may get the same handle
+        connect(QThread::currentThread(), &QThread::finished, this, [this, thread_id](){
+            tx_mutex.lock();
+            tx_ids.remove(thread_id);
+            tx_mutex.unlock();
+        }, Qt::DirectConnection);
+    }
+    tx_ids[thread_id] = id;
+    tx_id_default = id;
+    tx_mutex.unlock();
 }
 
 void Communication::setBaudrate(unsigned int baudrate, unsigned int commType) {
     if (commType == 1) { //CAN
+        canDriver->setCANFD(false, 0);
         connect(this, SIGNAL(baudrateSignal(unsigned int)), canDriver, SLOT(setChannelBaudrate(unsigned int)), Qt::DirectConnection);
         emit baudrateSignal(baudrate);
         disconnect(this, SIGNAL(baudrateSignal(unsigned int)), canDriver, SLOT(setChannelBaudrate(unsigned int)));
     } else if (commType == 2) { //CAN-FD
-        //TODO has to be changed as soon as we have CAN-FD implemented
+        // Nominal bit rate stays, the given bit rate is used for the data phase
+        canDriver->setCANFD(true, baudrate);
     } else if (commType == 3){ //ethernet
         //need commInterface instance for default implementation
     }
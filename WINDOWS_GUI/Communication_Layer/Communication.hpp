@@ -4,7 +4,7 @@
 //============================================================================
 // Name        : Communication.hpp
 // Author      : Michael Bauer
-// Version     : 0.2
+// Version     : 0.6
 // Copyright   : MIT
 // Description : Qt Communication Layer implementation
 //============================================================================
@@ -16,46 +16,88 @@
 #include <QThread>
 #include <QDebug>
 #include <QByteArray>
+#include <QElapsedTimer>
 #include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QWaitCondition>
 
 #include <stdint.h>
 
-#include "../Communication/Can_Wrapper.hpp"
+#include "../Communication/CommInterface.hpp"
+#if defined(_WIN32)
+ #include "../Communication/Can_Wrapper.hpp"
+#endif
+#if defined(__linux__)
+ #include "../Communication/SocketCAN_Wrapper.hpp"
+#endif
+#if defined(FBL_SIMULATED_ECU)
+ #include "../Communication/SimulatedEcuDriver.hpp"
+#endif
+#include "../waitstatistics.h"
 
 #define VERBOSE_COMMUNICATION               0      // switch for verbose console information
+#define COMM_ISOTP_LEGACY_ACK               0      // 1 = ACK for every Consecutive Frame (bootloaders built with ISOTP_RX_MODE_ACK), 0 = ISO 15765-2 Flow Control
 
 #define COMM_INTERFACE_CAN					(0x1)
+#define COMM_INTERFACE_SOCKETCAN            (0x2)
+#define COMM_INTERFACE_SIMULATED_ECU        (0x3)
 #define COMM_FLOW_CTR_WAIT                  (300)  // Waittime for FlowControl Frame in ms
 #define COMM_CONSEC_RETRIES                 (10)   // Max Tries for Consecutive Frame
 #define COMM_CONSEC_WAIT                    (300)  // Waittime for Consecutive Frame in ms
+#define COMM_FLOW_CTR_WAIT_MAX              (10)   // Max number of accepted Flow Control WAIT frames per block
+#define COMM_RX_CONTEXTS                    (16)   // Preallocated reassembly contexts, Multiframes of this many senders are received at the same time
+#define COMM_RX_TIMEOUT                     (1000) // Max time between two frames of a received Multiframe in ms (N_Cr)
 
 class Communication : public QObject{
     Q_OBJECT
 
 public:
-    enum INTERFACE {CAN_DRIVER = COMM_INTERFACE_CAN};
+    enum INTERFACE {CAN_DRIVER = COMM_INTERFACE_CAN, SOCKETCAN_DRIVER = COMM_INTERFACE_SOCKETCAN, SIMULATED_ECU_DRIVER = COMM_INTERFACE_SIMULATED_ECU};
+    enum ISOTP_MODE {ISOTP_FLOW_CONTROL, ISOTP_ACK_CONSECUTIVE_FRAMES};
 
 private:
     QThread *threadCAN;                         // Thread for the CAN Driver
-    CAN_Wrapper* canDriver;                     // Instance of the CAN Driver
+    CommInterface* canDriver;                   // Instance of the CAN Driver (Vector XL, SocketCAN or simulated ECU)
+    INTERFACE can_driver_type;                  // Type of the created CAN Driver instance
 
     INTERFACE curr_interface_type;
-
-    // Used for consecutive frames
-    uint32_t multiframe_curr_id;                // ECU ID of the currently processed Multiframe
-    uint8_t *multiframe_curr_uds_msg;           // Pointer to currently process UDS Multiframe message
-    uint32_t multiframe_curr_uds_msg_len;       // Length of the UDS Multiframe message
-    uint32_t multiframe_curr_uds_msg_idx;       // UDS Multiframe message index of the data, starting idx for writing to multiframe_curr_uds_msg
-    uint32_t multiframe_next_msg_available;     // Indicates if next frame is available
-    uint8_t multiframe_still_receiving;         // Indicates that Multiframe receiving is still ongoing, used as Trigger for final Frame of the Multiframe message
-
-    QMutex multiframe_mutex;
-    uint8_t multiframe_flow_ctr_valid;          // Flag for checking if Flow Control Frame is received
-    uint8_t multiframe_flow_ctr_flag;           // Store flag of last received Flow Control Frame
-    uint8_t multiframe_flow_ctr_blocksize;      // Store blocksize of last received Flow Control Frame
-    uint8_t multiframe_flow_ctr_sep_time;       // Store separation time of last received Flow Control Frame
-
-    uint8_t multiframe_consecutive_frame_ctr;   // Store counter of last received Consecutive Frame
+    ISOTP_MODE isotp_mode;                      // Flow Control handling for transmitted Multiframes
+
+    // ISO TP state per sender (CAN ID): Reassembly of a received Multiframe and Flow Control/ACK for transmissions to it
+    struct RXContext {
+        uint32_t id;                            // CAN ID of the sender, 0 if the context is free
+        QByteArray buffer;                      // Buffer of the reassembler, handed out to the receivers via implicit sharing
+        uint8_t *msg;                           // Data of buffer for the currently received Multiframe
+        uint32_t msg_len;                       // Length of the Multiframe, 0 if no Multiframe is received
+        uint32_t msg_idx;                       // Index of the next byte to be written to msg
+        uint8_t sequence;                       // Sequence number of the last received Consecutive Frame, 0 after the First Frame
+        qint64 last_frame_ms;                   // Time of the last frame of the sender, for the timeout and the reuse of the context
+
+        uint8_t flow_ctr_valid;                 // Flag for checking if Flow Control Frame is received
+        uint8_t flow_ctr_flag;                  // Store flag of last received Flow Control Frame
+        uint8_t flow_ctr_blocksize;             // Store blocksize of last received Flow Control Frame
+        uint8_t flow_ctr_sep_time;              // Store separation time of last received Flow Control Frame
+        uint8_t consecutive_frame_ctr;          // Store counter of last received ACK for a Consecutive Frame
+    };
+    RXContext rx_contexts[COMM_RX_CONTEXTS];    // Pool, the buffers are allocated once with MAX_ISOTP_MESSAGE_LEN
+    QHash<uint32_t, RXContext*> rx_context_table; // Contexts of rx_contexts in use by CAN ID
+    QElapsedTimer rx_clock;                     // Time base of last_frame_ms
+    QByteArray singleframe_buffer;              // Buffer for Single Frames, handed out to the receivers via implicit sharing
+
+    QMutex multiframe_mutex;                    // Protects rx_context_table, the Flow Control/ACK state and tx_curr_id
+    QWaitCondition multiframe_cond;             // Signalled with multiframe_mutex on received Flow Control and ACK
+
+    // Used for several sessions (threads) sharing the bus, e.g. parallel flashing of several ECUs
+    QMutex tx_mutex;
+    QWaitCondition tx_cond;                     // Signalled with tx_mutex when a transmission is finished
+    uint32_t tx_ticket_next;                    // Ticket of the next transmission requested, served in order
+    uint32_t tx_ticket_serving;                 // Ticket of the transmission currently on the bus
+    uint32_t tx_id_default;                     // Last TX ID set, for threads without own ID
+    QHash<Qt::HANDLE, uint32_t> tx_ids;         // TX ID set per thread, removed when the thread finishes
+    uint32_t tx_curr_id;                        // TX ID of the transmission currently on the bus, Flow Control and ACK are accepted from this ECU only
+
+    WaitStatistics wait_stats;                  // Time spent waiting on Flow Control and ACK frames
 
 public:
     explicit Communication(QObject *parent = 0);
@@ -63,25 +105,46 @@ public:
 
     void init(INTERFACE ct);
     void setCommunicationType(INTERFACE ct);
+    void setISOTPMode(ISOTP_MODE mode);
+
+    // Time spent waiting on Flow Control and ACK frames
+    const WaitStatistics &getWaitStatistics();
+    void resetWaitStatistics();
 
     // Testing
     void setTestMode();
+#if defined(FBL_SIMULATED_ECU)
+    void setSimulationTiming(uint32_t frame_latency_us, uint32_t fd_frame_latency_us, const SimEcuTiming &timing);
+    void setSimulatedEcuCount(uint8_t count);
+    QList<uint8_t> getSimulatedEcuInstances();
+#endif
 
 private:
     // General
     void resetMultiFrame();
+    void resetMultiFrameTX();
+    RXContext *getRXContext(uint32_t id);
+    void resetRXContext(RXContext *ctx);
+    bool isFromTXTarget(uint32_t id);
+    uint8_t txFlowControlReceived(uint8_t *flag, uint8_t *blocksize, uint8_t *sep_time);
+    uint8_t txACKReceived(uint8_t consecutive_frame_ctr);
+    void txClearFlowControl();
+    bool isCANInterface(INTERFACE ct);
+    void createCANDriver(INTERFACE ct);
 
     // TX Section
     void setID(uint32_t id);
     void txData(uint8_t *data, uint32_t no_bytes);
+    uint8_t txWaitOnFlowControl(uint8_t *blocksize, uint8_t *sep_time);
+    void txWaitSeparationTime(uint8_t sep_time);
 
     // RX Section
-    void dataReceiveHandleMulti();
+    void dataReceiveHandleMulti(RXContext *ctx);
     // CAN Event Received
-    void handleCANEvent(unsigned int id, unsigned short dlc, unsigned char data[]);
+    void handleCANEvent(unsigned int id, unsigned short dlc, const uint8_t *data);
 
     // Debugging
-    void _debug_printf_isotp_buffer();
+    void _debug_printf_isotp_buffer(const RXContext *ctx);
 
 signals:
     /**
@@ -103,6 +166,12 @@ signals:
      */
     void txCANDataSignal(const QByteArray &data);
 
+    /**
+     * @brief Signals that several CAN frames are ready to be transmitted in order without waiting in between
+     * @param frames Contains the frames to be transmitted
+     */
+    void txCANDataBatchSignal(const QList<QByteArray> &frames);
+
     /**
      * @brief Signals a Text to be print to GUI console
      */
@@ -119,19 +188,26 @@ public slots:
 
     /**
      * @brief Slot for the CAN Driver
+     * @param frame Received frame
+     */
+    void rxCANFrameSlot(const CANFrame &frame);
+
+    /**
+     * @brief Slot for frames given as ByteArray (e.g. loopbacks for testing)
      * @param id
      * @param ba
      */
     void rxCANDataSlot(const unsigned int id, const QByteArray &ba);
 
     /**
-     * @brief Slot to send Data via the pre selected interface
+     * @brief Slot to send Data via the pre selected interface with the ID set by the calling thread. Transmissions
+     *        of several threads are served one after another in the order they were requested.
      * @param data Array including the data
      */
     void txDataSlot(const QByteArray &data);
 
     /**
-     * @brief Slot to set the ID for the pre selected interface
+     * @brief Slot to set the ID for the pre selected interface, used for the next txDataSlot of the calling thread
      * @param id ID to be set
      */
     void setIDSlot(uint32_t id);
@@ -0,0 +1,48 @@
+# SPDX-License-Identifier: MIT
+# SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+# Simulated ECU: Builds the bootloader sources of MCU_Aurix for the host. The hardware drivers (CAN, flash, reset, timer)
+# are replaced by the models of this directory, the sector bookkeeping of the flash driver (flash_eraser.c) is shared.
+# Provides the static library SIMULATED_ECU and defines FBL_SIMULATED_ECU for everything linking it. uds.c uses a
+# variable length array, therefore MSVC is not supported.
+
+if(MSVC OR TARGET SIMULATED_ECU)
+    return()
+endif()
+
+enable_language(C)
+
+set(FBL_MCU_DIR ${CMAKE_CURRENT_LIST_DIR}/../../MCU_Aurix)
+set(FBL_SIM_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+add_library(SIMULATED_ECU STATIC
+    ${FBL_MCU_DIR}/bootloader/src/crc.c
+    ${FBL_MCU_DIR}/bootloader/src/flashing.c
+    ${FBL_MCU_DIR}/bootloader/src/isotp.c
+    ${FBL_MCU_DIR}/bootloader/src/lz4.c
+    ${FBL_MCU_DIR}/bootloader/src/memory.c
+    ${FBL_MCU_DIR}/bootloader/src/perf_counters.c
+    ${FBL_MCU_DIR}/bootloader/src/session_manager.c
+    ${FBL_MCU_DIR}/bootloader/src/uds.c
+    ${FBL_MCU_DIR}/bootloader/src/uds_comm_spec.c
+    ${FBL_MCU_DIR}/driver/src/flash_eraser.c
+    ${FBL_SIM_DIR}/flash_driver_sim.c
+    ${FBL_SIM_DIR}/simulated_ecu.c
+    ${FBL_SIM_DIR}/simulated_ecu.h
+    ${FBL_SIM_DIR}/simulated_ecu_symbols.h
+)
+
+# The bootloader includes both spellings Ifx_Types.h and Ifx_types.h, only the first one is part of the repository
+# to keep it usable on case insensitive file systems
+set(FBL_SIM_ALIAS_DIR ${CMAKE_CURRENT_BINARY_DIR}/simulated_ecu_platform)
+file(WRITE ${FBL_SIM_ALIAS_DIR}/Ifx_types.h "#include \"Ifx_Types.h\"\n")
+
+target_include_directories(SIMULATED_ECU PRIVATE
+    ${FBL_SIM_DIR}/platform
+    ${FBL_SIM_ALIAS_DIR}
+    ${FBL_MCU_DIR}/bootloader/inc
+    ${FBL_MCU_DIR}/driver/inc
+)
+target_compile_options(SIMULATED_ECU PRIVATE -include ${FBL_SIM_DIR}/simulated_ecu_symbols.h)
+target_compile_definitions(SIMULATED_ECU PUBLIC FBL_SIMULATED_ECU)
+set_target_properties(SIMULATED_ECU PROPERTIES C_STANDARD 11 C_EXTENSIONS ON)
@@ -0,0 +1,435 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : flash_driver_sim.c
+// Author      : Michael Bauer
+// Version     : 0.7
+// Copyright   : MIT
+// Description : Host implementation of flash_driver.h on top of an in-memory PFLASH/DFLASH model, the sector
+//               bookkeeping is the one of the hardware driver (flash_eraser.c)
+//============================================================================
+
+#include <string.h>
+#include <stdlib.h> /* calloc, free */
+
+#include "flash_driver.h"
+#include "flash_driver_TC375_LK.h"
+#include "flash_eraser.h"
+#include "crc.h"
+#include "memory.h"
+#include "perf_counters.h"
+#include "uds_comm_spec.h"
+
+#include "simulated_ecu.h"
+
+#define PFLASH_0_SIZE               (PROGRAM_FLASH_0_PHY_END_ADDR - PROGRAM_FLASH_0_PHY_BASE_ADDR + 1)
+#define PFLASH_1_SIZE               (PROGRAM_FLASH_1_PHY_END_ADDR - PROGRAM_FLASH_1_PHY_BASE_ADDR + 1)
+#define DFLASH_0_SIZE               (DATA_FLASH_0_END_ADDR - DATA_FLASH_0_BASE_ADDR + 1)
+#define DFLASH_1_SIZE               (DATA_FLASH_1_END_ADDR - DATA_FLASH_1_BASE_ADDR + 1)
+#define DFLASH_PHY_SECTOR_LENGTH    (DFLASH_SECTOR_LENGTH + 1)  /* DFLASH_SECTOR_LENGTH is the last offset within the sector */
+
+/*********************************************************************************************************************/
+/*--------------------------------------------Private Variables/Constants--------------------------------------------*/
+/*********************************************************************************************************************/
+
+typedef struct
+{
+    uint32_t base_addr;
+    uint32_t size;
+    uint32_t page_length;
+    uint8_t *mem;                   /* Content, erased flash reads 0 */
+    uint8_t *programmed;            /* One bit per page, set while the page is programmed and not erased again */
+} Flash_Region;
+
+/* Content of the flash of one simulated ECU */
+typedef struct
+{
+    uint8_t pflash0_mem[PFLASH_0_SIZE];
+    uint8_t pflash1_mem[PFLASH_1_SIZE];
+    uint8_t dflash0_mem[DFLASH_0_SIZE];
+    uint8_t dflash1_mem[DFLASH_1_SIZE];
+
+    uint8_t pflash0_programmed[PFLASH_0_SIZE / PFLASH_PAGE_LENGTH / 8];
+    uint8_t pflash1_programmed[PFLASH_1_SIZE / PFLASH_PAGE_LENGTH / 8];
+    uint8_t dflash0_programmed[DFLASH_0_SIZE / DFLASH_PAGE_LENGTH / 8];
+    uint8_t dflash1_programmed[DFLASH_1_SIZE / DFLASH_PAGE_LENGTH / 8];
+
+    Flash_Eraser eraser;                    /* pflash_eraser while another ECU is selected */
+} Flash_Content;
+
+static Flash_Content flash_content0;        /* First ECU, the flash of further ECUs is allocated (simEcuFlashCreate) */
+static Flash_Content *flash_content = &flash_content0;
+
+static Flash_Region flash_regions[] = {
+    {PROGRAM_FLASH_0_PHY_BASE_ADDR, PFLASH_0_SIZE, PFLASH_PAGE_LENGTH, flash_content0.pflash0_mem, flash_content0.pflash0_programmed},
+    {PROGRAM_FLASH_1_PHY_BASE_ADDR, PFLASH_1_SIZE, PFLASH_PAGE_LENGTH, flash_content0.pflash1_mem, flash_content0.pflash1_programmed},
+    {DATA_FLASH_0_BASE_ADDR,        DFLASH_0_SIZE, DFLASH_PAGE_LENGTH, flash_content0.dflash0_mem, flash_content0.dflash0_programmed},
+    {DATA_FLASH_1_BASE_ADDR,        DFLASH_1_SIZE, DFLASH_PAGE_LENGTH, flash_content0.dflash1_mem, flash_content0.dflash1_programmed},
+};
+
+#define FLASH_REGIONS               (sizeof(flash_regions) / sizeof(flash_regions[0]))
+
+uint32_t flash_driver_last_flashpage[PFLASH_LAST_PAGE_SIZE];
+
+/*********************************************************************************************************************/
+/*--------------------------------------------Private Helper Functions-----------------------------------------------*/
+/*********************************************************************************************************************/
+
+static Flash_Region *getRegion(uint32_t addr){
+    for(uint32_t i = 0; i < FLASH_REGIONS; i++){
+        if(addr >= flash_regions[i].base_addr && addr - flash_regions[i].base_addr < flash_regions[i].size)
+            return &flash_regions[i];
+    }
+    return NULL;
+}
+
+/* Reads one byte of the model, unmapped addresses read 0 */
+static uint8_t readByte(uint32_t addr){
+    Flash_Region *region = getRegion(addr);
+    if(region == NULL)
+        return 0;
+    return region->mem[addr - region->base_addr];
+}
+
+/* Equivalent of MEM(address) of the hardware driver, little endian */
+static uint32_t readWord(uint32_t addr){
+    uint32_t word = 0;
+    for(int i = 0; i < 4; i++)
+        word |= (uint32_t)readByte(addr + i) << (8 * i);
+    return word;
+}
+
+/* Erases the given range, the range is extended to full sectors */
+static uint32_t eraseRange(uint32_t addr, uint32_t sectorLength, uint32_t numSectors){
+    Flash_Region *region = getRegion(addr);
+    if(region == NULL)
+        return 0;
+
+    uint32_t offset = (addr - region->base_addr) / sectorLength * sectorLength;
+    uint32_t erased = 0;
+    for(; erased < numSectors && offset < region->size; erased++, offset += sectorLength){
+        memset(&region->mem[offset], 0, sectorLength);
+        for(uint32_t page = offset / region->page_length; page < (offset + sectorLength) / region->page_length; page++)
+            region->programmed[page / 8] &= (uint8_t)~(1 << (page % 8));
+    }
+    return erased;
+}
+
+/* Programs one page, returns 1 if the page was not erased before */
+static uint32_t programPage(uint32_t pageAddr, const uint8_t *pageData){
+    Flash_Region *region = getRegion(pageAddr);
+    if(region == NULL)
+        return 1;
+
+    uint32_t offset = pageAddr - region->base_addr;
+    uint32_t page = offset / region->page_length;
+    uint32_t error = (region->programmed[page / 8] >> (page % 8)) & 1;
+
+    memcpy(&region->mem[offset], pageData, region->page_length);
+    region->programmed[page / 8] |= (uint8_t)(1 << (page % 8));
+    return error;
+}
+
+static void createLastFlashPage(uint32_t *data, size_t dataSize){
+
+    /* Write 32 bytes (8 double words) into the last page buffer */
+    for(uint32_t index = 0; index < PFLASH_LAST_PAGE_SIZE; index++)
+    {
+        // Use given data
+        if(index < dataSize){
+            flash_driver_last_flashpage[index] = *(data+index);
+        }
+
+        // fill the rest of the last page with zeros
+        else {
+            flash_driver_last_flashpage[index] = 0;
+        }
+    }
+}
+
+/* Backend of flash_eraser.c, the erase is accounted like a flash operation without programmed pages */
+void flashEraseLogSectors(IfxFlash_FlashType flashModule, uint32_t sectorAddr, uint32_t numSectors){
+    Ifx_TickTime start = perfStart();
+    simEcuFlashOperation(1, eraseRange(sectorAddr, PFLASH_SECTOR_LENGTH, numSectors), 0, 0);
+    perfStop(PERF_ERASE, start);
+}
+
+static bool flashWriteProgram(IfxFlash_FlashType flashModule, uint32_t flashStartAddr, uint32_t data[], size_t dataSize)
+{
+    if(pflash_eraser.init == 0){
+        flashDriverInit();
+        if(pflash_eraser.init == 0) // Init was not successful
+            return false;
+    }
+
+    uint32_t num_pages = flashGetNumPerSize(PFLASH_PAGE_LENGTH, dataSize, 1);
+
+    // Always use buffered last page for flashing to make sure full pages are written
+    uint32_t *data_for_last_page = (uint32_t*) (((uint8_t*) data) + ((num_pages-1) * PFLASH_PAGE_LENGTH));
+    createLastFlashPage(data_for_last_page, dataSize%PFLASH_LAST_PAGE_SIZE == 0 ? PFLASH_LAST_PAGE_SIZE : dataSize%PFLASH_LAST_PAGE_SIZE);
+
+    // Erase and program are accounted separately, so the busy time is measured per section like on the hardware
+    flashErasePFlashSectors(flashModule, flashStartAddr, dataSize * sizeof(uint32_t));
+
+    Ifx_TickTime start = perfStart();
+    uint32_t errors = 0;
+    for(uint32_t page = 0; page < num_pages; page++){
+        uint32_t page_addr = flashStartAddr + (page * PFLASH_PAGE_LENGTH);
+        if(page < num_pages-1)
+            errors += programPage(page_addr, ((uint8_t*) data) + (page * PFLASH_PAGE_LENGTH));
+        else // Act different for last page
+            errors += programPage(page_addr, (uint8_t*) flash_driver_last_flashpage);
+    }
+
+    simEcuFlashOperation(1, 0, num_pages, errors);
+    perfStop(PERF_PROGRAM, start);
+    return true;
+}
+
+/* Programs the pages without erasing them before */
+static bool flashProgramDataPages(uint32_t flashStartAddr, uint32_t data[], uint32_t num_pages)
+{
+    Ifx_TickTime start = perfStart();
+    uint32_t errors = 0;
+    for(uint32_t page = 0; page < num_pages; page++)
+        errors += programPage(flashStartAddr + (page * DFLASH_PAGE_LENGTH), ((uint8_t*) data) + (page * DFLASH_PAGE_LENGTH));
+
+    simEcuFlashOperation(0, 0, num_pages, errors);
+    perfStop(PERF_PROGRAM, start);
+    return true;
+}
+
+static bool flashWriteData(uint32_t flashStartAddr, uint32_t data[], size_t dataSize)
+{
+    uint32_t num_sectors = flashGetNumPerSize(DFLASH_SECTOR_LENGTH, dataSize, 1);
+    uint32_t num_pages = flashGetNumPerSize(DFLASH_PAGE_LENGTH, dataSize, 1);
+
+    Ifx_TickTime start = perfStart();
+    simEcuFlashOperation(0, eraseRange(flashStartAddr, DFLASH_PHY_SECTOR_LENGTH, num_sectors), 0, 0);
+    perfStop(PERF_ERASE, start);
+
+    // Like the hardware driver, the last page is taken from the data buffer as a whole
+    return flashProgramDataPages(flashStartAddr, data, num_pages);
+}
+
+/*********************************************************************************************************************/
+/*------------------------------------------------Function Prototypes------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/* Same address checks as the hardware driver */
+bool flashWrite(uint32_t flashStartAddr, uint32_t data[], size_t dataSize) {
+    if (flashStartAddr >= DATA_FLASH_0_BASE_ADDR && flashStartAddr < DATA_FLASH_0_END_ADDR)
+    {
+        if (flashStartAddr + dataSize >= DATA_FLASH_0_END_ADDR) {
+            return false;
+        }
+        return flashWriteData(flashStartAddr, data, dataSize);
+    }
+    else if (flashStartAddr >= DATA_FLASH_1_BASE_ADDR && flashStartAddr < DATA_FLASH_1_END_ADDR)
+    {
+        if (flashStartAddr + dataSize >= DATA_FLASH_1_END_ADDR) {
+            return false;
+        }
+        return flashWriteData(flashStartAddr, data, dataSize);
+    }
+    else if (flashStartAddr >= PROGRAM_FLASH_0_BASE_ADDR && flashStartAddr < PROGRAM_FLASH_0_END_ADDR)
+    {
+        if (flashStartAddr + dataSize * sizeof(uint32) >= PROGRAM_FLASH_0_END_ADDR)
+        {
+            return false;
+        }
+        return flashWriteProgram(PROGRAM_FLASH_0, flashStartAddr, data, dataSize);
+    }
+    else if (flashStartAddr >= PROGRAM_FLASH_1_BASE_ADDR && flashStartAddr < PROGRAM_FLASH_1_END_ADDR)
+    {
+        if (flashStartAddr + dataSize * sizeof(uint32) >= PROGRAM_FLASH_1_END_ADDR)
+        {
+            return false;
+        }
+        return flashWriteProgram(PROGRAM_FLASH_1, flashStartAddr, data, dataSize);
+    }
+    return false;
+}
+
+/* Same sector bookkeeping as flashWrite */
+bool flashEraseProgram(uint32_t flashStartAddr, uint32_t lengthInBytes) {
+    IfxFlash_FlashType flashModule;
+    if (lengthInBytes == 0)
+        return false;
+
+    if (flashStartAddr >= PROGRAM_FLASH_0_BASE_ADDR && flashStartAddr + lengthInBytes - 1 <= PROGRAM_FLASH_0_END_ADDR)
+        flashModule = PROGRAM_FLASH_0;
+    else if (flashStartAddr >= PROGRAM_FLASH_1_BASE_ADDR && flashStartAddr + lengthInBytes - 1 <= PROGRAM_FLASH_1_END_ADDR)
+        flashModule = PROGRAM_FLASH_1;
+    else
+        return false;
+
+    if(pflash_eraser.init == 0){
+        flashDriverInit();
+        if(pflash_eraser.init == 0) // Init was not successful
+            return false;
+    }
+
+    flashErasePFlashSectors(flashModule, flashStartAddr, lengthInBytes);
+    return true;
+}
+
+static bool dataFlashRange(uint32_t flashStartAddr, uint32_t bytes){
+    return (flashStartAddr >= DATA_FLASH_0_BASE_ADDR && flashStartAddr + bytes - 1 <= DATA_FLASH_0_END_ADDR) ||
+           (flashStartAddr >= DATA_FLASH_1_BASE_ADDR && flashStartAddr + bytes - 1 <= DATA_FLASH_1_END_ADDR);
+}
+
+bool flashEraseData(uint32_t flashStartAddr, uint32_t numSectors) {
+    if(!dataFlashRange(flashStartAddr, numSectors * DFLASH_PHY_SECTOR_LENGTH))
+        return false;
+
+    Ifx_TickTime start = perfStart();
+    simEcuFlashOperation(0, eraseRange(flashStartAddr, DFLASH_PHY_SECTOR_LENGTH, numSectors), 0, 0);
+    perfStop(PERF_ERASE, start);
+    return true;
+}
+
+bool flashProgramData(uint32_t flashStartAddr, uint32_t data[], size_t dataSize) {
+    if(!dataFlashRange(flashStartAddr, dataSize * sizeof(uint32)))
+        return false;
+
+    return flashProgramDataPages(flashStartAddr, data, flashGetNumPerSize(DFLASH_PAGE_LENGTH, dataSize, 1));
+}
+
+bool flashVerify(uint32_t flashStartAddr, uint32_t data[], size_t dataSize)
+{
+    for (uint32_t idx = 0; idx < dataSize; idx++)
+    {
+        if (readWord(flashStartAddr + idx * sizeof(uint32)) != data[idx])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t *flashRead(uint32_t flashStartAddr, size_t dataBytesToRead){
+
+    uint8_t *data = (uint8_t*)calloc((uint32_t)dataBytesToRead, sizeof(uint8_t));
+    if(data != NULL){
+        for(uint32_t i = 0; i < dataBytesToRead; i++)
+            data[i] = readByte(flashStartAddr + i);
+    }
+    return data;
+}
+
+/* Caution: CRC-Calculation is based on ASCII not Hex-number (see flash_driver.c) */
+uint32_t flashCalculateChecksum(uint32_t flashStartAddr, uint32_t length) {
+
+    char flashContent[2];
+    uint32_t addr = flashStartAddr;
+    uint32_t endAddr = flashStartAddr + length;
+
+    Ifx_TickTime start = perfStart();
+    crc_t crc = crc_init();
+    while (addr < endAddr) {
+        uint8_t byte = readByte(addr);
+        uint8_t lower = byte & 0x0F;
+        uint8_t higher = byte >> 4;
+        flashContent[0] = higher + (higher > 9 ? 0x37 : 0x30);
+        flashContent[1] = lower + (lower > 9 ? 0x37 : 0x30);
+        crc = crc_update(crc, flashContent, 2);
+        addr++;
+    }
+
+    crc = crc_finalize(crc);
+    perfStop(PERF_CRC, start);
+
+    return (uint32_t) crc;
+}
+
+/* Raw bytes (FBL_CHECKSUM_MODE_RAW), the CRC runs directly on the model like on the memory mapped flash */
+uint32_t flashCalculateChecksumRaw(uint32_t flashStartAddr, uint32_t length) {
+
+    uint32_t addr = flashStartAddr;
+    uint32_t endAddr = flashStartAddr + length;
+    static const uint8_t unmapped[PFLASH_PAGE_LENGTH];
+
+    Ifx_TickTime start = perfStart();
+    crc_t crc = crc_init();
+    while (addr < endAddr) {
+        Flash_Region *region = getRegion(addr);
+        uint32_t chunk;
+        if(region != NULL){
+            chunk = region->size - (addr - region->base_addr);
+            if(chunk > endAddr - addr)
+                chunk = endAddr - addr;
+            crc = crc_update(crc, &region->mem[addr - region->base_addr], chunk);
+        }
+        else{
+            chunk = endAddr - addr < sizeof(unmapped) ? endAddr - addr : sizeof(unmapped);
+            crc = crc_update(crc, unmapped, chunk);
+        }
+        addr += chunk;
+    }
+
+    crc = crc_finalize(crc);
+    perfStop(PERF_CRC, start);
+
+    return (uint32_t) crc;
+}
+
+/*********************************************************************************************************************/
+/*-----------------------------------------------Simulation Access---------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/**
+ * Allocates the erased flash of a further simulated ECU, the first ECU uses the static content
+ * Return NULL: if out of memory
+ */
+void *simEcuFlashCreate(void){
+    return calloc(1, sizeof(Flash_Content));
+}
+
+/**
+ * Switches the flash model to the flash of another simulated ECU, called by simEcuSelect
+ *
+ * @param flash     Flash of simEcuFlashCreate, NULL for the first ECU
+ */
+void simEcuFlashSelect(void *flash){
+    Flash_Content *content = flash != NULL ? (Flash_Content*)flash : &flash_content0;
+
+    flash_content->eraser = pflash_eraser;
+    pflash_eraser = content->eraser;
+    flash_content = content;
+
+    flash_regions[0].mem = content->pflash0_mem;
+    flash_regions[0].programmed = content->pflash0_programmed;
+    flash_regions[1].mem = content->pflash1_mem;
+    flash_regions[1].programmed = content->pflash1_programmed;
+    flash_regions[2].mem = content->dflash0_mem;
+    flash_regions[2].programmed = content->dflash0_programmed;
+    flash_regions[3].mem = content->dflash1_mem;
+    flash_regions[3].programmed = content->dflash1_programmed;
+}
+
+/**
+ * Copies the content of the flash model, e.g. to compare it with the flashed image
+ * Return 0: if OK
+ * Return 1: if a part of the range is not covered by the model
+ */
+uint8_t simEcuReadMemory(uint32_t address, uint8_t *data, uint32_t len){
+    uint8_t ret = 0;
+    for(uint32_t i = 0; i < len; i++){
+        if(getRegion(address + i) == NULL)
+            ret = 1;
+        data[i] = readByte(address + i);
+    }
+    return ret;
+}
+
+/**
+ * Erases the complete flash model, the next power on loads the default configuration
+ */
+void simEcuEraseFlash(void){
+    for(uint32_t i = 0; i < FLASH_REGIONS; i++){
+        memset(flash_regions[i].mem, 0, flash_regions[i].size);
+        memset(flash_regions[i].programmed, 0, flash_regions[i].size / flash_regions[i].page_length / 8);
+    }
+}
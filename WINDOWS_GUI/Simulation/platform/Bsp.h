@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : Bsp.h
+// Author      : Michael Bauer
+// Version     : 0.2
+// Copyright   : MIT
+// Description : Host replacement of the BSP timing functions (one tick equals one microsecond) and interrupt locks
+//============================================================================
+
+#ifndef SIMULATION_PLATFORM_BSP_H_
+#define SIMULATION_PLATFORM_BSP_H_
+
+#include "Ifx_Types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef sint64 Ifx_TickTime;
+
+#define BSP_DEFAULT_TIMER                               (0)
+#define IfxStm_getFrequency(stm)                        (1000000)
+#define IfxStm_getTicksFromMilliseconds(stm, ms)        ((Ifx_TickTime)(ms) * 1000)
+
+// Frames are received in the thread of the main loop (simEcuRxFrame, busy callback of the flash), nothing preempts it
+#define IfxCpu_disableInterrupts()                      ((boolean)0)
+#define IfxCpu_restoreInterrupts(enabled)               ((void)(enabled))
+
+Ifx_TickTime now(void);
+Ifx_TickTime elapsed(Ifx_TickTime since);
+void waitTime(Ifx_TickTime timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIMULATION_PLATFORM_BSP_H_ */
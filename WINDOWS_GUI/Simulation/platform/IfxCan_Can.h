@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : IfxCan_Can.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Host replacement of the iLLD CAN types used by can_driver_TC375_LK.h
+//============================================================================
+
+#ifndef SIMULATION_PLATFORM_IFXCAN_CAN_H_
+#define SIMULATION_PLATFORM_IFXCAN_CAN_H_
+
+#include "Ifx_Types.h"
+
+/* Data Length Code of a received frame, the simulated CAN driver passes the number of bytes (0..8) */
+typedef enum
+{
+    IfxCan_DataLengthCode_0 = 0,
+    IfxCan_DataLengthCode_1,
+    IfxCan_DataLengthCode_2,
+    IfxCan_DataLengthCode_3,
+    IfxCan_DataLengthCode_4,
+    IfxCan_DataLengthCode_5,
+    IfxCan_DataLengthCode_6,
+    IfxCan_DataLengthCode_7,
+    IfxCan_DataLengthCode_8,
+    IfxCan_DataLengthCode_12,
+    IfxCan_DataLengthCode_16,
+    IfxCan_DataLengthCode_20,
+    IfxCan_DataLengthCode_24,
+    IfxCan_DataLengthCode_32,
+    IfxCan_DataLengthCode_48,
+    IfxCan_DataLengthCode_64
+} IfxCan_DataLengthCode;
+
+/* Handles of the CAN module are never touched on the host, they only need to be complete types */
+typedef struct { uint32 reserved; } IfxCan_Can_Config;
+typedef struct { uint32 reserved; } IfxCan_Can;
+typedef struct { uint32 reserved; } IfxCan_Can_Node;
+typedef struct { uint32 reserved; } IfxCan_Can_NodeConfig;
+typedef struct { uint32 reserved; } IfxCan_Filter;
+
+typedef struct
+{
+    uint32 messageId;
+    IfxCan_DataLengthCode dataLengthCode;
+} IfxCan_Message;
+
+#endif /* SIMULATION_PLATFORM_IFXCAN_CAN_H_ */
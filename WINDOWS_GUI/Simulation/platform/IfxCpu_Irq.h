@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : IfxCpu_Irq.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Empty host replacement of the iLLD header, nothing of it is used by the simulated ECU
+//============================================================================
+
+#ifndef SIMULATION_PLATFORM_IFXCPU_IRQ_H_
+#define SIMULATION_PLATFORM_IFXCPU_IRQ_H_
+
+#include "Ifx_Types.h"
+
+#endif /* SIMULATION_PLATFORM_IFXCPU_IRQ_H_ */
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : IfxFlash.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Host replacement of the iLLD flash definitions used by flash_driver_TC375_LK.h
+//============================================================================
+
+#ifndef SIMULATION_PLATFORM_IFXFLASH_H_
+#define SIMULATION_PLATFORM_IFXFLASH_H_
+
+#include "Ifx_Types.h"
+
+#define IFXFLASH_PFLASH_PAGE_LENGTH     (0x20)      /* 32 Bytes */
+#define IFXFLASH_DFLASH_PAGE_LENGTH     (0x8)       /* 8 Bytes */
+
+typedef enum
+{
+    IfxFlash_FlashType_Fa = 0,
+    IfxFlash_FlashType_D0,
+    IfxFlash_FlashType_D1,
+    IfxFlash_FlashType_P0,
+    IfxFlash_FlashType_P1,
+    IfxFlash_FlashType_P2,
+    IfxFlash_FlashType_P3
+} IfxFlash_FlashType;
+
+#endif /* SIMULATION_PLATFORM_IFXFLASH_H_ */
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : Ifx_Types.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Host replacement of the iLLD base types for the simulated ECU
+//============================================================================
+
+#ifndef SIMULATION_PLATFORM_IFX_TYPES_H_
+#define SIMULATION_PLATFORM_IFX_TYPES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>     /* malloc, calloc, free - isotp.c relies on the iLLD headers pulling them in */
+
+typedef uint8_t         uint8;
+typedef uint16_t        uint16;
+typedef uint32_t        uint32;
+typedef uint64_t        uint64;
+typedef int8_t          sint8;
+typedef int16_t         sint16;
+typedef int32_t         sint32;
+typedef int64_t         sint64;
+typedef float           float32;
+typedef unsigned char   boolean;
+
+#ifndef TRUE
+#define TRUE            (1)
+#endif
+#ifndef FALSE
+#define FALSE           (0)
+#endif
+
+#define __nop()         ((void)0)
+
+#endif /* SIMULATION_PLATFORM_IFX_TYPES_H_ */
@@ -0,0 +1,518 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : simulated_ecu.c
+// Author      : Michael Bauer
+// Version     : 0.4
+// Copyright   : MIT
+// Description : Host simulation of the bootloader ECU (bootloader sources on top of a CAN and flash model)
+//============================================================================
+
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+ #include <windows.h>
+#else
+ #include <time.h>
+#endif
+
+#include "Bsp.h"
+#include "can_driver.h"
+#include "can_driver_TC375_LK.h"
+#include "flash_driver.h"
+#include "flashing.h"
+#include "isotp.h"
+#include "memory.h"
+#include "perf_counters.h"
+#include "reset.h"
+#include "session_manager.h"
+#include "uds.h"
+
+#include "simulated_ecu.h"
+
+/*********************************************************************************************************************/
+/*--------------------------------------------Private Variables/Constants--------------------------------------------*/
+/*********************************************************************************************************************/
+
+/* State of one simulated ECU besides the bootloader RAM, which is swapped on simEcuSelect */
+typedef struct {
+    SimEcuTxCallback tx_callback;
+    SimEcuBusyCallback busy_callback;
+    void *tx_context;
+
+    uint8_t powered;                        // Bootloader was initialized once, uds_init must only be called once
+    uint8_t reset_pending;                  // Reset was triggered by UDS, executed after the current request
+    uint8_t flash_busy;                     // Main loop is blocked by an erase or program operation
+    uint8_t sequential_transfer_data;       // TransferData is programmed before its response (simEcuSetSequentialTransferData), kept on resets
+
+    SimEcuTiming timing;
+    SimEcuStatistics stats;
+
+    uint8_t *ram;                           // Bootloader RAM (sim_ram_blocks) while another ECU is selected
+    void *flash;                            // Flash model, NULL for the first ECU (static content)
+} SimEcu_Instance;
+
+/* Bootloader variables, saved and restored on simEcuSelect. The ISO TP RX structs are allocated per ECU by uds_init,
+ * the TX struct of uds.c is shared as every response is transmitted completely within one call */
+typedef struct {
+    void *addr;
+    size_t size;
+} SimEcu_RamBlock;
+
+extern uint32_t flashBuffer[FLASHING_BUFFERS][MAX_ISOTP_MESSAGE_LEN/4];
+extern uint32_t flashTransferDataCtr;
+extern uint32_t flashSectorChecksums[FLASHING_SECTOR_CHECKSUMS];
+extern Flashing_Internal flashing_int_data;
+extern isoTP_RX* iso_RX_Single;
+extern uint8_t isoTP_RX_single_data_buffer[MAX_FRAME_LEN_CANFD];
+extern isoTP_RX* iso_RX_Multi;
+extern uint8_t isoTP_RX_multi_data_buffer[MAX_ISOTP_MESSAGE_LEN];
+extern uint8_t isoTP_RX_canfd;
+extern boolean init;
+extern Memory_Data memData;
+extern Memory_Layout memLayout;
+#if MEMORY_DID_LOG
+extern Memory_Log memLog;
+#endif
+extern uint8_t session;
+extern boolean authenticated;
+extern Perf_Counters perfCounters;
+
+static const SimEcu_RamBlock sim_ram_blocks[] = {
+    {flashBuffer, sizeof(flashBuffer)},
+    {&flashTransferDataCtr, sizeof(flashTransferDataCtr)},
+    {flashSectorChecksums, sizeof(flashSectorChecksums)},
+    {&flashing_int_data, sizeof(flashing_int_data)},
+    {&iso_RX_Single, sizeof(iso_RX_Single)},
+    {isoTP_RX_single_data_buffer, sizeof(isoTP_RX_single_data_buffer)},
+    {&iso_RX_Multi, sizeof(iso_RX_Multi)},
+    {isoTP_RX_multi_data_buffer, sizeof(isoTP_RX_multi_data_buffer)},
+    {&isoTP_RX_canfd, sizeof(isoTP_RX_canfd)},
+    {&init, sizeof(init)},
+    {&memData, sizeof(memData)},
+    {&memLayout, sizeof(memLayout)},
+#if MEMORY_DID_LOG
+    {&memLog, sizeof(memLog)},
+#endif
+    {&session, sizeof(session)},
+    {&authenticated, sizeof(authenticated)},
+    {&perfCounters, sizeof(perfCounters)},
+};
+
+#define SIM_RAM_BLOCKS              (sizeof(sim_ram_blocks) / sizeof(sim_ram_blocks[0]))
+
+static SimEcu_Instance sim_instances[SIM_ECU_MAX_INSTANCES];
+static uint8_t sim_instance_count = 1;
+static uint8_t sim_selected = 0;
+static SimEcu_Instance *sim = &sim_instances[0];   // Selected ECU
+
+static void (*processDataFunction)(uint32_t*, IfxCan_DataLengthCode) = NULL;
+
+/* Number of data bytes for the DLC 0-15, same as the CAN driver */
+static const uint8_t sim_dlc_length[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
+/*********************************************************************************************************************/
+/*--------------------------------------------Private Helper Functions-----------------------------------------------*/
+/*********************************************************************************************************************/
+
+static void delayUs(uint64_t us){
+    if(us == 0)
+        return;
+#if defined(_WIN32)
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(us / 1000000);
+    ts.tv_nsec = (long)((us % 1000000) * 1000);
+    while(nanosleep(&ts, &ts) != 0);
+#endif
+}
+
+static size_t ramSize(void){
+    size_t size = 0;
+    for(uint32_t i = 0; i < SIM_RAM_BLOCKS; i++)
+        size += sim_ram_blocks[i].size;
+    return size;
+}
+
+static void ramSave(uint8_t *ram){
+    for(uint32_t i = 0; i < SIM_RAM_BLOCKS; i++){
+        memcpy(ram, sim_ram_blocks[i].addr, sim_ram_blocks[i].size);
+        ram += sim_ram_blocks[i].size;
+    }
+}
+
+static void ramLoad(const uint8_t *ram){
+    for(uint32_t i = 0; i < SIM_RAM_BLOCKS; i++){
+        memcpy(sim_ram_blocks[i].addr, ram, sim_ram_blocks[i].size);
+        ram += sim_ram_blocks[i].size;
+    }
+}
+
+/* RX part of isotp_init for a further ECU, the structs are saved with the bootloader RAM */
+static void isotpRxInit(void){
+    iso_RX_Single = (isoTP_RX*)malloc(sizeof(isoTP_RX));
+    iso_RX_Single->data = isoTP_RX_single_data_buffer;
+    rx_reset_isotp_single_buffer();
+
+    iso_RX_Multi = (isoTP_RX*)malloc(sizeof(isoTP_RX));
+    iso_RX_Multi->data = isoTP_RX_multi_data_buffer;
+    rx_reset_isotp_multi_buffer();
+
+    isoTP_RX_canfd = 0;
+}
+
+/* Same init sequence as init_bootloader, without the LEDs */
+static void bootloaderInit(void){
+    init_memory();
+
+    flashDriverInit();
+    flashingInit();
+    if(sim->sequential_transfer_data)
+        flashingSetPipelined(0);
+
+    init_session_manager();
+
+    perfReset(); // Cleared by the startup code on the hardware
+}
+
+/*********************************************************************************************************************/
+/*----------------------------------------------------Instances------------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/**
+ * Creates a further simulated ECU with erased flash, the first ECU (instance 0) always exists. The ECU is not selected.
+ *
+ * @return      Instance of the new ECU, SIM_ECU_NO_INSTANCE if SIM_ECU_MAX_INSTANCES is reached or out of memory
+ */
+uint8_t simEcuCreate(void){
+    if(sim_instance_count >= SIM_ECU_MAX_INSTANCES)
+        return SIM_ECU_NO_INSTANCE;
+
+    // The first ECU only needs a RAM buffer once another ECU can be selected
+    if(sim_instances[0].ram == NULL){
+        sim_instances[0].ram = (uint8_t*)calloc(1, ramSize());
+        if(sim_instances[0].ram == NULL)
+            return SIM_ECU_NO_INSTANCE;
+    }
+
+    SimEcu_Instance *created = &sim_instances[sim_instance_count];
+    memset(created, 0, sizeof(*created));
+    created->ram = (uint8_t*)calloc(1, ramSize());  // Zero initialized like the variables at startup
+    created->flash = simEcuFlashCreate();
+    if(created->ram == NULL || created->flash == NULL){
+        free(created->ram);
+        free(created->flash);
+        memset(created, 0, sizeof(*created));
+        return SIM_ECU_NO_INSTANCE;
+    }
+    return sim_instance_count++;
+}
+
+/**
+ * Returns the number of simulated ECUs, the instances are numbered from 0
+ */
+uint8_t simEcuInstances(void){
+    return sim_instance_count;
+}
+
+/**
+ * Selects the simulated ECU all other functions act on. The bootloader RAM of the previous ECU is saved and the one of
+ * the given ECU is restored, like switching between several microcontrollers running the same code.
+ *
+ * @param instance  ECU of simEcuCreate, 0 for the first one
+ */
+void simEcuSelect(uint8_t instance){
+    if(instance >= sim_instance_count || instance == sim_selected)
+        return;
+
+    ramSave(sim->ram);
+    sim_selected = instance;
+    sim = &sim_instances[instance];
+    ramLoad(sim->ram);
+    simEcuFlashSelect(sim->flash);
+}
+
+/**
+ * Returns the selected simulated ECU
+ */
+uint8_t simEcuSelected(void){
+    return sim_selected;
+}
+
+/*********************************************************************************************************************/
+/*-------------------------------------------------------ECU---------------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/**
+ * Powers on the ECU. The first call initializes the bootloader, every further call restarts it like a reset.
+ * The content of the flash model is kept.
+ *
+ * @param tx        Called for every frame transmitted by the ECU
+ * @param busy      Called while the flash is busy, NULL to sleep instead
+ * @param context   Passed to tx and busy
+ */
+void simEcuPowerOn(SimEcuTxCallback tx, SimEcuBusyCallback busy, void *context){
+    sim->tx_callback = tx;
+    sim->busy_callback = busy;
+    sim->tx_context = context;
+    sim->reset_pending = 0;
+
+    bootloaderInit();
+
+    if(!sim->powered && processDataFunction == NULL){
+        uds_init(); // Registers process_can_to_isotp via canInitDriver
+        sim->powered = 1;
+    }
+    else if(!sim->powered){
+        // Further ECUs only need own ISO TP RX structs, the TX struct of uds.c is shared
+        isotpRxInit();
+        sim->powered = 1;
+    }
+    else{
+        // The ISO TP buffers are static, only the content is lost on a reset
+        rx_reset_isotp_single_buffer();
+        rx_reset_isotp_multi_buffer();
+    }
+}
+
+/**
+ * Powers off the ECU, no more frames are transmitted. The content of the flash model is kept.
+ */
+void simEcuPowerOff(void){
+    sim->tx_callback = NULL;
+    sim->busy_callback = NULL;
+    sim->tx_context = NULL;
+}
+
+/**
+ * Passes a received frame to the bootloader, equivalent to the RX interrupt of the CAN driver. Frames for other ECUs
+ * are dropped like by the CAN driver (canRxIDAccepted).
+ *
+ * @param id    CAN ID of the frame
+ * @param data  Frame data
+ * @param len   Number of bytes (max SIM_ECU_MAX_FRAME_LEN), CAN FD lengths between the DLC steps are padded with 0
+ */
+void simEcuRxFrame(uint32_t id, const uint8_t *data, uint8_t len){
+    uint32_t rxData[SIM_ECU_MAX_FRAME_LEN / sizeof(uint32_t)] = {0};
+
+    if(!sim->powered || processDataFunction == NULL || len > SIM_ECU_MAX_FRAME_LEN)
+        return;
+    if(!canRxIDAccepted(id, getID()))
+        return;
+
+    uint8_t dlc = 0;
+    while(sim_dlc_length[dlc] < len)
+        dlc++;
+
+    sim->stats.rx_frames++;
+    if(sim->flash_busy)
+        sim->stats.rx_frames_flash_busy++;
+    memcpy(rxData, data, len);
+    processDataFunction(rxData, (IfxCan_DataLengthCode)dlc);
+}
+
+/**
+ * Processes received UDS messages, equivalent to cyclicProcessing without the jump to the ASW.
+ * A reset requested via UDS is executed afterwards.
+ */
+void simEcuCyclic(void){
+    uint32_t rx_total_length_single = 0;
+    uint32_t rx_total_length_multi = 0;
+
+    uint8_t *rx_uds_message_single = isotp_single_rcv(&rx_total_length_single);
+    if(rx_total_length_single != 0){
+        uds_handleRX(rx_uds_message_single, rx_total_length_single);
+        free(rx_uds_message_single);
+    }
+
+    uint8_t *rx_uds_message_multi = isotp_multi_rcv(&rx_total_length_multi);
+    if(rx_total_length_multi != 0){
+        // RX Buffer of Multiframe is used, no need to free the buffer
+        uds_handleRX(rx_uds_message_multi, rx_total_length_multi);
+        rx_reset_isotp_multi_buffer();
+    }
+
+    flashingProcess();
+
+    if(sim->reset_pending){
+        sim->stats.resets++;
+        simEcuPowerOn(sim->tx_callback, sim->busy_callback, sim->tx_context);
+    }
+}
+
+/**
+ * Returns the CAN ID the ECU is transmitting with
+ */
+uint32_t simEcuGetID(void){
+    return getID();
+}
+
+/**
+ * Reads a DID of the ECU without using the bus
+ *
+ * @param did   Data Identifier
+ * @param data  Buffer for the data, needs to hold SIM_ECU_MAX_DID_LEN bytes
+ * @param len   Number of bytes written to data
+ * @return      0 if OK, otherwise the Negative Response Code
+ */
+uint8_t simEcuReadDID(uint16_t did, uint8_t *data, uint8_t *len){
+    uint8_t nrc = 0;
+    uint8_t *read = readData(did, len, &nrc);
+    if(!nrc)
+        memcpy(data, read, *len);
+    else
+        *len = 0;
+    free(read);
+    return nrc;
+}
+
+/**
+ * Writes a DID of the ECU without using the bus, stored in the data flash like Write Data By Identifier
+ *
+ * @param did   Data Identifier
+ * @param data  Data to be written
+ * @param len   Number of bytes
+ * @return      0 if OK, otherwise the Negative Response Code
+ */
+uint8_t simEcuWriteDID(uint16_t did, uint8_t *data, uint8_t len){
+    return writeData(did, data, len);
+}
+
+/**
+ * Checks an address range with the memory layout of the ECU like Request Download, without using the bus
+ *
+ * @param address   Start address
+ * @param len       Number of bytes
+ * @return          1 if the range may be written, otherwise 0
+ */
+uint8_t simEcuAddrInRange(uint32_t address, uint32_t len){
+    return flashingAddrInRange(address, len) ? 1 : 0;
+}
+
+/*********************************************************************************************************************/
+/*----------------------------------------------------Flash Model----------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/**
+ * Sets the modelled busy times of the flash, applied to the following erase and program operations
+ */
+void simEcuSetTiming(const SimEcuTiming *timing){
+    sim->timing = *timing;
+}
+
+void simEcuGetTiming(SimEcuTiming *timing){
+    *timing = sim->timing;
+}
+
+/**
+ * Programs every TransferData before its response instead of confirming it before programming
+ * (FLASHING_PIPELINED_TRANSFER_DATA), e.g. to compare the flashing time. The setting is kept on resets like the timing.
+ *
+ * @param sequential    1 = Programmed before the response, 0 = As configured in flashing.h
+ */
+void simEcuSetSequentialTransferData(uint8_t sequential){
+    sim->sequential_transfer_data = sequential;
+    flashingSetPipelined(sequential ? 0 : FLASHING_PIPELINED_TRANSFER_DATA);
+}
+
+void simEcuGetStatistics(SimEcuStatistics *stats){
+    *stats = sim->stats;
+}
+
+void simEcuResetStatistics(void){
+    memset(&sim->stats, 0, sizeof(sim->stats));
+}
+
+/**
+ * Accounts an erase and program operation of the flash model and blocks the main loop for the modelled busy time,
+ * frames are still received meanwhile via the busy callback like by the RX interrupt on the real ECU
+ *
+ * @param pflash            1 for PFLASH, 0 for DFLASH
+ * @param erased_sectors    Number of erased sectors
+ * @param programmed_pages  Number of programmed pages
+ * @param program_errors    Number of pages programmed without being erased
+ */
+void simEcuFlashOperation(uint8_t pflash, uint32_t erased_sectors, uint32_t programmed_pages, uint32_t program_errors){
+    uint64_t busy_us = 0;
+
+    if(pflash){
+        sim->stats.pflash_erased_sectors += erased_sectors;
+        sim->stats.pflash_programmed_pages += programmed_pages;
+        busy_us = (uint64_t)erased_sectors * sim->timing.pflash_erase_sector_us + (uint64_t)programmed_pages * sim->timing.pflash_program_page_us;
+    }
+    else{
+        sim->stats.dflash_erased_sectors += erased_sectors;
+        sim->stats.dflash_programmed_pages += programmed_pages;
+        busy_us = (uint64_t)erased_sectors * sim->timing.dflash_erase_sector_us + (uint64_t)programmed_pages * sim->timing.dflash_program_page_us;
+    }
+    sim->stats.program_errors += program_errors;
+    sim->stats.flash_busy_us += busy_us;
+
+    if(busy_us == 0)
+        return;
+
+    // Other ECUs may be selected during the busy callback
+    SimEcu_Instance *ecu = sim;
+    ecu->flash_busy = 1;
+    if(ecu->busy_callback != NULL)
+        ecu->busy_callback(ecu->tx_context, busy_us);
+    else
+        delayUs(busy_us);
+    ecu->flash_busy = 0;
+}
+
+/*********************************************************************************************************************/
+/*-----------------------------------------Platform (can_driver.h, reset.h, Bsp.h)-----------------------------------*/
+/*********************************************************************************************************************/
+
+void canInitDriver(void (*processData)(uint32_t*, IfxCan_DataLengthCode)){
+    processDataFunction = processData;
+}
+
+uint8_t canDlcToLength(IfxCan_DataLengthCode dlc){
+    return sim_dlc_length[dlc & 0xF];
+}
+
+int canTransmitMessage(uint32_t canMessageID, uint8_t* data, size_t size){
+    if (size > SIM_ECU_MAX_FRAME_LEN) {
+        return -1;
+    }
+
+    sim->stats.tx_frames++;
+    if(sim->tx_callback != NULL)
+        sim->tx_callback(sim->tx_context, canMessageID, data, (uint8_t)size);
+    return 0;
+}
+
+void softReset(void){
+    sim->reset_pending = 1;
+}
+
+void hardReset(void){
+    sim->reset_pending = 1;
+}
+
+Ifx_TickTime now(void){
+#if defined(_WIN32)
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (Ifx_TickTime)(counter.QuadPart / freq.QuadPart * 1000000 + (counter.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (Ifx_TickTime)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+Ifx_TickTime elapsed(Ifx_TickTime since){
+    return now() - since;
+}
+
+void waitTime(Ifx_TickTime timeout){
+    if(timeout > 0)
+        delayUs((uint64_t)timeout);
+}
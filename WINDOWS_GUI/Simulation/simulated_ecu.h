@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : simulated_ecu.h
+// Author      : Michael Bauer
+// Version     : 0.3
+// Copyright   : MIT
+// Description : Host simulation of the bootloader ECU (bootloader sources on top of a CAN and flash model)
+//============================================================================
+
+#ifndef SIMULATION_SIMULATED_ECU_H_
+#define SIMULATION_SIMULATED_ECU_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************************************************************************************************************/
+/*------------------------------------------------------Macros-------------------------------------------------------*/
+/*********************************************************************************************************************/
+
+#define SIM_ECU_MAX_FRAME_LEN               (64)            /* Classic CAN and CAN FD frames */
+#define SIM_ECU_MAX_DID_LEN                 (32)            /* Largest DID (FBL_DID_SYSTEM_NAME_BYTES_SIZE) */
+#define SIM_ECU_MAX_INSTANCES               (16)            /* Simulated ECUs per process */
+#define SIM_ECU_NO_INSTANCE                 (0xFF)          /* Returned by simEcuCreate on failure */
+
+/*********************************************************************************************************************/
+/*-------------------------------------------------Data Structures---------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/* Frame transmitted by the simulated ECU, called from the thread running simEcuRxFrame/simEcuCyclic */
+typedef void (*SimEcuTxCallback)(void *context, uint32_t id, const uint8_t *data, uint8_t len);
+
+/* Called while the flash is busy for busy_us, the ECU main loop is blocked. Frames received meanwhile are passed to
+ * simEcuRxFrame like the RX interrupt of the CAN driver. Without callback the calling thread sleeps.
+ * Other ECUs may be selected meanwhile, the ECU of the callback must be selected again before returning */
+typedef void (*SimEcuBusyCallback)(void *context, uint64_t busy_us);
+
+/* Modelled busy time of the flash, the ECU is blocked accordingly. 0 runs at host speed */
+typedef struct {
+    uint32_t pflash_erase_sector_us;        /* Erase of one logical PFLASH sector (16 KB) */
+    uint32_t pflash_program_page_us;        /* Program of one PFLASH page (32 bytes) */
+    uint32_t dflash_erase_sector_us;        /* Erase of one DFLASH sector (4 KB) */
+    uint32_t dflash_program_page_us;        /* Program of one DFLASH page (8 bytes) */
+} SimEcuTiming;
+
+typedef struct {
+    uint32_t rx_frames;                     /* Frames received by the ECU */
+    uint32_t tx_frames;                     /* Frames transmitted by the ECU */
+    uint32_t resets;                        /* ECU resets requested via UDS */
+    uint32_t pflash_erased_sectors;         /* Erased logical PFLASH sectors */
+    uint32_t pflash_programmed_pages;       /* Programmed PFLASH pages */
+    uint32_t dflash_erased_sectors;         /* Erased DFLASH sectors */
+    uint32_t dflash_programmed_pages;       /* Programmed DFLASH pages */
+    uint32_t program_errors;                /* Pages programmed without being erased before (ECC error on the real flash) */
+    uint64_t flash_busy_us;                 /* Modelled busy time of all erase and program operations */
+    uint32_t rx_frames_flash_busy;          /* Frames received while the flash was busy (bus transfer overlapping programming) */
+} SimEcuStatistics;
+
+/*********************************************************************************************************************/
+/*------------------------------------------------Function Prototypes------------------------------------------------*/
+/*********************************************************************************************************************/
+
+/* The bootloader sources use global variables, so the functions act on the selected simulated ECU. Each ECU has its own
+ * flash model, its bootloader RAM is swapped on simEcuSelect. It is not thread safe, only one thread at a time may
+ * drive the ECUs. */
+
+// Instances
+uint8_t simEcuCreate(void);
+uint8_t simEcuInstances(void);
+void simEcuSelect(uint8_t instance);
+uint8_t simEcuSelected(void);
+
+// ECU
+void simEcuPowerOn(SimEcuTxCallback tx, SimEcuBusyCallback busy, void *context);
+void simEcuPowerOff(void);
+void simEcuRxFrame(uint32_t id, const uint8_t *data, uint8_t len);
+void simEcuCyclic(void);
+uint32_t simEcuGetID(void);
+uint8_t simEcuReadDID(uint16_t did, uint8_t *data, uint8_t *len);
+uint8_t simEcuWriteDID(uint16_t did, uint8_t *data, uint8_t len);
+uint8_t simEcuAddrInRange(uint32_t address, uint32_t len);
+
+// Flash model
+void simEcuSetTiming(const SimEcuTiming *timing);
+void simEcuGetTiming(SimEcuTiming *timing);
+void simEcuSetSequentialTransferData(uint8_t sequential);
+void simEcuGetStatistics(SimEcuStatistics *stats);
+void simEcuResetStatistics(void);
+uint8_t simEcuReadMemory(uint32_t address, uint8_t *data, uint32_t len);
+void simEcuEraseFlash(void);
+
+// Internal - called by the flash model (flash_driver_sim.c)
+void simEcuFlashOperation(uint8_t pflash, uint32_t erased_sectors, uint32_t programmed_pages, uint32_t program_errors);
+void *simEcuFlashCreate(void);
+void simEcuFlashSelect(void *flash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIMULATION_SIMULATED_ECU_H_ */
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : simulated_ecu_symbols.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Renames the C symbols of the bootloader that also exist in the GUI (UDS_Spec/uds_comm_spec.cpp),
+//               included in front of every source of the simulated ECU. This way the simulated ECU runs the
+//               bootloader's own copy of uds_comm_spec.c while being linked into the GUI.
+//============================================================================
+
+#ifndef SIMULATION_SIMULATED_ECU_SYMBOLS_H_
+#define SIMULATION_SIMULATED_ECU_SYMBOLS_H_
+
+#define prepare_message                          simEcu_prepare_message
+#define upload_download_message                  simEcu_upload_download_message
+#define rx_consecutive_frame                     simEcu_rx_consecutive_frame
+#define rx_is_consecutive_frame                  simEcu_rx_is_consecutive_frame
+#define rx_is_flow_control_frame                 simEcu_rx_is_flow_control_frame
+#define rx_is_single_Frame                       simEcu_rx_is_single_Frame
+#define rx_is_starting_frame                     simEcu_rx_is_starting_frame
+#define rx_starting_frame                        simEcu_rx_starting_frame
+#define tx_consecutive_frame                     simEcu_tx_consecutive_frame
+#define tx_flow_control_frame                    simEcu_tx_flow_control_frame
+#define tx_starting_frame                        simEcu_tx_starting_frame
+#define _create_diagnostic_session_control       simEcu__create_diagnostic_session_control
+#define _create_ecu_reset                        simEcu__create_ecu_reset
+#define _create_neg_response                     simEcu__create_neg_response
+#define _create_read_data_by_ident               simEcu__create_read_data_by_ident
+#define _create_read_memory_by_address           simEcu__create_read_memory_by_address
+#define _create_request_download                 simEcu__create_request_download
+#define _create_request_download_format          simEcu__create_request_download_format
+#define _create_request_transfer_exit            simEcu__create_request_transfer_exit
+#define _create_request_upload                   simEcu__create_request_upload
+#define _create_request_upload_sector_map        simEcu__create_request_upload_sector_map
+#define _create_security_access                  simEcu__create_security_access
+#define _create_tester_present                   simEcu__create_tester_present
+#define _create_transfer_data                    simEcu__create_transfer_data
+#define _create_write_data_by_ident              simEcu__create_write_data_by_ident
+
+#endif /* SIMULATION_SIMULATED_ECU_SYMBOLS_H_ */
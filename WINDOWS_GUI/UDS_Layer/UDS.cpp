@@ -5,34 +5,47 @@
 //============================================================================
 // Name        : UDS.cpp
 // Author      : Michael Bauer, Wiktor Pilarczyk
-// Version     : 0.3
+// Version     : 0.9
 // Copyright   : MIT
 // Description : Qt UDS Layer implementation
 //============================================================================
 
 #include <QDebug>
-#include <QDateTime>
+#include <QElapsedTimer>
 
 #include "UDS.hpp"
 
+#include "../flashtrace.h"
 #include "../UDS_Spec/uds_comm_spec.h"
 
 UDS::UDS(){
     this->init = 0;
+    this->rx_exp_id = 0;
+    this->trace_start_ns = 0;
+    this->async_window_default = 1;
+    this->async_pending = 0;
+    this->async_clock.start();
 }
 
 UDS::UDS(uint8_t gui_id) {
 	this->gui_id = gui_id;
     this->init = 1;
+    this->rx_exp_id = 0;
     this->ecu_rec_buffer_size = 0;
+    this->ecu_rec_erased_bytes = 0;
+    this->ecu_rec_erase_total_bytes = 0;
+    this->ecu_rec_programmed_start = 0;
+    this->ecu_rec_programmed_bytes = 0;
+    this->trace_start_ns = 0;
+    this->async_window_default = 1;
+    this->async_pending = 0;
+    this->async_clock.start();
 
     // Default: Sync-Mode is turned on
     this->synchronized_rx_tx = true;
 
     // Initialize the comm flag
-    comm_mutex.lock();
-    _comm = false;
-    comm_mutex.unlock();
+    releaseComm();
 }
 
 UDS::~UDS() {
@@ -63,6 +76,43 @@ uint32_t UDS::getECUChecksum() {
     return ecu_rec_checksum;
 }
 
+/**
+ * @brief Returns the checksums of the last Request Upload in FBL_CHECKSUM_MODE_SECTOR_MAP, the first one belongs to
+ *        the sector (FBL_CHECKSUM_SECTOR_LENGTH) containing the requested address
+ * @return One checksum per sector, only one entry for a single checksum
+ */
+QList<uint32_t> UDS::getECUSectorChecksums() {
+    return ecu_rec_sector_checksums;
+}
+
+/**
+ * @brief Returns the erase progress of the last Read Data By Identifier of FBL_DID_ERASE_PROGRESS
+ * @param total Set to the number of bytes of the current download
+ * @return Number of bytes of the download that are erased, equal to total once the erase is done
+ */
+uint32_t UDS::getECUEraseProgress(uint32_t *total) {
+    *total = ecu_rec_erase_total_bytes;
+    return ecu_rec_erased_bytes;
+}
+
+/**
+ * @brief Returns the programmed data of the last download of the last Read Data By Identifier of FBL_DID_PROGRAMMED_OFFSET
+ * @param start Set to the start address of the download, 0 if the ECU does not know the programmed data
+ * @return Number of bytes from the start address on that are programmed
+ */
+uint32_t UDS::getECUProgrammedOffset(uint32_t *start) {
+    *start = ecu_rec_programmed_start;
+    return ecu_rec_programmed_bytes;
+}
+
+const WaitStatistics &UDS::getWaitStatistics() {
+    return wait_stats;
+}
+
+void UDS::resetWaitStatistics() {
+    wait_stats.reset();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Private - Receiving UDS Messages
 //////////////////////////////////////////////////////////////////////////////
@@ -90,10 +140,32 @@ void UDS::rxMsgCopyToBuffer(uint8_t* data, int len){
 
 void UDS::messageInterpreter(unsigned int id, uint8_t *data, uint32_t no_bytes){
 
-    // Initialize the Msg flags
-    rx_msg_valid = false;
-    rx_msg_neg_resp = false;
-    ecu_rec_nrc = 0;
+    // Responses to asynchronous requests are correlated by ECU ID and SID, the synchronous request is not affected
+    QSharedPointer<AsyncState> async_req;
+    if(no_bytes > 0){
+        uint8_t req_sid = (data[0] == FBL_NEGATIVE_RESPONSE && no_bytes >= 3) ? data[1] : (uint8_t)(data[0] & ~FBL_SID_ACK);
+        async_req = takeAsyncRequest(id, req_sid);
+    }
+
+    const uint8_t *exp_data = rx_exp_data;
+    int exp_no_bytes = rx_no_bytes;
+    if(async_req){
+        exp_data = async_req->rx_exp_data;
+        exp_no_bytes = async_req->rx_no_bytes;
+    }
+    else{
+        // Responses of other ECUs belong to other sessions on the bus (e.g. parallel flashing), except for a broadcast
+        uint32_t rx_exp_ecu = rx_exp_id & FBLCAN_ECU_ID_MASK;
+        if(rx_exp_ecu != 0 && (id & FBLCAN_ECU_ID_MASK) != rx_exp_ecu){
+            if(VERBOSE_UDS) qInfo() << ">> UDS INFO: Ignoring message of ID" << QString("0x%1").arg(id, 8, 16, QLatin1Char( '0' ));
+            return;
+        }
+
+        // Initialize the Msg flags
+        rx_msg_valid = false;
+        rx_msg_neg_resp = false;
+        ecu_rec_nrc = 0;
+    }
 
     QString s;
     QTextStream out(&s);
@@ -108,19 +180,23 @@ void UDS::messageInterpreter(unsigned int id, uint8_t *data, uint32_t no_bytes){
     // 1. Checking on Negative Response
     uint8_t SID = data[0];
     bool neg_resp = false;
+    uint8_t nrc = 0;
     QString neg_resp_code = "";
     if(SID == FBL_NEGATIVE_RESPONSE && no_bytes >= 3) {
         neg_resp = true;
-        rx_msg_neg_resp = true;
-        ecu_rec_nrc = data[2];
+        nrc = data[2];
+        if(!async_req){
+            rx_msg_neg_resp = true;
+            ecu_rec_nrc = data[2];
+        }
         SID = data[1];
         neg_resp_code = translateNegResp(data[2]);
         out << "Negative Response (Negative Response Code:" << neg_resp_code << ")\n";
     }
 
     // 2. Do a precheck of the message, Ignore if SID does not fit
-    if((!neg_resp) && ((rx_no_bytes <= 0) || data[0] != rx_exp_data[0])){
-        qInfo() << ">> UDS INFO: Ignoring message - Received SID "<<QString("0x%1").arg(uint8_t(data[0]), 2, 16, QLatin1Char( '0' )) << " does not fit to expected SID "<< QString("0x%1").arg(uint8_t(rx_exp_data[0]), 2, 16, QLatin1Char( '0' ));
+    if((!neg_resp) && ((exp_no_bytes <= 0) || data[0] != exp_data[0])){
+        qInfo() << ">> UDS INFO: Ignoring message - Received SID "<<QString("0x%1").arg(uint8_t(data[0]), 2, 16, QLatin1Char( '0' )) << " does not fit to expected SID "<< QString("0x%1").arg(uint8_t(exp_data[0]), 2, 16, QLatin1Char( '0' ));
         return;
     }
 
@@ -139,31 +215,32 @@ void UDS::messageInterpreter(unsigned int id, uint8_t *data, uint32_t no_bytes){
     uint16_t did_raw;
     QString DID = "";
     QString read_data;
+    bool msg_valid = false;
 
     switch(SID) {
         case FBL_DIAGNOSTIC_SESSION_CONTROL:
             out << info + "Diagnostic Session Control" << SID_str << ID_str<<"\n";
 
             // Check on the relevant message - Session is correct
-            rx_msg_valid = rxMsgValid(neg_resp, true, rx_no_bytes, no_bytes, rx_exp_data, data, 1);
+            msg_valid = rxMsgValid(neg_resp, true, exp_no_bytes, no_bytes, exp_data, data, 1);
             break;
 
         case FBL_ECU_RESET:
             out << info + "ECU Reset " << SID_str << ID_str<<"\n";
             // Check on the relevant message - ECU Reset Type is correct
-            rx_msg_valid = rxMsgValid(neg_resp, true, rx_no_bytes, no_bytes, rx_exp_data, data, 1);
+            msg_valid = rxMsgValid(neg_resp, true, exp_no_bytes, no_bytes, exp_data, data, 1);
             break;
 
         case FBL_SECURITY_ACCESS:
             out << info + "Security Access "<< SID_str << ID_str<<"\n";
             // Check on the relevant message - Request Type is correct
-            rx_msg_valid = rxMsgValid(neg_resp, true, rx_no_bytes, no_bytes, rx_exp_data, data, 1);
+            msg_valid = rxMsgValid(neg_resp, true, exp_no_bytes, no_bytes, exp_data, data, 1);
             break;
 
         case FBL_TESTER_PRESENT:
             out << info + "Tester Present " << SID_str << ID_str<<"\n";
             // Check on the relevant message - Response Type is correct
-            rx_msg_valid = rxMsgValid(neg_resp, true, rx_no_bytes, no_bytes, rx_exp_data, data, 1);
+            msg_valid = rxMsgValid(neg_resp, true, exp_no_bytes, no_bytes, exp_data, data, 1);
             break;
 
         case FBL_READ_DATA_BY_IDENTIFIER:
@@ -177,30 +254,39 @@ void UDS::messageInterpreter(unsigned int id, uint8_t *data, uint32_t no_bytes){
             }
 
             // Check on the relevant message - Data is included, DID is correct
-            rx_msg_valid = rxMsgValid(neg_resp, false, rx_no_bytes, no_bytes, rx_exp_data, data, 2);
+            msg_valid = rxMsgValid(neg_resp, false, exp_no_bytes, no_bytes, exp_data, data, 2);
             signalContent[Key] = QString::number(did_raw)+"#"+read_data;
+
+            if(msg_valid && did_raw == FBL_DID_ERASE_PROGRESS && no_bytes == 3 + 8){
+                this->ecu_rec_erased_bytes = ((uint32_t)data[3] << 24) | ((uint32_t)data[4] << 16) | ((uint32_t)data[5] << 8) | data[6];
+                this->ecu_rec_erase_total_bytes = ((uint32_t)data[7] << 24) | ((uint32_t)data[8] << 16) | ((uint32_t)data[9] << 8) | data[10];
+            }
+            if(msg_valid && did_raw == FBL_DID_PROGRAMMED_OFFSET && no_bytes == 3 + 8){
+                this->ecu_rec_programmed_start = ((uint32_t)data[3] << 24) | ((uint32_t)data[4] << 16) | ((uint32_t)data[5] << 8) | data[6];
+                this->ecu_rec_programmed_bytes = ((uint32_t)data[7] << 24) | ((uint32_t)data[8] << 16) | ((uint32_t)data[9] << 8) | data[10];
+            }
             break;
 
         case FBL_READ_MEMORY_BY_ADDRESS:
             out << info + "Read Memory By Address "<< SID_str << ID_str<<"\n";
 
             // Check on the relevant message - Data is included, Adress is correct
-            rx_msg_valid = rxMsgValid(neg_resp, false, rx_no_bytes, no_bytes, rx_exp_data, data, 4);
+            msg_valid = rxMsgValid(neg_resp, false, exp_no_bytes, no_bytes, exp_data, data, 4);
             break;
 
         case FBL_WRITE_DATA_BY_IDENTIFIER:
             out << info + "Write Data By Identifier "<< SID_str << ID_str<<"\n";
 
             // Check on the relevant message - DID is correct
-            rx_msg_valid = rxMsgValid(neg_resp, true, rx_no_bytes, no_bytes, rx_exp_data, data, 2);
+            msg_valid = rxMsgValid(neg_resp, true, exp_no_bytes, no_bytes, exp_data, data, 2);
             break;
 
         case FBL_REQUEST_DOWNLOAD:
             out << info + "Request Download "<< SID_str << ID_str<<"\n";
 
             // Check on the relevant message - Adress is correct
-            rx_msg_valid = rxMsgValid(neg_resp, true, rx_no_bytes, no_bytes, rx_exp_data, data, 4);
-            if(rx_msg_valid){
+            msg_valid = rxMsgValid(neg_resp, true, exp_no_bytes, no_bytes, exp_data, data, 4);
+            if(msg_valid){
                 this->ecu_rec_buffer_size = 0;
                 this->ecu_rec_buffer_size |= (data[5] << 24);
                 this->ecu_rec_buffer_size |= (data[6] << 16);
@@ -217,14 +303,13 @@ void UDS::messageInterpreter(unsigned int id, uint8_t *data, uint32_t no_bytes){
         case FBL_REQUEST_UPLOAD:
             out << info + "Request Upload "<< SID_str << ID_str<<"\n";
 
-            // Check on the relevant message - Adress is correct
-            rx_msg_valid = rxMsgValid(neg_resp, true, rx_no_bytes, no_bytes, rx_exp_data, data, 4);
-            if (rx_msg_valid) {
-                this->ecu_rec_checksum = 0;
-                this->ecu_rec_checksum |= (data[5] << 24);
-                this->ecu_rec_checksum |= (data[6] << 16);
-                this->ecu_rec_checksum |= (data[7] << 8);
-                this->ecu_rec_checksum |= data[8];
+            // Check on the relevant message - Adress is correct, a sector map (FBL_CHECKSUM_MODE_SECTOR_MAP) has more than one checksum
+            msg_valid = rxMsgValid(neg_resp, no_bytes <= 9, exp_no_bytes, no_bytes, exp_data, data, 4) && (no_bytes - 5) % 4 == 0;
+            this->ecu_rec_sector_checksums.clear();
+            if (msg_valid) {
+                for (uint32_t idx = 5; idx + 3 < no_bytes; idx += 4)
+                    this->ecu_rec_sector_checksums.append(((uint32_t)data[idx] << 24) | ((uint32_t)data[idx+1] << 16) | ((uint32_t)data[idx+2] << 8) | data[idx+3]);
+                this->ecu_rec_checksum = this->ecu_rec_sector_checksums.first();
             } else {
                 this->ecu_rec_checksum = 0;
             }
@@ -235,14 +320,14 @@ void UDS::messageInterpreter(unsigned int id, uint8_t *data, uint32_t no_bytes){
             out << info + "Transfer Data "<< SID_str << ID_str<<"\n";
 
             // Check on the relevant message - Adress is correct
-            rx_msg_valid = rxMsgValid(neg_resp, true, rx_no_bytes, no_bytes, rx_exp_data, data, 4);
+            msg_valid = rxMsgValid(neg_resp, true, exp_no_bytes, no_bytes, exp_data, data, 4);
             break;
 
         case FBL_REQUEST_TRANSFER_EXIT:
             out << info + "Request Transfer Exit "<< SID_str << ID_str<<"\n";
 
             // Info: Response includes the end address. There is no content check here
-            rx_msg_valid = true;
+            msg_valid = true;
             break;
         case FBL_RESET_TO_BOOTLOADER:
             out << info + "ERROR - we should not receive RESET_TO_BOOTLOADER "<< SID_str << ID_str<<"\n";
@@ -257,12 +342,18 @@ void UDS::messageInterpreter(unsigned int id, uint8_t *data, uint32_t no_bytes){
     qInfo() << infoString;
     emit toConsole(infoString);
 
+    if(async_req){
+        finishAsync(async_req, neg_resp ? RX_NEG_RESP : (msg_valid ? TX_RX_OK : TX_RX_NOK), nrc, data, no_bytes);
+        if(msg_valid && !neg_resp)
+            emit ecuResponse(signalContent);
+        return;
+    }
+
     // Only release
+    rx_msg_valid = msg_valid;
     if (rx_msg_valid) {
         // Release the communication flag
-        comm_mutex.lock();
-        _comm = false;
-        comm_mutex.unlock();
+        releaseComm();
 
         // Signal the response
         emit ecuResponse(signalContent);
@@ -295,6 +386,7 @@ void UDS::txMessageSend(uint32_t id, uint8_t *msg, int len) {
 	// Set the right ID to be used for transmitting
     if(VERBOSE_UDS) qInfo("UDS: Sending Signal setID");
     emit setID(id); // TODO: Check Architecture how to handle interface
+    rx_exp_id = id; // Response is expected from the addressed ECU
 
     // Wrap data into QByteArray
     QByteArray qbdata;
@@ -304,26 +396,49 @@ void UDS::txMessageSend(uint32_t id, uint8_t *msg, int len) {
     // Free the allocated memory of msg
     free(msg);
 
+    // Request/Response pair for the timing trace, ends with rxMessageValid
+    trace_start_ns = FlashTrace::current() != nullptr ? FlashTrace::nowNs() : 0;
+    if(trace_start_ns != 0)
+        trace_request = qbdata.left(4);
+
     // 4. Transmit the data on the bus
     if(VERBOSE_UDS) qInfo() << "UDS: Sending Signal txData with " << len << " bytes";
     emit txData(qbdata);
 }
 
 const UDS::RESP UDS::rxMessageValid(uint32_t waittime) {
-    if(rx_no_bytes == 0)
-        return RX_ERROR;
+    RESP res = RX_ERROR;
+    if(rx_no_bytes > 0){
+        // 5. Wait on RX message interpreter
+        res = checkOnResponse(waittime);
 
-    // 5. Wait on RX message interpreter
-    RESP res = checkOnResponse(waittime);
-    if( res == TX_RX_OK){
         // Check on result of message interpreter
-        if (rx_msg_valid)
-            return TX_RX_OK;
-        else
-            return TX_RX_NOK;
+        if(res == TX_RX_OK && !rx_msg_valid)
+            res = TX_RX_NOK;
     }
-    else
-        return res;
+
+    traceRequest(res);
+    return res;
+}
+
+/**
+ * @brief Records the request/response pair sent with the last txMessageSend in the timing trace of the thread
+ * @param resp Result of the request
+ */
+void UDS::traceRequest(RESP resp){
+    FlashTrace *trace = FlashTrace::current();
+    if(trace == nullptr || trace_start_ns == 0)
+        return;
+
+    static const char *resp_names[] = {"NO_INIT", "STILL_BUSY", "TX_FREE", "RX_NO_RESPONSE", "RX_ERROR", "TX_RX_OK", "TX_RX_NOK", "TX_OK", "RX_NEG_RESP"};
+    QJsonObject args;
+    args["request"] = QString(trace_request.toHex(' ').toUpper());
+    args["resp"] = resp_names[resp];
+    if(resp == TX_RX_NOK && rx_msg_neg_resp)
+        args["nrc"] = translateNegResp(ecu_rec_nrc);
+
+    trace->complete("uds", translateSID(trace_request.isEmpty() ? 0 : (uint8_t)trace_request[0]), trace_start_ns, FlashTrace::nowNs(), args);
+    trace_start_ns = 0;
 }
 
 /**
@@ -354,9 +469,7 @@ UDS::RESP UDS::reqIdentification() { // broadcast for tester present
     txMessageSend(id, msg, len);
 
     // Release the communication flag
-    comm_mutex.lock();
-    _comm = false;
-    comm_mutex.unlock();
+    releaseComm();
 
     return TX_OK;
 }
@@ -512,9 +625,7 @@ UDS::RESP UDS::testerPresent(uint32_t id) {
     rx_no_bytes = 0;
 
     // Release the communication flag
-    comm_mutex.lock();
-    _comm = false;
-    comm_mutex.unlock();
+    releaseComm();
 
     txMessageSend(send_id, msg, len);
 
@@ -659,9 +770,10 @@ UDS::RESP UDS::writeDataByIdentifier(uint32_t id, uint16_t identifier, uint8_t*
  * @param id Target ID
  * @param address Target Memory Address
  * @param no_bytes Number of bytes to be downloaded to ECU ID
+ * @param data_format dataFormatIdentifier, e.g. FBL_DATA_FORMAT_LZ4 for compressed Transfer Data. Not sent for FBL_DATA_FORMAT_UNCOMPRESSED
  * @return UDS::RESP accordingly
  */
-UDS::RESP UDS::requestDownload(uint32_t id, uint32_t address, uint32_t no_bytes) {
+UDS::RESP UDS::requestDownload(uint32_t id, uint32_t address, uint32_t no_bytes, uint8_t data_format) {
     UDS::RESP resp = txMessageStart();
     if(resp != TX_OK){
         return resp;
@@ -675,7 +787,11 @@ UDS::RESP UDS::requestDownload(uint32_t id, uint32_t address, uint32_t no_bytes)
     emit toConsole("<< UDS: Request Download" + id_str);
 
 	int len;
-	uint8_t *msg = _create_request_download(&len, 0, address, no_bytes); 
+	uint8_t *msg;
+    if(data_format == FBL_DATA_FORMAT_UNCOMPRESSED)
+        msg = _create_request_download(&len, 0, address, no_bytes);
+    else
+        msg = _create_request_download_format(&len, address, no_bytes, data_format);
 
     rx_no_bytes = 0;
     uint8_t *temp_rx_exp_data = _create_request_download(&rx_no_bytes, 1, address, 0); // ECU need to response with the buffer size for bytes_size
@@ -741,9 +857,7 @@ UDS::RESP UDS::resetToBootloader(uint32_t canID) {
     txMessageSend(send_id, msg, len); 
 
     // Release the communication flag
-    comm_mutex.lock();
-    _comm = false;
-    comm_mutex.unlock(); 
+    releaseComm();
 
     return TX_OK;
 }
@@ -810,7 +924,8 @@ UDS::RESP UDS::requestTransferExit(uint32_t id, uint32_t address) {
     free(temp_rx_exp_data);
 
     txMessageSend(send_id, msg, len);
-    return rxMessageValid(rx_max_waittime_general);
+    // ECU programs the last confirmed Transfer Data before responding
+    return rxMessageValid(rx_max_waittime_flashing);
 }
 
 // Supported Common Response Codes
@@ -849,15 +964,310 @@ UDS::RESP UDS::negativeResponse(uint32_t id, uint8_t rej_sid, uint8_t neg_resp_c
     txMessageSend(send_id, msg, len);
 
     // Release the communication flag
-    comm_mutex.lock();
-    _comm = false;
-    comm_mutex.unlock();
+    releaseComm();
 
     if(synchronized_rx_tx)
         return TX_RX_OK;
     return TX_OK;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Public - Sending asynchronous TX UDS Messages
+//////////////////////////////////////////////////////////////////////////////
+
+UDS::AsyncRequest::AsyncRequest(){
+    this->uds = nullptr;
+}
+
+/**
+ * @brief Checks if the request is finished (response received, timeout or error)
+ * @return true if the result is available
+ */
+bool UDS::AsyncRequest::isFinished() const {
+    if(!state)
+        return true;
+
+    uds->async_mutex.lock();
+    bool finished = state->finished;
+    uds->async_mutex.unlock();
+    return finished;
+}
+
+/**
+ * @brief Blocks until the request is finished. Transmits the queued requests of the UDS instance meanwhile
+ * @param timeout_ms Max time to wait
+ * @return true if the request is finished, false on timeout
+ */
+bool UDS::AsyncRequest::wait(unsigned long timeout_ms){
+    if(!state)
+        return true;
+    return uds->waitOnAsync(state, timeout_ms);
+}
+
+/**
+ * @brief Returns the result of the request, resp is RX_NO_RESPONSE while the request is not finished
+ * @return Result of the request
+ */
+UDS::AsyncResult UDS::AsyncRequest::result() const {
+    if(!state)
+        return {0, 0, NO_INIT, 0, QByteArray()};
+
+    uds->async_mutex.lock();
+    AsyncResult result = state->result;
+    uds->async_mutex.unlock();
+    return result;
+}
+
+/**
+ * @brief Sets the max number of outstanding asynchronous requests per ECU, the following requests are queued until a response arrives
+ * @param window Max outstanding requests of ECUs without own window, 1 by default (the ECU processes one request after the other)
+ */
+void UDS::setAsyncWindow(uint8_t window){
+    async_mutex.lock();
+    async_window_default = window > 0 ? window : 1;
+    async_mutex.unlock();
+}
+
+/**
+ * @brief Sets the max number of outstanding asynchronous requests for the given ECU ID
+ * @param id Target ID
+ * @param window Max outstanding requests, e.g. for ECUs buffering requests
+ */
+void UDS::setAsyncWindow(uint32_t id, uint8_t window){
+    async_mutex.lock();
+    async_windows[id] = window > 0 ? window : 1;
+    async_mutex.unlock();
+}
+
+/**
+ * @brief Asynchronous version of diagnosticSessionControl
+ * @param id Target ID
+ * @param session Target Session
+ * @param callback Called once the request is finished, optional
+ * @return Handle of the request
+ */
+UDS::AsyncRequest UDS::diagnosticSessionControlAsync(uint32_t id, uint8_t session, AsyncCallback callback) {
+    int len;
+    uint8_t *msg = _create_diagnostic_session_control(&len, 0, session);
+
+    int exp_len = 0;
+    uint8_t *exp_data = _create_diagnostic_session_control(&exp_len, 1, session);
+
+    return txAsyncStart("Diagnostic Session Control", id, msg, len, exp_data, exp_len, rx_max_waittime_short, callback);
+}
+
+/**
+ * @brief Asynchronous version of testerPresentResponse
+ * @param id Target ID
+ * @param callback Called once the request is finished, optional
+ * @return Handle of the request
+ */
+UDS::AsyncRequest UDS::testerPresentResponseAsync(uint32_t id, AsyncCallback callback) {
+    int len;
+    uint8_t *msg = _create_tester_present(&len, 0, FBL_TESTER_PRES_WITH_RESPONSE);
+
+    int exp_len = 0;
+    uint8_t *exp_data = _create_tester_present(&exp_len, 1, FBL_TESTER_PRES_WITH_RESPONSE);
+
+    return txAsyncStart("Tester Present with Response", id, msg, len, exp_data, exp_len, rx_max_waittime_short, callback);
+}
+
+/**
+ * @brief Asynchronous version of readDataByIdentifier, the data is part of the result
+ * @param id Target ID
+ * @param identifier Data Identifier
+ * @param callback Called once the request is finished, optional
+ * @return Handle of the request
+ */
+UDS::AsyncRequest UDS::readDataByIdentifierAsync(uint32_t id, uint16_t identifier, AsyncCallback callback) {
+    int len;
+    uint8_t *msg = _create_read_data_by_ident(&len, 0, identifier, 0, 0);
+
+    int exp_len = 0;
+    uint8_t *exp_data = _create_read_data_by_ident(&exp_len, 1, identifier, 0, 0);
+
+    QString did_str = " for DID "+translateDID(identifier) + " ("+QString("0x%1").arg(identifier, 4, 16, QLatin1Char( '0' )) +")";
+    return txAsyncStart("Read Data By Identifier" + did_str, id, msg, len, exp_data, exp_len, rx_max_waittime_short, callback);
+}
+
+/**
+ * @brief Asynchronous version of writeDataByIdentifier
+ * @param id Target ID
+ * @param identifier Data Identifier
+ * @param data Given Data to be written, copied into the request
+ * @param data_len Length of the given data
+ * @param callback Called once the request is finished, optional
+ * @return Handle of the request
+ */
+UDS::AsyncRequest UDS::writeDataByIdentifierAsync(uint32_t id, uint16_t identifier, uint8_t* data, uint8_t data_len, AsyncCallback callback) {
+    int len;
+    uint8_t *msg = _create_write_data_by_ident(&len, 0, identifier, data, data_len);
+
+    int exp_len = 0;
+    uint8_t *exp_data = _create_write_data_by_ident(&exp_len, 1, identifier, 0, 0);
+
+    return txAsyncStart("Write Data By Identifier", id, msg, len, exp_data, exp_len, rx_max_waittime_general, callback);
+}
+
+/**
+ * @brief Asynchronous version of requestDownload, the buffer size of the ECU is part of the response data
+ * @param id Target ID
+ * @param address Target Memory Address
+ * @param no_bytes Number of bytes to be downloaded to ECU ID
+ * @param data_format dataFormatIdentifier, see requestDownload
+ * @param callback Called once the request is finished, optional
+ * @return Handle of the request
+ */
+UDS::AsyncRequest UDS::requestDownloadAsync(uint32_t id, uint32_t address, uint32_t no_bytes, uint8_t data_format, AsyncCallback callback) {
+    int len;
+    uint8_t *msg;
+    if(data_format == FBL_DATA_FORMAT_UNCOMPRESSED)
+        msg = _create_request_download(&len, 0, address, no_bytes);
+    else
+        msg = _create_request_download_format(&len, address, no_bytes, data_format);
+
+    int exp_len = 0;
+    uint8_t *exp_data = _create_request_download(&exp_len, 1, address, 0);
+
+    return txAsyncStart("Request Download", id, msg, len, exp_data, exp_len, rx_max_waittime_general, callback);
+}
+
+/**
+ * @brief Asynchronous version of transferData
+ * @param id Target ID
+ * @param address Target Memory Address
+ * @param data Data to be transferred, copied into the request
+ * @param data_len Number of bytes of the data
+ * @param callback Called once the request is finished, optional
+ * @return Handle of the request
+ */
+UDS::AsyncRequest UDS::transferDataAsync(uint32_t id, uint32_t address, uint8_t* data, uint32_t data_len, AsyncCallback callback) {
+    int len;
+    uint8_t *msg = _create_transfer_data(&len, 0, address, data, data_len);
+
+    int exp_len = 0;
+    uint8_t *exp_data = _create_transfer_data(&exp_len, 1, address, 0, 0);
+
+    return txAsyncStart("Transfer Data", id, msg, len, exp_data, exp_len, rx_max_waittime_flashing, callback);
+}
+
+/**
+ * @brief Asynchronous version of requestTransferExit
+ * @param id Target ID
+ * @param address Target Memory Address
+ * @param callback Called once the request is finished, optional
+ * @return Handle of the request
+ */
+UDS::AsyncRequest UDS::requestTransferExitAsync(uint32_t id, uint32_t address, AsyncCallback callback) {
+    int len;
+    uint8_t *msg = _create_request_transfer_exit(&len, 0, address);
+
+    int exp_len = 0;
+    uint8_t *exp_data = _create_request_transfer_exit(&exp_len, 1, address);
+
+    return txAsyncStart("Request Transfer Exit", id, msg, len, exp_data, exp_len, rx_max_waittime_flashing, callback);
+}
+
+/**
+ * @brief Finishes the timed out asynchronous requests and transmits the queued requests as far as the windows of the ECUs allow.
+ *        Called by the async requests and the waits. Needs to be called periodically if only callbacks are used.
+ *        Must not be called from the Communication RX thread, the transmission waits on Flow Control frames received there
+ */
+void UDS::processAsync(){
+    QList<QSharedPointer<AsyncState>> expired;
+    QList<QSharedPointer<AsyncState>> transmit;
+
+    async_mutex.lock();
+    qint64 now = async_clock.elapsed();
+    for(auto it = async_outstanding.begin(); it != async_outstanding.end(); ++it){
+        QList<QSharedPointer<AsyncState>> &outstanding = it.value();
+        for(int i = 0; i < outstanding.size();){
+            const QSharedPointer<AsyncState> &state = outstanding[i];
+            if(state->sent_ms >= 0 && now - state->sent_ms > (qint64)state->waittime)
+                expired.append(outstanding.takeAt(i));
+            else
+                i++;
+        }
+    }
+    for(auto it = async_queued.begin(); it != async_queued.end(); ++it){
+        QList<QSharedPointer<AsyncState>> &queued = it.value();
+        QList<QSharedPointer<AsyncState>> &outstanding = async_outstanding[it.key()];
+        uint8_t window = async_windows.value(it.key(), async_window_default);
+
+        // Registered as outstanding before the transmission, the response can arrive before txData returns
+        while(!queued.isEmpty() && outstanding.size() < window){
+            outstanding.append(queued.first());
+            transmit.append(queued.takeFirst());
+        }
+    }
+    async_mutex.unlock();
+
+    for(const QSharedPointer<AsyncState> &state : expired){
+        emit toConsole("UDS: ERROR - No response of ECU " + QString("0x%1").arg(state->result.id, 3, 16, QLatin1Char( '0' ))
+                       + " to SID " + QString("0x%1").arg(state->result.sid, 2, 16, QLatin1Char( '0' )));
+        finishAsync(state, RX_NO_RESPONSE, 0, nullptr, 0);
+    }
+
+    for(const QSharedPointer<AsyncState> &state : transmit){
+        if(VERBOSE_UDS) qInfo("UDS: Sending Signal setID");
+        emit setID(state->send_id);
+        if(VERBOSE_UDS) qInfo() << "UDS: Sending Signal txData with " << state->request.size() << " bytes";
+        emit txData(state->request);
+
+        async_mutex.lock();
+        state->sent_ms = async_clock.elapsed();
+        async_cond.wakeAll(); // Waiting threads take the timeout into account
+        async_mutex.unlock();
+    }
+}
+
+/**
+ * @brief Blocks until all asynchronous requests are finished. Transmits the queued requests meanwhile
+ * @param timeout_ms Max time to wait, every request times out on its own after the wait time of its service
+ * @return true if all requests are finished, false on timeout
+ */
+bool UDS::waitForAsync(unsigned long timeout_ms){
+    return waitOnAsync(QSharedPointer<AsyncState>(), timeout_ms);
+}
+
+/**
+ * @brief Translates a given SID into the name of the service according to UDS Communication documentation
+ * @param sid Given SID of a request
+ * @return
+ */
+QString UDS::translateSID(uint8_t sid){
+    switch(sid){
+    case FBL_DIAGNOSTIC_SESSION_CONTROL:
+        return QString("Diagnostic Session Control"); break;
+    case FBL_ECU_RESET:
+        return QString("ECU Reset"); break;
+    case FBL_SECURITY_ACCESS:
+        return QString("Security Access"); break;
+    case FBL_TESTER_PRESENT:
+        return QString("Tester Present"); break;
+    case FBL_READ_DATA_BY_IDENTIFIER:
+        return QString("Read Data By Identifier"); break;
+    case FBL_READ_MEMORY_BY_ADDRESS:
+        return QString("Read Memory By Address"); break;
+    case FBL_WRITE_DATA_BY_IDENTIFIER:
+        return QString("Write Data By Identifier"); break;
+    case FBL_REQUEST_DOWNLOAD:
+        return QString("Request Download"); break;
+    case FBL_REQUEST_UPLOAD:
+        return QString("Request Upload"); break;
+    case FBL_TRANSFER_DATA:
+        return QString("Transfer Data"); break;
+    case FBL_REQUEST_TRANSFER_EXIT:
+        return QString("Request Transfer Exit"); break;
+    case FBL_RESET_TO_BOOTLOADER:
+        return QString("Reset To Bootloader"); break;
+    case FBL_NEGATIVE_RESPONSE:
+        return QString("Negative Response"); break;
+    default:
+        return QString("SID unknown");
+    }
+}
+
 /**
  * @brief Translates a given Negative Response Code into a String representation according to UDS Communication documentation
  * @param nrc Given Negative Response Code for translation
@@ -931,6 +1341,12 @@ QString UDS::translateDID(uint16_t DID){
             return QString("CAN Base Mask"); break;
         case FBL_DID_CAN_ID:
             return QString("CAN ID"); break;
+        case FBL_DID_ERASE_PROGRESS:
+            return QString("Erase Progress"); break;
+        case FBL_DID_PROGRAMMED_OFFSET:
+            return QString("Programmed Offset"); break;
+        case FBL_DID_PERF_COUNTERS:
+            return QString("Performance Counters"); break;
         case FBL_DID_BL_WRITE_START_ADD_CORE0:
             return QString("Write Start Address Core 0"); break;
         case FBL_DID_BL_WRITE_END_ADD_CORE0:
@@ -1003,6 +1419,45 @@ QString UDS::readDIDData(uint16_t DID, uint8_t* data, uint32_t no_bytes){
             return retText; break;
         case FBL_DID_CAN_ID:
             return QString("Not yet supported"); break;
+        case FBL_DID_ERASE_PROGRESS:
+            if(no_bytes != 8)
+                return "Wrong Erase Progress format";
+            return QString::number(((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3]) + " of "
+                   + QString::number(((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7]) + " bytes erased";
+            break;
+        case FBL_DID_PROGRAMMED_OFFSET:
+            if(no_bytes != 8)
+                return "Wrong Programmed Offset format";
+            return QString::number(((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7]) + " bytes programmed from "
+                   + QString("0x%1").arg(((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3], 8, 16, QLatin1Char( '0' ));
+            break;
+        case FBL_DID_PERF_COUNTERS: {
+            // Table with one line per section, the ticks are converted with the STM frequency of the ECU
+            auto u32 = [data](uint32_t idx) {
+                return ((uint32_t)data[idx] << 24) | ((uint32_t)data[idx+1] << 16) | ((uint32_t)data[idx+2] << 8) | data[idx+3];
+            };
+            if(no_bytes < 5 || no_bytes != 5 + data[4] * 16u + 12)
+                return "Wrong Performance Counters format";
+
+            static const char *sections[] = {"Erase", "Program", "CRC", "ISO TP RX Frame", "UDS Request"};
+            uint32_t freq = u32(0);
+            double us_per_tick = freq > 0 ? 1000000.0 / freq : 0.0;
+
+            retText.append(QString("\n%1 %2 %3 %4 %5\n").arg("Section", -16).arg("Count", 10).arg("Total [ms]", 12).arg("Avg [us]", 10).arg("Max [us]", 10));
+            uint32_t idx = 5;
+            for(int i = 0; i < data[4]; i++, idx += 16){
+                uint32_t count = u32(idx);
+                uint64_t ticks = ((uint64_t)u32(idx+4) << 32) | u32(idx+8);
+                QString name = i < (int)(sizeof(sections) / sizeof(sections[0])) ? QString(sections[i]) : "Section " + QString::number(i);
+                retText.append(QString("%1 %2 %3 %4 %5\n").arg(name, -16).arg(count, 10)
+                               .arg(ticks * us_per_tick / 1000.0, 12, 'f', 1)
+                               .arg(count > 0 ? ticks * us_per_tick / count : 0.0, 10, 'f', 1)
+                               .arg(u32(idx+12) * us_per_tick, 10, 'f', 1));
+            }
+            retText.append("Negative Responses: " + QString::number(u32(idx)) + ", Busy Repeat Request: " + QString::number(u32(idx+4))
+                           + ", CAN RX FIFO Overrun Events: " + QString::number(u32(idx+8)));
+            return retText;
+        }
         case FBL_DID_BL_WRITE_START_ADD_CORE0:
             for(int i=0; i < no_bytes; i++)
                 retText.append(QString("%1").arg(data[i], 2, 16, QLatin1Char( '0' )));
@@ -1072,22 +1527,35 @@ uint32_t UDS::createCommonID(uint32_t base_id, uint8_t gui_id, uint32_t ecu_id){
 	return send_id;
 }
 
+/**
+ * @brief Releases the communication flag and wakes up all threads waiting on it
+ */
+void UDS::releaseComm(){
+    comm_mutex.lock();
+    _comm = false;
+    comm_cond.wakeAll();
+    comm_mutex.unlock();
+}
+
 /**
  * @brief Checks if the communication is free to send and receive message
  * @return STILL_BUSY if the communication is not free after max waiting time, TX_FREE if TX can be send
  */
 UDS::RESP UDS::checkOnFreeTX(){
+    WaitStatisticsScope scope(&wait_stats);
 
-    bool isCommBusy = true;
-    QDateTime start = QDateTime::currentDateTime();
-    do {
-        comm_mutex.lock();
-        isCommBusy = _comm;
-        comm_mutex.unlock();
-        if (start.msecsTo(QDateTime::currentDateTime()) > tx_max_waittime_free_tx){
+    QElapsedTimer timer;
+    timer.start();
+
+    comm_mutex.lock();
+    while(_comm){
+        qint64 remaining = (qint64)tx_max_waittime_free_tx - timer.elapsed();
+        if(remaining <= 0 || (!comm_cond.wait(&comm_mutex, remaining) && _comm)){
+            comm_mutex.unlock();
             return STILL_BUSY;
         }
-    } while(isCommBusy);
+    }
+    comm_mutex.unlock();
     return TX_FREE;
 }
 
@@ -1099,33 +1567,174 @@ UDS::RESP UDS::checkOnFreeTX(){
 UDS::RESP UDS::checkOnResponse(uint32_t waittime){
     // No synchronization of TX to RX
     if(!synchronized_rx_tx){
-        comm_mutex.lock();
-        _comm = false;
-        comm_mutex.unlock();
-
+        releaseComm();
         return TX_OK;
     }
 
-    bool isCommBusy = true;
-    QDateTime start = QDateTime::currentDateTime();
-    do {
-        comm_mutex.lock();
-        isCommBusy = _comm;
-        comm_mutex.unlock();
+    WaitStatisticsScope scope(&wait_stats);
+
+    QElapsedTimer timer;
+    timer.start();
 
-        if (start.msecsTo(QDateTime::currentDateTime()) > waittime){
+    // Sleeps until the message interpreter releases the communication flag
+    comm_mutex.lock();
+    while(_comm){
+        qint64 remaining = (qint64)waittime - timer.elapsed();
+        if(remaining <= 0 || (!comm_cond.wait(&comm_mutex, remaining) && _comm)){
             // Release the communication flag
-            comm_mutex.lock();
             _comm = false;
+            comm_cond.wakeAll();
             comm_mutex.unlock();
 
             return RX_NO_RESPONSE;
         }
-    } while(isCommBusy);
+    }
+    comm_mutex.unlock();
 
     return TX_RX_OK;
 }
 
+/**
+ * @brief Creates an asynchronous request and transmits it if the window of the ECU allows
+ * @param name Service name for the console
+ * @param id Target ID
+ * @param msg Request, is freed
+ * @param len Length of the request
+ * @param exp_data Data to be expected from ECU, is freed
+ * @param exp_len Number of bytes to be expected from ECU
+ * @param waittime Time to wait for the response after the transmission
+ * @param callback Called once the request is finished, optional
+ * @return Handle of the request
+ */
+UDS::AsyncRequest UDS::txAsyncStart(const QString &name, uint32_t id, uint8_t *msg, int len, uint8_t *exp_data, int exp_len, uint32_t waittime, AsyncCallback callback){
+    QSharedPointer<AsyncState> state(new AsyncState());
+    state->result = {id, msg[0], RX_NO_RESPONSE, 0, QByteArray()};
+    state->send_id = init ? createCommonID((uint32_t)FBLCAN_BASE_ADDRESS, this->gui_id, id) : 0;
+    state->request = QByteArray((const char*)msg, len);
+    state->rx_no_bytes = exp_len;
+    for(int i = 0; i < exp_len && i < RX_EXP_DATA_BUFFER_SIZE; i++)
+        state->rx_exp_data[i] = exp_data[i];
+    state->waittime = waittime;
+    state->sent_ms = -1;
+    state->finished = false;
+    state->callback = callback;
+    free(msg);
+    free(exp_data);
+
+    AsyncRequest request;
+    request.uds = this;
+    request.state = state;
+
+    async_mutex.lock();
+    async_pending++;
+    async_mutex.unlock();
+
+    // Responses are correlated by ECU ID, a broadcast has no unique response
+    if(!init || id == 0 || id > 0xFFF){
+        finishAsync(state, init ? RX_ERROR : NO_INIT, 0, nullptr, 0);
+        return request;
+    }
+
+    QString id_str = " using ID "+ QString("0x%1").arg(state->send_id, 8, 16, QLatin1Char( '0' ));
+    if(VERBOSE_UDS) qInfo() << "<< UDS:" << name << "(async)";
+    emit toConsole("<< UDS: " + name + " (async)" + id_str);
+
+    async_mutex.lock();
+    async_queued[id].append(state);
+    async_mutex.unlock();
+
+    processAsync();
+    return request;
+}
+
+/**
+ * @brief Takes the oldest outstanding asynchronous request of the sender with the given SID
+ * @param id Sender ID
+ * @param sid SID of the request
+ * @return The request, null if no asynchronous request of the sender waits for the SID
+ */
+QSharedPointer<UDS::AsyncState> UDS::takeAsyncRequest(uint32_t id, uint8_t sid){
+    QSharedPointer<AsyncState> state;
+    uint32_t ecu_id = (id & FBLCAN_ECU_ID_MASK) >> 4;
+
+    async_mutex.lock();
+    auto it = async_outstanding.find(ecu_id);
+    if(it != async_outstanding.end()){
+        QList<QSharedPointer<AsyncState>> &outstanding = it.value();
+        for(int i = 0; i < outstanding.size(); i++){
+            if(outstanding[i]->result.sid == sid){
+                state = outstanding.takeAt(i);
+                break;
+            }
+        }
+    }
+    async_mutex.unlock();
+    return state;
+}
+
+/**
+ * @brief Stores the result of an asynchronous request, wakes up the waiting threads and calls the callback
+ * @param state Request, not in the queued and outstanding lists anymore
+ * @param resp Result
+ * @param nrc Negative Response Code for RX_NEG_RESP
+ * @param data Response of the ECU, nullptr if none
+ * @param no_bytes Number of bytes of the response
+ */
+void UDS::finishAsync(const QSharedPointer<AsyncState> &state, RESP resp, uint8_t nrc, const uint8_t *data, uint32_t no_bytes){
+    async_mutex.lock();
+    state->result.resp = resp;
+    state->result.nrc = nrc;
+    if(data != nullptr)
+        state->result.data = QByteArray((const char*)data, no_bytes);
+    state->finished = true;
+    async_pending--;
+    AsyncResult result = state->result;
+    AsyncCallback callback = state->callback;
+    async_cond.wakeAll();
+    async_mutex.unlock();
+
+    if(callback)
+        callback(result);
+}
+
+/**
+ * @brief Blocks until the given or all asynchronous requests are finished. Transmits the queued requests and finishes timed out requests meanwhile
+ * @param state Request to wait on, null for all requests
+ * @param timeout_ms Max time to wait
+ * @return true if finished, false on timeout
+ */
+bool UDS::waitOnAsync(const QSharedPointer<AsyncState> &state, unsigned long timeout_ms){
+    WaitStatisticsScope scope(&wait_stats);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while(true){
+        processAsync();
+
+        async_mutex.lock();
+        bool finished = state ? state->finished : async_pending == 0;
+        qint64 remaining = timeout_ms == ULONG_MAX ? LLONG_MAX : (qint64)timeout_ms - timer.elapsed();
+        if(finished || remaining <= 0){
+            async_mutex.unlock();
+            return finished;
+        }
+
+        // Sleeps until a request is finished or transmitted, at most until the next transmitted request times out
+        qint64 now = async_clock.elapsed();
+        qint64 sleep = remaining;
+        for(const QList<QSharedPointer<AsyncState>> &outstanding : async_outstanding){
+            for(const QSharedPointer<AsyncState> &pending : outstanding){
+                if(pending->sent_ms >= 0)
+                    sleep = qMin(sleep, pending->sent_ms + (qint64)pending->waittime - now + 1);
+            }
+        }
+        if(sleep > 0)
+            async_cond.wait(&async_mutex, (unsigned long)qMin(sleep, (qint64)ULONG_MAX));
+        async_mutex.unlock();
+    }
+}
+
 
 //============================================================================
 // Slots
@@ -1133,15 +1742,7 @@ UDS::RESP UDS::checkOnResponse(uint32_t waittime){
 
 void UDS::rxDataReceiverSlot(const unsigned int id, const QByteArray &ba){
     if(VERBOSE_UDS) qInfo("UDS: Slot - Received UDS Message to be processed");
-    // Unwrap the data
 
-    uint8_t* msg = (uint8_t*)calloc(ba.size(), sizeof(uint8_t));
-    if (msg != nullptr){
-        for(int i= 0; i < ba.size(); i++){
-            msg[i] = ba[i];
-            //qInfo() << "Step " << i << "Data: " << msg[i];
-        }
-        this->messageInterpreter(id, msg, ba.size());
-        free(msg);
-    }
+    // messageInterpreter only reads the data, no copy needed
+    this->messageInterpreter(id, (uint8_t*)ba.constData(), ba.size());
 }
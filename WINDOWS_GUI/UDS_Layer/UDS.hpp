@@ -5,7 +5,7 @@
 //============================================================================
 // Name        : UDS.hpp
 // Author      : Michael Bauer, Wiktor Pilarczyk
-// Version     : 0.3
+// Version     : 0.6
 // Copyright   : MIT
 // Description : Qt UDS Layer implementation
 //============================================================================
@@ -18,10 +18,21 @@
 
 #include <QObject>
 #include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
 #include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#include <functional>
+#include <limits.h>
 
 #include "stdint.h"
 
+#include "../waitstatistics.h"
+#include "../UDS_Spec/uds_comm_spec.h"
+
 
 class UDS : public QObject{
     Q_OBJECT
@@ -29,6 +40,54 @@ class UDS : public QObject{
 public:
     enum RESP {NO_INIT, STILL_BUSY, TX_FREE, RX_NO_RESPONSE, RX_ERROR, TX_RX_OK, TX_RX_NOK, TX_OK, RX_NEG_RESP};
 
+    /**
+     * @brief Result of an asynchronous request
+     */
+    struct AsyncResult {
+        uint32_t id;                            // Target ECU ID
+        uint8_t sid;                            // SID of the request
+        RESP resp;                              // TX_RX_OK, TX_RX_NOK, RX_NEG_RESP, RX_NO_RESPONSE, NO_INIT or RX_ERROR (wrong ECU ID)
+        uint8_t nrc;                            // Negative Response Code for RX_NEG_RESP
+        QByteArray data;                        // Response of the ECU
+    };
+
+    /**
+     * @brief Called once an asynchronous request is finished. Runs in the thread receiving the response (Communication)
+     *        or in the thread detecting the timeout, must not block and must not send requests
+     */
+    typedef std::function<void(const AsyncResult &)> AsyncCallback;
+
+private:
+    struct AsyncState {
+        AsyncResult result;
+        uint32_t send_id;                       // TX ID of the request
+        QByteArray request;                     // Request to be transmitted
+        uint8_t rx_exp_data[RX_EXP_DATA_BUFFER_SIZE];   // Data to be expected from ECU
+        int rx_no_bytes;                        // No bytes to be expected from ECU
+        uint32_t waittime;                      // ms - Wait time for the response after the transmission
+        qint64 sent_ms;                         // Time of the transmission (async_clock), -1 while not transmitted
+        bool finished;
+        AsyncCallback callback;
+    };
+
+public:
+    /**
+     * @brief Handle (future) of an asynchronous request. The UDS instance needs to outlive the handle
+     */
+    class AsyncRequest {
+        friend class UDS;
+
+    private:
+        UDS *uds;
+        QSharedPointer<AsyncState> state;
+
+    public:
+        AsyncRequest();
+        bool isFinished() const;
+        bool wait(unsigned long timeout_ms = ULONG_MAX);
+        AsyncResult result() const;
+    };
+
 private:
     bool synchronized_rx_tx;                    // Flag to enable synchronized mode
 
@@ -45,6 +104,10 @@ private:
 
     bool _comm;                                 // For communication usage, only synchronized TX+RX is possible
     QMutex comm_mutex;                          // Protects _comm
+    QWaitCondition comm_cond;                   // Signalled with comm_mutex whenever _comm is released
+    WaitStatistics wait_stats;                  // Time spent in checkOnFreeTX and checkOnResponse
+    uint64_t trace_start_ns;                    // Transmission of the last request for the timing trace (FlashTrace), 0 if not traced
+    QByteArray trace_request;                   // First bytes of the last traced request
 
     unsigned int rx_exp_id;                     // ID to be expected for response of TX
     uint8_t rx_exp_data[RX_EXP_DATA_BUFFER_SIZE];                       // Data to be expected from ECU, if possible
@@ -55,6 +118,21 @@ private:
     uint8_t ecu_rec_nrc;                        // Used for any last UDS Message NRC
     uint32_t ecu_rec_buffer_size;               // Used for Request Download response -> ECU indicates the buffer size that could used for transfer data
     uint32_t ecu_rec_checksum;                      // Used for request upload response to store checksum calculated by the ECU
+    QList<uint32_t> ecu_rec_sector_checksums;   // Used for request upload response with FBL_CHECKSUM_MODE_SECTOR_MAP -> one checksum per sector
+    uint32_t ecu_rec_erased_bytes;              // Used for read data by identifier response of FBL_DID_ERASE_PROGRESS -> bytes erased ahead
+    uint32_t ecu_rec_erase_total_bytes;         // Used for read data by identifier response of FBL_DID_ERASE_PROGRESS -> bytes of the download
+    uint32_t ecu_rec_programmed_start;          // Used for read data by identifier response of FBL_DID_PROGRAMMED_OFFSET -> start address of the last download
+    uint32_t ecu_rec_programmed_bytes;          // Used for read data by identifier response of FBL_DID_PROGRAMMED_OFFSET -> programmed bytes of the last download
+
+    // Asynchronous requests, independent of _comm. Requests to different ECUs are outstanding at the same time
+    QMutex async_mutex;                         // Protects the asynchronous requests
+    QWaitCondition async_cond;                  // Signalled with async_mutex whenever an asynchronous request is finished or transmitted
+    QElapsedTimer async_clock;                  // Time base of AsyncState::sent_ms
+    QMap<uint32_t, QList<QSharedPointer<AsyncState>>> async_queued;      // Requests per ECU ID waiting for a free slot of the window
+    QMap<uint32_t, QList<QSharedPointer<AsyncState>>> async_outstanding; // Transmitted requests per ECU ID in the order of transmission
+    QMap<uint32_t, uint8_t> async_windows;      // Max outstanding requests per ECU ID
+    uint8_t async_window_default;               // Max outstanding requests of ECUs without own window
+    int async_pending;                          // Number of requests not finished yet
 
 public:
     UDS();
@@ -68,6 +146,13 @@ public:
     uint8_t getECUNegativeResponse();
     uint32_t getECUTransferDataBufferSize();
     uint32_t getECUChecksum();
+    QList<uint32_t> getECUSectorChecksums();
+    uint32_t getECUEraseProgress(uint32_t *total);
+    uint32_t getECUProgrammedOffset(uint32_t *start);
+
+    // Time spent waiting on free TX and on responses
+    const WaitStatistics &getWaitStatistics();
+    void resetWaitStatistics();
 
     // UDS TX
     // Sending out broadcast for tester present
@@ -88,7 +173,7 @@ public:
     RESP writeDataByIdentifier(uint32_t id, uint16_t identifier, uint8_t* data, uint8_t data_len);
 
 	// Specification for Upload | Download
-    RESP requestDownload(uint32_t id, uint32_t address, uint32_t no_bytes);
+    RESP requestDownload(uint32_t id, uint32_t address, uint32_t no_bytes, uint8_t data_format = FBL_DATA_FORMAT_UNCOMPRESSED);
     RESP requestUpload(uint32_t id, uint32_t address, uint32_t no_bytes);
     RESP transferData(uint32_t id, uint32_t address, uint8_t* data, uint32_t data_len);
     RESP requestTransferExit(uint32_t id, uint32_t address);
@@ -99,6 +184,20 @@ public:
 	// Supported Common Response Codes
     RESP negativeResponse(uint32_t id, uint8_t rej_sid, uint8_t neg_resp_code);
 
+    // UDS TX - Asynchronous, the response is correlated by ECU ID and SID
+    void setAsyncWindow(uint8_t window);
+    void setAsyncWindow(uint32_t id, uint8_t window);
+    AsyncRequest diagnosticSessionControlAsync(uint32_t id, uint8_t session, AsyncCallback callback = nullptr);
+    AsyncRequest testerPresentResponseAsync(uint32_t id, AsyncCallback callback = nullptr);
+    AsyncRequest readDataByIdentifierAsync(uint32_t id, uint16_t identifier, AsyncCallback callback = nullptr);
+    AsyncRequest writeDataByIdentifierAsync(uint32_t id, uint16_t identifier, uint8_t* data, uint8_t data_len, AsyncCallback callback = nullptr);
+    AsyncRequest requestDownloadAsync(uint32_t id, uint32_t address, uint32_t no_bytes, uint8_t data_format = FBL_DATA_FORMAT_UNCOMPRESSED, AsyncCallback callback = nullptr);
+    AsyncRequest transferDataAsync(uint32_t id, uint32_t address, uint8_t* data, uint32_t data_len, AsyncCallback callback = nullptr);
+    AsyncRequest requestTransferExitAsync(uint32_t id, uint32_t address, AsyncCallback callback = nullptr);
+    void processAsync();
+    bool waitForAsync(unsigned long timeout_ms = ULONG_MAX);
+
+    QString translateSID(uint8_t sid);
     QString translateNegResp(uint8_t nrc);
     QString translateDID(uint16_t DID);
     QString readDIDData(uint16_t DID, uint8_t* data, uint32_t no_bytes);
@@ -108,13 +207,20 @@ private:
     void rxMsgCopyToBuffer(uint8_t* data, int len);
     void messageInterpreter(unsigned int id, uint8_t *data, uint32_t no_bytes);
 
+    void releaseComm();
     RESP checkOnFreeTX();
     const RESP txMessageStart();
     void txMessageSend(uint32_t id, uint8_t *msg, int len);
     const RESP rxMessageValid(uint32_t waittime);
+    void traceRequest(RESP resp);
     RESP checkOnResponse(uint32_t waittime);
 	uint32_t createCommonID(uint32_t base_id, uint8_t gui_id, uint32_t ecu_id);
 
+    AsyncRequest txAsyncStart(const QString &name, uint32_t id, uint8_t *msg, int len, uint8_t *exp_data, int exp_len, uint32_t waittime, AsyncCallback callback);
+    QSharedPointer<AsyncState> takeAsyncRequest(uint32_t id, uint8_t sid);
+    void finishAsync(const QSharedPointer<AsyncState> &state, RESP resp, uint8_t nrc, const uint8_t *data, uint32_t no_bytes);
+    bool waitOnAsync(const QSharedPointer<AsyncState> &state, unsigned long timeout_ms);
+
 
 
 signals:
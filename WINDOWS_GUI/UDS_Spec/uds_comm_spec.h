@@ -6,7 +6,7 @@
 //============================================================================
 // Name        : uds_comm_spec.h
 // Author      : Michael Bauer, Leon Wilms, Wiktor Pilarczyk
-// Version     : 1.0
+// Version     : 1.1
 // Copyright   : MIT
 // Description : UDS communication specification for AMOS Flashbootloader
 //============================================================================
@@ -23,9 +23,12 @@ extern "C" {
 
 #define MAX_FRAME_LEN_CAN											(0x08)
 #define MAX_FRAME_LEN_CANFD                                         (0x40)
-#define MAX_ISOTP_MESSAGE_LEN                                       (4096)
+#define MAX_ISOTP_MESSAGE_LEN                                       (16384)
+#define ISOTP_FF_DL_12BIT_MAX                                       (0xFFF) // Longer messages use the First Frame escape sequence (32 bit length)
+#define ISOTP_PADDING_BYTE                                          (0xCC)  // Fills CAN FD frames up to the next valid DLC
 #define FBLCAN_IDENTIFIER_MASK								  		(0x0F24FFFF)
 #define FBLCAN_BASE_ADDRESS											(FBLCAN_IDENTIFIER_MASK & 0xFFFF0000)
+#define FBLCAN_ECU_ID_MASK                                          (0x0000FFF0) // ECU ID within the CAN ID, 0 addresses all ECUs (broadcast)
 
 //////////////////////////////////////////////////////////////////////////////
 // Supported Service Overview (SID)
@@ -131,6 +134,10 @@ extern "C" {
 #define FBL_DID_BL_KEY_GOOD_VALUE                                   (0xFD01)
 #define FBL_DID_CAN_BASE_MASK                                       (0xFD02)
 #define FBL_DID_CAN_ID                                              (0xFD03)
+#define FBL_DID_CHECKSUM_MODE                                       (0xFD04)
+#define FBL_DID_ERASE_PROGRESS                                      (0xFD05)
+#define FBL_DID_PROGRAMMED_OFFSET                                   (0xFD06)
+#define FBL_DID_PERF_COUNTERS                                       (0xFD07)
 #define FBL_DID_BL_WRITE_START_ADD_CORE0                            (0xFD10)
 #define FBL_DID_BL_WRITE_END_ADD_CORE0                              (0xFD11)
 #define FBL_DID_BL_WRITE_START_ADD_CORE1                            (0xFD12)
@@ -142,23 +149,52 @@ extern "C" {
 #define FBL_DID_BL_WRITE_START_ADD_CAL_DATA                         (0xFD18)
 #define FBL_DID_BL_WRITE_END_ADD_CAL_DATA                           (0xFD19)
 
+// Checksum of the Request Upload response (FBL_DID_CHECKSUM_MODE), not stored - the ECU starts with ASCII after reset
+#define FBL_CHECKSUM_MODE_ASCII                                     (0x00)  // CRC over the ASCII-Hex representation of the flash content (2 characters per byte)
+#define FBL_CHECKSUM_MODE_RAW                                       (0x01)  // CRC over the raw bytes of the flash content
+#define FBL_CHECKSUM_MODE_SECTOR_MAP                                (0x02)  // CRC over the raw bytes of every sector of the range (differential flashing)
+#define FBL_CHECKSUM_SECTOR_LENGTH                                  (0x4000)// Sector of FBL_CHECKSUM_MODE_SECTOR_MAP (16 KB, logical PFLASH sector)
+
+// dataFormatIdentifier of Request Download (high nibble = compression method, low nibble = encryption method)
+#define FBL_DATA_FORMAT_UNCOMPRESSED                                (0x00)  // Transfer Data payloads are the raw bytes (also without dataFormatIdentifier)
+#define FBL_DATA_FORMAT_LZ4                                         (0x10)  // Every Transfer Data payload is a LZ4 block, the address is the one of the decompressed data
+
+// Erase of the sectors of the current download ahead of the Transfer Data (FBL_DID_ERASE_PROGRESS), read only:
+// [Erased Bytes Byte 3..0][Bytes of the Request Download Byte 3..0], both are equal once the erase is done
+
+// Data of the last download that is in the flash (FBL_DID_PROGRAMMED_OFFSET), read only, kept after Transfer Exit and session changes:
+// [Start Address of the Request Download Byte 3..0][Programmed Bytes from the Start Address on Byte 3..0]
+// A Request Download starting at the end of the programmed bytes continues the download without erasing its last sector again
+
+// Performance counters of the bootloader since the last reset (FBL_DID_PERF_COUNTERS), all values big-endian:
+// [STM Tick Frequency in Hz Byte 3..0][Number of Sections N]
+// N times [Count Byte 3..0][Sum of Ticks Byte 7..0][Max Ticks Byte 3..0], Sections: Erase, Program, CRC, ISO TP RX Frame, UDS Request
+// [Negative Responses Byte 3..0][Busy Repeat Request Responses Byte 3..0][CAN RX FIFO Overruns Byte 3..0]
+// Writing the single byte FBL_PERF_COUNTERS_RESET sets all counters to 0
+#define FBL_PERF_COUNTERS_RESET                                     (0x00)
+
 //############################################################################
 
 //////////////////////////////////////////////////////////////////////////////
 // ISO TP Handling
 //////////////////////////////////////////////////////////////////////////////
 
+// Flow Control Flags (Flow Status)
+#define ISOTP_FC_FLAG_CONTINUE_TO_SEND                              (0x00)
+#define ISOTP_FC_FLAG_WAIT                                          (0x01)
+#define ISOTP_FC_FLAG_OVERFLOW                                      (0x02)
+
 
 uint8_t *tx_starting_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t max_len_per_frame, uint8_t* data_in, uint32_t data_in_len, uint32_t* data_out_idx_ctr);
 uint8_t *tx_consecutive_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t max_len_per_frame, uint8_t* data_in, uint32_t data_in_len, uint32_t* data_out_idx_ctr, uint8_t* frame_idx);
 uint8_t *tx_flow_control_frame(uint32_t *data_out_len, uint8_t flag, uint8_t blocksize, uint8_t sep_time_millis, uint8_t sep_time_multi_millis);
 
-uint8_t rx_is_starting_frame(uint8_t* data_in, uint32_t data_in_len, uint8_t max_len_per_frame);
-uint8_t rx_is_consecutive_frame(uint8_t* data_in, uint32_t data_in_len, uint8_t max_len_per_frame);
-uint8_t rx_is_single_Frame(uint8_t* data_in, uint32_t data_in_len, uint8_t max_len_per_frame);
-uint8_t rx_is_flow_control_frame(uint8_t* data_in, uint32_t data_in_len, uint8_t max_len_per_frame);
-uint8_t *rx_starting_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t max_len_per_frame, uint8_t* data_in, uint32_t data_in_len);
-uint8_t rx_consecutive_frame(uint32_t *data_out_len, uint8_t *data_out, uint32_t *has_next, uint32_t data_in_len, uint8_t* data_in, uint32_t *idx); // TODO: Error Handling for correct order
+uint8_t rx_is_starting_frame(const uint8_t* data_in, uint32_t data_in_len);
+uint8_t rx_is_consecutive_frame(const uint8_t* data_in, uint32_t data_in_len);
+uint8_t rx_is_single_Frame(const uint8_t* data_in, uint32_t data_in_len);
+uint8_t rx_is_flow_control_frame(const uint8_t* data_in, uint32_t data_in_len);
+uint8_t *rx_starting_frame(uint32_t *data_out_len, uint32_t *has_next, uint8_t* data_in, uint32_t data_in_len);
+uint8_t rx_consecutive_frame(uint32_t *data_out_len, uint8_t *data_out, uint32_t *has_next, uint32_t data_in_len, const uint8_t* data_in, uint32_t *idx); // TODO: Error Handling for correct order
 
 //////////////////////////////////////////////////////////////////////////////
 // Templates for UDS Messages
@@ -178,7 +214,9 @@ uint8_t *_create_write_data_by_ident(int *len, uint8_t response, uint16_t did, u
 
 // Specification for Upload | Download
 uint8_t *_create_request_download(int *len, uint8_t response, uint32_t add, uint32_t bytes_size);
+uint8_t *_create_request_download_format(int *len, uint32_t add, uint32_t bytes_size, uint8_t data_format);
 uint8_t *_create_request_upload(int *len, uint8_t response, uint32_t add, uint32_t bytes_size);
+uint8_t *_create_request_upload_sector_map(int *len, uint32_t add, const uint32_t *checksums, uint32_t num_checksums);
 uint8_t *_create_transfer_data(int *len, uint8_t response, uint32_t add, uint8_t* data, uint32_t data_len);
 uint8_t *_create_request_transfer_exit(int *len, uint8_t response, uint32_t add);
 
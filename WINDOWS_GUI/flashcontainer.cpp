@@ -0,0 +1,445 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : flashcontainer.cpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Precompiled flash container, memory-mapped by the FlashManager and used as cache of validated files
+//============================================================================
+
+#include "flashcontainer.h"
+#include "CCRC32.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QStandardPaths>
+
+#include <string.h>
+
+#include "UDS_Spec/uds_comm_spec.h"
+
+// The tables are used directly from the mapping, their layout must not depend on the compiler
+static_assert(sizeof(FlashContainer::Region) == 12, "Unexpected size of FlashContainer::Region");
+static_assert(sizeof(FlashContainer::Header) == 328, "Unexpected size of FlashContainer::Header");
+static_assert(sizeof(FlashContainer::Segment) == 24, "Unexpected size of FlashContainer::Segment");
+static_assert(sizeof(FlashContainer::Sector) == 8, "Unexpected size of FlashContainer::Sector");
+
+//============================================================================
+// Constructor
+//============================================================================
+
+FlashContainer::FlashContainer(){
+    mapped = nullptr;
+    header = nullptr;
+    segmentTable = nullptr;
+    sectorTable = nullptr;
+}
+
+FlashContainer::~FlashContainer(){
+    close();
+}
+
+//============================================================================
+// Public Method
+//============================================================================
+
+/**
+ * @brief Maps a container, only the header and the tables are checked (the payloads are checked by the validation of the flashing)
+ * @param path Path of the container
+ * @return false if the file is no valid container, see errorString
+ */
+bool FlashContainer::open(const QString &path){
+    close();
+
+    file.setFileName(path);
+    if(!file.open(QFile::ReadOnly)){
+        error = "Could not open " + path + ": " + file.errorString();
+        return false;
+    }
+
+    qint64 size = file.size();
+    if(size < (qint64) sizeof(Header)){
+        error = path + " is no flash container";
+        close();
+        return false;
+    }
+
+    mapped = file.map(0, size);
+    if(mapped == nullptr){
+        error = "Could not map " + path + ": " + file.errorString();
+        close();
+        return false;
+    }
+
+    const Header *candidate = (const Header *) mapped;
+    if(memcmp(candidate->magic, FLASH_CONTAINER_MAGIC, sizeof(candidate->magic)) != 0 || candidate->version != FLASH_CONTAINER_VERSION){
+        error = path + " is no flash container of version " + QString::number(FLASH_CONTAINER_VERSION);
+        close();
+        return false;
+    }
+
+    uint64_t tables_end = sizeof(Header) + (uint64_t) candidate->segment_count * sizeof(Segment) + (uint64_t) candidate->sector_count * sizeof(Sector);
+    if(candidate->file_size != (uint64_t) size || tables_end > (uint64_t) size || candidate->region_count > FLASH_CONTAINER_MAX_REGIONS
+        || candidate->app_id_len > FLASH_CONTAINER_APP_ID_BYTES || candidate->sector_length != FBL_CHECKSUM_SECTOR_LENGTH){
+        error = path + " is truncated or was written for another sector length";
+        close();
+        return false;
+    }
+
+    // Header and tables are protected by the CRC, the payloads by the segment checksums
+    Header copy = *candidate;
+    copy.table_crc = 0;
+
+    CCRC32 crc;
+    crc.Initialize();
+    unsigned int table_crc = 0xFFFFFFFF;
+    crc.PartialCRC(&table_crc, (const unsigned char *) &copy, sizeof(copy));
+    crc.PartialCRC(&table_crc, mapped + sizeof(Header), tables_end - sizeof(Header));
+    if((table_crc ^ 0xFFFFFFFF) != candidate->table_crc){
+        error = path + " is corrupt, the checksum of the header does not match";
+        close();
+        return false;
+    }
+
+    header = candidate;
+    segmentTable = (const Segment *) (mapped + sizeof(Header));
+    sectorTable = (const Sector *) (segmentTable + header->segment_count);
+
+    for(uint32_t i = 0; i < header->segment_count; i++){
+        if(segmentTable[i].offset % FLASH_CONTAINER_ALIGNMENT != 0 || segmentTable[i].offset > (uint64_t) size
+            || segmentTable[i].size > (uint64_t) size - segmentTable[i].offset){
+            error = path + " is corrupt, segment " + QString::number(i) + " exceeds the file";
+            close();
+            return false;
+        }
+    }
+
+    error.clear();
+    return true;
+}
+
+/**
+ * @brief Unmaps the container, the segments returned by getSegments must not be used afterwards
+ */
+void FlashContainer::close(){
+    if(mapped != nullptr)
+        file.unmap((uchar *) mapped);
+    file.close();
+
+    mapped = nullptr;
+    header = nullptr;
+    segmentTable = nullptr;
+    sectorTable = nullptr;
+}
+
+bool FlashContainer::isOpen() const {
+    return header != nullptr;
+}
+
+QString FlashContainer::errorString() const {
+    return error;
+}
+
+/**
+ * @brief Returns the flash content, the data is not copied but references the mapping of the container
+ * @return Map with Address -> continous byte array, valid as long as the container is open
+ */
+QMap<uint32_t, QByteArray> FlashContainer::getSegments() const {
+    QMap<uint32_t, QByteArray> segments;
+    if(!isOpen())
+        return segments;
+
+    for(uint32_t i = 0; i < header->segment_count; i++){
+        const Segment &segment = segmentTable[i];
+        segments.insert(segment.address, QByteArray::fromRawData((const char *) mapped + segment.offset, segment.size));
+    }
+    return segments;
+}
+
+/**
+ * @brief Returns the precomputed checksums of the segments, like the ECU calculates them for Request Upload
+ * @param raw true for FBL_CHECKSUM_MODE_RAW, false for the ASCII-Hex checksums
+ * @return Map of the checksums for every address
+ */
+QMap<uint32_t, uint32_t> FlashContainer::getChecksums(bool raw) const {
+    QMap<uint32_t, uint32_t> checksums;
+    if(!isOpen())
+        return checksums;
+
+    for(uint32_t i = 0; i < header->segment_count; i++)
+        checksums.insert(segmentTable[i].address, raw ? segmentTable[i].crc_raw : segmentTable[i].crc_ascii);
+    return checksums;
+}
+
+/**
+ * @brief Returns the precomputed checksums of the sectors touched by the content (FBL_CHECKSUM_MODE_SECTOR_MAP)
+ * @return Map of sector address -> checksum
+ */
+QMap<uint32_t, uint32_t> FlashContainer::getSectorChecksums() const {
+    QMap<uint32_t, uint32_t> checksums;
+    if(!isOpen())
+        return checksums;
+
+    for(uint32_t i = 0; i < header->sector_count; i++)
+        checksums.insert(sectorTable[i].address, sectorTable[i].crc);
+    return checksums;
+}
+
+QByteArray FlashContainer::getAppID() const {
+    if(!isOpen())
+        return QByteArray();
+    return QByteArray(header->app_id, header->app_id_len);
+}
+
+QByteArray FlashContainer::getContentHash() const {
+    if(!isOpen())
+        return QByteArray();
+    return QByteArray((const char *) header->content_hash, sizeof(header->content_hash));
+}
+
+/**
+ * @brief Checks if the content was aligned for the memory regions of the ECU
+ * @param layout Memory regions of the ECU (ValidateManager::getRegions)
+ * @return true if the regions are equal
+ */
+bool FlashContainer::matchesLayout(const QList<ValidateManager::MemoryRegion> &layout) const {
+    if(!isOpen() || (uint32_t) layout.size() != header->region_count)
+        return false;
+
+    for(int i = 0; i < layout.size(); i++){
+        const Region &region = header->regions[i];
+        if(region.start != layout[i].start || region.end != layout[i].end || region.kind != layout[i].kind
+            || (region.supported != 0) != layout[i].supported)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Compiles the validated and aligned flash content into a container. The container is written to a temporary
+ *        file first, so a cache entry is either complete or missing.
+ * @param path Path of the container
+ * @param data Flash content after ValidateManager::transformData
+ * @param app_id Payload of FBL_DID_APP_ID (app version of the S0 record)
+ * @param layout Memory regions of the ECU the content was aligned for
+ * @param content_hash SHA-256 of the source file (hashFile)
+ * @return false if the container could not be written
+ */
+bool FlashContainer::write(const QString &path, const QMap<uint32_t, QByteArray> &data, const QByteArray &app_id,
+                           const QList<ValidateManager::MemoryRegion> &layout, const QByteArray &content_hash){
+
+    if(layout.size() > FLASH_CONTAINER_MAX_REGIONS || content_hash.size() != (qsizetype) sizeof(Header::content_hash))
+        return false;
+
+    QMap<uint32_t, uint32_t> sectors = calculateSectorChecksums(data);
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FLASH_CONTAINER_MAGIC, sizeof(header.magic));
+    header.version = FLASH_CONTAINER_VERSION;
+    memcpy(header.content_hash, content_hash.constData(), sizeof(header.content_hash));
+    header.region_count = layout.size();
+    for(int i = 0; i < layout.size(); i++){
+        header.regions[i].start = layout[i].start;
+        header.regions[i].end = layout[i].end;
+        header.regions[i].kind = layout[i].kind;
+        header.regions[i].supported = layout[i].supported;
+    }
+    header.app_id_len = qMin((qsizetype) FLASH_CONTAINER_APP_ID_BYTES, app_id.size());
+    memcpy(header.app_id, app_id.constData(), header.app_id_len);
+    header.segment_count = data.size();
+    header.sector_count = sectors.size();
+    header.sector_length = FBL_CHECKSUM_SECTOR_LENGTH;
+
+    CCRC32 crc;
+    crc.Initialize();
+
+    // Tables, every payload starts at the next aligned offset
+    uint64_t offset = sizeof(Header) + (uint64_t) data.size() * sizeof(Segment) + (uint64_t) sectors.size() * sizeof(Sector);
+    QList<Segment> segment_table;
+    for(auto [address, bytes] : data.asKeyValueRange()){
+        offset = (offset + FLASH_CONTAINER_ALIGNMENT - 1) / FLASH_CONTAINER_ALIGNMENT * FLASH_CONTAINER_ALIGNMENT;
+
+        Segment segment;
+        memset(&segment, 0, sizeof(segment));
+        segment.address = address;
+        segment.size = bytes.size();
+        segment.offset = offset;
+        segment.crc_raw = (uint32_t) crc.FullCRC((const unsigned char *) bytes.constData(), bytes.size());
+        segment.crc_ascii = asciiChecksum(bytes);
+        segment_table.append(segment);
+
+        offset += bytes.size();
+    }
+    header.file_size = offset;
+
+    QList<Sector> sector_table;
+    for(auto [address, checksum] : sectors.asKeyValueRange())
+        sector_table.append({address, checksum});
+
+    unsigned int table_crc = 0xFFFFFFFF;
+    crc.PartialCRC(&table_crc, (const unsigned char *) &header, sizeof(header));
+    crc.PartialCRC(&table_crc, (const unsigned char *) segment_table.constData(), segment_table.size() * sizeof(Segment));
+    crc.PartialCRC(&table_crc, (const unsigned char *) sector_table.constData(), sector_table.size() * sizeof(Sector));
+    header.table_crc = table_crc ^ 0xFFFFFFFF;
+
+    // Write the container
+    QString temp_path = path + ".tmp";
+    QFile out(temp_path);
+    if(!out.open(QFile::WriteOnly | QFile::Truncate))
+        return false;
+
+    bool written = out.write((const char *) &header, sizeof(header)) == sizeof(header)
+                   && out.write((const char *) segment_table.constData(), segment_table.size() * sizeof(Segment)) == (qint64) (segment_table.size() * sizeof(Segment))
+                   && out.write((const char *) sector_table.constData(), sector_table.size() * sizeof(Sector)) == (qint64) (sector_table.size() * sizeof(Sector));
+
+    int i = 0;
+    for(auto it = data.constBegin(); it != data.constEnd() && written; ++it, i++){
+        QByteArray padding(segment_table[i].offset - out.pos(), 0);
+        written = out.write(padding) == padding.size() && out.write(it.value()) == it.value().size();
+    }
+    out.close();
+
+    if(!written){
+        QFile::remove(temp_path);
+        return false;
+    }
+
+    QFile::remove(path);
+    return QFile::rename(temp_path, path);
+}
+
+/**
+ * @brief Checks if a file starts with FLASH_CONTAINER_MAGIC
+ * @param path Path of the file
+ * @return true if the file is a flash container
+ */
+bool FlashContainer::isContainer(const QString &path){
+    QFile in(path);
+    if(!in.open(QFile::ReadOnly))
+        return false;
+    return in.read(4) == FLASH_CONTAINER_MAGIC;
+}
+
+/**
+ * @brief Calculates the key of a file for the cache
+ * @param path Path of the source file
+ * @return SHA-256 of the file content, empty if the file can not be read
+ */
+QByteArray FlashContainer::hashFile(const QString &path){
+    QFile in(path);
+    if(!in.open(QFile::ReadOnly))
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    const uchar *content = in.size() > 0 ? in.map(0, in.size()) : nullptr;
+    if(content != nullptr)
+        hash.addData(QByteArray::fromRawData((const char *) content, in.size()));
+    else
+        hash.addData(in.readAll());
+    return hash.result();
+}
+
+/**
+ * @brief Returns the path of the cached container of a file, the directory is taken from FBL_CONTAINER_CACHE_DIR
+ *        or the cache location of the GUI
+ * @param content_hash SHA-256 of the source file (hashFile)
+ * @param layout Memory regions of the ECU, the same file is aligned differently for other layouts
+ * @return Path of the container, empty if no cache directory is available
+ */
+QString FlashContainer::cachePath(const QByteArray &content_hash, const QList<ValidateManager::MemoryRegion> &layout){
+    QString dir = qEnvironmentVariable("FBL_CONTAINER_CACHE_DIR");
+    if(dir.isEmpty()){
+        QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        if(cache.isEmpty())
+            return QString();
+        dir = cache + "/flash_containers";
+    }
+
+    if(!QDir().mkpath(dir))
+        return QString();
+
+    return dir + "/" + content_hash.toHex() + "_" + QString("%1").arg(layoutChecksum(layout), 8, 16, QLatin1Char( '0' ))
+           + "." + FLASH_CONTAINER_SUFFIX;
+}
+
+/**
+ * @brief Calculates the checksum of the ASCII-Hex representation of the data without creating a copy of it
+ *        (same as the FlashManager for bootloaders without raw checksums)
+ * @param data Raw bytes
+ * @return CRC32 of the upper case hex characters
+ */
+uint32_t FlashContainer::asciiChecksum(const QByteArray &data){
+    static const char hex[] = "0123456789ABCDEF";
+
+    CCRC32 crc;
+    crc.Initialize();
+
+    unsigned int checksum = 0xFFFFFFFF;
+    unsigned char chunk[2 * FLASH_CONTAINER_CRC_CHUNK];
+    for(qsizetype pos = 0; pos < data.size(); pos += FLASH_CONTAINER_CRC_CHUNK){
+        qsizetype len = qMin((qsizetype) FLASH_CONTAINER_CRC_CHUNK, data.size() - pos);
+        for(qsizetype i = 0; i < len; i++){
+            uint8_t byte = (uint8_t) data[pos + i];
+            chunk[2 * i] = hex[byte >> 4];
+            chunk[2 * i + 1] = hex[byte & 0x0F];
+        }
+        crc.PartialCRC(&checksum, chunk, 2 * len);
+    }
+    return checksum ^ 0xFFFFFFFF;
+}
+
+/**
+ * @brief Calculates the checksum of every sector (FBL_CHECKSUM_SECTOR_LENGTH) touched by the data, like the ECU
+ *        calculates them for FBL_CHECKSUM_MODE_SECTOR_MAP. Bytes not covered by the data are expected to be 0 (erased flash).
+ * @param data Flash content
+ * @return Map of sector address -> checksum
+ */
+QMap<uint32_t, uint32_t> FlashContainer::calculateSectorChecksums(const QMap<uint32_t, QByteArray> &data){
+
+    // Expected content of every sector touched by the data
+    QMap<uint32_t, QByteArray> sectors;
+    for (auto it = data.constBegin(); it != data.constEnd(); ++it) {
+        uint32_t end = it.key() + it.value().size();
+        for (uint32_t sector = it.key() - it.key() % FBL_CHECKSUM_SECTOR_LENGTH; sector < end; sector += FBL_CHECKSUM_SECTOR_LENGTH) {
+            QByteArray &content = sectors[sector];
+            if (content.isEmpty())
+                content.fill(0, FBL_CHECKSUM_SECTOR_LENGTH);
+
+            uint32_t from = qMax(sector, it.key());
+            uint32_t to = qMin(sector + FBL_CHECKSUM_SECTOR_LENGTH, end);
+            memcpy(content.data() + (from - sector), it.value().constData() + (from - it.key()), to - from);
+        }
+    }
+
+    CCRC32 crc;
+    crc.Initialize();
+
+    QMap<uint32_t, uint32_t> checksums;
+    for (auto it = sectors.constBegin(); it != sectors.constEnd(); ++it)
+        checksums.insert(it.key(), (uint32_t) crc.FullCRC((const unsigned char *) it.value().constData(), it.value().size()));
+    return checksums;
+}
+
+//============================================================================
+// Private Method
+//============================================================================
+
+/**
+ * @brief Checksum of the memory regions, part of the name of a cached container
+ * @param layout Memory regions of the ECU
+ * @return CRC32 over start, end, kind and support of every region
+ */
+uint32_t FlashContainer::layoutChecksum(const QList<ValidateManager::MemoryRegion> &layout){
+    QByteArray regions;
+    for(const ValidateManager::MemoryRegion &region : layout){
+        Region entry = {region.start, region.end, region.kind, region.supported};
+        regions.append((const char *) &entry, sizeof(entry));
+    }
+
+    CCRC32 crc;
+    crc.Initialize();
+    return (uint32_t) crc.FullCRC((const unsigned char *) regions.constData(), regions.size());
+}
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : flashcontainer.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Precompiled flash container, memory-mapped by the FlashManager and used as cache of validated files
+//============================================================================
+
+#ifndef FLASHCONTAINER_H_
+#define FLASHCONTAINER_H_
+
+#define FLASH_CONTAINER_CACHE           1           // 1 = Validated files are compiled into a container in the cache directory and loaded from it the next time, 0 = No cache
+#define FLASH_CONTAINER_MAGIC           "FBLC"      // First bytes of every container file
+#define FLASH_CONTAINER_SUFFIX          "fblc"      // Suffix of container files
+#define FLASH_CONTAINER_VERSION         (1)         // Format version, containers of other versions are rejected (and compiled again)
+#define FLASH_CONTAINER_ALIGNMENT       (0x1000)    // Payloads start at a multiple of the page size of the host, so they can be used directly from the mapping
+#define FLASH_CONTAINER_MAX_REGIONS     (16)        // Max number of memory regions of the target layout
+#define FLASH_CONTAINER_APP_ID_BYTES    (64)        // Max bytes of the FBL_DID_APP_ID payload
+#define FLASH_CONTAINER_CRC_CHUNK       (0x1000)    // Bytes expanded to ASCII-Hex at once for the checksum of bootloaders without raw checksums
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include <stdint.h>
+
+#include "validatemanager.h"
+
+class FlashContainer {
+
+public:
+
+    // File layout, all values little-endian:
+    // Header | Segment table | Sector table | Payloads (each aligned to FLASH_CONTAINER_ALIGNMENT)
+
+    struct Region {
+        uint32_t start;                                 // First address of the region
+        uint32_t end;                                   // End address of the region as reported by the ECU
+        uint16_t kind;                                  // Key of the address range (see ValidateManager::MemoryRegion)
+        uint16_t supported;                             // 0 if the ECU does not support the validation of the region
+    };
+
+    struct Header {
+        char magic[4];                                  // FLASH_CONTAINER_MAGIC
+        uint32_t version;                               // FLASH_CONTAINER_VERSION
+        uint8_t content_hash[32];                       // SHA-256 of the source file, key of the cache
+        uint32_t region_count;                          // Target layout the content was aligned for (transformData)
+        Region regions[FLASH_CONTAINER_MAX_REGIONS];
+        uint32_t app_id_len;                            // App version of the S0 record, written as FBL_DID_APP_ID after the flashing
+        char app_id[FLASH_CONTAINER_APP_ID_BYTES];
+        uint32_t segment_count;                         // Entries of the segment table, directly after the header
+        uint32_t sector_count;                          // Entries of the sector table, directly after the segment table
+        uint32_t sector_length;                         // FBL_CHECKSUM_SECTOR_LENGTH the sector checksums are calculated with
+        uint32_t table_crc;                             // CRC32 of the header (with table_crc = 0) and both tables
+        uint64_t file_size;                             // Size of the container, the last payload ends here
+    };
+
+    struct Segment {
+        uint32_t address;                               // Start address of the continuous data
+        uint32_t size;                                  // Bytes of the segment
+        uint64_t offset;                                // Position of the payload in the container
+        uint32_t crc_raw;                               // CRC32 of the bytes (FBL_CHECKSUM_MODE_RAW)
+        uint32_t crc_ascii;                             // CRC32 of the ASCII-Hex representation (FBL_CHECKSUM_MODE_ASCII)
+    };
+
+    struct Sector {
+        uint32_t address;                               // Start address of the sector
+        uint32_t crc;                                   // CRC32 of the sector, bytes not covered by the content are 0 (erased)
+    };
+
+private:
+    QFile file;
+    const uchar *mapped;                                // Mapping of the complete container, nullptr if none is open
+    const Header *header;
+    const Segment *segmentTable;
+    const Sector *sectorTable;
+    QString error;
+
+public:
+    FlashContainer();
+    virtual ~FlashContainer();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    QMap<uint32_t, QByteArray> getSegments() const;
+    QMap<uint32_t, uint32_t> getChecksums(bool raw) const;
+    QMap<uint32_t, uint32_t> getSectorChecksums() const;
+    QByteArray getAppID() const;
+    QByteArray getContentHash() const;
+    bool matchesLayout(const QList<ValidateManager::MemoryRegion> &layout) const;
+
+    static bool write(const QString &path, const QMap<uint32_t, QByteArray> &data, const QByteArray &app_id,
+                      const QList<ValidateManager::MemoryRegion> &layout, const QByteArray &content_hash);
+    static bool isContainer(const QString &path);
+    static QByteArray hashFile(const QString &path);
+    static QString cachePath(const QByteArray &content_hash, const QList<ValidateManager::MemoryRegion> &layout);
+
+    static uint32_t asciiChecksum(const QByteArray &data);
+    static QMap<uint32_t, uint32_t> calculateSectorChecksums(const QMap<uint32_t, QByteArray> &data);
+
+private:
+    static uint32_t layoutChecksum(const QList<ValidateManager::MemoryRegion> &layout);
+};
+
+#endif /* FLASHCONTAINER_H_ */
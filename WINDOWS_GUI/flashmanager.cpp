@@ -5,18 +5,23 @@
 //============================================================================
 // Name        : flashmanager.cpp
 // Author      : Michael Bauer, Sebastian Rodriguez
-// Version     : 0.2
+// Version     : 0.6
 // Copyright   : MIT
 // Description : Flashmanger to flash ECUs
 //============================================================================
 
 #include "flashmanager.h"
 #include "CCRC32.h"
+#include "lz4compressor.h"
 #include <QDate>
 #include <QTime>
 #include <QTimer>
 #include <QThread>
 #include <QString>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QSettings>
+#include <QDir>
 
 #include "UDS_Spec/uds_comm_spec.h"
 
@@ -32,6 +37,20 @@ FlashManager::FlashManager(QObject *parent): QObject(parent){
     this->ecu_id = 0;
     this->uds = 0;
     this->file = "";
+    this->rawChecksum = false;
+    this->skippedBytes = 0;
+    this->compressionSupported = true;
+    this->flashCurrentDataFormat = FBL_DATA_FORMAT_UNCOMPRESSED;
+    this->transferDataBytes = 0;
+    this->eraseAheadSupported = true;
+    this->programmedOffsetSupported = true;
+    this->journalImage = 0;
+    this->journalActive = false;
+    this->resumingSession = false;
+    this->flashCurrentOffset = 0;
+    this->succeeded = false;
+    this->sharedBus = false;
+    this->traceDirectory = qEnvironmentVariable("FBL_TRACE_DIR");
 
     // Flashing Thread is stopped by default
     this->_working =false;
@@ -159,6 +178,23 @@ void FlashManager::setTestFile(){
 void FlashManager::setFlashFile(QMap<uint32_t, QByteArray> data){
     flashContent.clear();
     flashContent = data;
+    container.reset();
+}
+
+/**
+ * @brief Flashes directly from a mapped container, its checksums are used instead of calculating them
+ *        and its app version is written as FBL_DID_APP_ID
+ * @param container Open container, kept open by the FlashManager as long as it is flashed
+ * @return false if the container is not open
+ */
+bool FlashManager::setFlashContainer(QSharedPointer<FlashContainer> container){
+    if(!container || !container->isOpen())
+        return false;
+
+    this->container = container;
+    flashContent = container->getSegments();
+    setUpdateVersion(container->getAppID());
+    return true;
 }
 
 void FlashManager::setUpdateVersion(QByteArray version){
@@ -177,6 +213,60 @@ QMap<uint32_t, QByteArray> FlashManager::getFlashContent(void) {
     return flashContent;
 }
 
+size_t FlashManager::getSkippedBytes(void) {
+    return skippedBytes;
+}
+
+size_t FlashManager::getTransferDataBytes(void) {
+    return transferDataBytes;
+}
+
+/**
+ * @brief Returns the bytes of the last flashing that were not transferred again, since an interrupted flashing left them on the ECU
+ * @return Bytes verified on the ECU before their downloads were continued (RESUMABLE_FLASHING)
+ */
+size_t FlashManager::getResumedBytes(void) {
+    size_t bytes = 0;
+    for(uint32_t resumed : resumedBytes)
+        bytes += resumed;
+    return bytes;
+}
+
+/**
+ * @brief Sets whether the Communication is shared with other FlashManagers flashing other ECUs at the same time.
+ *        With a shared bus startFlashing and stopFlashing only connect and disconnect the own session, the
+ *        connections of the other sessions and the wait statistics of the Communication are kept.
+ * @param shared true for a shared bus, needs to be set before startFlashing
+ */
+void FlashManager::setSharedBus(bool shared) {
+    sharedBus = shared;
+}
+
+/**
+ * @brief Returns the result of the last flashing
+ * @return true if the flashing was finished with the Good Key and the Default Session
+ */
+bool FlashManager::hasSucceeded(void) {
+    return succeeded;
+}
+
+/**
+ * @brief Sets the directory the timing trace of every flashing session is written to (FLASH_TRACE). The default is
+ *        the environment variable FBL_TRACE_DIR.
+ * @param dir Directory for the trace files, empty to disable the trace
+ */
+void FlashManager::setTraceDirectory(QString dir) {
+    traceDirectory = dir;
+}
+
+/**
+ * @brief Returns the timing trace of the last flashing
+ * @return Path of the trace file, empty if no trace was written
+ */
+QString FlashManager::getTraceFile(void) {
+    return traceFile;
+}
+
 //============================================================================
 // Private Helper Method
 //============================================================================
@@ -216,7 +306,7 @@ void FlashManager::updateGUIProgressBar(){
     for(uint32_t add: flashedBytes.keys()){
         bytes_counter += flashedBytes[add];
     }
-    size_t new_value = (size_t)(bytes_counter/getOverallByteSize()*100);
+    size_t new_value = (size_t)(bytes_counter/(getOverallByteSize() - skippedBytes)*100);
     if(new_value != last_update_gui_progressbar){
         last_update_gui_progressbar = new_value;
         emit updateStatus(UPDATE, "", new_value);
@@ -292,6 +382,7 @@ void FlashManager::queuedGUIFlashingLog(FlashManager::STATUS s, QString info, bo
 
 void FlashManager::changeSessionAndLogin(){
 
+    FlashTraceScope trace("phase", "Session change and login");
     UDS::RESP resp = UDS::RESP::RX_NO_RESPONSE;
 
     queuedGUIConsoleLog("Change Session to Programming Session for selected ECU");
@@ -316,7 +407,23 @@ void FlashManager::changeSessionAndLogin(){
 
 }
 
-QMap<uint32_t, QByteArray>FlashManager::uncompressData(QMap<uint32_t, QByteArray> compressedData) {
+/**
+ * @brief Asks the ECU to calculate the checksums of Request Upload over the raw bytes. Bootloaders without
+ *        FBL_DID_CHECKSUM_MODE answer negative and keep calculating them over the ASCII-Hex representation.
+ * @return true if the ECU uses FBL_CHECKSUM_MODE_RAW
+ */
+bool FlashManager::selectRawChecksumMode(){
+    uint8_t mode = FBL_CHECKSUM_MODE_RAW;
+    UDS::RESP resp = uds->writeDataByIdentifier(ecu_id, FBL_DID_CHECKSUM_MODE, &mode, sizeof(mode));
+    if(resp != UDS::TX_RX_OK){
+        queuedGUIConsoleLog("FlashManager: ECU does not support raw checksums, using ASCII-Hex checksums\n");
+        return false;
+    }
+    return true;
+}
+
+QMap<uint32_t, QByteArray>FlashManager::uncompressData(const QMap<uint32_t, QByteArray> &compressedData) {
+    FlashTraceScope trace("phase", "ASCII-Hex expansion");
     QMap<uint32_t, QByteArray> result;
 
     for (auto [key, value] : compressedData.asKeyValueRange()) {
@@ -340,24 +447,259 @@ QMap<uint32_t, QByteArray>FlashManager::uncompressData(QMap<uint32_t, QByteArray
     return result;
 }
 
-QMap<uint32_t, uint32_t> FlashManager::calculateFileChecksums(QMap<uint32_t, QByteArray> data) {
+QMap<uint32_t, uint32_t> FlashManager::calculateFileChecksums(const QMap<uint32_t, QByteArray> &data) {
+    FlashTraceScope trace("phase", "File checksums");
     QMap<uint32_t, uint32_t> result;
 
+    CCRC32 crc;
+    crc.Initialize();
+
     for (auto [key, value] : data.asKeyValueRange()) {
-        CCRC32 crc;
-        crc.Initialize();
+        uint32_t checksum = (uint32_t) crc.FullCRC((const unsigned char *) value.constData(), value.size());
+        result.insert(key, checksum);
+    }
 
-        QByteArray line = value;
+    return result;
+}
 
-        char *nextLine = line.data();
+/**
+ * @brief Reduces the flash content to the sectors (FBL_CHECKSUM_SECTOR_LENGTH) whose checksum on the ECU differs from the file.
+ *        A sector is expected to contain the file data and 0 (erased flash) for the bytes not covered by the file.
+ *        The sector of the ASW key is always transferred, since the bad key is written into it before the download.
+ * @param data Flash content of the file
+ * @return Flash content to be transferred, the unchanged data if the ECU does not support FBL_CHECKSUM_MODE_SECTOR_MAP
+ */
+QMap<uint32_t, QByteArray> FlashManager::planDifferentialFlashing(const QMap<uint32_t, QByteArray> &data) {
+    FlashTraceScope trace("phase", "Differential planning");
+    uint8_t mode = FBL_CHECKSUM_MODE_SECTOR_MAP;
+    if(uds->writeDataByIdentifier(ecu_id, FBL_DID_CHECKSUM_MODE, &mode, sizeof(mode)) != UDS::TX_RX_OK){
+        queuedGUIConsoleLog("FlashManager: ECU does not support sector checksums, transferring the complete file\n");
+        return data;
+    }
 
-        QString str = QString(nextLine);
+    // Expected checksum of every sector touched by the file, precomputed by a flash container
+    QMap<uint32_t, uint32_t> sectors = container ? container->getSectorChecksums() : FlashContainer::calculateSectorChecksums(data);
 
-        uint32_t checksum = (uint32_t) crc.FullCRC((const unsigned char *) nextLine, strlen(nextLine));
-        result.insert(key, checksum);
+    // Sector checksums of the ECU, one Request Upload per block
+    QMap<uint32_t, uint32_t> ecuChecksums;
+    bool uploaded = true;
+    for (auto it = data.constBegin(); it != data.constEnd() && uploaded; ++it) {
+        if (uds->requestUpload(ecu_id, it.key(), it.value().size()) != UDS::TX_RX_OK) {
+            uploaded = false;
+            break;
+        }
+
+        QList<uint32_t> blockChecksums = uds->getECUSectorChecksums();
+        uint32_t firstSector = it.key() - it.key() % FBL_CHECKSUM_SECTOR_LENGTH;
+        for (int i = 0; i < blockChecksums.size(); i++)
+            ecuChecksums[firstSector + i * FBL_CHECKSUM_SECTOR_LENGTH] = blockChecksums[i];
     }
 
-    return result;
+    // The following Request Uploads of the validation need the checksum of the whole block again
+    mode = rawChecksum ? FBL_CHECKSUM_MODE_RAW : FBL_CHECKSUM_MODE_ASCII;
+    uds->writeDataByIdentifier(ecu_id, FBL_DID_CHECKSUM_MODE, &mode, sizeof(mode));
+
+    if (!uploaded) {
+        queuedGUIConsoleLog("FlashManager: Reading the sector checksums failed, transferring the complete file\n");
+        return data;
+    }
+
+    // Sectors that need to be erased and programmed
+    QSet<uint32_t> changed;
+    for (auto it = sectors.constBegin(); it != sectors.constEnd(); ++it) {
+        if (!ecuChecksums.contains(it.key()) || ecuChecksums.value(it.key()) != it.value())
+            changed.insert(it.key());
+    }
+    changed.insert(aswKeyAdd - aswKeyAdd % FBL_CHECKSUM_SECTOR_LENGTH);
+
+    // Continous ranges of the changed sectors within every block
+    QMap<uint32_t, QByteArray> plan;
+    size_t fileBytes = 0;
+    size_t planBytes = 0;
+    for (auto it = data.constBegin(); it != data.constEnd(); ++it) {
+        uint32_t end = it.key() + it.value().size();
+        uint32_t rangeStart = 0;
+        uint32_t rangeEnd = 0;
+        fileBytes += it.value().size();
+
+        for (uint32_t sector = it.key() - it.key() % FBL_CHECKSUM_SECTOR_LENGTH; sector < end; sector += FBL_CHECKSUM_SECTOR_LENGTH) {
+            if (!changed.contains(sector))
+                continue;
+
+            uint32_t from = qMax(sector, it.key());
+            uint32_t to = qMin(sector + FBL_CHECKSUM_SECTOR_LENGTH, end);
+            if (rangeEnd != from) {
+                if (rangeEnd > rangeStart)
+                    plan[rangeStart] = it.value().mid(rangeStart - it.key(), rangeEnd - rangeStart);
+                rangeStart = from;
+            }
+            rangeEnd = to;
+        }
+        if (rangeEnd > rangeStart)
+            plan[rangeStart] = it.value().mid(rangeStart - it.key(), rangeEnd - rangeStart);
+    }
+
+    for (const QByteArray &bytes : plan)
+        planBytes += bytes.size();
+    skippedBytes = fileBytes - planBytes;
+
+    QString info = "FlashManager: Differential flashing - " + QString::number(changed.size()) + " of " + QString::number(sectors.size())
+                   + " sectors changed, transferring " + QString::number(planBytes) + " of " + QString::number(fileBytes)
+                   + " bytes (" + QString::number(skippedBytes) + " bytes saved)\n";
+    qInfo() << info;
+    queuedGUIConsoleLog(info);
+
+    return plan;
+}
+
+/**
+ * @brief Returns the settings group of the progress journal of the ECU
+ * @return Group within the settings of the GUI
+ */
+QString FlashManager::journalGroup() {
+    return "FlashJournal/" + QString("%1").arg(ecu_id, 3, 16, QLatin1Char( '0' ));
+}
+
+/**
+ * @brief Loads the progress journal of an interrupted flashing of the ECU. A journal of another file is discarded.
+ * @param image Checksum of the file to be flashed
+ */
+void FlashManager::loadJournal(uint32_t image) {
+    journal.clear();
+    journalImage = image;
+    lastJournalSync = QDateTime::currentDateTime();
+
+    QSettings settings("AMOS", "FBL");
+    settings.beginGroup(journalGroup());
+    if (settings.value("image", 0).toUInt() != image) {
+        settings.endGroup();
+        return;
+    }
+
+    settings.beginGroup("blocks");
+    for (const QString &key : settings.childKeys())
+        journal[key.toUInt(nullptr, 16)] = settings.value(key).toUInt();
+    settings.endGroup();
+    settings.endGroup();
+
+    size_t journalBytes = 0;
+    for (uint32_t bytes : journal)
+        journalBytes += bytes;
+    if (journalBytes > 0)
+        queuedGUIConsoleLog("FlashManager: Journal of an interrupted flashing of this file with " + QString::number(journalBytes) + " confirmed bytes found\n");
+}
+
+/**
+ * @brief Writes the progress journal to the settings, at most every FLASH_JOURNAL_SYNC_MS. An empty journal is removed.
+ * @param forced Write without regard to the last write
+ */
+void FlashManager::saveJournal(bool forced) {
+    if (!journalActive)
+        return;
+    if (!forced && lastJournalSync.msecsTo(QDateTime::currentDateTime()) <= FLASH_JOURNAL_SYNC_MS)
+        return;
+    lastJournalSync = QDateTime::currentDateTime();
+
+    QSettings settings("AMOS", "FBL");
+    settings.remove(journalGroup());
+    if (journal.isEmpty())
+        return;
+
+    settings.beginGroup(journalGroup());
+    settings.setValue("image", journalImage);
+    settings.beginGroup("blocks");
+    for (auto it = journal.constBegin(); it != journal.constEnd(); ++it)
+        settings.setValue(QString("%1").arg(it.key(), 8, 16, QLatin1Char( '0' )), it.value());
+    settings.endGroup();
+    settings.endGroup();
+}
+
+/**
+ * @brief Checks if the ECU still has the last download of the journaled flashing (FBL_DID_PROGRAMMED_OFFSET), i.e. it was not
+ *        reset since. The Bad Key was written before that download, the download itself can be continued at page granularity.
+ * @return true if the programmed data of the last download of the ECU is within the journal
+ */
+bool FlashManager::ecuContinuesJournal() {
+    if (journal.isEmpty() || !programmedOffsetSupported)
+        return false;
+
+    if (uds->readDataByIdentifier(ecu_id, FBL_DID_PROGRAMMED_OFFSET) != UDS::TX_RX_OK) {
+        queuedGUIConsoleLog("FlashManager: ECU does not report the programmed data, downloads continue at sector boundaries\n");
+        programmedOffsetSupported = false;
+        return false;
+    }
+
+    uint32_t start = 0;
+    uint32_t programmed = uds->getECUProgrammedOffset(&start);
+    if (programmed == 0)
+        return false;
+
+    for (auto it = journal.constBegin(); it != journal.constEnd(); ++it) {
+        if (start >= it.key() && start <= it.key() + it.value())
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Determines the bytes of the current address that are on the ECU already and need no Transfer Data. Candidates are the
+ *        end of the data the ECU programmed with its last download (continued without erasing its last sector again) and the
+ *        journaled bytes rounded down to a sector (the sector is erased again). The first candidate whose checksum matches wins.
+ * @return Bytes of flashCurrentAdd verified on the ECU, 0 to download all of them
+ */
+uint32_t FlashManager::findResumeOffset() {
+    if (!journalActive)
+        return 0;
+
+    FlashTraceScope trace("phase", "Resume verification");
+
+    uint32_t size = flashContent[flashCurrentAdd].size();
+    QList<uint32_t> candidates;
+
+    // Programmed data of the last download of the ECU, after an interruption in this or the last session
+    if (programmedOffsetSupported && uds->readDataByIdentifier(ecu_id, FBL_DID_PROGRAMMED_OFFSET) == UDS::TX_RX_OK) {
+        uint32_t start = 0;
+        uint32_t programmed = uds->getECUProgrammedOffset(&start);
+        uint32_t end = start + programmed;
+        if (programmed > 0 && end > flashCurrentAdd && end <= flashCurrentAdd + size)
+            candidates.append(end - flashCurrentAdd);
+    }
+
+    // Journaled data, the download restarts at the sector the ECU did not necessarily finish
+    auto it = journal.upperBound(flashCurrentAdd);
+    if (it != journal.begin()) {
+        --it;
+        uint32_t end = qMin(it.key() + it.value(), flashCurrentAdd + size);
+        if (end < flashCurrentAdd + size)
+            end -= end % FBL_CHECKSUM_SECTOR_LENGTH;
+        if (end > flashCurrentAdd && !candidates.contains(end - flashCurrentAdd))
+            candidates.append(end - flashCurrentAdd);
+    }
+
+    for (uint32_t bytes : candidates) {
+        if (verifyOnECU(bytes))
+            return bytes;
+    }
+
+    if (!candidates.isEmpty())
+        queuedGUIConsoleLog("FlashManager: Data of the interrupted flashing at " + QString("0x%8").arg(flashCurrentAdd, 8, 16, QLatin1Char( '0' ))
+                            + " differs on the ECU, downloading the complete range\n");
+    return 0;
+}
+
+/**
+ * @brief Compares the checksum of the first bytes of the current address on the ECU with the file (FBL_CHECKSUM_MODE_RAW)
+ * @param bytes Number of bytes from flashCurrentAdd on
+ * @return true if the ECU has the data of the file
+ */
+bool FlashManager::verifyOnECU(uint32_t bytes) {
+    if (uds->requestUpload(ecu_id, flashCurrentAdd, bytes) != UDS::TX_RX_OK)
+        return false;
+
+    CCRC32 crc;
+    crc.Initialize();
+    uint32_t checksum = (uint32_t) crc.FullCRC((const unsigned char *) flashContent[flashCurrentAdd].constData(), bytes);
+    return uds->getECUChecksum() == checksum;
 }
 
 //============================================================================
@@ -370,6 +712,14 @@ void FlashManager::doFlashing(){
     qInfo() << "FlashManager: Started flashing.\n";
     queuedGUIConsoleLog("###############################################\nFlashManager: Started flashing.\n###############################################\n");
 
+    // Timing trace of the session, recorded by the FlashManager, UDS and Communication running in this thread
+    FlashTrace *trace = nullptr;
+    traceFile = "";
+    if(FLASH_TRACE && !traceDirectory.isEmpty()){
+        trace = new FlashTrace(ecu_id, "ECU " + QString("0x%1").arg(ecu_id, 3, 16, QLatin1Char( '0' )));
+        FlashTrace::setCurrent(trace);
+    }
+
     while(this->_working) {
         // Check if thread should be canceled
         mutex.lock();
@@ -388,6 +738,7 @@ void FlashManager::doFlashing(){
 
         // Count up the attempts of current state
         state_attempt_ctr++;
+        uint64_t state_start_ns = trace != nullptr ? FlashTrace::nowNs() : 0;
 
         // Handling for State Machine
         switch(curr_state){
@@ -430,6 +781,9 @@ void FlashManager::doFlashing(){
                 break;
         }
 
+        if(trace != nullptr)
+            trace->complete("state", stateName(prev_state), state_start_ns, FlashTrace::nowNs(), QJsonObject{{"attempt", state_attempt_ctr}});
+
         // Check the print queues
         queuedGUIConsoleLog("");
         queuedGUIFlashingLog(INFO, "");
@@ -446,18 +800,16 @@ void FlashManager::doFlashing(){
         }
 
         if(state_attempt_ctr > 0 && curr_state != IDLE){
+            FlashTraceScope retry_trace("wait", "Wait after attempt");
             qInfo() << "\nFlashManager: Change to next state not possible. Waiting "+QString::number((uint32_t)WAITTIME_AFTER_ATTEMPT) + " ms before starting next attempt\n\n";
             emit errorPrint("\nFlashManager: Change to next state not possible. Waiting "+QString::number((uint32_t)WAITTIME_AFTER_ATTEMPT) + " ms before starting next attempt\n\n");
             QThread::msleep((unsigned long)WAITTIME_AFTER_ATTEMPT);
 
             if(curr_state == TRANSFER_DATA){
-                // Force Transfer Exit for the current address
-                uds->requestTransferExit(ecu_id, flashCurrentAdd);
+                // Force Transfer Exit for the current download
+                uds->requestTransferExit(ecu_id, flashCurrentAdd + flashCurrentOffset);
 
-                // Reset the package counter => Need to restart the flashing for first address
-                flashCurrentPackageCtr = 0; // No Reset: Partial Flashing allowed
-
-                // Change to Request Download again
+                // Change to Request Download again, it continues after the data verified on the ECU (RESUMABLE_FLASHING)
                 curr_state = REQ_DOWNLOAD;
             }
         }
@@ -472,16 +824,90 @@ void FlashManager::doFlashing(){
     _working = false;
     mutex.unlock();
 
+    // An interrupted flashing continues with the next start
+    saveJournal(1);
+
     // Reset progress bar
     queuedGUIFlashingLog(INFO, "", 1);
     emit updateStatus(FlashManager::UPDATE, "", 0);
 
+    logWaitStatistics();
+
+    if(trace != nullptr){
+        FlashTrace::setCurrent(nullptr);
+        writeTrace(trace);
+        delete trace;
+    }
+
     qInfo() << "FlashManager: Stopped flashing.\n";
     queuedGUIConsoleLog("###############################################\nFlashManager: Stopped flashing.\n###############################################\n");
     queuedGUIConsoleLog("", 1);
     emit flashingThreadFinished();
 }
 
+/**
+ * @brief Prints the time the flashing thread spent waiting on the ECU during the session
+ */
+void FlashManager::logWaitStatistics(){
+    if(uds == nullptr || comm == nullptr)
+        return;
+
+    const WaitStatistics &uds_wait = uds->getWaitStatistics();
+    const WaitStatistics &comm_wait = comm->getWaitStatistics();
+
+    QString info = "FlashManager: Time spent waiting during the session\n";
+    info += "UDS (free TX and responses): " + QString::number(uds_wait.waits) + " waits, "
+            + QString::number(uds_wait.wall_ns / 1000000.0, 'f', 1) + " ms wall time, "
+            + QString::number(uds_wait.cpu_ns / 1000000.0, 'f', 1) + " ms CPU time\n";
+    info += "Communication (Flow Control and ACK): " + QString::number(comm_wait.waits) + " waits, "
+            + QString::number(comm_wait.wall_ns / 1000000.0, 'f', 1) + " ms wall time, "
+            + QString::number(comm_wait.cpu_ns / 1000000.0, 'f', 1) + " ms CPU time\n";
+
+    qInfo() << info;
+    queuedGUIConsoleLog(info);
+}
+
+/**
+ * @brief Writes the timing trace of the session into the trace directory, one file per session
+ * @param trace Trace of the session
+ */
+void FlashManager::writeTrace(FlashTrace *trace){
+    QDir dir(traceDirectory);
+    if(!dir.exists() && !dir.mkpath(".")){
+        emit errorPrint("FlashManager: ERROR - Could not create the trace directory " + traceDirectory);
+        return;
+    }
+
+    QString file = dir.filePath("flash_" + QString("%1").arg(ecu_id, 3, 16, QLatin1Char( '0' )) + "_"
+                                + QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss_zzz") + ".json");
+    if(!trace->write(file)){
+        emit errorPrint("FlashManager: ERROR - Could not write the timing trace " + file);
+        return;
+    }
+
+    traceFile = file;
+    QString info = "FlashManager: Timing trace with " + QString::number(trace->size()) + " events written to " + file + "\n";
+    qInfo() << info;
+    queuedGUIConsoleLog(info);
+}
+
+/**
+ * @brief Returns the name of a state for the timing trace
+ */
+const char *FlashManager::stateName(STATE_MACHINE state){
+    switch(state){
+        case PREPARE:           return "PREPARE";
+        case START_FLASHING:    return "START_FLASHING";
+        case REQ_DOWNLOAD:      return "REQ_DOWNLOAD";
+        case TRANSFER_DATA:     return "TRANSFER_DATA";
+        case VALIDATE:          return "VALIDATE";
+        case FINISH:            return "FINISH";
+        case IDLE:              return "IDLE";
+        case ERR_STATE:         return "ERR_STATE";
+        default:                return "UNKNOWN";
+    }
+}
+
 void FlashManager::prepareFlashing(){
 
     queuedGUIConsoleLog("###############################\nFlashManager: Preparing Flashing Process\n###############################\n");
@@ -503,10 +929,49 @@ void FlashManager::prepareFlashing(){
     // Reset the counter for flashed bytes
     flashedBytesCtr = 0;
     flashedBytes.clear();
+    transferDataBytes = 0;
+    compressionSupported = COMPRESSED_TRANSFER_DATA;
+    eraseAheadSupported = true;
+    programmedOffsetSupported = true;
+    resumedBytes.clear();
     fillOverallByteSize();
 
-    QMap<uint32_t, QByteArray> uncompressedData = uncompressData(flashContent);
-    this->checksums = calculateFileChecksums(uncompressedData);
+    // Raw checksums need neither the ASCII-Hex copy of the content nor the double CRC work on both sides
+    rawChecksum = selectRawChecksumMode();
+    if(container)
+        this->checksums = container->getChecksums(rawChecksum);
+    else if(rawChecksum)
+        this->checksums = calculateFileChecksums(flashContent);
+    else
+        this->checksums = calculateFileChecksums(uncompressData(flashContent));
+
+    // Checksums and sizes of the complete file are kept for the validation, only the changed sectors are transferred
+    skippedBytes = 0;
+    if(DIFFERENTIAL_FLASHING && rawChecksum && !flashContent.isEmpty()){
+        flashContent = planDifferentialFlashing(flashContent);
+        if(flashContent.isEmpty()){
+            queuedGUIFlashingLog(INFO, "ECU content is equal to the file, nothing to transfer");
+            curr_state = VALIDATE;
+            return;
+        }
+    }
+
+    // Journal of an interrupted flashing of the same file, the data on the ECU is verified with raw checksums
+    journal.clear();
+    resumingSession = false;
+    journalActive = RESUMABLE_FLASHING && rawChecksum;
+    if(journalActive){
+        CCRC32 crc;
+        crc.Initialize();
+        QByteArray image;
+        for (auto [key, value] : checksums.asKeyValueRange())
+            image.append((const char *) &key, sizeof(key)).append((const char *) &value, sizeof(value));
+        loadJournal((uint32_t) crc.FullCRC((const unsigned char *) image.constData(), image.size()));
+
+        resumingSession = ecuContinuesJournal();
+        if(resumingSession)
+            queuedGUIFlashingLog(INFO, "Continuing the interrupted flashing");
+    }
 
     curr_state = START_FLASHING;
 }
@@ -529,7 +994,10 @@ void FlashManager::startFlashing(){
 
     if(abort)
         return;
-    writeKey(BAD);
+
+    // The interrupted flashing wrote the Bad Key already, another download would end the one the ECU continues
+    if(!resumingSession)
+        writeKey(BAD);
 
     // Change session again to ensure that ASW could also write into Key Address Range (should not do it, but could)
     changeSessionAndLogin();
@@ -539,6 +1007,7 @@ void FlashManager::startFlashing(){
     // Setup the variables
     flashCurrentAdd = flashContent.firstKey();
     flashCurrentPackageCtr = 0;
+    flashCurrentOffset = 0;
     curr_state = REQ_DOWNLOAD;
 }
 
@@ -558,20 +1027,47 @@ void FlashManager::requestDownload(){
         return;
     }
 
+    // ##############################################################################################################
+    // Data of an interrupted download that is on the ECU already
+    QByteArray bytes = flashContent[flashCurrentAdd];
+    flashCurrentOffset = findResumeOffset();
+    flashCurrentPackageCtr = 0;
+    flashedBytes[flashCurrentAdd] = flashCurrentOffset;
+    resumedBytes[flashCurrentAdd] = flashCurrentOffset;
+    if(flashCurrentOffset > 0){
+        QString info = "FlashManager: Continuing flash address "+QString("0x%8").arg(flashCurrentAdd, 8, 16, QLatin1Char( '0' ))+" after "
+                       +QString::number(flashCurrentOffset)+" of "+QString::number(bytes.size())+" bytes verified on the ECU\n";
+        qInfo() << info;
+        queuedGUIConsoleLog(info);
+    }
+    if(flashCurrentOffset >= (uint32_t)bytes.size()){
+        nextFlashAddress();
+        state_attempt_ctr = 0; // The next address is no further attempt of this state
+        return;
+    }
+
     // ##############################################################################################################
     // Request Download
     UDS::RESP resp = UDS::RESP::RX_NO_RESPONSE;
 
-    QByteArray bytes = flashContent[flashCurrentAdd];
-    queuedGUIFlashingLog(INFO, "Flashing "+QString::number(bytes.size())+" bytes to flash address "+QString("0x%8").arg(flashCurrentAdd, 8, 16, QLatin1Char( '0' )));
+    uint32_t downloadAdd = flashCurrentAdd + flashCurrentOffset;
+    uint32_t downloadBytes = bytes.size() - flashCurrentOffset;
+    queuedGUIFlashingLog(INFO, "Flashing "+QString::number(downloadBytes)+" bytes to flash address "+QString("0x%8").arg(downloadAdd, 8, 16, QLatin1Char( '0' )));
 
     //queuedGUIConsoleLog("Requesting Download for flash address "+QString("0x%8").arg(flashCurrentAdd, 8, 16, QLatin1Char( '0' )));
-    resp = uds->requestDownload(ecu_id, flashCurrentAdd, bytes.size());
+    flashCurrentDataFormat = compressionSupported ? FBL_DATA_FORMAT_LZ4 : FBL_DATA_FORMAT_UNCOMPRESSED;
+    resp = uds->requestDownload(ecu_id, downloadAdd, downloadBytes, flashCurrentDataFormat);
 
     if(resp != UDS::TX_RX_OK){
 
         // Check on response more detailed
         if(uds->getECUNegativeResponse() > 0){
+            // Bootloaders without compression reject the dataFormatIdentifier, the next attempt is uncompressed
+            if(flashCurrentDataFormat != FBL_DATA_FORMAT_UNCOMPRESSED){
+                queuedGUIConsoleLog("FlashManager: ECU does not support compressed Transfer Data, transferring raw bytes\n");
+                compressionSupported = false;
+            }
+
             // Negative Response received, ECU is responding
             // Strategy: Try again
             return;
@@ -589,15 +1085,25 @@ void FlashManager::requestDownload(){
         emit errorPrint("ERROR: ECU Buffer size is 0.");
         return;
     }
+    // Transfer Data needs SID and address (5 bytes) besides the data, the ISO TP message needs to fit the reassembler
+    if(flashCurrentBufferSize > MAX_ISOTP_MESSAGE_LEN - 5)
+        flashCurrentBufferSize = MAX_ISOTP_MESSAGE_LEN - 5;
+
+    // The compressed package needs to fit the ISO TP message even for incompressible data, the decompressed one the ECU buffer
+    if(flashCurrentDataFormat == FBL_DATA_FORMAT_LZ4){
+        uint32_t maxInput = lz4MaxInputSize(MAX_ISOTP_MESSAGE_LEN - 5) / TRANSFER_DATA_ALIGNMENT * TRANSFER_DATA_ALIGNMENT;
+        if(flashCurrentBufferSize > maxInput)
+            flashCurrentBufferSize = maxInput;
+    }
 
     // Calculate the packages
-    flashCurrentPackages = bytes.size() % flashCurrentBufferSize > 0 ? bytes.size() / flashCurrentBufferSize + 1 : bytes.size() / flashCurrentBufferSize;
-    QString info = "Request Download OK for flash address "+QString("0x%8").arg(flashCurrentAdd, 8, 16, QLatin1Char( '0' ))+" (Buffer size="+QString::number(flashCurrentBufferSize)+", Packages="+QString::number(flashCurrentPackages)+")";
+    flashCurrentPackages = downloadBytes % flashCurrentBufferSize > 0 ? downloadBytes / flashCurrentBufferSize + 1 : downloadBytes / flashCurrentBufferSize;
+    QString info = "Request Download OK for flash address "+QString("0x%8").arg(downloadAdd, 8, 16, QLatin1Char( '0' ))+" (Buffer size="+QString::number(flashCurrentBufferSize)+", Packages="+QString::number(flashCurrentPackages)+")";
     queuedGUIConsoleLog(info);
     qInfo() << info;
 
-    // Prepare the flashed bytes map
-    flashedBytes[flashCurrentAdd] = 0;
+    // Transfer Data starts once the download range is erased, no package has to wait for an erase
+    waitForEraseAhead();
 
     mutex.lock();
     abort = _abort;
@@ -609,6 +1115,52 @@ void FlashManager::requestDownload(){
     curr_state = TRANSFER_DATA;
 }
 
+/**
+ * @brief Polls the erase progress (FBL_DID_ERASE_PROGRESS) after Request Download until the ECU erased all sectors of the
+ *        download. Bootloaders without the DID erase the sectors with the first Transfer Data writing into them.
+ */
+void FlashManager::waitForEraseAhead(){
+    if(!eraseAheadSupported)
+        return;
+
+    FlashTraceScope trace("wait", "Erase wait");
+
+    QElapsedTimer timer;
+    timer.start();
+    uint32_t total = 0;
+    uint32_t erased = 0;
+    while(true){
+        if(uds->readDataByIdentifier(ecu_id, FBL_DID_ERASE_PROGRESS) != UDS::TX_RX_OK){
+            queuedGUIConsoleLog("FlashManager: ECU does not report the erase progress, sectors are erased while programming\n");
+            eraseAheadSupported = false;
+            return;
+        }
+
+        erased = uds->getECUEraseProgress(&total);
+        if(erased >= total)
+            break;
+
+        if(timer.elapsed() > ERASE_AHEAD_TIMEOUT_MS){
+            queuedGUIConsoleLog("FlashManager: Erase of the download range did not finish in time, starting Transfer Data\n");
+            return;
+        }
+
+        queuedGUIFlashingLog(INFO, "Erasing flash: " + QString::number(erased / 1024) + " of " + QString::number(total / 1024) + " KB");
+
+        mutex.lock();
+        bool abort = _abort;
+        mutex.unlock();
+        if(abort)
+            return;
+
+        QThread::msleep(ERASE_AHEAD_POLL_MS);
+    }
+
+    QString info = "FlashManager: ECU erased the download range of " + QString::number(total) + " bytes in " + QString::number(timer.elapsed()) + " ms\n";
+    qInfo() << info;
+    queuedGUIConsoleLog(info);
+}
+
 void FlashManager::transferData(){
 
     mutex.lock();
@@ -625,19 +1177,33 @@ void FlashManager::transferData(){
     QByteArray bytes = flashContent[flashCurrentAdd];
     uint8_t *data = (uint8_t*) bytes.data();
 
+    // The download starts after the data verified on the ECU
+    uint32_t downloadAdd = flashCurrentAdd + flashCurrentOffset;
+    uint32_t downloadEnd = flashCurrentAdd + bytes.size();
+
     UDS::RESP resp = UDS::RESP::RX_NO_RESPONSE;
     for(int package = flashCurrentPackageCtr; package < flashCurrentPackages; package++){
-        curr_flash_add = flashCurrentAdd + package*flashCurrentBufferSize;
-        curr_flash_byte_ptr = package*flashCurrentBufferSize;
+        curr_flash_add = downloadAdd + package*flashCurrentBufferSize;
+        curr_flash_byte_ptr = curr_flash_add - flashCurrentAdd;
 
         // Calc the bytes to be flashed
-        if(curr_flash_add + flashCurrentBufferSize < flashCurrentAdd+flashContent[flashCurrentAdd].size())
+        if(curr_flash_add + flashCurrentBufferSize < downloadEnd)
             curr_flash_bytes = flashCurrentBufferSize;
         else
-            curr_flash_bytes = flashCurrentAdd + flashContent[flashCurrentAdd].size() - curr_flash_add; // Last Packages
+            curr_flash_bytes = downloadEnd - curr_flash_add; // Last Packages
 
         //queuedGUIConsoleLog("Package "+QString::number(package+1)+"/"+QString::number(flashCurrentPackages)+": Transfer Data for flash address "+QString("0x%8").arg(curr_flash_add, 8, 16, QLatin1Char( '0' ))+ " ("+QString::number(curr_flash_bytes)+" bytes)");
-        resp = uds->transferData(ecu_id, curr_flash_add, data+curr_flash_byte_ptr, curr_flash_bytes);
+        // The ECU confirms a package before programming it (FLASHING_PIPELINED_TRANSFER_DATA), the next package is sent directly
+        // to keep one request in flight while the flash is busy. A programming failure is reported with the next package or Transfer Exit.
+        if(flashCurrentDataFormat == FBL_DATA_FORMAT_LZ4){
+            QByteArray block = lz4CompressBlock(data+curr_flash_byte_ptr, curr_flash_bytes);
+            resp = uds->transferData(ecu_id, curr_flash_add, (uint8_t*)block.data(), block.size());
+            transferDataBytes += block.size();
+        }
+        else{
+            resp = uds->transferData(ecu_id, curr_flash_add, data+curr_flash_byte_ptr, curr_flash_bytes);
+            transferDataBytes += curr_flash_bytes;
+        }
 
         if(resp != UDS::TX_RX_OK){
             // Check on response more detailed
@@ -656,9 +1222,12 @@ void FlashManager::transferData(){
         // Transfer Data successfully, update package ctr
         flashCurrentPackageCtr = package;
 
+        // Journal the confirmed data, an interrupted flashing continues after it
+        journal[flashCurrentAdd] = curr_flash_byte_ptr + curr_flash_bytes;
+        saveJournal();
+
         // Update the GUI progress bar
-        //TODO: Fix progress bar if flashing starts again for same address - Currently only adding
-        flashedBytes[flashCurrentAdd] += curr_flash_bytes;
+        flashedBytes[flashCurrentAdd] = curr_flash_byte_ptr + curr_flash_bytes;
         updateGUIProgressBar();
 
         mutex.lock();
@@ -673,12 +1242,20 @@ void FlashManager::transferData(){
         queuedGUIFlashingLog(INFO, "");
     }
 
-    resp = uds->requestTransferExit(ecu_id, flashCurrentAdd);
+    resp = uds->requestTransferExit(ecu_id, downloadAdd);
     if(resp != UDS::TX_RX_OK){
         emit errorPrint("ERROR: Transfer Exit failed");
         return;
     }
 
+    nextFlashAddress();
+}
+
+/**
+ * @brief Continues with the download of the next flash address, or with the validation once the file is transferred
+ */
+void FlashManager::nextFlashAddress(){
+
     // Update to the next flash address
     size_t itemsRemoved = flashContent.remove(flashCurrentAdd);
     if(!itemsRemoved){
@@ -687,6 +1264,7 @@ void FlashManager::transferData(){
 
     if(flashContent.keys().count() > 0){
         flashCurrentPackageCtr = 0;
+        flashCurrentOffset = 0;
         flashCurrentAdd = flashContent.firstKey();
         curr_state = REQ_DOWNLOAD;
         return;
@@ -694,6 +1272,18 @@ void FlashManager::transferData(){
 
     queuedGUIFlashingLog(INFO, "Flash file fully transmitted.");
 
+    size_t transmittedBytes = 0;
+    for(uint32_t bytes : flashedBytes)
+        transmittedBytes += bytes;
+    size_t resumed = getResumedBytes();
+    transmittedBytes -= resumed;
+    if(transmittedBytes > 0)
+        queuedGUIConsoleLog("FlashManager: Transfer Data payload " + QString::number(transferDataBytes) + " bytes for "
+                            + QString::number(transmittedBytes) + " bytes (" + QString::number(100.0 * transferDataBytes / transmittedBytes, 'f', 1) + " %)\n");
+    if(resumed > 0)
+        queuedGUIConsoleLog("FlashManager: " + QString::number(resumed) + " bytes of the interrupted flashing were verified on the ECU and not transferred again\n");
+
+    FlashTraceScope trace("wait", "Wait before Validate");
     QThread::msleep(2000);
     curr_state = VALIDATE;
 }
@@ -733,6 +1323,10 @@ void FlashManager::validateFlashing(){
              qInfo() << "IO - Should be: 0x" + QString::number(value, 16) + ", was: 0x" + QString::number(ecuChecksum, 16) + "\n";
         }
     }
+    // The content is checked completely, a new flashing must not continue on the journal
+    journal.clear();
+    saveJournal(1);
+
     if (errorcount != 0) {
         queuedGUIConsoleLog(QString::number(errorcount) + " checksums didn't match\n");
         curr_state = ERR_STATE; //TODO vllt
@@ -796,10 +1390,12 @@ void FlashManager::finishFlashing(){
     // Update GUI
     queuedGUIFlashingLog(INFO, "Flashing finished!");
 
+    succeeded = true;
     curr_state = IDLE;
 }
 
 void FlashManager::writeKey(int keyType){
+    FlashTraceScope trace("phase", keyType == GOOD ? "Write Good Key" : "Write Bad Key");
     if (keyType == GOOD)
     {
     
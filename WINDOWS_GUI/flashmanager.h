@@ -6,7 +6,7 @@
 //============================================================================
 // Name        : flashmanager.h
 // Author      : Michael Bauer, Sebastian Rodriguez
-// Version     : 0.2
+// Version     : 0.6
 // Copyright   : MIT
 // Description : Flashmanger to flash ECUs
 //============================================================================
@@ -20,6 +20,14 @@
 #define WAITTIME_AFTER_ATTEMPT      500         // Waittime in ms
 #define TIME_DELTA_GUI_LOG          500         // Delta in ms between GUI Updates for Console and Flashing log
 #define TIME_DELTA_GUI_FLASHING_LOG 1000        // Delta in ms between GUI Updates for Console and Flashing log
+#define DIFFERENTIAL_FLASHING       1           // 1 = Only sectors that differ from the ECU content are transferred, 0 = Complete file is transferred
+#define COMPRESSED_TRANSFER_DATA    1           // 1 = Transfer Data payloads are LZ4 compressed (FBL_DATA_FORMAT_LZ4) if the ECU supports it, 0 = Raw bytes
+#define TRANSFER_DATA_ALIGNMENT     32          // Compressed Transfer Data: Bytes per package are a multiple of the PFLASH page
+#define ERASE_AHEAD_POLL_MS         20          // Polling of FBL_DID_ERASE_PROGRESS after Request Download until the ECU erased the download range
+#define ERASE_AHEAD_TIMEOUT_MS      60000       // Max wait for the erase, Transfer Data starts anyway afterwards (the ECU erases while programming)
+#define RESUMABLE_FLASHING          1           // 1 = Confirmed Transfer Data is journaled, an interrupted flashing continues after the data verified on the ECU; 0 = Every download starts at its first byte
+#define FLASH_JOURNAL_SYNC_MS       1000        // Max delta in ms between writes of the progress journal during Transfer Data
+#define FLASH_TRACE                 1           // 1 = A timing trace (trace event JSON) is written per session if a trace directory is set (FBL_TRACE_DIR or setTraceDirectory), 0 = No tracing
 
 #define TESTFILE_PADDING_BYTES      7           // Padding between test data
 #define TESTFILE_CORE0_START_ADD    0xA0090000  // Start Address for flashing Core 0
@@ -40,11 +48,15 @@
 #include <QQueue>
 #include <QDateTime>
 #include <QPair>
+#include <QList>
+#include <QSharedPointer>
 
 #include <stdint.h>
 
 #include "UDS_Layer/UDS.hpp"
 #include "Communication_Layer/Communication.hpp"
+#include "flashtrace.h"
+#include "flashcontainer.h"
 
 class FlashManager : public QObject {
     Q_OBJECT
@@ -63,15 +75,35 @@ private:
     QString file;                                               // Reference to file for flashing
     QByteArray updateVersion;                                   // ByteArray with Update Version content, to be written after flashing is finished
     QMap<uint32_t, QByteArray> flashContent;                    // Map with Address -> continous byte array
+    QSharedPointer<FlashContainer> container;                   // Mapped container flashContent references, with the precomputed checksums (nullptr for setFlashFile)
     QMap<uint32_t, uint32_t> flashContentSize;                  // Map with total size of content for every address
     QMap<uint32_t, uint32_t> flashedBytes;                      // Map with sum of flashed bytes for every address
     QMap<uint32_t, uint32_t> checksums;                         // Map of the checksums for every address
+    bool rawChecksum;                                           // ECU calculates the checksums over the raw bytes (FBL_CHECKSUM_MODE_RAW) instead of ASCII-Hex
+    size_t skippedBytes;                                        // Bytes of the file not transferred since their sectors are equal on the ECU (DIFFERENTIAL_FLASHING)
+    bool compressionSupported;                                  // Cleared if the ECU rejects a Request Download with FBL_DATA_FORMAT_LZ4
+    uint8_t flashCurrentDataFormat;                             // dataFormatIdentifier of the current download
+    size_t transferDataBytes;                                   // Payload bytes of all Transfer Data requests (compressed size with FBL_DATA_FORMAT_LZ4)
+    bool eraseAheadSupported;                                   // Cleared if the ECU does not answer FBL_DID_ERASE_PROGRESS
+    bool programmedOffsetSupported;                             // Cleared if the ECU does not answer FBL_DID_PROGRAMMED_OFFSET
+    QMap<uint32_t, uint32_t> journal;                           // Progress journal: start address -> bytes confirmed by Transfer Data (RESUMABLE_FLASHING)
+    uint32_t journalImage;                                      // Checksum of the file the journal belongs to
+    bool journalActive;                                         // Journal is loaded and written, needs the raw checksums for the verification
+    QDateTime lastJournalSync;                                  // Stores the last timestamp the journal was written to the settings
+    bool resumingSession;                                       // The ECU kept the data of the interrupted flashing, the Bad Key is written already
+    QMap<uint32_t, uint32_t> resumedBytes;                      // Map with the bytes of every address verified on the ECU instead of transferred again
+    bool succeeded;                                             // Set once the flashing is finished with the Good Key and the Default Session
+    bool sharedBus;                                             // Communication is shared with other FlashManagers, see setSharedBus
+    QList<QMetaObject::Connection> commConnections;             // Connections to comm made by startFlashing
+    QString traceDirectory;                                     // Directory for the timing trace of every session (FLASH_TRACE), empty = no trace
+    QString traceFile;                                          // Timing trace of the last session, empty if none was written
 
     size_t flashedBytesCtr;                                     // Counter for flashed bytes
     uint32_t flashCurrentAdd;                                   // Stores the current address to be flashed
     uint32_t flashCurrentPackages;                              // Stores the current number of packes for flashCurrentAdd;
     uint32_t flashCurrentBufferSize;                            // Stores the current buffer size per
     uint32_t flashCurrentPackageCtr;                            // Stores the current counter of the package
+    uint32_t flashCurrentOffset;                                // Bytes of flashCurrentAdd verified on the ECU, the download starts after them
 
     uint32_t aswKeyAdd;                                         // Stores the address of the ASW Key
     uint32_t goodKeyValue;                                      // Stores the good key value which is stored in MCU
@@ -93,9 +125,17 @@ public:
     void setECUID(uint32_t ecu_id);
     void setTestFile();
     void setFlashFile(QMap<uint32_t, QByteArray> data);
+    bool setFlashContainer(QSharedPointer<FlashContainer> container);
     void setUpdateVersion(QByteArray version);
     void setASWKeyContent(uint32_t add, uint32_t content);
     QMap<uint32_t, QByteArray> getFlashContent(void);
+    size_t getSkippedBytes(void);
+    size_t getTransferDataBytes(void);
+    size_t getResumedBytes(void);
+    void setSharedBus(bool shared);
+    bool hasSucceeded(void);
+    void setTraceDirectory(QString dir);
+    QString getTraceFile(void);
 
     void startFlashing(uint32_t ecu_id, uint32_t gui_id, Communication* comm){
 
@@ -108,16 +148,24 @@ public:
         this->ecu_id = ecu_id;
         this->comm = comm;
         this->uds = new UDS(gui_id);
+        this->succeeded = false;
 
-        // Disconnect everything from comm
-        disconnect(comm, SIGNAL(rxDataReceived(uint, QByteArray)), 0, 0); // disconnect everything connect to rxDataReived
-        disconnect(comm, SIGNAL(toConsole(QString)), 0, 0); // disconnect everything connect to toConsole
+        // The other sessions on a shared bus keep their connections and wait statistics
+        if(!sharedBus){
+            // Wait statistics are accounted per flashing session
+            this->comm->resetWaitStatistics();
 
-        // GUI Console Print
-        connect(this->comm, SIGNAL(toConsole(QString)), this, SLOT(forwardToConsole(QString)), Qt::DirectConnection);
+            // Disconnect everything from comm
+            disconnect(comm, SIGNAL(rxDataReceived(uint, QByteArray)), 0, 0); // disconnect everything connect to rxDataReived
+            disconnect(comm, SIGNAL(toConsole(QString)), 0, 0); // disconnect everything connect to toConsole
+        }
+
+        // GUI Console Print, forwarded once for all sessions on a shared bus
+        if(!sharedBus)
+            commConnections.append(connect(this->comm, SIGNAL(toConsole(QString)), this, SLOT(forwardToConsole(QString)), Qt::DirectConnection));
 
         // Comm RX Signal to UDS RX Slot
-        connect(this->comm, SIGNAL(rxDataReceived(uint, QByteArray)), this->uds, SLOT(rxDataReceiverSlot(uint, QByteArray)), Qt::DirectConnection);
+        commConnections.append(connect(this->comm, SIGNAL(rxDataReceived(uint, QByteArray)), this->uds, SLOT(rxDataReceiverSlot(uint, QByteArray)), Qt::DirectConnection));
 
         // UDS TX Signals to Comm TX Slots
         connect(this->uds, SIGNAL(setID(uint32_t)),    this->comm, SLOT(setIDSlot(uint32_t)), Qt::DirectConnection);
@@ -148,10 +196,13 @@ public:
 
 
         // Comm RX Signal to UDS RX Slot
-        if(comm != nullptr){
+        if(comm != nullptr && !sharedBus){
             disconnect(comm, SIGNAL(rxDataReceived(uint, QByteArray)), 0, 0); // disconnect everything connect to rxDataReived
             disconnect(comm, SIGNAL(toConsole(QString)), 0, 0);
         }
+        for(const QMetaObject::Connection &connection : commConnections)
+            disconnect(connection);
+        commConnections.clear();
 
         // UDS TX Signals to Comm TX Slots
         if(uds != nullptr){
@@ -170,15 +221,28 @@ private:
     void updateGUIProgressBar();
     void queuedGUIConsoleLog(QString info, bool forced=0);
     void queuedGUIFlashingLog(FlashManager::STATUS s, QString info, bool forced=0);
+    void logWaitStatistics();
+    void writeTrace(FlashTrace *trace);
+    static const char *stateName(STATE_MACHINE state);
     void changeSessionAndLogin();
-    QMap<uint32_t, uint32_t> calculateFileChecksums(QMap<uint32_t, QByteArray> data);
-    QMap<uint32_t, QByteArray> uncompressData(QMap<uint32_t, QByteArray> compressedData);
+    bool selectRawChecksumMode();
+    QMap<uint32_t, uint32_t> calculateFileChecksums(const QMap<uint32_t, QByteArray> &data);
+    QMap<uint32_t, QByteArray> planDifferentialFlashing(const QMap<uint32_t, QByteArray> &data);
+    QMap<uint32_t, QByteArray> uncompressData(const QMap<uint32_t, QByteArray> &compressedData);
+    QString journalGroup();
+    void loadJournal(uint32_t image);
+    void saveJournal(bool forced=0);
+    bool ecuContinuesJournal();
+    uint32_t findResumeOffset();
+    bool verifyOnECU(uint32_t bytes);
 
     void doFlashing();
     void prepareFlashing();
     void startFlashing();
     void requestDownload();
+    void waitForEraseAhead();
     void transferData();
+    void nextFlashAddress();
     void validateFlashing();
     void finishFlashing();
     void writeKey(int keyType);
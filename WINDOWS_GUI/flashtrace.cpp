@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : flashtrace.cpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Timing trace of a flashing session in the Chrome trace event format
+//============================================================================
+
+#include "flashtrace.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QThread>
+
+// Trace of the calling thread, set by the flashing thread for its session
+static thread_local FlashTrace *current_trace = nullptr;
+
+//////////////////////////////////////////////////////////////////////////////
+// FlashTrace
+//////////////////////////////////////////////////////////////////////////////
+
+FlashTrace::FlashTrace(uint32_t pid, const QString &process_name){
+    this->pid = pid;
+    this->process_name = process_name;
+    this->dropped = 0;
+}
+
+/**
+ * @brief Returns the monotonic time base shared by all traces
+ * @return Time in ns since the first call
+ */
+uint64_t FlashTrace::nowNs(){
+    static QElapsedTimer clock = [](){
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return (uint64_t)clock.nsecsElapsed();
+}
+
+/**
+ * @brief Returns the trace the calling thread records to
+ * @return Current trace, nullptr if tracing is disabled for the thread
+ */
+FlashTrace *FlashTrace::current(){
+    return current_trace;
+}
+
+/**
+ * @brief Sets the trace the calling thread records to
+ * @param trace Trace to record to, nullptr to disable tracing for the thread
+ */
+void FlashTrace::setCurrent(FlashTrace *trace){
+    current_trace = trace;
+}
+
+/**
+ * @brief Returns the index of the calling thread within the trace, needs the mutex
+ */
+int FlashTrace::threadIndex(){
+    quintptr handle = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    auto it = threads.constFind(handle);
+    if(it != threads.constEnd())
+        return it.value();
+
+    int tid = threads.size() + 1;
+    threads.insert(handle, tid);
+    return tid;
+}
+
+/**
+ * @brief Records an event with a duration
+ * @param cat Category of the event, needs to be a string literal
+ * @param name Name of the event
+ * @param start_ns Start of the event (nowNs)
+ * @param end_ns End of the event (nowNs)
+ * @param args Details of the event
+ */
+void FlashTrace::complete(const char *cat, const QString &name, uint64_t start_ns, uint64_t end_ns, const QJsonObject &args){
+    mutex.lock();
+    if(events.size() >= FLASH_TRACE_MAX_EVENTS){
+        dropped++;
+        mutex.unlock();
+        return;
+    }
+    events.append({cat, name, start_ns, end_ns >= start_ns ? end_ns - start_ns : 0, false, threadIndex(), args});
+    mutex.unlock();
+}
+
+/**
+ * @brief Records an event without a duration at the current time
+ * @param cat Category of the event, needs to be a string literal
+ * @param name Name of the event
+ * @param args Details of the event
+ */
+void FlashTrace::instant(const char *cat, const QString &name, const QJsonObject &args){
+    uint64_t now = nowNs();
+    mutex.lock();
+    if(events.size() >= FLASH_TRACE_MAX_EVENTS){
+        dropped++;
+        mutex.unlock();
+        return;
+    }
+    events.append({cat, name, now, 0, true, threadIndex(), args});
+    mutex.unlock();
+}
+
+/**
+ * @brief Returns the number of recorded events
+ */
+int FlashTrace::size(){
+    mutex.lock();
+    int size = events.size();
+    mutex.unlock();
+    return size;
+}
+
+/**
+ * @brief Writes the trace as JSON object format of the trace event format, timestamps in us
+ * @param file Path of the file, overwritten if it exists
+ * @return true if the file was written
+ */
+bool FlashTrace::write(const QString &file){
+    QFile out(file);
+    if(!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    mutex.lock();
+
+    out.write("{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":");
+    out.write(QByteArray::number((qulonglong)dropped));
+    out.write("},\"traceEvents\":[\n");
+
+    // Names of the process and the threads
+    QJsonObject meta;
+    meta["name"] = "process_name";
+    meta["ph"] = "M";
+    meta["pid"] = (qint64)pid;
+    meta["args"] = QJsonObject{{"name", process_name}};
+    out.write(QJsonDocument(meta).toJson(QJsonDocument::Compact));
+
+    for(auto it = threads.constBegin(); it != threads.constEnd(); ++it){
+        meta["name"] = "thread_name";
+        meta["tid"] = it.value();
+        meta["args"] = QJsonObject{{"name", it.value() == 1 ? QString("Flashing") : "Thread " + QString::number(it.value())}};
+        out.write(",\n");
+        out.write(QJsonDocument(meta).toJson(QJsonDocument::Compact));
+    }
+
+    for(const Event &event : events){
+        QJsonObject obj;
+        obj["name"] = event.name;
+        obj["cat"] = event.cat;
+        obj["ph"] = event.instant ? "i" : "X";
+        obj["ts"] = event.start_ns / 1000.0;
+        if(event.instant)
+            obj["s"] = "t";
+        else
+            obj["dur"] = event.dur_ns / 1000.0;
+        obj["pid"] = (qint64)pid;
+        obj["tid"] = event.tid;
+        if(!event.args.isEmpty())
+            obj["args"] = event.args;
+        out.write(",\n");
+        out.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    }
+
+    mutex.unlock();
+
+    out.write("\n]}\n");
+    out.close();
+    return out.error() == QFileDevice::NoError;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// FlashTraceScope
+//////////////////////////////////////////////////////////////////////////////
+
+FlashTraceScope::FlashTraceScope(const char *cat, const char *name){
+    this->trace = FlashTrace::current();
+    this->cat = cat;
+    this->name = name;
+    this->start_ns = trace != nullptr ? FlashTrace::nowNs() : 0;
+}
+
+FlashTraceScope::~FlashTraceScope(){
+    if(trace != nullptr)
+        trace->complete(cat, QString::fromLatin1(name), start_ns, FlashTrace::nowNs(), args);
+}
+
+/**
+ * @brief Adds a detail to the event, only call it if the scope is active
+ * @param key Name of the detail
+ * @param value Value of the detail
+ */
+void FlashTraceScope::setArg(const QString &key, const QJsonValue &value){
+    args[key] = value;
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : flashtrace.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Timing trace of a flashing session in the Chrome trace event format
+//============================================================================
+
+#ifndef FLASHTRACE_H_
+#define FLASHTRACE_H_
+
+#define FLASH_TRACE_MAX_EVENTS      (500000)    // Events per trace, further events are only counted
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include "stdint.h"
+
+/**
+ * @brief Collects timed events of one flashing session and writes them as trace event JSON (chrome://tracing, Perfetto).
+ *        The events are recorded for the threads the trace is set as current trace for, all traces share one
+ *        monotonic time base, so the traces of parallel sessions can be loaded side by side.
+ */
+class FlashTrace {
+
+private:
+    struct Event {
+        const char *cat;                        // Category, string literal
+        QString name;                           // Name shown in the timeline
+        uint64_t start_ns;                      // Start on the common time base
+        uint64_t dur_ns;                        // Duration, 0 for instant events
+        bool instant;                           // Instant event instead of a complete event
+        int tid;                                // Index of the recording thread
+        QJsonObject args;                       // Details of the event, optional
+    };
+
+    uint32_t pid;                               // Process ID of the trace, the ECU ID
+    QString process_name;                       // Name of the process in the timeline
+    QVector<Event> events;                      // Recorded events
+    QMap<quintptr, int> threads;                // Thread handle -> tid of the trace
+    uint64_t dropped;                           // Events not recorded due to FLASH_TRACE_MAX_EVENTS
+    QMutex mutex;                               // Protects events, threads and dropped
+
+    int threadIndex();
+
+public:
+    FlashTrace(uint32_t pid, const QString &process_name);
+
+    void complete(const char *cat, const QString &name, uint64_t start_ns, uint64_t end_ns, const QJsonObject &args = QJsonObject());
+    void instant(const char *cat, const QString &name, const QJsonObject &args = QJsonObject());
+    bool write(const QString &file);
+    int size();
+
+    static uint64_t nowNs();
+    static FlashTrace *current();
+    static void setCurrent(FlashTrace *trace);
+};
+
+/**
+ * @brief Records a complete event of the current trace of the thread from construction to destruction.
+ *        Without a current trace only the pointer is checked.
+ */
+class FlashTraceScope {
+
+private:
+    FlashTrace *trace;
+    const char *cat;
+    const char *name;
+    uint64_t start_ns;
+    QJsonObject args;
+
+public:
+    FlashTraceScope(const char *cat, const char *name);
+    ~FlashTraceScope();
+
+    bool active() const { return trace != nullptr; }
+    void setArg(const QString &key, const QJsonValue &value);
+};
+
+#endif /* FLASHTRACE_H_ */
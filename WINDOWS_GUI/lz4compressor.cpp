@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : lz4compressor.cpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Compression of LZ4 blocks for Transfer Data with FBL_DATA_FORMAT_LZ4
+//============================================================================
+
+#include "lz4compressor.h"
+
+#include <string.h>
+#include <vector>
+
+//============================================================================
+// Internal helper function
+//============================================================================
+
+static inline uint32_t read32(const uint8_t *data){
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash32(uint32_t sequence){
+    return (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+/**
+ * @brief Appends the extension bytes of a literal or match length that does not fit into the token nibble
+ * @param out Compressed block
+ * @param len Length, at least 15
+ */
+static void writeLength(QByteArray &out, uint32_t len){
+    len -= 15;
+    while(len >= 255){
+        out.append((char)255);
+        len -= 255;
+    }
+    out.append((char)len);
+}
+
+/**
+ * @brief Appends a sequence of literals followed by a match, a match length of 0 marks the last sequence
+ * @param out Compressed block
+ * @param literals First literal
+ * @param literal_len Number of literals
+ * @param offset Distance of the match to the current position
+ * @param match_len Length of the match, 0 or at least LZ4_MIN_MATCH
+ */
+static void writeSequence(QByteArray &out, const uint8_t *literals, uint32_t literal_len, uint32_t offset, uint32_t match_len){
+    uint32_t match_code = match_len > 0 ? match_len - LZ4_MIN_MATCH : 0;
+    uint8_t token = (uint8_t)(((literal_len < 15 ? literal_len : 15) << 4) | (match_code < 15 ? match_code : 15));
+
+    out.append((char)token);
+    if(literal_len >= 15)
+        writeLength(out, literal_len);
+    out.append((const char*)literals, literal_len);
+
+    if(match_len == 0)
+        return;
+
+    out.append((char)(offset & 0xFF));
+    out.append((char)((offset >> 8) & 0xFF));
+    if(match_code >= 15)
+        writeLength(out, match_code);
+}
+
+//============================================================================
+// Public
+//============================================================================
+
+/**
+ * @brief Compresses the data into one LZ4 block (no frame header), decompressed by lz4DecompressBlock of the bootloader.
+ *        Greedy matching with a hash table of the last position of every 4 byte sequence.
+ * @param data Data to be compressed
+ * @param len Number of bytes, at least 1
+ * @return Compressed block with at most lz4CompressBound(len) bytes
+ */
+QByteArray lz4CompressBlock(const uint8_t *data, uint32_t len){
+    QByteArray out;
+    out.reserve(lz4CompressBound(len));
+
+    std::vector<int32_t> table(1 << LZ4_HASH_BITS, -1);
+
+    uint32_t anchor = 0;                                        // First literal not written yet
+    uint32_t pos = 0;
+    if(len > LZ4_MATCH_FIND_LIMIT){
+        uint32_t match_start_limit = len - LZ4_MATCH_FIND_LIMIT;
+        uint32_t match_end_limit = len - LZ4_LAST_LITERALS;
+
+        while(pos <= match_start_limit){
+            uint32_t sequence = read32(data + pos);
+            uint32_t hash = hash32(sequence);
+            int32_t ref = table[hash];
+            table[hash] = (int32_t)pos;
+
+            if(ref < 0 || pos - ref > LZ4_MAX_OFFSET || read32(data + ref) != sequence){
+                pos++;
+                continue;
+            }
+
+            uint32_t match_len = LZ4_MIN_MATCH;
+            while(pos + match_len < match_end_limit && data[ref + match_len] == data[pos + match_len])
+                match_len++;
+
+            // The match might already start within the literals
+            while(pos > anchor && ref > 0 && data[pos - 1] == data[ref - 1]){
+                pos--;
+                ref--;
+                match_len++;
+            }
+
+            writeSequence(out, data + anchor, pos - anchor, pos - ref, match_len);
+            pos += match_len;
+            anchor = pos;
+        }
+    }
+
+    writeSequence(out, data + anchor, len - anchor, 0, 0);
+    return out;
+}
+
+/**
+ * @brief Returns the size of a compressed block in the worst case (incompressible data)
+ * @param len Number of bytes to be compressed
+ * @return Max number of bytes of the compressed block
+ */
+uint32_t lz4CompressBound(uint32_t len){
+    return len + len / 255 + 16;
+}
+
+/**
+ * @brief Returns the number of bytes that can be compressed in any case into the given size
+ * @param compressed_capacity Max number of bytes of the compressed block
+ * @return Max number of bytes to be compressed
+ */
+uint32_t lz4MaxInputSize(uint32_t compressed_capacity){
+    if(compressed_capacity <= 16)
+        return 0;
+    return (uint32_t)((uint64_t)(compressed_capacity - 16) * 255 / 256);
+}
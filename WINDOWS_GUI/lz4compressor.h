@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : lz4compressor.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Compression of LZ4 blocks for Transfer Data with FBL_DATA_FORMAT_LZ4
+//============================================================================
+
+#ifndef LZ4COMPRESSOR_H_
+#define LZ4COMPRESSOR_H_
+
+#define LZ4_MIN_MATCH               4           // Shortest match, encoded as 0 in the token
+#define LZ4_LAST_LITERALS           5           // The last bytes of a block are always literals
+#define LZ4_MATCH_FIND_LIMIT        12          // The last match starts at least this number of bytes before the end
+#define LZ4_MAX_OFFSET              65535       // Matches reference at most 64 KB back
+#define LZ4_HASH_BITS               12          // Entries of the hash table for finding matches (2^x)
+
+#include <QByteArray>
+
+#include <stdint.h>
+
+QByteArray lz4CompressBlock(const uint8_t *data, uint32_t len);
+uint32_t lz4CompressBound(uint32_t len);
+uint32_t lz4MaxInputSize(uint32_t compressed_capacity);
+
+#endif /* LZ4COMPRESSOR_H_ */
@@ -135,8 +135,7 @@ void MainWindow::connectSignalSlots() {
                     return;
                 }
                 ui->label_size->setText("File size:  " + QString::number(file.size()));
-                QByteArray data = file.readAll();
-                ui->label_content->setText("File content:  " + data.left(16).toHex());
+                ui->label_content->setText("File content:  " + file.read(16).toHex());
 
                 // Set file type
                 QFileInfo fileInfo(path);
@@ -145,10 +144,28 @@ void MainWindow::connectSignalSlots() {
 
                 rootDir = fileInfo.absolutePath();
 
-                // Validate file, result is already prepared for further calculations
-                validMan->validateFileAsync(data);
-
                 file.close();
+
+                // A container (compiled before or cached for the file and the layout of the ECU) needs no validation.
+                // The content of the previous container references its mapping and is dropped with it.
+                if(flashContainer){
+                    validMan->data.clear();
+                    flashContainer.reset();
+                }
+                flashContainerCachePath.clear();
+                if(FlashContainer::isContainer(path)){
+                    loadFlashContainer(path);
+                    return;
+                }
+                if(FLASH_CONTAINER_CACHE){
+                    flashContainerHash = FlashContainer::hashFile(path);
+                    flashContainerCachePath = FlashContainer::cachePath(flashContainerHash, validMan->getRegions());
+                    if(!flashContainerCachePath.isEmpty() && QFileInfo::exists(flashContainerCachePath) && loadFlashContainer(flashContainerCachePath))
+                        return;
+                }
+
+                // Validate file, result is already prepared for further calculations (file is parsed in the validation thread)
+                validMan->validateFileAsync(path);
             }
         }
         else{
@@ -262,6 +279,11 @@ void MainWindow::setupFlashPopup() {
                 }
 
                 flashMan->setUpdateVersion(ui->label_version->text().mid(14).toLocal8Bit());
+
+                // Flashed directly from the mapped container with its precomputed checksums
+                if(flashContainer)
+                    flashMan->setFlashContainer(flashContainer);
+
                 flashMan->startFlashing(selectedID, gui_id, comm);
             }
         }
@@ -479,15 +501,17 @@ void MainWindow::updateECUList(){
     // Wait and then check on all the received ECUs
     QTimer::singleShot(500, [this]{
         qInfo("Updating ECU Listing Table");
+        // The requests to all ECUs are outstanding at the same time, every ECU answers one after the other
         for(QString ID : eculist.keys()){
             unsigned int id_int = ID.toUInt();
             uint32_t ecu_id = (0xFFF0 & id_int) >> 4;
             if(id_int > 0){
-                uds->readDataByIdentifier(ecu_id, (uint16_t) FBL_DID_SYSTEM_NAME);
-                uds->readDataByIdentifier(ecu_id, (uint16_t) FBL_DID_APP_ID);
-                uds->readDataByIdentifier(ecu_id, (uint16_t) FBL_DID_PROGRAMMING_DATE);
+                uds->readDataByIdentifierAsync(ecu_id, (uint16_t) FBL_DID_SYSTEM_NAME);
+                uds->readDataByIdentifierAsync(ecu_id, (uint16_t) FBL_DID_APP_ID);
+                uds->readDataByIdentifierAsync(ecu_id, (uint16_t) FBL_DID_PROGRAMMING_DATE);
             }
         }
+        uds->waitForAsync();
 
         // Short break to process the incoming signals
         QTimer::singleShot(100, [this]{
@@ -904,6 +928,50 @@ void MainWindow::onValidationDone(const QMap<uint32_t, QByteArray> result){
     // Handle the result of validation here
     validMan->data = result; // Or use the result directly
 
+    // Compile the valid file into the cache, the next selection of it is loaded from there
+    if(FLASH_CONTAINER_CACHE && !flashContainerCachePath.isEmpty() && !result.isEmpty() && ui->label_valid->text() == "File validity:  Valid")
+        compileFlashContainer(result);
+}
+
+/**
+ * @brief Loads a flash container instead of validating a file, the content is used from the mapping
+ * @param path Path of the container
+ * @return false if the container is not valid or was compiled for other address ranges than the ones of the ECU
+ */
+bool MainWindow::loadFlashContainer(const QString &path){
+    QSharedPointer<FlashContainer> container(new FlashContainer());
+    if(!container->open(path) || !container->matchesLayout(validMan->getRegions())){
+        QString reason = container->isOpen() ? "it was compiled for other address ranges than the ones of the ECU" : container->errorString();
+        qInfo() << "MainWindow: Flash container " + path + " not used, " + reason;
+        appendTextToConsole("INFO: Flash container " + path + " not used, " + reason + "\n");
+        updateLabel(ValidateManager::VALID, "File validity:  Not Valid");
+        return false;
+    }
+
+    QMap<uint32_t, QByteArray> segments = container->getSegments();
+    updateLabel(ValidateManager::HEADER, "File version: " + QString::fromLatin1(container->getAppID()));
+    updateLabel(ValidateManager::VALID, validMan->checkBlockAddressRange(segments) ? "File validity:  Valid" : "File validity:  Not Valid");
+    appendTextToConsole("INFO: Loaded flash container " + path + "\n");
+
+    validMan->data = segments;
+    flashContainer = container;
+    return true;
+}
+
+/**
+ * @brief Compiles the validated content of the selected file into its cache entry and flashes from it afterwards
+ * @param data Validated and aligned content of the file
+ */
+void MainWindow::compileFlashContainer(const QMap<uint32_t, QByteArray> &data){
+    QByteArray app_id = ui->label_version->text().mid(14).toLocal8Bit();
+    if(!FlashContainer::write(flashContainerCachePath, data, app_id, validMan->getRegions(), flashContainerHash)){
+        qInfo() << "MainWindow: Could not write flash container " + flashContainerCachePath;
+        return;
+    }
+
+    QSharedPointer<FlashContainer> container(new FlashContainer());
+    if(container->open(flashContainerCachePath))
+        flashContainer = container;
 }
 
 //=============================================================================
@@ -14,6 +14,7 @@
 #include "Communication_Layer/Communication.hpp"
 #include "flashmanager.h"
 #include "validatemanager.h"
+#include "flashcontainer.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -48,6 +49,9 @@ private:
     QMap<QString, QMap<QString, QString>> eculist;
     bool validManagerValuesAvailable;
     ValidateManager *validMan;
+    QSharedPointer<FlashContainer> flashContainer;     // Container of the selected file, flashed instead of validMan->data
+    QString flashContainerCachePath;                   // Cache entry the selected file is compiled into after its validation
+    QByteArray flashContainerHash;                     // SHA-256 of the selected file
     QTimer *ecuConnectivityTimer;
 
 protected:
@@ -78,6 +82,8 @@ private:
     void setFlashButton(FLASH_BTN m);
 
     bool updateValidManager();
+    bool loadFlashContainer(const QString &path);
+    void compileFlashContainer(const QMap<uint32_t, QByteArray> &data);
 
 private slots:
     void startUDSUsage();
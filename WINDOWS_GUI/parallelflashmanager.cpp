@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : parallelflashmanager.cpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Flashes several ECUs at the same time, one FlashManager per ECU
+//============================================================================
+
+#include "parallelflashmanager.h"
+
+#include <QDeadlineTimer>
+#include <QSet>
+
+//============================================================================
+// Constructor
+//============================================================================
+
+ParallelFlashManager::ParallelFlashManager(QObject *parent): QObject(parent){
+
+    // Register Result to make it usable for Signals&Slots
+    qRegisterMetaType<ParallelFlashManager::Result>("ParallelFlashManager::Result");
+
+    this->aswKeyAdd = 0;
+    this->goodKeyValue = 0;
+    this->running = 0;
+}
+
+ParallelFlashManager::~ParallelFlashManager(){
+    stopFlashing();
+    clearECUs();
+}
+
+//============================================================================
+// Public Method
+//============================================================================
+
+/**
+ * @brief Adds an ECU to be flashed with the next startFlashing
+ * @param ecu_id ECU ID to flash, the broadcast ID 0 is not possible
+ * @param comm Communication of the bus the ECU is connected to, can be shared with other ECUs
+ */
+void ParallelFlashManager::addECU(uint32_t ecu_id, Communication *comm){
+    if(ecu_id == 0 || ecu_id > 0xFFF || comm == nullptr){
+        emit errorPrint("ParallelFlashManager: Could not add ECU. Wrong ECU ID or Communication given");
+        return;
+    }
+
+    Session *session = new Session();
+    session->ecu_id = ecu_id;
+    session->comm = comm;
+    session->flashMan = nullptr;
+    session->thread = nullptr;
+    session->result = {ecu_id, false, false, 0, 0, 0};
+    sessions.append(session);
+}
+
+/**
+ * @brief Removes all ECUs, the flashing needs to be finished
+ */
+void ParallelFlashManager::clearECUs(){
+    for(Session *session : sessions){
+        if(session->thread != nullptr)
+            session->thread->wait();
+
+        if(session->flashMan != nullptr){
+            disconnect(session->flashMan, nullptr, nullptr, nullptr);
+            delete session->flashMan;
+        }
+        delete session->thread;
+        delete session;
+    }
+    sessions.clear();
+
+    for(const QMetaObject::Connection &connection : commConnections)
+        disconnect(connection);
+    commConnections.clear();
+}
+
+void ParallelFlashManager::setFlashFile(QMap<uint32_t, QByteArray> data){
+    flashContent = data;
+}
+
+void ParallelFlashManager::setUpdateVersion(QByteArray version){
+    updateVersion = version;
+}
+
+void ParallelFlashManager::setASWKeyContent(uint32_t add, uint32_t content){
+    aswKeyAdd = add;
+    goodKeyValue = content;
+}
+
+/**
+ * @brief Starts one flashing thread per ECU. Everything connected to the RX and console signals of the
+ *        Communications is disconnected, the sessions only connect themselves (FlashManager::setSharedBus).
+ * @param gui_id GUI ID for TX
+ */
+void ParallelFlashManager::startFlashing(uint32_t gui_id){
+    if(sessions.isEmpty()){
+        emit errorPrint("ParallelFlashManager: Could not start flashing. No ECUs given");
+        emit allFinished();
+        return;
+    }
+
+    // Sessions of the last flashing
+    for(Session *session : sessions){
+        if(session->thread != nullptr)
+            session->thread->wait();
+        if(session->flashMan != nullptr){
+            disconnect(session->flashMan, nullptr, nullptr, nullptr);
+            delete session->flashMan;
+        }
+        delete session->thread;
+        session->flashMan = nullptr;
+        session->thread = nullptr;
+    }
+    for(const QMetaObject::Connection &connection : commConnections)
+        disconnect(connection);
+    commConnections.clear();
+
+    // Every Communication is prepared once, even if it is shared by several ECUs
+    QSet<Communication*> comms;
+    for(Session *session : sessions){
+        if(comms.contains(session->comm))
+            continue;
+        comms.insert(session->comm);
+
+        disconnect(session->comm, SIGNAL(rxDataReceived(uint, QByteArray)), 0, 0);
+        disconnect(session->comm, SIGNAL(toConsole(QString)), 0, 0);
+        session->comm->resetWaitStatistics();
+        commConnections.append(connect(session->comm, &Communication::toConsole, this, [this](const QString &text){
+            emit infoPrint(text);
+        }, Qt::DirectConnection));
+    }
+
+    mutex.lock();
+    running = sessions.size();
+    mutex.unlock();
+
+    for(Session *session : sessions){
+        session->result = {session->ecu_id, false, false, 0, 0, 0};
+
+        session->thread = new QThread();
+        session->flashMan = new FlashManager();
+        session->flashMan->moveToThread(session->thread);
+        session->flashMan->setSharedBus(true);
+
+        QString prefix = "ECU " + QString("0x%1").arg(session->ecu_id, 3, 16, QLatin1Char( '0' )) + ": ";
+        connect(session->flashMan, SIGNAL(flashingStartThreadRequested()), session->thread, SLOT(start()), Qt::DirectConnection);
+        connect(session->thread, SIGNAL(started()), session->flashMan, SLOT(runThread()));
+        connect(session->flashMan, SIGNAL(flashingThreadFinished()), session->thread, SLOT(quit()), Qt::DirectConnection);
+        connect(session->flashMan, &FlashManager::flashingThreadFinished, session->flashMan, [this, session](){
+            sessionFinished(session);
+        }, Qt::DirectConnection);
+        connect(session->flashMan, &FlashManager::infoPrint, session->flashMan, [this, prefix](const QString &text){
+            emit infoPrint(prefix + text);
+        }, Qt::DirectConnection);
+        connect(session->flashMan, &FlashManager::errorPrint, session->flashMan, [this, prefix](const QString &text){
+            emit errorPrint(prefix + text);
+        }, Qt::DirectConnection);
+
+        session->flashMan->setFlashFile(flashContent);
+        session->flashMan->setASWKeyContent(aswKeyAdd, goodKeyValue);
+        if(!updateVersion.isEmpty())
+            session->flashMan->setUpdateVersion(updateVersion);
+
+        session->timer.start();
+        session->flashMan->startFlashing(session->ecu_id, gui_id, session->comm);
+    }
+}
+
+/**
+ * @brief Requests all running sessions to abort
+ */
+void ParallelFlashManager::stopFlashing(){
+    for(Session *session : sessions){
+        if(session->flashMan != nullptr)
+            session->flashMan->stopFlashing();
+    }
+}
+
+/**
+ * @brief Blocks until all sessions are finished
+ * @param timeout_ms Max time to wait
+ * @return true if all sessions are finished, false on timeout
+ */
+bool ParallelFlashManager::waitForFinished(unsigned long timeout_ms){
+    QDeadlineTimer deadline(timeout_ms);
+    for(Session *session : sessions){
+        if(session->thread != nullptr && !session->thread->wait(deadline))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the results of the last flashing
+ * @return One result per ECU in the order of addECU
+ */
+QList<ParallelFlashManager::Result> ParallelFlashManager::getResults(){
+    QList<Result> results;
+    mutex.lock();
+    for(Session *session : sessions)
+        results.append(session->result);
+    mutex.unlock();
+    return results;
+}
+
+//============================================================================
+// Private Method
+//============================================================================
+
+/**
+ * @brief Records the result of a session, called from its flashing thread
+ * @param session Finished session
+ */
+void ParallelFlashManager::sessionFinished(Session *session){
+    Result result;
+    result.ecu_id = session->ecu_id;
+    result.finished = true;
+    result.passed = session->flashMan->hasSucceeded();
+    result.flash_ms = session->timer.elapsed();
+    result.skipped_bytes = session->flashMan->getSkippedBytes();
+    result.transfer_data_bytes = session->flashMan->getTransferDataBytes();
+
+    mutex.lock();
+    session->result = result;
+    bool all_finished = --running == 0;
+    mutex.unlock();
+
+    emit infoPrint("ECU " + QString("0x%1").arg(session->ecu_id, 3, 16, QLatin1Char( '0' )) + ": Flashing "
+                   + (result.passed ? "passed" : "failed") + " after " + QString::number(result.flash_ms) + " ms");
+    emit ecuFinished(result);
+    if(all_finished)
+        emit allFinished();
+}
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : parallelflashmanager.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Flashes several ECUs at the same time, one FlashManager per ECU
+//============================================================================
+
+#ifndef PARALLELFLASHMANAGER_H_
+#define PARALLELFLASHMANAGER_H_
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QThread>
+
+#include <stdint.h>
+
+#include "flashmanager.h"
+#include "Communication_Layer/Communication.hpp"
+
+/**
+ * @brief Runs one flashing session (UDS client and state machine of a FlashManager) per ECU in its own thread.
+ * The ECUs may share one Communication (bus), the Transfer Data requests of the sessions are interleaved by the
+ * Communication in the order they are requested.
+ */
+class ParallelFlashManager : public QObject {
+    Q_OBJECT
+
+public:
+    struct Result {
+        uint32_t ecu_id;
+        bool finished;                                          // Session is finished (passed or aborted)
+        bool passed;                                            // See FlashManager::hasSucceeded
+        qint64 flash_ms;                                        // Duration of the session
+        size_t skipped_bytes;                                   // See FlashManager::getSkippedBytes
+        size_t transfer_data_bytes;                             // See FlashManager::getTransferDataBytes
+    };
+
+private:
+    struct Session {
+        uint32_t ecu_id;
+        Communication *comm;
+        FlashManager *flashMan;
+        QThread *thread;
+        QElapsedTimer timer;
+        Result result;
+    };
+
+    QList<Session*> sessions;                                   // One session per ECU in the order of addECU
+    QList<QMetaObject::Connection> commConnections;             // Console forwarding of the Communications
+    QMap<uint32_t, QByteArray> flashContent;                    // Map with Address -> continous byte array
+    QByteArray updateVersion;                                   // Written to every ECU after flashing
+    uint32_t aswKeyAdd;                                         // Address of the ASW Key
+    uint32_t goodKeyValue;                                      // Good key value of the ASW Key
+
+    QMutex mutex;                                               // Protects the results and running
+    int running;                                                // Number of sessions not finished yet
+
+public:
+    explicit ParallelFlashManager(QObject *parent = 0);
+    virtual ~ParallelFlashManager();
+
+    void addECU(uint32_t ecu_id, Communication *comm);
+    void clearECUs();
+    void setFlashFile(QMap<uint32_t, QByteArray> data);
+    void setUpdateVersion(QByteArray version);
+    void setASWKeyContent(uint32_t add, uint32_t content);
+
+    void startFlashing(uint32_t gui_id);
+    void stopFlashing();
+    bool waitForFinished(unsigned long timeout_ms);
+    QList<Result> getResults();
+
+private:
+    void sessionFinished(Session *session);
+
+signals:
+
+    /**
+     * @brief Signals that INFO text is available for printing to console, prefixed with the ECU ID
+     * @param text To be printed
+     */
+    void infoPrint(const QString &text);
+
+    /**
+     * @brief Signals that ERROR text is available for printing to console, prefixed with the ECU ID
+     * @param text To be printed
+     */
+    void errorPrint(const QString &text);
+
+    /**
+     * @brief Signals that the flashing of an ECU is finished, emitted from its flashing thread
+     * @param result Result of the ECU
+     */
+    void ecuFinished(const ParallelFlashManager::Result &result);
+
+    /**
+     * @brief Signals that the flashing of all ECUs is finished, emitted from the flashing thread finished last
+     */
+    void allFinished();
+};
+
+#endif /* PARALLELFLASHMANAGER_H_ */
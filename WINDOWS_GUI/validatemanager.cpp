@@ -5,7 +5,7 @@
 //============================================================================
 // Name        : validatemanager.cpp
 // Author      : Leon Wilms, Michael Bauer
-// Version     : 0.1
+// Version     : 0.6
 // Copyright   : MIT
 // Description : Validation Manager to validate selected files
 //============================================================================
@@ -17,6 +17,89 @@
 #include <QPointer>
 #include <QApplication>
 #include <QList>
+#include <QFile>
+#include <QFileInfo>
+#include <QBitArray>
+
+#include <algorithm>
+
+// Lookup table for decoding the hex characters of a S19 or Intel HEX file, -1 for all other characters
+struct HexLookup {
+    int8_t value[256];
+
+    constexpr HexLookup() : value() {
+        for(int i = 0; i < 256; i++)
+            value[i] = -1;
+        for(int i = 0; i < 10; i++)
+            value['0' + i] = i;
+        for(int i = 0; i < 6; i++){
+            value['A' + i] = 10 + i;
+            value['a' + i] = 10 + i;
+        }
+    }
+};
+
+static constexpr HexLookup hex_lookup;
+
+// Collects the data records of a file into blocks of continuous data, the records may be unsorted
+class BlockCollector {
+public:
+    BlockCollector(QMap<uint32_t, QByteArray> &blocks) : blocks(blocks), block(blocks.end()), block_address_end(0) {}
+
+    /**
+     * @brief Appends the data of one record, continuing the block of the previous record if possible
+     * @param address Start address of the data
+     * @param data Data of the record
+     * @param data_len Number of bytes of data
+     */
+    void append(uint32_t address, const char *data, uint32_t data_len){
+
+        if(block == blocks.end() || block_address_end != address){
+
+            // Data continues an earlier block (unsorted file) or starts a new block
+            if(block != blocks.end())
+                mergeFollowingBlocks();
+
+            block = blocks.upperBound(address);
+            if(block != blocks.begin() && std::prev(block).key() + std::prev(block).value().size() == address){
+                block = std::prev(block);
+            }
+            else {
+                block = blocks.insert(address, QByteArray());
+            }
+        }
+
+        block.value().append(data, data_len);
+
+        // calculate new ending of this block
+        block_address_end = address + data_len;
+    }
+
+    /**
+     * @brief Merges the last block with the blocks that directly follow it, called after the last record
+     */
+    void finish(){
+        if(block != blocks.end())
+            mergeFollowingBlocks();
+    }
+
+private:
+    QMap<uint32_t, QByteArray> &blocks;
+    QMap<uint32_t, QByteArray>::iterator block;     // Block of the previous data record
+    uint32_t block_address_end;
+
+    /**
+     * @brief Appends the blocks that directly follow the current block (e.g. written before it in an unsorted file)
+     */
+    void mergeFollowingBlocks(){
+
+        QMap<uint32_t, QByteArray>::iterator next = std::next(block);
+        while(next != blocks.end() && block.key() + block.value().size() == next.key()){
+            block.value().append(next.value());
+            next = blocks.erase(next);
+        }
+    }
+};
 
 //============================================================================
 // Constructor
@@ -25,66 +108,92 @@
 ValidateManager::ValidateManager() {
 
     data.clear();
-    core_addr = QMap<uint16_t, QMap<QString, QString>>();
+    regions.clear();
+    regionsSupported = true;
+    binaryBaseAddress = 0;
 }
 
 ValidateManager::~ValidateManager(){
     data.clear();
-    core_addr.clear();
+    regions.clear();
 }
 
 //============================================================================
 // Public Method
 //============================================================================
 
+/**
+ * @brief Sets the load address of raw binary files
+ * @param address Address of the first byte, 0 for the start of the first region of the ECU
+ */
+void ValidateManager::setBinaryBaseAddress(uint32_t address){
+    binaryBaseAddress = address;
+}
+
 void ValidateManager::setCoreAddr(QMap<uint16_t, QMap<QString, QString>> new_core_addr){
 
     emit infoPrint("INFO: Updated the Address Ranges of the ECU for File Validation\n");
 
-    core_addr.clear();
-    for(uint16_t core : new_core_addr.keys()){
-        core_addr[core] = new_core_addr[core];
-    }
-    return;
-}
+    // Parse the strings only once, the lookups during validation and transformation are integer compares
+    QList<MemoryRegion> new_regions;
+    bool new_regions_supported = true;
+    for(auto [core, range] : new_core_addr.asKeyValueRange()){
+        QString core_start_add_string = range.value("start");
+        QString core_end_add_string = range.value("end");
+
+        MemoryRegion region;
+        region.kind = core;
+
+        if(core_start_add_string == "Not yet supported" || core_end_add_string == "Not yet supported"){
+            region.start = 0;
+            region.end = 0;
+            region.supported = false;
+            new_regions_supported = false;
+            new_regions.append(region);
+            continue;
+        }
 
-void ValidateManager::validateFileAsync(QByteArray data){
+        if(core_start_add_string == "" || core_end_add_string == ""){
+            emit infoPrint("INFO: No address range information from ECU available for range "+QString::number(core)+"\n");
+            continue;
+        }
 
-    // For Null pointer safety
-    QPointer<ValidateManager> self = this;
+        region.start = core_start_add_string.toUInt(NULL, 16);
+        region.end = core_end_add_string.toUInt(NULL, 16);
+        region.supported = true;
 
-    if(core_addr.size()==0){
-        emit updateLabel(ValidateManager::VALID, "File validity:  No information from ECU about address ranges received. Was reading finished?");
-        return;
+        if(region.start > 0 && region.end > 0)
+            new_regions.append(region);
     }
 
-    // Change cursor to loading state
-    QApplication::setOverrideCursor(Qt::WaitCursor);
+    std::sort(new_regions.begin(), new_regions.end(), [](const MemoryRegion &a, const MemoryRegion &b){
+        return a.start < b.start;
+    });
 
-    // Create thread for validation
-    QThread* thread = QThread::create([self, data]() {
+    regions = new_regions;
+    regionsSupported = new_regions_supported;
+    return;
+}
 
-        if (!self) {
-            return;
-        }
+/**
+ * @brief Returns the memory regions of the ECU the files are validated and aligned for
+ * @return Regions sorted by start address
+ */
+QList<ValidateManager::MemoryRegion> ValidateManager::getRegions(){
+    return regions;
+}
 
-        QMap<uint32_t, QByteArray> result;
-        {
-            QMutexLocker locker(&self->dataMutex);
-            result = self->validateFile(data);
-        }
+void ValidateManager::validateFileAsync(QByteArray data){
 
-        result = self->transformData(result);
-        emit self->validationDone(result);
+    validateAsync([data](ValidateManager *self){
+        return self->validateFile(data.constData(), data.size());
     });
-    thread->start();
-    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+}
 
-    // Use a queued connection to restore the cursor in the main thread
-    connect(thread, &QThread::finished, []() {
-        QMetaObject::invokeMethod(qApp, []() {
-                QApplication::restoreOverrideCursor();
-            }, Qt::QueuedConnection);
+void ValidateManager::validateFileAsync(const QString &path){
+
+    validateAsync([path](ValidateManager *self){
+        return self->validateFile(path);
     });
 }
 
@@ -93,9 +202,7 @@ bool ValidateManager::checkBlockAddressRange(const QMap<uint32_t, QByteArray> bl
     for (QMap<uint32_t, QByteArray>::const_iterator iterator = blocks.constBegin(); iterator != blocks.constEnd(); ++iterator) {
 
         uint32_t addr = iterator.key();
-
-        QByteArray block = blocks[addr];
-        uint32_t data_len = block.size();
+        uint32_t data_len = iterator.value().size();
 
         if(!addrInRange(addr, data_len)){
 
@@ -116,10 +223,10 @@ QMap<uint32_t, QByteArray> ValidateManager::transformData(QMap<uint32_t, QByteAr
 
     emit infoPrint("INFO: File is being prepared for flashing (Flash alignment)! \n");
 
-    QMap<uint16_t, QMap<QString, QString>> core_addr_processing = core_addr;
-    core_addr_processing.detach(); // Copy to own variable
+    QList<MemoryRegion> regions_processing = regions;
+    regions_processing.detach(); // Copy to own variable
 
-    if(core_addr_processing.size() == 0){
+    if(regions_processing.size() == 0){
         emit errorPrint("ERROR: Could not calculate the data for flashing since the range is missing. Click on the ECU again\n");
         QMap<uint32_t, QByteArray> empty_blocks;
         return empty_blocks;
@@ -128,144 +235,115 @@ QMap<uint32_t, QByteArray> ValidateManager::transformData(QMap<uint32_t, QByteAr
     // -------------------------------------------------------------------------------------
     qInfo() << "ValidateManager: Start to tranform the data";
 
-    QMap<uint32_t, QByteArray> pages;           // Content of the pages
-
     // -------------------------------------------------------------------------------------
-    // Prepare the pages for all ranges
-    for (int rangeCtr = 0; rangeCtr < core_addr_processing.count(); rangeCtr++){
-        QString core_start_add_string = core_addr_processing[rangeCtr]["start"];
-        QString core_end_add_string = core_addr_processing[rangeCtr]["end"];
-        uint32_t core_start_add = core_start_add_string.toUInt(NULL, 16);
-        uint32_t core_end_add = core_end_add_string.toUInt(NULL, 16);
-
-        if(core_start_add > 0 && core_end_add > 0){
-            uint32_t sizeOfRange = core_end_add - core_start_add;
+    // Prepare the pages for all ranges: One buffer with the content of all pages, one bit per page if it is used
+    QList<PageRange> ranges;
+    qsizetype numPages = 0;
+    for (const MemoryRegion &region : regions_processing){
+        uint32_t core_start_add = region.start;
+        uint32_t core_end_add = region.end;
+
+        if(region.supported && core_end_add > core_start_add){
             qInfo() << "Prepare pages for range from "+QString("0x%1").arg(core_start_add, 2, 16, QLatin1Char( '0' )) + " to " +QString("0x%1").arg(core_end_add, 2, 16, QLatin1Char( '0' ));
-            for(int addrOffset = 0; addrOffset < sizeOfRange; addrOffset = addrOffset + MINIMUM_BLOCK_SIZE){
-                uint32_t pageAddr = core_start_add + addrOffset;
 
-                // Initialize with empty QByteArray
-                QByteArray pageContent;
-                pages[pageAddr] = pageContent;
-            }
+            PageRange range;
+            range.start = core_start_add;
+            range.end = core_end_add;
+            range.firstPage = numPages;
+            range.numPages = (core_end_add - core_start_add + MINIMUM_BLOCK_SIZE - 1) / MINIMUM_BLOCK_SIZE;
+            ranges.append(range);
+
+            numPages += range.numPages;
         }
     }
 
-    if(pages.size() == 0){
+    if(numPages == 0){
         emit errorPrint("ERROR: Could not calculate the data for flashing since the information about the core ranges is missing. Click on the ECU again\n");
         QMap<uint32_t, QByteArray> empty_blocks;
         return empty_blocks;
     }
 
-    // -------------------------------------------------------------------------------------
-    // Preprocess the data: insert the data into the specific pages
-    uint32_t foundAddr = pages.firstKey();
-    uint32_t foundAddrIdx = 0;
-
-    // Consider: Blocks are already sorted, storing of foundAddr therefore possible
-    for(uint32_t addr : blocks.keys()){ // Go through all the addresses
-        QByteArray block = blocks[addr];
-
-        //qInfo() << "Processing "+QString("0x%1").arg(addr, 2, 16, QLatin1Char( '0' ));
-
-        // Go through all the single entries of on address
-        for(int valueAddrOffSet = 0; valueAddrOffSet <  block.size(); valueAddrOffSet++){
-            uint32_t valueAddr = addr+valueAddrOffSet;
-
-            // Check different ranges
-            bool supported = true;
-            bool added = false;
-            for (int rangeCtr = 0; rangeCtr < core_addr_processing.count(); rangeCtr++){
-                if(addrInCoreRange(valueAddr, 1, rangeCtr, &supported)){ // Correct range found
-                    // Extract the value of the block
-                    uint8_t value = block[valueAddrOffSet];
+    QByteArray pageContent(numPages * MINIMUM_BLOCK_SIZE, 0);  // Unused parts of a used page stay 0
+    QBitArray pageUsed(numPages);
 
-                    // Search the pages for correct one..
-                    QMap<uint32_t, QByteArray>::iterator it = pages.upperBound(valueAddr);
-
-                    if(it != pages.begin() && it != pages.end()){
-                        it = std::prev(it);
-                    }
-
-                    // Extract page
-                    uint32_t foundAddr = it.key();
-                    QByteArray foundPage = it.value();
-
-                    if(foundAddr + foundPage.size() >= valueAddr){
-
-                        // Create real page if it not already initialized properly before
-                        if(foundPage.size() < MINIMUM_BLOCK_SIZE){
-                            foundPage.fill(0, MINIMUM_BLOCK_SIZE);
-                        }
+    // -------------------------------------------------------------------------------------
+    // Preprocess the data: copy every segment of a block that lies in one range into the pages
+    for (QMap<uint32_t, QByteArray>::const_iterator it = blocks.constBegin(); it != blocks.constEnd(); ++it){
+        uint32_t addr = it.key();
+        const QByteArray &block = it.value();
+
+        qsizetype offset = 0;
+        while(offset < block.size()){
+            uint32_t segmentAddr = addr + offset;
+            qsizetype segmentLen = block.size() - offset;
+
+            const PageRange *range = findPageRange(ranges, segmentAddr);
+            if(range == nullptr){
+                // Ignore everything until the next range starts
+                for(const PageRange &next : ranges){
+                    if(next.start > segmentAddr && next.start - segmentAddr < segmentLen)
+                        segmentLen = next.start - segmentAddr;
+                }
 
-                        // Calc the index + Insert data
-                        uint32_t index = valueAddr - foundAddr;
-                        foundPage[index] = value;
+                emit errorPrint("ERROR: Searched Adresses "+QString("0x%1").arg(segmentAddr, 2, 16, QLatin1Char( '0' ))+" to "+QString("0x%1").arg(segmentAddr + (uint32_t)segmentLen - 1, 2, 16, QLatin1Char( '0' ))+" were ignored during transformation of data!\n");
+                qInfo() << "Out of range - Ignoring addresses " + QString("0x%1").arg(segmentAddr, 2, 16, QLatin1Char( '0' )) + " to " + QString("0x%1").arg(segmentAddr + (uint32_t)segmentLen - 1, 2, 16, QLatin1Char( '0' ));
+            }
+            else {
+                if(segmentLen > range->end - segmentAddr)
+                    segmentLen = range->end - segmentAddr;
 
-                        // Store back into pages map
-                        pages[foundAddr] = foundPage;
+                uint32_t rangeOffset = segmentAddr - range->start;
+                memcpy(pageContent.data() + range->firstPage * MINIMUM_BLOCK_SIZE + rangeOffset, block.constData() + offset, segmentLen);
 
-                        // At least one Value was added
-                        added = true;
-                        break;
-                    }
-                }
+                qsizetype firstPage = range->firstPage + rangeOffset / MINIMUM_BLOCK_SIZE;
+                qsizetype lastPage = range->firstPage + (rangeOffset + segmentLen - 1) / MINIMUM_BLOCK_SIZE;
+                pageUsed.fill(true, firstPage, lastPage + 1);
             }
 
-            if(!added){
-                emit errorPrint("ERROR: Searched Adress "+QString("0x%1").arg(valueAddr, 2, 16, QLatin1Char( '0' ))+" was ignored during transformation of data!\n");
-                qInfo() << "Out of range - Ignoring address " + QString("0x%1").arg(valueAddr, 2, 16, QLatin1Char( '0' ));
-            }
+            offset += segmentLen;
         }
     }
 
     // -------------------------------------------------------------------------------------
-    // Reduce the pages - remove empty pages and combine
+    // Reduce the pages - remove empty pages and combine consecutive pages
     QMap<uint32_t, QByteArray> transformedData;
+    QMap<uint32_t, QByteArray>::iterator combination = transformedData.end();
 
-    bool combination = false;
-    bool combinationLast = false;
+    bool lastPageUsed = false;
+    uint32_t lastPageAddr = 0;
 
-    uint32_t combinationAddr = 0;
-    uint32_t lastAddr = 0;
+    for(const PageRange &range : ranges){
+        qsizetype page = 0;
+        while(page < range.numPages){
 
-    for(uint32_t pageAddr : pages.keys()){
-        QByteArray content = pages[pageAddr];
+            // Skip the empty pages
+            if(!pageUsed.testBit(range.firstPage + page)){
+                page++;
+                continue;
+            }
 
-        // If not empty it need to be included
-        combinationLast = combination;
-        if(content.size() == MINIMUM_BLOCK_SIZE){ // There is content available for this page
-            combination = true;
+            // Run of used pages
+            qsizetype runEnd = page + 1;
+            while(runEnd < range.numPages && pageUsed.testBit(range.firstPage + runEnd))
+                runEnd++;
 
-            // Rising flag, first page to be inserted
-            if(combination == true && combinationLast == false){
-                combinationAddr = pageAddr;
-                transformedData[combinationAddr] = content;
-            }
+            uint32_t pageAddr = range.start + page * MINIMUM_BLOCK_SIZE;
+            const char *content = pageContent.constData() + (range.firstPage + page) * MINIMUM_BLOCK_SIZE;
+            qsizetype contentLen = (runEnd - page) * MINIMUM_BLOCK_SIZE;
 
-            // Consecutive pages
+            // Continue the previous block only at the start of a range, if the last page of the previous range is used and there is no gap
+            if(page == 0 && lastPageUsed && combination != transformedData.end() && pageAddr - lastPageAddr <= MINIMUM_BLOCK_SIZE){
+                combination.value().append(content, contentLen);
+            }
             else {
-                // Bigger Gap between two pages, consider as new address
-                if(pageAddr - lastAddr > MINIMUM_BLOCK_SIZE){
-                    combinationAddr = pageAddr;
-                    transformedData[combinationAddr] = content;
-                }
-
-                // Normal append
-                else {
-                    QByteArray existingPages = transformedData[combinationAddr];
-                    existingPages = existingPages.append(content);
-                    transformedData[combinationAddr] = existingPages;
-                }
+                combination = transformedData.insert(pageAddr, QByteArray(content, contentLen));
             }
 
-        }
-        else {
-            // Ignore page since it is empty
-            combination = false;
+            page = runEnd;
         }
 
-        lastAddr = pageAddr;
+        lastPageUsed = pageUsed.testBit(range.firstPage + range.numPages - 1);
+        lastPageAddr = range.start + (range.numPages - 1) * MINIMUM_BLOCK_SIZE;
     }
 
     if(ADD_SUPPORTING_PAGES_EVERY <= 0) // Ignore Supporting Pages if switched off
@@ -276,12 +354,10 @@ QMap<uint32_t, QByteArray> ValidateManager::transformData(QMap<uint32_t, QByteAr
     QMap<uint32_t, QByteArray> filledTransformedData = transformedData;
     filledTransformedData.detach();
 
-    for (int rangeCtr = 0; rangeCtr < core_addr_processing.count(); rangeCtr++){
+    for (const PageRange &range : ranges){
         QList<uint32_t> relevantAddr;
-        for(uint32_t addr : transformedData.keys()){
-            if(addrInCoreRange(addr, 1, rangeCtr, nullptr)){
-                relevantAddr.append(addr);
-            }
+        for(auto it = transformedData.lowerBound(range.start); it != transformedData.end() && it.key() < range.end; ++it){
+            relevantAddr.append(it.key());
         }
 
         // There are at least 2 Addresses
@@ -308,118 +384,248 @@ QMap<uint32_t, QByteArray> ValidateManager::transformData(QMap<uint32_t, QByteAr
 // Private Method
 //============================================================================
 
-QMap<uint32_t, QByteArray> ValidateManager::validateFile(QByteArray data)
+void ValidateManager::validateAsync(std::function<QMap<uint32_t, QByteArray>(ValidateManager*)> validation){
+
+    // For Null pointer safety
+    QPointer<ValidateManager> self = this;
+
+    if(regions.size()==0){
+        emit updateLabel(ValidateManager::VALID, "File validity:  No information from ECU about address ranges received. Was reading finished?");
+        return;
+    }
+
+    // Change cursor to loading state
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    // Create thread for validation
+    QThread* thread = QThread::create([self, validation]() {
+
+        if (!self) {
+            return;
+        }
+
+        QMap<uint32_t, QByteArray> result;
+        {
+            QMutexLocker locker(&self->dataMutex);
+            result = validation(self);
+        }
+
+        result = self->transformData(result);
+        emit self->validationDone(result);
+    });
+    thread->start();
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+
+    // Use a queued connection to restore the cursor in the main thread
+    connect(thread, &QThread::finished, []() {
+        QMetaObject::invokeMethod(qApp, []() {
+                QApplication::restoreOverrideCursor();
+            }, Qt::QueuedConnection);
+    });
+}
+
+QMap<uint32_t, QByteArray> ValidateManager::validateFile(const QString &path)
 {
-    QList<QByteArray> lines = data.split('\n');
-    uint32_t block_address_end = 0;
+    QFile file(path);
+    if(!file.open(QFile::ReadOnly)){
+        emit errorPrint("ERROR: Could not open " + path + ": " + file.errorString() + "\n");
+        emit updateLabel(ValidateManager::VALID, "File validity:  Not Valid");
+        return QMap<uint32_t, QByteArray>();
+    }
 
-    int current_index = 0;
+    // Parse the file directly from the page cache, reading it is only the fallback
+    QString suffix = QFileInfo(path).suffix();
+    const uchar *mapped = file.size() > 0 ? file.map(0, file.size()) : nullptr;
+    if(mapped != nullptr)
+        return validateFile((const char *) mapped, file.size(), detectFormat((const char *) mapped, file.size(), suffix));
 
-    int count_record = -1;
-    int jump_record = -1;
+    QByteArray content = file.readAll();
+    return validateFile(content.constData(), content.size(), detectFormat(content.constData(), content.size(), suffix));
+}
+
+/**
+ * @brief Detects the format of a file, raw binary files are only detected by their suffix
+ * @param content File content
+ * @param size Number of bytes of content
+ * @param suffix Suffix of the file name, empty if unknown
+ * @return Format of the file, S19 if it is none of the other formats
+ */
+ValidateManager::FILE_FORMAT ValidateManager::detectFormat(const char *content, qsizetype size, const QString &suffix){
+
+    if(size >= 4 && memcmp(content, "\x7F" "ELF", 4) == 0)
+        return ELF;
+
+    if(suffix.compare("bin", Qt::CaseInsensitive) == 0)
+        return BINARY;
+
+    if(size > 0 && content[0] == ':')
+        return INTEL_HEX;
+
+    return S19;
+}
+
+/**
+ * @brief Parses and validates a file, every format results in the same map of continuous data
+ * @param content File content
+ * @param size Number of bytes of content
+ * @param format Format of the content, AUTO detects S19, Intel HEX and ELF by the content
+ * @return Map of start address -> continuous data
+ */
+QMap<uint32_t, QByteArray> ValidateManager::validateFile(const char *content, qsizetype size, FILE_FORMAT format)
+{
+    if(format == AUTO)
+        format = detectFormat(content, size);
+
+    QMap<uint32_t, QByteArray> block_result;
+    bool file_validity = false;
+
+    switch(format){
+        case INTEL_HEX:
+            emit updateLabel(ValidateManager::HEADER, "File version: N/A");
+            file_validity = parseIntelHex(content, size, block_result);
+            break;
+        case ELF:
+            emit updateLabel(ValidateManager::HEADER, "File version: N/A");
+            file_validity = parseElf(content, size, block_result);
+            break;
+        case BINARY:
+            emit updateLabel(ValidateManager::HEADER, "File version: N/A");
+            file_validity = parseBinary(content, size, block_result);
+            break;
+        default:
+            file_validity = parseS19(content, size, block_result);
+            break;
+    }
+
+    if(file_validity){
+
+        file_validity = checkBlockAddressRange(block_result);
+    }
+
+    // Show validity of file in UI
+    if(file_validity)
+    {
+
+        emit updateLabel(ValidateManager::VALID, "File validity:  Valid");
 
+    }
+    else {
+
+        emit updateLabel(ValidateManager::VALID, "File validity:  Not Valid");
+    }
+    return block_result;
+}
+
+/**
+ * @brief Parses a S19 file in a single pass, the data records are decoded directly into the blocks
+ * @param content S19 content, lines terminated by "\n" or "\r\n"
+ * @param size Number of bytes of content
+ * @param block_result Map of start address -> continuous data
+ * @return false if the content is not a valid S19 file
+ */
+bool ValidateManager::parseS19(const char *content, qsizetype size, QMap<uint32_t, QByteArray> &block_result)
+{
+    const char *pos = content;
+    const char *end = content + size;
+
+    int count_record = -1;
     int count_lines = 0;
-    int nlines = lines.size();
 
     bool file_validity = true;
     bool file_header = false;
 
-    QByteArray new_line;
-    QByteArray result;
-    QByteArray line_buffer;
+    uint8_t record[S19_MAX_RECORD_BYTES];       // Decoded bytes of one line: Address, data and checksum
 
-    QMap<uint32_t, QByteArray> merged_blocks;
-    QMap<uint32_t, QByteArray> block_result;
+    BlockCollector blocks(block_result);
 
-    // Print each line
-    for (QByteArray& line : lines) {
+    while (pos < end) {
 
-        if(line.size() == 0){
+        const char *line_end = (const char *) memchr(pos, '\n', end - pos);
+        if(line_end == nullptr)
+            line_end = end;
 
-            break;
-        }
+        const char *line = pos;
+        qsizetype line_len = line_end - line;
+        pos = line_end + 1;
 
         // remove '\r' at the end of each line
-        if(current_index != (nlines - 1)){
+        if(line_len > 0 && line[line_len - 1] == '\r')
+            line_len--;
 
-            line = line.left(line.size() - 1 );
+        if(line_len == 0){
+
+            break;
         }
 
-        char record_type = line.at(1);              // get record type
-        line = line.mid(2);                         // Trim Record type for preprocessing
+        // Line: 'S', record type, count, address + data + checksum (count bytes)
+        int count = line_len >= 4 ? decodeHexByte(line + 2) : -1;
+        if(count < 1 || line_len != 4 + 2 * count){
+            emit infoPrint("INFO: File not valid! Length of a line does not match its byte count.\n");
+            file_validity = false;
+            break;
+        }
+
+        char record_type = line[1];
 
         // Check validity of one line at a time
-        if(!validateLine(line))
+        uint8_t sum = (uint8_t) count;
+        bool decoded = true;
+        for (int i = 0; i < count; i++) {
+            int value = decodeHexByte(line + 4 + 2 * i);
+            if(value < 0){
+                qDebug() << "Error converting hexPair:" << QByteArray(line + 4 + 2 * i, 2);
+                emit errorPrint("ERROR: Error converting hexPair:" + QByteArray(line + 4 + 2 * i, 2) + "\n");
+                decoded = false;
+                break;
+            }
+            record[i] = (uint8_t) value;
+            sum += record[i];
+        }
+
+        if(!decoded || sum != 0xFF)
         {
             emit infoPrint("INFO: File not valid! Checksum of a line did not match the expected value.\n");
             file_validity = false;
             break;
         }
 
+        uint8_t data_count = count - 1;         // Without checksum
+
         // extract header information
         if(record_type == '0'){
 
             QByteArray header;
-
-            line = line.left(line.size() - 2);
-            line = line.right(line.size() - 2);
-
             file_header = true;
 
-
-            for (int i = 0; i < line.size(); i += 2)
+            for (int i = 0; i < data_count; i++)
             {
-                // Convert each pair of hex characters to a byte
-                QString hexPair = line.mid(i, 2);
-
-                char asciiChar = hexPair.toUShort(NULL, 16); // Convert hexPair to integer
+                if(record[i] != 0){
 
-                if(asciiChar != NULL){
-
-                    header.append(asciiChar);
+                    header.append((char) record[i]);
                 }
-
             }
 
             // Convert QByteArray to QString (assuming it's ASCII)
             QString asciiString = QString::fromLatin1(header);
 
             emit updateLabel(ValidateManager::HEADER, "File version: " + asciiString);
-
-
         }
         // preprocess data for flashing and count data records for validation
         else if(record_type == '1' or record_type == '2' or record_type == '3'){
 
-            new_line = extractData(line, record_type);
-
-            uint32_t data_len = (new_line.size() - 8);
-
-            QString address_string = new_line.left(8);
-            uint32_t address_start = address_string.toUInt(NULL, 16);
-
-            if(line_buffer.isEmpty()){
-
-                line_buffer.append(new_line.right(data_len + 8));
-                count_lines += 1;
-
-            }
-            else if(block_address_end == address_start){
-
-                line_buffer.append(new_line.right(data_len));
-                count_lines += 1;
+            uint8_t address_len = record_type - '1' + 2;
+            if(data_count < address_len){
+                emit infoPrint("INFO: File not valid! Length of a line does not match its byte count.\n");
+                file_validity = false;
+                break;
             }
-            else{
-                merged_blocks.insert(getAddr(line_buffer.left(8).toUInt(NULL, 16)), getData(line_buffer.right(line_buffer.size()-8)));
-
-                line_buffer.clear();
 
-                line_buffer.append(new_line.right(data_len + 8));
-                count_lines += 1;
-            }
+            uint32_t address_start = 0;
+            for (int i = 0; i < address_len; i++)
+                address_start = (address_start << 8) | record[i];
 
-            // calculate new ending of this block
-            block_address_end = address_start + (data_len / 2);
+            count_lines += 1;
+            blocks.append(getAddr(address_start), (const char *) record + address_len, data_count - address_len);
         }
         // preprocess data for flashing
         else if(record_type == '7' or record_type == '8' or record_type == '9'){
@@ -428,23 +634,6 @@ QMap<uint32_t, QByteArray> ValidateManager::validateFile(QByteArray data)
             //currently deprecated.
             emit infoPrint("INFO: Jump addresses not supported!");
             continue;
-            if(jump_record != -1){
-
-                emit infoPrint("INFO: File not Valid! Too many termination records.\n");
-                file_validity = false;
-                break;
-            }
-
-            if(current_index == (nlines - 1)){
-                merged_blocks.insert(getAddr(line_buffer.left(8).toUInt(NULL, 16)), getData(line_buffer.right(line_buffer.size()-8)));
-
-                line_buffer.clear();
-            }
-
-            new_line = extractData(line, record_type);
-
-
-            //merged_blocks.insert(block_index, new_line);
         }
         // optional entry, can be used to validate file
         else if(record_type == '5' or record_type == '6'){
@@ -456,36 +645,20 @@ QMap<uint32_t, QByteArray> ValidateManager::validateFile(QByteArray data)
                 break;
             }
 
-            line = line.left(line.size() - 2);
-            line = line.right(line.size() - 2);
-
-            count_record = line.toInt(NULL, 16);
+            count_record = 0;
+            for (int i = 0; i < data_count; i++)
+                count_record = (count_record << 8) | record[i];
         }
         // S4 is reserved and should not be used & all other inputs are invalid s19 inputs
         else {
 
-            qDebug() << "There was an error with the selected file! Record type: " << record_type << line;
+            qDebug() << "There was an error with the selected file! Record type: " << record_type << QByteArray(line, line_len);
             emit errorPrint(("ERROR: There was an error with the selected file! Record Type: " + QString::number(record_type) + "\n"));
-            emit errorPrint("ERROR: Test");
             break;
         }
-
-        current_index += 1;
-    }
-
-    if(!line_buffer.isEmpty()){
-        merged_blocks.insert(getAddr(line_buffer.left(8).toUInt(NULL, 16)), getData(line_buffer.right(line_buffer.size()-8)));
-        line_buffer.clear();
-    }
-    block_result = combineSortedQMap(merged_blocks);
-
-    //TODO: remove
-
-    if(file_validity){
-
-        file_validity = checkBlockAddressRange(block_result);
     }
 
+    blocks.finish();
 
     if(!file_header){
 
@@ -499,204 +672,309 @@ QMap<uint32_t, QByteArray> ValidateManager::validateFile(QByteArray data)
         file_validity = false;
     }
 
-    // Show validity of file in UI
-    if(file_validity)
-    {
+    return file_validity;
+}
 
-        emit updateLabel(ValidateManager::VALID, "File validity:  Valid");
+/**
+ * @brief Parses an Intel HEX file in a single pass, including extended segment and extended linear address records
+ * @param content Intel HEX content, lines terminated by "\n" or "\r\n"
+ * @param size Number of bytes of content
+ * @param block_result Map of start address -> continuous data
+ * @return false if the content is not a valid Intel HEX file or the end of file record is missing
+ */
+bool ValidateManager::parseIntelHex(const char *content, qsizetype size, QMap<uint32_t, QByteArray> &block_result)
+{
+    const char *pos = content;
+    const char *end = content + size;
 
-    }
-    else {
+    bool file_validity = true;
+    bool end_of_file = false;
+    uint32_t base_address = 0;                  // Set by the extended segment/linear address records
 
-        emit updateLabel(ValidateManager::VALID, "File validity:  Not Valid");
-    }
-    return block_result;
-}
+    uint8_t record[IHEX_MAX_RECORD_BYTES];      // Decoded bytes of one line: Count, address, type, data and checksum
 
-bool ValidateManager::validateLine(QByteArray line)
-{
-    int sum = 0;
-    int checksum = line.right(2).toInt(NULL, 16); // Extracts the last two characters
+    BlockCollector blocks(block_result);
 
-    // Remove the checksum from the original line for further processing
-    QByteArray trimmedLine = line.left(line.size() - 2);
+    while (pos < end && !end_of_file) {
 
-    // Process the line in pairs of hexadecimal values
-    for (int i = 0; i < trimmedLine.size(); i += 2)
-    {
-        // Extract each pair of characters
-        QByteArray hexPair = trimmedLine.mid(i, 2);
+        const char *line_end = (const char *) memchr(pos, '\n', end - pos);
+        if(line_end == nullptr)
+            line_end = end;
 
-        // Convert the hexPair to a hexadecimal value
-        bool ok;
-        int hexValue = hexPair.toInt(&ok, 16); // Convert hexPair to ushort (16-bit) integer
+        const char *line = pos;
+        qsizetype line_len = line_end - line;
+        pos = line_end + 1;
 
-        if (!ok)
-        {
-            // Handle conversion error
-            qDebug() << "Error converting hexPair:" << hexPair;
-            emit errorPrint("ERROR: Error converting hexPair:" + hexPair + "\n");
+        // remove '\r' at the end of each line
+        if(line_len > 0 && line[line_len - 1] == '\r')
+            line_len--;
 
-            return false;
+        if(line_len == 0)
+            continue;
+
+        // Line: ':', count, address (2 bytes), record type, data (count bytes), checksum
+        int count = line_len >= 3 && line[0] == ':' ? decodeHexByte(line + 1) : -1;
+        if(count < 0 || line_len != 1 + 2 * (count + 5)){
+            emit infoPrint("INFO: File not valid! Length of a line does not match its byte count.\n");
+            file_validity = false;
+            break;
         }
-        else
-        {
 
-            sum += hexValue;
+        uint8_t sum = 0;
+        bool decoded = true;
+        for (int i = 0; i < count + 5; i++) {
+            int value = decodeHexByte(line + 1 + 2 * i);
+            if(value < 0){
+                emit errorPrint("ERROR: Error converting hexPair:" + QByteArray(line + 1 + 2 * i, 2) + "\n");
+                decoded = false;
+                break;
+            }
+            record[i] = (uint8_t) value;
+            sum += record[i];
         }
 
-    }
+        if(!decoded || sum != 0)
+        {
+            emit infoPrint("INFO: File not valid! Checksum of a line did not match the expected value.\n");
+            file_validity = false;
+            break;
+        }
 
-    if(checksum == (0xFF - (sum & 0xFF))){
+        uint16_t offset = (record[1] << 8) | record[2];
+        uint8_t record_type = record[3];
+        const uint8_t *data = record + 4;
 
-        return true;
-    }
+        switch(record_type){
+            case 0x00: // Data
+                blocks.append(getAddr(base_address + offset), (const char *) data, count);
+                break;
 
-    return false;
-}
+            case 0x01: // End of file
+                end_of_file = true;
+                break;
 
-QByteArray ValidateManager::extractData(QByteArray line, char record_type)
-{
-    // Trim Count
-    QByteArray trimmed_line = line.left(line.size() - 2);
-    // Trim Checksum
-    trimmed_line = trimmed_line.right(trimmed_line.size() - 2);
+            case 0x02: // Extended segment address, bits 4-19 of the address
+            case 0x04: // Extended linear address, bits 16-31 of the address
+                if(count != 2){
+                    emit infoPrint("INFO: File not valid! Length of an address record is not 2.\n");
+                    file_validity = false;
+                    break;
+                }
+                base_address = (uint32_t)((data[0] << 8) | data[1]) << (record_type == 0x02 ? 4 : 16);
+                break;
 
-    // Pad address
-    if(record_type == '1' or record_type == '9'){
+            case 0x03: // Start segment address
+            case 0x05: // Start linear address
+                emit infoPrint("INFO: Jump addresses not supported!");
+                break;
 
-        trimmed_line = trimmed_line.rightJustified(trimmed_line.size() + 4, '0');
-    }
-    else if(record_type == '2' or record_type == '8'){
+            default:
+                emit errorPrint("ERROR: There was an error with the selected file! Record Type: " + QString::number(record_type) + "\n");
+                file_validity = false;
+                break;
+        }
 
-        trimmed_line = trimmed_line.rightJustified(trimmed_line.size() + 2, '0');
+        if(!file_validity)
+            break;
     }
-    else if(record_type == '3' or record_type == '7'){
 
-        // There is nothing to pad, dont do anything
-    }
-    // Did we encounter a S-record that is not supposed to be here?
-    else{
+    blocks.finish();
 
-        qDebug() << "ERROR: There was an error! with current line!";
-        emit errorPrint("ERROR: There was an error with current line!\n");
+    if(file_validity && !end_of_file){
+
+        emit infoPrint("INFO: File not valid! End of file record is missing.\n");
+        file_validity = false;
     }
 
-    return trimmed_line;
+    return file_validity;
 }
 
+/**
+ * @brief Loads the PT_LOAD segments of an ELF file (32 or 64 bit, both byte orders) at their physical address,
+ *        the part of a segment that is only in memory (e.g. .bss) is not flashed
+ * @param content ELF content
+ * @param size Number of bytes of content
+ * @param block_result Map of start address -> continuous data
+ * @return false if the content is not a valid ELF file
+ */
+bool ValidateManager::parseElf(const char *content, qsizetype size, QMap<uint32_t, QByteArray> &block_result)
+{
+    const uint8_t *elf = (const uint8_t *) content;
+
+    if(size < 52 || memcmp(elf, "\x7F" "ELF", 4) != 0 || (elf[4] != 1 && elf[4] != 2) || (elf[5] != 1 && elf[5] != 2)){
+        emit infoPrint("INFO: File not valid! No ELF header.\n");
+        return false;
+    }
 
-QMap<uint32_t, QByteArray> ValidateManager::combineSortedQMap(const QMap<uint32_t, QByteArray> blocks){
+    bool elf64 = elf[4] == 2;
+    bool big_endian = elf[5] == 2;
 
-    QMap<uint32_t, QByteArray> merged_blocks;
+    // Reads a field of the file in its byte order, the offsets are checked against the size before
+    auto read = [elf, big_endian](qsizetype offset, int bytes) {
+        uint64_t value = 0;
+        for(int i = 0; i < bytes; i++)
+            value |= (uint64_t) elf[offset + (big_endian ? bytes - 1 - i : i)] << (8 * i);
+        return value;
+    };
 
-    if (blocks.isEmpty()) {
-        return merged_blocks;
+    if(elf64 && size < 64){
+        emit infoPrint("INFO: File not valid! No ELF header.\n");
+        return false;
     }
 
-    QByteArray line_buffer;
+    uint64_t phoff = elf64 ? read(0x20, 8) : read(0x1C, 4);
+    uint64_t phentsize = elf64 ? read(0x36, 2) : read(0x2A, 2);
+    uint64_t phnum = elf64 ? read(0x38, 2) : read(0x2C, 2);
 
-    uint32_t new_start_addr = blocks.firstKey();
-    uint32_t addr_end = 0;
+    if(phnum == 0 || phentsize < (elf64 ? 56u : 32u) || phoff > (uint64_t) size || phnum * phentsize > (uint64_t) size - phoff){
+        emit infoPrint("INFO: File not valid! Program headers are missing or exceed the file.\n");
+        return false;
+    }
 
-    for (QMap<uint32_t, QByteArray>::const_iterator iterator = blocks.constBegin(); iterator != blocks.constEnd(); ++iterator){
+    BlockCollector blocks(block_result);
+    bool file_validity = true;
+    int loaded = 0;
 
-        uint32_t addr_start = iterator.key();
+    for(uint64_t i = 0; i < phnum; i++){
+        qsizetype ph = (qsizetype)(phoff + i * phentsize);
 
-        if(addr_start == addr_end){
+        if(read(ph, 4) != ELF_PT_LOAD)
+            continue;
 
-            line_buffer.append(blocks[addr_start]);
-        }
-        else{
+        uint64_t offset = elf64 ? read(ph + 0x08, 8) : read(ph + 0x04, 4);
+        uint64_t paddr = elf64 ? read(ph + 0x18, 8) : read(ph + 0x0C, 4);
+        uint64_t filesz = elf64 ? read(ph + 0x20, 8) : read(ph + 0x10, 4);
 
-            merged_blocks.insert(new_start_addr, line_buffer);
-            line_buffer.clear();
+        if(filesz == 0)
+            continue;
 
-            new_start_addr = addr_start;
-            line_buffer.append(blocks[addr_start]);
+        if(offset > (uint64_t) size || filesz > (uint64_t) size - offset || paddr + filesz - 1 > 0xFFFFFFFF){
+            emit infoPrint("INFO: File not valid! Segment " + QString::number(i) + " exceeds the file or the 32 bit address space.\n");
+            file_validity = false;
+            break;
         }
 
-        addr_end = addr_start + blocks[addr_start].size();
+        blocks.append(getAddr((uint32_t) paddr), content + offset, (uint32_t) filesz);
+        loaded++;
     }
 
-    merged_blocks.insert(new_start_addr, line_buffer);
+    blocks.finish();
 
-    return merged_blocks;
-}
-
-bool ValidateManager::addrInCoreRange(uint32_t addr, uint32_t data_len,  uint16_t core, bool* supported){
-
-    if(core_addr.size() == 0){
-        emit infoPrint("INFO: No address range information from ECU available \n");
-        return false;
+    if(file_validity && loaded == 0){
+        emit infoPrint("INFO: File not valid! No loadable segment.\n");
+        file_validity = false;
     }
 
-    QString core_start_add_string = core_addr[core]["start"];
-    QString core_end_add_string = core_addr[core]["end"];
-
-    if(core_start_add_string == "Not yet supported" || core_end_add_string == "Not yet supported"){
+    return file_validity;
+}
 
-        if(supported != nullptr)
-            *supported = false;
-        //qDebug() << "INFO: Address Validation not supported for core" << core << "!";
+/**
+ * @brief Loads a raw binary file as one block at the base address (setBinaryBaseAddress)
+ * @param content Binary content
+ * @param size Number of bytes of content
+ * @param block_result Map of start address -> continuous data
+ * @return false if the file is empty or no base address is known
+ */
+bool ValidateManager::parseBinary(const char *content, qsizetype size, QMap<uint32_t, QByteArray> &block_result)
+{
+    uint32_t base_address = binaryBaseAddress;
 
-        return true;
+    // Without a base address the file starts at the first region of the ECU
+    if(base_address == 0){
+        for(const MemoryRegion &region : regions){
+            if(region.supported){
+                base_address = region.start;
+                break;
+            }
+        }
     }
 
-    if(core_start_add_string == "" || core_end_add_string == ""){
-        emit infoPrint("INFO: No address range information from ECU available \n");
+    if(size == 0 || base_address == 0 || (uint64_t) base_address + size - 1 > 0xFFFFFFFF){
+        emit infoPrint("INFO: File not valid! Binary file is empty or has no base address.\n");
         return false;
     }
 
-    uint32_t core_start_add = core_start_add_string.toUInt(NULL, 16);
-    uint32_t core_end_add = core_end_add_string.toUInt(NULL, 16);
-
-    if((core_start_add > 0 && core_end_add > 0) && (addr >= core_start_add && addr < core_end_add)){
+    emit infoPrint("INFO: Binary file is loaded at " + QString("0x%1").arg(base_address, 8, 16, QLatin1Char( '0' )) + "\n");
 
-        if(addr + (data_len-1) <= core_end_add){
-
-            return true;
-        }
-    }
-
-    return false;
+    BlockCollector blocks(block_result);
+    blocks.append(base_address, content, (uint32_t) size);
+    blocks.finish();
+    return true;
 }
 
-
 bool ValidateManager::addrInRange(uint32_t address, uint32_t data_len){
 
-    bool supported = true;
+    if(regions.size() == 0){
+        emit infoPrint("INFO: No address range information from ECU available \n");
+        return false;
+    }
 
-    if( addrInCoreRange(address, data_len, 0, &supported) ||
-        addrInCoreRange(address, data_len, 1, &supported) ||
-        addrInCoreRange(address, data_len, 2, &supported) ||
-        addrInCoreRange(address, data_len, 3, &supported) ||
-        addrInCoreRange(address, data_len, 4, &supported))
-    {
+    // The validation is skipped if the ECU does not support it for one of the regions
+    if(!regionsSupported)
+        return true;
 
+    const MemoryRegion *region = findRegion(address);
+    if(region != nullptr && address + (data_len-1) <= region->end)
         return true;
-    }
 
-    if(!supported){
+    return false;
+}
+
+/**
+ * @brief Searches the supported memory region that contains the address (binary search, the regions do not overlap)
+ * @param addr Address to search
+ * @return Region or nullptr if the address is not part of a supported region
+ */
+const ValidateManager::MemoryRegion *ValidateManager::findRegion(uint32_t addr) const {
 
-        emit infoPrint("INFO: Address validation not supported for one or more cores! Please check debugging output! \n");
+    auto it = std::upper_bound(regions.cbegin(), regions.cend(), addr, [](uint32_t addr, const MemoryRegion &region){
+        return addr < region.start;
+    });
+    if(it == regions.cbegin())
+        return nullptr;
 
-    }
+    it = std::prev(it);
+    if(it->supported && addr >= it->start && addr < it->end)
+        return &(*it);
 
-    return false;
+    return nullptr;
 }
 
 //============================================================================
 // Private Helper Method
 //============================================================================
 
-QByteArray ValidateManager::getData(QByteArray tempData) {
-    QByteArray transformedData;
-    for (int i = 0; i < tempData.size(); i += 2) {
-        QString hexByte = tempData.mid(i, 2);
-        transformedData.append((uint8_t)(0xFF & hexByte.toUInt(NULL, 16)));
-    }
-    return transformedData;
+/**
+ * @brief Searches the range of the page map that contains the address
+ * @param ranges Ranges of the page map
+ * @param addr Address to search
+ * @return Range or nullptr if the address is not part of a range
+ */
+const ValidateManager::PageRange *ValidateManager::findPageRange(const QList<PageRange> &ranges, uint32_t addr){
+    auto it = std::upper_bound(ranges.cbegin(), ranges.cend(), addr, [](uint32_t addr, const PageRange &range){
+        return addr < range.start;
+    });
+    if(it == ranges.cbegin())
+        return nullptr;
+
+    it = std::prev(it);
+    if(addr < it->end)
+        return &(*it);
+
+    return nullptr;
+}
+
+/**
+ * @brief Decodes two hex characters
+ * @param hex Pointer to the characters
+ * @return Value of the byte, -1 if one of the characters is no hex character
+ */
+int ValidateManager::decodeHexByte(const char *hex){
+    int high = hex_lookup.value[(uint8_t) hex[0]];
+    int low = hex_lookup.value[(uint8_t) hex[1]];
+    if((high | low) < 0)
+        return -1;
+    return (high << 4) | low;
 }
 
 uint32_t ValidateManager::getAddr(uint32_t addr){
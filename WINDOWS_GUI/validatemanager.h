@@ -5,7 +5,7 @@
 //============================================================================
 // Name        : validatemanager.h
 // Author      : Leon Wilms, Michael Bauer
-// Version     : 0.2
+// Version     : 0.6
 // Copyright   : MIT
 // Description : Validation Manager to validate selected files
 //============================================================================
@@ -15,14 +15,20 @@
 
 #define MINIMUM_BLOCK_SIZE          (32)    // Bytes, Content of 1 Page
 #define ADD_SUPPORTING_PAGES_EVERY  0x50000  // Number of bytes if there is a big gap between two addresses within range
+#define S19_MAX_RECORD_BYTES        (255)   // Max byte count of a S19 line (Address, data and checksum)
+#define IHEX_MAX_RECORD_BYTES       (260)   // Max number of bytes of an Intel HEX line (Count, address, type, 255 data bytes and checksum)
+#define ELF_PT_LOAD                 (1)     // Program header type of a loadable segment
 
 #include <QObject>
 #include <QDebug>
 #include <QMap>
+#include <QList>
 #include <QByteArray>
 #include <QThread>
 #include <QMutex>
 
+#include <functional>
+
 class ValidateManager : public QObject {
 
     Q_OBJECT
@@ -30,13 +36,32 @@ class ValidateManager : public QObject {
 public:
 
     enum LABEL {HEADER, VALID, CONTENT, SIZE, TYPE};
+    enum FILE_FORMAT {AUTO, S19, INTEL_HEX, ELF, BINARY};
 
     QMap<uint32_t, QByteArray> data;
 
+    // Memory region of the ECU, parsed once from the address ranges in setCoreAddr
+    struct MemoryRegion {
+        uint32_t start;             // First address of the region
+        uint32_t end;               // End address of the region as reported by the ECU
+        uint16_t kind;              // Key of the address range (0..2 Core 0..2, 3 ASW Key, 4 Calibration Data)
+        bool supported;             // false if the ECU does not support the validation of the region
+    };
+
 private:
 
+    // Range of the page map of transformData
+    struct PageRange {
+        uint32_t start;             // First address of the range
+        uint32_t end;               // End address of the range (excluded)
+        qsizetype firstPage;        // Index of the first page of the range in the page map
+        qsizetype numPages;         // Number of pages of the range
+    };
+
     QMutex dataMutex;
-    QMap<uint16_t, QMap<QString, QString>> core_addr;
+    QList<MemoryRegion> regions;        // Sorted by start address
+    bool regionsSupported;              // false if the validation of at least one region is not supported
+    uint32_t binaryBaseAddress;         // Load address of raw binary files, 0 for the start of the first region
 
 public:
 
@@ -44,25 +69,31 @@ public:
     virtual ~ValidateManager();
 
     void setCoreAddr(QMap<uint16_t, QMap<QString, QString>> new_core_addr);
+    QList<MemoryRegion> getRegions();
 
     void validateFileAsync(QByteArray data);
+    void validateFileAsync(const QString &path);
+    void setBinaryBaseAddress(uint32_t address);
+    static FILE_FORMAT detectFormat(const char *content, qsizetype size, const QString &suffix = QString());
+    QMap<uint32_t, QByteArray> validateFile(const char *content, qsizetype size, FILE_FORMAT format = AUTO);
     bool checkBlockAddressRange(QMap<uint32_t, QByteArray> blocks);
 
     QMap<uint32_t, QByteArray> transformData(QMap<uint32_t, QByteArray> blocks);
 
 private:
 
-    QMap<uint32_t, QByteArray> validateFile(QByteArray data);
+    void validateAsync(std::function<QMap<uint32_t, QByteArray>(ValidateManager*)> validation);
+    QMap<uint32_t, QByteArray> validateFile(const QString &path);
+    bool parseS19(const char *content, qsizetype size, QMap<uint32_t, QByteArray> &block_result);
+    bool parseIntelHex(const char *content, qsizetype size, QMap<uint32_t, QByteArray> &block_result);
+    bool parseElf(const char *content, qsizetype size, QMap<uint32_t, QByteArray> &block_result);
+    bool parseBinary(const char *content, qsizetype size, QMap<uint32_t, QByteArray> &block_result);
 
-    bool validateLine(QByteArray line);
-    QByteArray extractData(QByteArray line, char record_type);
-    QMap<uint32_t, QByteArray> combineSortedQMap(QMap<uint32_t, QByteArray> blocks);
-
-    bool addrInCoreRange(uint32_t addr, uint32_t data_len,  uint16_t core, bool* supported);
     bool addrInRange(uint32_t address, uint32_t data_len);
+    const MemoryRegion *findRegion(uint32_t addr) const;
 
-
-    QByteArray getData(QByteArray tempData);
+    static int decodeHexByte(const char *hex);
+    static const PageRange *findPageRange(const QList<PageRange> &ranges, uint32_t addr);
     uint32_t getAddr(uint32_t addr);
 
 signals:
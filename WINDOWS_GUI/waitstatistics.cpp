@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : waitstatistics.cpp
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Accounting of time spent in blocking wait loops
+//============================================================================
+
+#if defined(_WIN32)
+ #define  STRICT
+ #include <windows.h>
+#else
+ #include <time.h>
+#endif
+
+#include "waitstatistics.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// WaitStatistics
+//////////////////////////////////////////////////////////////////////////////
+
+WaitStatistics::WaitStatistics(){
+    reset();
+}
+
+void WaitStatistics::reset(){
+    waits = 0;
+    wall_ns = 0;
+    cpu_ns = 0;
+}
+
+void WaitStatistics::add(uint64_t wall_ns, uint64_t cpu_ns){
+    this->waits++;
+    this->wall_ns += wall_ns;
+    this->cpu_ns += cpu_ns;
+}
+
+/**
+ * @brief Returns the CPU time (user + kernel) consumed by the calling thread
+ * @return CPU time in ns
+ */
+uint64_t WaitStatistics::threadCPUTimeNs(){
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if(!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+
+    uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (k + u) * 100; // FILETIME is in 100 ns units
+#else
+    struct timespec ts;
+    if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// WaitStatisticsScope
+//////////////////////////////////////////////////////////////////////////////
+
+WaitStatisticsScope::WaitStatisticsScope(WaitStatistics *stats){
+    this->stats = stats;
+    this->cpu_start = WaitStatistics::threadCPUTimeNs();
+    wall.start();
+}
+
+WaitStatisticsScope::~WaitStatisticsScope(){
+    uint64_t cpu_end = WaitStatistics::threadCPUTimeNs();
+    stats->add(wall.nsecsElapsed(), cpu_end >= cpu_start ? cpu_end - cpu_start : 0);
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2024 Michael Bauer <mike.bauer@fau.de>
+
+//============================================================================
+// Name        : waitstatistics.h
+// Author      : Michael Bauer
+// Version     : 0.1
+// Copyright   : MIT
+// Description : Accounting of time spent in blocking wait loops
+//============================================================================
+
+#ifndef WAITSTATISTICS_H_
+#define WAITSTATISTICS_H_
+
+#include <QElapsedTimer>
+
+#include "stdint.h"
+
+/**
+ * @brief Accumulated wall clock and CPU time of the waiting thread for all waits of a session
+ */
+class WaitStatistics {
+
+public:
+    uint64_t waits;                             // Number of waits
+    uint64_t wall_ns;                           // Wall clock time spent waiting
+    uint64_t cpu_ns;                            // CPU time consumed by the waiting thread while waiting
+
+    WaitStatistics();
+
+    void reset();
+    void add(uint64_t wall_ns, uint64_t cpu_ns);
+
+    static uint64_t threadCPUTimeNs();
+};
+
+/**
+ * @brief Measures one wait from construction to destruction and adds it to the given statistics
+ */
+class WaitStatisticsScope {
+
+private:
+    WaitStatistics *stats;
+    QElapsedTimer wall;
+    uint64_t cpu_start;
+
+public:
+    WaitStatisticsScope(WaitStatistics *stats);
+    ~WaitStatisticsScope();
+};
+
+#endif /* WAITSTATISTICS_H_ */